@@ -0,0 +1,308 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Быстрое преобразование регистра и регистронезависимое сравнение/хэширование для базового диапазона ASCII
+
+    Repository: https://github.com/al-martyn1/umba
+*/
+
+#pragma once
+
+//----------------------------------------------------------------------------
+/*
+    Ядра работают с сырыми буферами (указатель + длина) и ничего не аллоцируют.
+    Преобразуются только латинские буквы 'A'-'Z'/'a'-'z', остальные символы
+    (в т.ч. байты UTF-8 и символы wchar_t за пределами ASCII) остаются как есть.
+
+    Для char:
+      - при наличии SSE2 обрабатывается по 16 байт за раз;
+      - иначе - по 8 байт за раз (SWAR на uint64_t).
+    Для других типов символов - посимвольно.
+
+    UMBA_ASCII_CASE_NO_SIMD - отключает SSE2 (остаётся SWAR).
+ */
+
+#include "zz_detect_environment.h"
+#include "internal/bit_utils.h"
+#include "internal/simd_detect.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(UMBA_SSE2_USED) && !defined(UMBA_ASCII_CASE_NO_SIMD)
+    #define UMBA_ASCII_CASE_SSE2
+#endif
+
+
+// umba::string_plus::
+namespace umba{
+namespace string_plus{
+
+
+//----------------------------------------------------------------------------
+//! Переводит символ в нижний регистр (только 'A'-'Z')
+template<typename CharType> inline
+CharType ascii_tolower_char( CharType ch )
+{
+    return (ch>=(CharType)'A' && ch<=(CharType)'Z') ? (CharType)(ch+((CharType)'a'-(CharType)'A')) : ch;
+}
+
+//----------------------------------------------------------------------------
+//! Переводит символ в верхний регистр (только 'a'-'z')
+template<typename CharType> inline
+CharType ascii_toupper_char( CharType ch )
+{
+    return (ch>=(CharType)'a' && ch<=(CharType)'z') ? (CharType)(ch-((CharType)'a'-(CharType)'A')) : ch;
+}
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace ascii_case_details{
+
+const std::uint64_t swarOnes = 0x0101010101010101ull;
+const std::uint64_t swarHigh = 0x8080808080808080ull;
+
+// Маска со старшим битом в каждом байте из диапазона [lo, hi]. Байты со старшим битом не попадают никогда
+inline
+std::uint64_t swarRangeMask( std::uint64_t x, unsigned char lo, unsigned char hi )
+{
+    std::uint64_t low7  = x & ~swarHigh;
+    std::uint64_t geLo  = low7 + (0x80u - lo    ) * swarOnes;
+    std::uint64_t gtHi  = low7 + (0x80u - hi - 1) * swarOnes;
+    return (geLo ^ gtHi) & ~x & swarHigh;
+}
+
+inline std::uint64_t swarToLower( std::uint64_t x ) { return x | (swarRangeMask(x, 'A', 'Z') >> 2); }
+inline std::uint64_t swarToUpper( std::uint64_t x ) { return x & ~(swarRangeMask(x, 'a', 'z') >> 2); }
+
+using umba::internal::load64;
+using umba::internal::store64;
+
+#if defined(UMBA_ASCII_CASE_SSE2)
+
+// 'A'..'Z' после сдвига на (0x80-'A') попадают в [-128, -103] (знаковое сравнение)
+inline
+__m128i sse2RangeMask( __m128i v, char lo, char hi )
+{
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + (hi - lo) + 1)));
+}
+
+inline __m128i sse2ToLower( __m128i v ) { return _mm_or_si128   (v, _mm_and_si128(sse2RangeMask(v, 'A', 'Z'), _mm_set1_epi8(0x20))); }
+inline __m128i sse2ToUpper( __m128i v ) { return _mm_andnot_si128(_mm_and_si128(sse2RangeMask(v, 'a', 'z'), _mm_set1_epi8(0x20)), v); }
+
+#endif
+
+template<bool ToLower> inline
+void convertCase( char *pDst, const char *pSrc, std::size_t n )
+{
+    std::size_t i = 0;
+
+    #if defined(UMBA_ASCII_CASE_SSE2)
+    for(; i+16<=n; i+=16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pSrc+i));
+        _mm_storeu_si128((__m128i*)(pDst+i), ToLower ? sse2ToLower(v) : sse2ToUpper(v));
+    }
+    #endif
+
+    for(; i+8<=n; i+=8)
+    {
+        std::uint64_t v = load64(pSrc+i);
+        store64(pDst+i, ToLower ? swarToLower(v) : swarToUpper(v));
+    }
+
+    for(; i!=n; ++i)
+        pDst[i] = ToLower ? ascii_tolower_char(pSrc[i]) : ascii_toupper_char(pSrc[i]);
+}
+
+inline
+std::uint64_t hashMix( std::uint64_t h, std::uint64_t v )
+{
+    h ^= v;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+    return h;
+}
+
+inline
+std::uint64_t hashFinal( std::uint64_t h )
+{
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace ascii_case_details
+//! @endcond
+
+
+//----------------------------------------------------------------------------
+//! Переводит буфер в нижний регистр (на месте)
+template<typename CharType> inline
+void ascii_tolower( CharType *p, std::size_t n )
+{
+    for(std::size_t i=0; i!=n; ++i)
+        p[i] = ascii_tolower_char(p[i]);
+}
+
+//! Переводит буфер в нижний регистр (на месте), версия для char
+inline
+void ascii_tolower( char *p, std::size_t n )
+{
+    ascii_case_details::convertCase<true>(p, p, n);
+}
+
+//----------------------------------------------------------------------------
+//! Переводит буфер в верхний регистр (на месте)
+template<typename CharType> inline
+void ascii_toupper( CharType *p, std::size_t n )
+{
+    for(std::size_t i=0; i!=n; ++i)
+        p[i] = ascii_toupper_char(p[i]);
+}
+
+//! Переводит буфер в верхний регистр (на месте), версия для char
+inline
+void ascii_toupper( char *p, std::size_t n )
+{
+    ascii_case_details::convertCase<false>(p, p, n);
+}
+
+//----------------------------------------------------------------------------
+//! Копирует буфер, переводя в нижний регистр. Буферы не должны перекрываться (кроме pDst==pSrc)
+template<typename CharType> inline
+void ascii_tolower_copy( CharType *pDst, const CharType *pSrc, std::size_t n )
+{
+    for(std::size_t i=0; i!=n; ++i)
+        pDst[i] = ascii_tolower_char(pSrc[i]);
+}
+
+//! Копирует буфер, переводя в нижний регистр, версия для char
+inline
+void ascii_tolower_copy( char *pDst, const char *pSrc, std::size_t n )
+{
+    ascii_case_details::convertCase<true>(pDst, pSrc, n);
+}
+
+//----------------------------------------------------------------------------
+//! Копирует буфер, переводя в верхний регистр. Буферы не должны перекрываться (кроме pDst==pSrc)
+template<typename CharType> inline
+void ascii_toupper_copy( CharType *pDst, const CharType *pSrc, std::size_t n )
+{
+    for(std::size_t i=0; i!=n; ++i)
+        pDst[i] = ascii_toupper_char(pSrc[i]);
+}
+
+//! Копирует буфер, переводя в верхний регистр, версия для char
+inline
+void ascii_toupper_copy( char *pDst, const char *pSrc, std::size_t n )
+{
+    ascii_case_details::convertCase<false>(pDst, pSrc, n);
+}
+
+//----------------------------------------------------------------------------
+//! Регистронезависимое сравнение. \returns -1, 0, 1
+/*! Результат совпадает со сравнением копий, переведённых в нижний регистр (символы сравниваются как беззнаковые)
+ */
+template<typename CharType> inline
+int ascii_icase_compare( const CharType *pA, std::size_t nA, const CharType *pB, std::size_t nB )
+{
+    typedef typename std::make_unsigned<CharType>::type UCharType;
+
+    std::size_t n = nA<nB ? nA : nB;
+    for(std::size_t i=0; i!=n; ++i)
+    {
+        UCharType a = (UCharType)ascii_tolower_char(pA[i]);
+        UCharType b = (UCharType)ascii_tolower_char(pB[i]);
+        if (a!=b)
+            return a<b ? -1 : 1;
+    }
+
+    return nA==nB ? 0 : (nA<nB ? -1 : 1);
+}
+
+//! Регистронезависимое сравнение, версия для char. \returns -1, 0, 1
+inline
+int ascii_icase_compare( const char *pA, std::size_t nA, const char *pB, std::size_t nB )
+{
+    using namespace ascii_case_details;
+
+    std::size_t n = nA<nB ? nA : nB;
+    std::size_t i = 0;
+
+    // Блоки целиком проходим только пока они совпадают, место различия ищем посимвольно
+    #if defined(UMBA_ASCII_CASE_SSE2)
+    for(; i+16<=n; i+=16)
+    {
+        __m128i a = sse2ToLower(_mm_loadu_si128((const __m128i*)(pA+i)));
+        __m128i b = sse2ToLower(_mm_loadu_si128((const __m128i*)(pB+i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))!=0xFFFF)
+            break;
+    }
+    #endif
+
+    for(; i+8<=n; i+=8)
+    {
+        if (swarToLower(load64(pA+i))!=swarToLower(load64(pB+i)))
+            break;
+    }
+
+    for(; i!=n; ++i)
+    {
+        unsigned char a = (unsigned char)ascii_tolower_char(pA[i]);
+        unsigned char b = (unsigned char)ascii_tolower_char(pB[i]);
+        if (a!=b)
+            return a<b ? -1 : 1;
+    }
+
+    return nA==nB ? 0 : (nA<nB ? -1 : 1);
+}
+
+//----------------------------------------------------------------------------
+//! Регистронезависимая проверка на равенство
+template<typename CharType> inline
+bool ascii_icase_equal( const CharType *pA, std::size_t nA, const CharType *pB, std::size_t nB )
+{
+    return nA==nB && ascii_icase_compare(pA, nA, pB, nB)==0;
+}
+
+//----------------------------------------------------------------------------
+//! Регистронезависимый хэш. Строки, равные без учёта регистра, имеют одинаковый хэш
+template<typename CharType> inline
+std::size_t ascii_icase_hash( const CharType *p, std::size_t n )
+{
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ (std::uint64_t)n;
+    for(std::size_t i=0; i!=n; ++i)
+        h = ascii_case_details::hashMix(h, (std::uint64_t)(typename std::make_unsigned<CharType>::type)ascii_tolower_char(p[i]));
+    return (std::size_t)ascii_case_details::hashFinal(h);
+}
+
+//! Регистронезависимый хэш, версия для char - по 8 байт за раз
+inline
+std::size_t ascii_icase_hash( const char *p, std::size_t n )
+{
+    using namespace ascii_case_details;
+
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ (std::uint64_t)n;
+    std::size_t i = 0;
+    for(; i+8<=n; i+=8)
+        h = hashMix(h, swarToLower(load64(p+i)));
+
+    if (i!=n)
+    {
+        char tail[8] = { 0 };
+        std::memcpy(tail, p+i, n-i);
+        h = hashMix(h, swarToLower(load64(tail)));
+    }
+
+    return (std::size_t)hashFinal(h);
+}
+
+
+} // namespace string_plus
+} // namespace umba
+
@@ -1,7 +1,7 @@
 /*! \file
     \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
     \copyright (c) 2018-2026 Alexander Martynov
-    \brief Автоматический захват и освобождение ресурса. Объект-ресурс должен предоставлять методы lock и unlock.
+    \brief Автоматический захват и освобождение ресурса. Объект-ресурс должен предоставлять методы lock и unlock (lockShared и unlockShared - для захвата на чтение).
 
     Repository: https://github.com/al-martyn1/umba
 */
@@ -67,4 +67,35 @@ class AutoLock
 }; // class AutoLock
 
 
+
+//! Класс-обертка для автоматического захвата объектов блокировки в разделяемом режиме (на чтение).
+/*! Объект блокировки должен предоставлять методы lockShared и unlockShared (например, umba::RwLock).
+    Для захвата в эксклюзивном режиме используется AutoLock.
+ */
+template<typename LockObject>
+class SharedAutoLock
+{
+
+    public:
+
+        //! Сохраняет ссылку на объект блокировки и производит его захват на чтение
+        SharedAutoLock( LockObject &lockObject )
+            : m_lockObject(lockObject)
+        {
+            m_lockObject.lockShared();
+        }
+
+        //! Освобождает объект блокировки
+        ~SharedAutoLock()
+        {
+            m_lockObject.unlockShared();
+        }
+
+    private:
+
+        LockObject &m_lockObject;
+
+}; // class SharedAutoLock
+
+
 } // namespace umba
@@ -30,6 +30,15 @@
     #include "winconhelpers.h"
 #endif
 
+#if !defined(UMBA_MCU_USED) && !defined(WIN32) && !defined(_WIN32)
+    #include <cerrno>
+    #include <vector>
+    //
+    #include <poll.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
 //-----------------------------------------------------------------------------
 
 // umba::term::colors::
@@ -211,6 +220,144 @@ protected:
 
 
 
+//-----------------------------------------------------------------------------
+//! Буферизующая обёртка над другим ICharWriter
+/*!
+    Символы и мелкие куски накапливаются в собственном буфере и передаются целевому
+    писателю одним вызовом writeBuf - при заполнении буфера и при явном вызове flush.
+    Куски, не меньшие размера буфера, передаются напрямую, минуя буфер.
+
+    Все терминальные операции (цвета, позиционирование, каретка) перед передачей целевому
+    писателю сбрасывают буфер, поэтому порядок вывода сохраняется.
+
+    Содержимое буфера сбрасывается также в деструкторе (без вызова target.flush()).
+
+    \tparam BufSize размер буфера
+ */
+template<size_t BufSize = 1024>
+struct BufferedCharWriter : UMBA_IMPLEMENTS ICharWriter
+{
+
+    UMBA_NON_COPYABLE_STRUCT(BufferedCharWriter)
+
+    //! Конструктор, принимающий ссылку на целевой писатель
+    BufferedCharWriter(ICharWriter &target) : m_target(target), m_bufLen(0) {}
+
+    ~BufferedCharWriter()
+    {
+        flushBuf();
+    }
+
+    //! Запись символа
+    virtual
+    void writeChar( char ch ) override
+    {
+        if (m_bufLen==BufSize)
+            flushBuf();
+        m_buf[m_bufLen++] = (uint8_t)ch;
+    }
+
+    //! Запись буфера
+    virtual
+    void writeBuf( const uint8_t* pBuf, size_t len ) override
+    {
+        if (len <= BufSize-m_bufLen)
+        {
+            std::memcpy(&m_buf[m_bufLen], pBuf, len);
+            m_bufLen += len;
+            return;
+        }
+
+        flushBuf();
+
+        if (len>=BufSize)
+        {
+            m_target.writeBuf(pBuf, len);
+            return;
+        }
+
+        std::memcpy(&m_buf[0], pBuf, len);
+        m_bufLen = len;
+    }
+
+    //! Запись ASCII-Z строки
+    virtual
+    void writeString( const char* str ) override
+    {
+        writeBuf( (const uint8_t*)str, std::strlen(str) );
+    }
+
+    //! Передаёт накопленное целевому писателю и сбрасывает его буферы
+    virtual
+    void flush() override
+    {
+        flushBuf();
+        m_target.flush();
+    }
+
+    virtual
+    void waitFlushDone() override
+    {
+        m_target.waitFlushDone();
+    }
+
+    //! Передаёт накопленное целевому писателю, не вызывая у него flush
+    void flushBuf()
+    {
+        if (!m_bufLen)
+            return;
+        m_target.writeBuf(&m_buf[0], m_bufLen);
+        m_bufLen = 0;
+    }
+
+    //! Количество накопленных байт
+    size_t getBufferedSize() const { return m_bufLen; }
+
+    //! Целевой писатель
+    ICharWriter& getTarget() { return m_target; }
+
+    virtual void putDefEndl()          override { flushBuf(); m_target.putDefEndl(); }
+    virtual void putEndl()             override { flushBuf(); m_target.putEndl();    }
+    virtual void putCR()               override { flushBuf(); m_target.putCR();      }
+    virtual void putFF()               override { flushBuf(); m_target.putFF();      }
+
+    virtual bool isTextMode()          override { return m_target.isTextMode();      }
+    virtual bool isTerminal()    const override { return m_target.isTerminal();      }
+    virtual bool isAnsiTerminal() const override { return m_target.isAnsiTerminal(); }
+
+    virtual size_t getNonBlockMax()    override { return BufSize-m_bufLen; }
+
+    virtual void setTermColors(term::colors::SgrColor clr) override { flushBuf(); m_target.setTermColors(clr); }
+    virtual void setDefaultTermColors()                    override { flushBuf(); m_target.setDefaultTermColors(); }
+
+    virtual void terminalSetCaret( int csz )                override { flushBuf(); m_target.terminalSetCaret(csz); }
+    virtual void terminalSetSpinnerMode( bool m )           override { flushBuf(); m_target.terminalSetSpinnerMode(m); }
+    virtual void terminalMoveToAbs0()                       override { flushBuf(); m_target.terminalMoveToAbs0(); }
+    virtual void terminalMoveRelative(int direction, int n) override { flushBuf(); m_target.terminalMoveRelative(direction, n); }
+    virtual void terminalMoveToNextLine(int n)              override { flushBuf(); m_target.terminalMoveToNextLine(n); }
+    virtual void terminalMoveToPrevLine(int n)              override { flushBuf(); m_target.terminalMoveToPrevLine(n); }
+    virtual void terminalMoveToAbsCol(int n)                override { flushBuf(); m_target.terminalMoveToAbsCol(n); }
+    virtual void terminalMoveToLineStart()                  override { flushBuf(); m_target.terminalMoveToLineStart(); }
+    virtual void terminalMoveToAbsPos( int x, int y )       override { flushBuf(); m_target.terminalMoveToAbsPos(x, y); }
+    virtual void terminalClearScreenEnd()                   override { flushBuf(); m_target.terminalClearScreenEnd(); }
+    virtual void terminalClearScreen()                      override { flushBuf(); m_target.terminalClearScreen(); }
+    virtual void terminalClearLine()                        override { flushBuf(); m_target.terminalClearLine(); }
+    virtual void terminalClearLineEnd()                     override { flushBuf(); m_target.terminalClearLineEnd(); }
+
+protected:
+
+    ICharWriter  &m_target;         //!< Целевой писатель
+    size_t        m_bufLen;         //!< Количество накопленных байт
+    uint8_t       m_buf[BufSize];   //!< Буфер
+
+}; // struct BufferedCharWriter
+
+//-----------------------------------------------------------------------------
+
+
+
+
+
 
 //-----------------------------------------------------------------------------
 #if !defined(UMBA_MCU_USED)
@@ -409,6 +556,7 @@ public:
         }
         else
         {
+        #if ( (defined(WIN32) || defined(_WIN32)) && !defined(UMBA_MCU_USED) && !defined(UMBA_DISABLE_AUTO_ENCODING) )
             if (waitForFirstUtfChar()) // ждём первый символ UTF8 последовательности
             {
                 std::size_t uSeqLen = umba::getNumberOfCharsUtf8((umba::utf8_char_t)ch);
@@ -446,17 +594,52 @@ public:
 
             m_utfCollectCount = 0;
             m_utfSeqLen       = 0;
+        #endif
         }
     }
 
 
-/*
-    // Используется дефолтная реализация
+    //! Запись буфера целиком, без посимвольной диспетчеризации
+    /*! Если требуется перекодирование UTF-8 в кодировку консоли (Win32), используется посимвольная запись
+     */
+    virtual
     void writeBuf( const uint8_t* pBuf, size_t len ) override
     {
-        m_stream.write( (const std::ostream::char_type*)pBuf, len );
+        if (needUtfCollect())
+        {
+            ICharWriter::writeBuf(pBuf, len);
+            return;
+        }
+
+        m_stream.write( (const std::ostream::char_type*)pBuf, (std::streamsize)len );
+
+        #if defined(WIN32) || defined(_WIN32)
+
+            #ifndef UMBA_CHAR_WRITTERS_DISABLE_OUTPUT_TO_DEBUGGER
+                if (&m_stream==&std::cout || &m_stream==&std::cerr)
+                {
+                    char tmp[257];
+                    while(len)
+                    {
+                        std::size_t partLen = std::min(len, (std::size_t)256);
+                        std::memcpy(&tmp[0], pBuf, partLen);
+                        tmp[partLen] = 0;
+                        OutputDebugStringA( tmp );
+                        pBuf += partLen;
+                        len  -= partLen;
+                    }
+                }
+            #endif
+
+        #endif
+    }
+
+    //! Запись ASCII-Z строки целиком
+    virtual
+    void writeString( const char* str ) override
+    {
+        writeBuf( (const uint8_t*)str, std::strlen(str) );
     }
-*/
 
     //! Реализация flush - сброс кешированных данных
     virtual
@@ -595,14 +778,14 @@ public:
 protected:
 
 
-    void termIncrementVerticalPos()
-    {
-        consoleCoord.X  = 0;
-        consoleCoord.Y += 1;
-    }
-
     #if defined(WIN32) || defined(_WIN32)
 
+        void termIncrementVerticalPos()
+        {
+            consoleCoord.X  = 0;
+            consoleCoord.Y += 1;
+        }
+
         COORD getConsoleCursorPosition() const
         {
             CONSOLE_SCREEN_BUFFER_INFO csbiInfo;
@@ -919,6 +1102,233 @@ protected:
 
 
 
+
+#if !defined(WIN32) && !defined(_WIN32)
+
+#if !defined(UMBA_FD_CHAR_WRITER_POLL_TIMEOUT_MS)
+    //! Максимальное время ожидания готовности неблокирующего дескриптора к записи в FdCharWriter, мс
+    #define UMBA_FD_CHAR_WRITER_POLL_TIMEOUT_MS   5000
+#endif
+
+//-----------------------------------------------------------------------------
+//! Реализация CharWriter, производящая вывод в файловый дескриптор (STDOUT_FILENO/STDERR_FILENO и т.п.) через write/writev
+/*!
+    В отличие от StdStreamCharWriter, не использует iostream и его синхронизацию с stdio.
+    Вывод накапливается во внутреннем буфере и отправляется системным вызовом при заполнении
+    буфера, при явном вызове flush и в деструкторе. Если новый кусок не помещается в буфер,
+    буфер и кусок уходят одним вызовом writev.
+
+    Терминальные ESC-последовательности тоже пишутся в буфер - цвет и позиционирование
+    не порождают отдельных системных вызовов.
+
+    Если в тот же дескриптор пишут и через std::cout/printf, то перед ними нужно вызывать flush.
+    Ошибки записи (кроме EINTR) не бросают исключений - оставшиеся данные отбрасываются,
+    а код ошибки доступен через getLastError(). Для неблокирующего дескриптора при EAGAIN
+    ожидается готовность к записи (poll), но не дольше UMBA_FD_CHAR_WRITER_POLL_TIMEOUT_MS,
+    после чего запись прекращается с ошибкой EAGAIN.
+ */
+struct FdCharWriter : UMBA_IMPLEMENTS ICharWriter
+{
+
+    UMBA_NON_COPYABLE_STRUCT(FdCharWriter)
+
+    //! Конструктор, принимающий дескриптор и размер буфера
+    explicit FdCharWriter(int fd, size_t bufSize = 8192)
+    : m_fd(fd)
+    , m_buf(bufSize ? bufSize : 1)
+    , m_bufLen(0)
+    , m_lastError(0)
+    , m_consoleType( ::isatty(fd) ? term::UMBA_CONSOLETYPE_ANSI_TERMINAL : term::UMBA_CONSOLETYPE_FILE )
+    {}
+
+    ~FdCharWriter()
+    {
+        flush();
+    }
+
+    //! Принудительное задание типа консоли
+    void forceSetConsoleType( term::ConsoleType consoleType )
+    {
+        m_consoleType = consoleType;
+    }
+
+    int getFd() const { return m_fd; }
+
+    //! Последняя ошибка записи (errno), 0 - ошибок не было
+    int getLastError() const { return m_lastError; }
+
+    //! Количество накопленных байт
+    size_t getBufferedSize() const { return m_bufLen; }
+
+    //! Запись символа
+    virtual
+    void writeChar( char ch ) override
+    {
+        if (m_bufLen==m_buf.size())
+            flush();
+        m_buf[m_bufLen++] = (uint8_t)ch;
+    }
+
+    //! Запись буфера
+    virtual
+    void writeBuf( const uint8_t* pBuf, size_t len ) override
+    {
+        if (len <= m_buf.size()-m_bufLen)
+        {
+            std::memcpy(&m_buf[m_bufLen], pBuf, len);
+            m_bufLen += len;
+            return;
+        }
+
+        struct iovec iov[2];
+        iov[0].iov_base = (void*)&m_buf[0];
+        iov[0].iov_len  = m_bufLen;
+        iov[1].iov_base = (void*)pBuf;
+        iov[1].iov_len  = len;
+
+        writeAll(&iov[0], 2);
+        m_bufLen = 0;
+    }
+
+    //! Запись ASCII-Z строки
+    virtual
+    void writeString( const char* str ) override
+    {
+        writeBuf( (const uint8_t*)str, std::strlen(str) );
+    }
+
+    //! Отправляет накопленное в дескриптор
+    virtual
+    void flush() override
+    {
+        if (!m_bufLen)
+            return;
+
+        struct iovec iov;
+        iov.iov_base = (void*)&m_buf[0];
+        iov.iov_len  = m_bufLen;
+
+        writeAll(&iov, 1);
+        m_bufLen = 0;
+    }
+
+    virtual
+    bool isTerminal() const override
+    {
+        return m_consoleType != term::UMBA_CONSOLETYPE_FILE;
+    }
+
+    virtual
+    bool isAnsiTerminal() const override
+    {
+        return m_consoleType == term::UMBA_CONSOLETYPE_ANSI_TERMINAL;
+    }
+
+    virtual
+    size_t getNonBlockMax() override
+    {
+        return m_buf.size()-m_bufLen;
+    }
+
+    virtual void putCR() override { if (isTerminal()) writeChar( '\r' ); }
+    virtual void putFF() override { if (isTerminal()) writeChar( '\f' ); }
+
+    virtual void setTermColors(term::colors::SgrColor clr) override { if (isAnsiTerminal()) setAnsiTermColorsImpl(clr); }
+    virtual void setDefaultTermColors()                    override { if (isAnsiTerminal()) setAnsiTermDefaultColorsImpl(); }
+
+    virtual void terminalSetCaret( int csz )                override { if (isAnsiTerminal()) terminalSetCaretImpl(csz); }
+    virtual void terminalMoveToAbs0()                       override { if (isAnsiTerminal()) terminalMoveToAbs0Impl(); }
+    virtual void terminalMoveRelative(int direction, int n) override { if (isAnsiTerminal()) terminalMoveRelativeImpl(direction, n); }
+    virtual void terminalMoveToNextLine(int n)              override { if (isAnsiTerminal()) terminalMoveToNextLineImpl(n); }
+    virtual void terminalMoveToPrevLine(int n)              override { if (isAnsiTerminal()) terminalMoveToPrevLineImpl(n); }
+    virtual void terminalMoveToAbsCol(int n)                override { if (isAnsiTerminal()) terminalMoveToAbsColImpl(n); }
+    virtual void terminalMoveToLineStart()                  override { if (isAnsiTerminal()) terminalMoveToLineStartImpl(); }
+    virtual void terminalMoveToAbsPos( int x, int y )       override { if (isAnsiTerminal()) terminalMoveToAbsPosImpl(x, y); }
+    virtual void terminalClearScreenEnd()                   override { if (isAnsiTerminal()) terminalClearScreenEndImpl(); }
+    virtual void terminalClearScreen()                      override { if (isAnsiTerminal()) terminalClearScreenImpl(); }
+    virtual void terminalClearLine()                        override { if (isAnsiTerminal()) terminalClearLineImpl(); }
+    virtual void terminalClearLineEnd()                     override { if (isAnsiTerminal()) terminalClearLineEndImpl(); }
+
+protected:
+
+    //! Запись всех частей, с дозаписью после частичной записи
+    void writeAll(struct iovec *pIov, int iovCnt)
+    {
+        while(iovCnt)
+        {
+            if (!pIov->iov_len)
+            {
+                ++pIov; --iovCnt;
+                continue;
+            }
+
+            ssize_t res = ::writev(m_fd, pIov, iovCnt);
+            if (res<0)
+            {
+                if (errno==EINTR)
+                    continue;
+
+                if ((errno==EAGAIN || errno==EWOULDBLOCK) && waitWritable())
+                    continue;
+
+                m_lastError = errno;
+                return;
+            }
+
+            size_t written = (size_t)res;
+            while(iovCnt && written>=pIov->iov_len)
+            {
+                written -= pIov->iov_len;
+                ++pIov; --iovCnt;
+            }
+
+            if (iovCnt)
+            {
+                pIov->iov_base  = (void*)((uint8_t*)pIov->iov_base + written);
+                pIov->iov_len  -= written;
+            }
+        }
+    }
+
+    //! Ожидание готовности неблокирующего дескриптора к записи. При таймауте или ошибке возвращает false, errno - код ошибки
+    bool waitWritable()
+    {
+        struct pollfd pfd;
+        pfd.fd      = m_fd;
+        pfd.events  = POLLOUT;
+        pfd.revents = 0;
+
+        for(;;)
+        {
+            int res = ::poll(&pfd, 1, UMBA_FD_CHAR_WRITER_POLL_TIMEOUT_MS);
+            if (res>0)
+                return true; // POLLERR/POLLHUP тоже - ошибку вернёт следующий writev
+
+            if (res==0)
+            {
+                errno = EAGAIN;
+                return false;
+            }
+
+            if (errno!=EINTR)
+                return false;
+        }
+    }
+
+    int                   m_fd;           //!< Дескриптор
+    std::vector<uint8_t>  m_buf;          //!< Буфер
+    size_t                m_bufLen;       //!< Количество накопленных байт
+    int                   m_lastError;    //!< Последняя ошибка записи
+    term::ConsoleType     m_consoleType;  //!< Тип консоли
+
+}; // struct FdCharWriter
+
+//-----------------------------------------------------------------------------
+
+#endif // !defined(WIN32) && !defined(_WIN32)
+
+
+
 #else /* UMBA_MCU_USED defined */
 
 
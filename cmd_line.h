@@ -35,6 +35,9 @@
 #include <unordered_map>
 #include <iterator>
 #include <functional>
+#include <memory>
+#include <cstring>
+#include <string_view>
 
 //
 #include <sys/stat.h>
@@ -305,14 +308,22 @@ namespace command_line{
 
 
 
+//! Версия без копирования строки - для пакетного разбора options-файлов
 inline
-bool isComment( std::string line )
+bool isComment( std::string_view line )
 {
-    umba::string_plus::trim(line);
+    while(!line.empty() && umba::string_plus::is_whitespace(line.front()))
+        line.remove_prefix(1);
 
     return umba::string_plus::starts_with( line, ";" ) || umba::string_plus::starts_with( line, "#" ) || umba::string_plus::starts_with( line, "//" );
 }
 
+inline
+bool isComment( const std::string &line )
+{
+    return isComment( std::string_view(line) );
+}
+
 inline
 bool isComment( std::wstring line )
 {
@@ -471,6 +482,248 @@ bool readBinaryFile( const std::string &fileName, std::string &data )
     return readBinaryFile( input, data );
 }
 
+//-----------------------------------------------------------------------------
+//! Режим разбиения options-файла на аргументы
+enum class OptionsFileTokenizeMode
+{
+    lines,   //!< Как readOptionsFile - один аргумент на строку, строка тримится, пустые строки и комментарии пропускаются
+    quoted   //!< Аргументы разделяются пробелами (как в @file у GCC), поддерживаются кавычки '' и "", и экранирование \" \' \\ и пробелов
+};
+
+//-----------------------------------------------------------------------------
+//! Аргумент, загруженный из options-файла
+struct OptionsFileArg
+{
+    std::string_view   text;     //!< Текст аргумента, указывает в буфер OptionsFileArgs
+    std::size_t        fileIdx;  //!< Индекс файла в OptionsFileArgs::fileNames - относительно него разрешаются относительные пути
+};
+
+//-----------------------------------------------------------------------------
+//! Пакетный загрузчик options/response-файлов
+/*! Каждый файл читается целиком одним вызовом и разбивается на аргументы за один проход прямо в своём буфере
+    (экранирование раскрывается на месте), аргументы - string_view в эти буферы, без копирования каждой строки.
+    Буферы хранятся в загрузчике, поэтому аргументы действительны, пока жив загрузчик.
+
+    Вложенные @file раскрываются загрузчиком (путь - относительно файла, который его включает),
+    циклические включения являются ошибкой, повторное включение уже загруженного файла
+    пропускается (если не отключено через deduplicate).
+ */
+class OptionsFileArgs
+{
+
+public:
+
+    OptionsFileTokenizeMode    tokenizeMode  = OptionsFileTokenizeMode::lines;  //!< Режим разбиения на аргументы
+    bool                       expandNested  = true;   //!< Раскрывать вложенные @file
+    bool                       deduplicate   = true;   //!< Не включать повторно уже загруженный файл
+
+    std::vector<std::string>   fileNames;     //!< Загруженные файлы
+    std::vector<OptionsFileArg> args;         //!< Аргументы в порядке следования
+    std::string                errorMessage;  //!< Текст ошибки, если load вернул false
+
+    //! Загружает файл (и вложенные). Возвращает false при ошибке, текст ошибки - в errorMessage
+    bool load( const std::string &fileName )
+    {
+        errorMessage.clear();
+        std::vector<std::string> includeStack;
+        return loadImpl( umba::filename::makeCanonical(fileName), includeStack );
+    }
+
+    //! Очищает загрузчик, освобождая буферы
+    void clear()
+    {
+        fileNames.clear();
+        args.clear();
+        errorMessage.clear();
+        m_buffers.clear();
+        m_loadedKeys.clear();
+    }
+
+    //! Разбивает буфер на строки-аргументы на месте. Аргументы дописываются в resVec
+    static void tokenizeLines( char *pBuf, std::size_t size, std::size_t fileIdx, std::vector<OptionsFileArg> &resVec )
+    {
+        char *p = pBuf, *pEnd = pBuf+size;
+        while(p!=pEnd)
+        {
+            char *pLineEnd = (char*)std::memchr(p, '\n', (std::size_t)(pEnd-p));
+            if (!pLineEnd)
+                pLineEnd = pEnd;
+
+            char *b = p, *e = pLineEnd;
+            p = pLineEnd==pEnd ? pEnd : pLineEnd+1;
+
+            while(b!=e && isOptionsFileSpace(*b))    ++b;
+            while(b!=e && isOptionsFileSpace(*(e-1))) --e;
+
+            if (b==e)
+                continue;
+
+            std::string_view line = std::string_view(b, (std::size_t)(e-b));
+            if (isComment(line))
+                continue;
+
+            resVec.push_back( OptionsFileArg{ line, fileIdx } );
+        }
+    }
+
+    //! Разбивает буфер на аргументы, разделённые пробелами, с учётом кавычек и экранирования, на месте. Аргументы дописываются в resVec
+    /*! Комментарий - от '#' или ';' в начале аргумента до конца строки.
+        Возвращает false, если кавычка не закрыта до конца буфера
+     */
+    static bool tokenizeQuoted( char *pBuf, std::size_t size, std::size_t fileIdx, std::vector<OptionsFileArg> &resVec )
+    {
+        char *r = pBuf, *pEnd = pBuf+size;
+        while(r!=pEnd)
+        {
+            if (isOptionsFileSpace(*r) || *r=='\n')
+            {
+                ++r;
+                continue;
+            }
+
+            if (*r=='#' || *r==';')
+            {
+                char *pLineEnd = (char*)std::memchr(r, '\n', (std::size_t)(pEnd-r));
+                r = pLineEnd ? pLineEnd : pEnd;
+                continue;
+            }
+
+            char *argStart = r;
+            char *w        = r;
+            char quot      = 0;
+
+            for(; r!=pEnd; ++r)
+            {
+                char ch = *r;
+
+                if (ch=='\\' && (r+1)!=pEnd)
+                {
+                    char next = r[1];
+                    if (next=='\\' || next=='\"' || next=='\'' || (!quot && (isOptionsFileSpace(next) || next=='\n')))
+                    {
+                        *w++ = next;
+                        ++r;
+                        continue;
+                    }
+                }
+
+                if (quot)
+                {
+                    if (ch==quot)
+                        quot = 0;
+                    else
+                        *w++ = ch;
+                    continue;
+                }
+
+                if (ch=='\"' || ch=='\'')
+                {
+                    quot = ch;
+                    continue;
+                }
+
+                if (isOptionsFileSpace(ch) || ch=='\n')
+                    break;
+
+                *w++ = ch;
+            }
+
+            if (quot)
+                return false;
+
+            resVec.push_back( OptionsFileArg{ std::string_view(argStart, (std::size_t)(w-argStart)), fileIdx } );
+        }
+
+        return true;
+    }
+
+
+protected:
+
+    static bool isOptionsFileSpace( char ch )
+    {
+        return ch==' ' || ch=='\t' || ch=='\r' || ch=='\v' || ch=='\f';
+    }
+
+    bool loadImpl( const std::string &fileName, std::vector<std::string> &includeStack )
+    {
+        std::string key = umba::filename::makeCanonicalForCompare(fileName);
+
+        if (std::find(includeStack.begin(), includeStack.end(), key)!=includeStack.end())
+        {
+            errorMessage = std::string("Recursive options file inclusion - '") + fileName + std::string("'");
+            return false;
+        }
+
+        if (deduplicate && m_loadedKeys.find(key)!=m_loadedKeys.end())
+            return true;
+
+        m_loadedKeys.insert(key);
+
+        std::string fileDataStr;
+        if (!filesys::readFile(fileName, fileDataStr))
+        {
+            errorMessage = std::string("Failed to read options file - '") + fileName + std::string("'");
+            return false;
+        }
+
+        #if !defined(UMBA_DISABLE_AUTO_ENCODING)
+        fileDataStr = encoding::toUnicodeAuto(fileDataStr);
+        #endif
+
+        // Буфер не перемещается после заполнения - string_view аргументов остаются валидными
+        m_buffers.emplace_back(std::make_unique<std::string>(std::move(fileDataStr)));
+        std::string &buf = *m_buffers.back();
+
+        std::size_t fileIdx = fileNames.size();
+        fileNames.push_back(fileName);
+
+        std::vector<OptionsFileArg> fileArgs;
+        fileArgs.reserve(buf.size()/16);
+
+        if (tokenizeMode==OptionsFileTokenizeMode::quoted)
+        {
+            if (!tokenizeQuoted(&buf[0], buf.size(), fileIdx, fileArgs))
+            {
+                errorMessage = std::string("Unterminated quote in options file - '") + fileName + std::string("'");
+                return false;
+            }
+        }
+        else
+            tokenizeLines(&buf[0], buf.size(), fileIdx, fileArgs);
+
+        if (!expandNested)
+        {
+            args.insert(args.end(), fileArgs.begin(), fileArgs.end());
+            return true;
+        }
+
+        includeStack.push_back(key);
+
+        for(const auto &a : fileArgs)
+        {
+            if (a.text.size()<2 || a.text[0]!='@')
+            {
+                args.push_back(a);
+                continue;
+            }
+
+            std::string nestedName = umba::filename::makeCanonical( umba::filename::makeAbsPath( std::string(a.text.substr(1)), umba::filename::getPath(fileName) ) );
+            if (!loadImpl(nestedName, includeStack))
+                return false;
+        }
+
+        includeStack.pop_back();
+
+        return true;
+    }
+
+
+    std::vector< std::unique_ptr<std::string> >  m_buffers;
+    std::unordered_set<std::string>              m_loadedKeys;
+
+}; // class OptionsFileArgs
+
 //-----------------------------------------------------------------------------
 inline
 bool isValidOptionNameChar(char ch)
@@ -2945,6 +3198,7 @@ struct ArgsParser
     bool                      quet                   = false;
     bool                      mustExit               = false; //!< prevent to continue parsing
     std::set<StringType>      argsNeedHelp           ;
+    std::string               errorMessage           ; //!< Ошибка, обнаруженная самим ArgsParser (а не argParser'ом), например, при загрузке options-файла
 
 
     ArgParser                             argParser;
@@ -3161,6 +3415,65 @@ struct ArgsParser
         return true;
     }
 
+    //! Разбор options-файла пакетным загрузчиком OptionsFileArgs - для файлов с большим количеством аргументов
+    /*! Вложенные @file раскрываются загрузчиком с проверкой на циклы. На время обработки аргументов имя файла,
+        из которого они получены, лежит на вершине optFiles, так что makeAbsPath работает как и при разборе response-файла.
+        Returns true if ok, false if some error occured. Ошибку загрузки файла выводит вызывающий (обычно argParser,
+        как и для прочих ошибок разбора), текст ошибки - в errorMessage.
+     */
+    bool parseOptionsFileBulk( const StringType &optionsFileName, OptionsFileTokenizeMode tokenizeMode = OptionsFileTokenizeMode::lines )
+    {
+        OptionsFileArgs optArgs;
+        optArgs.tokenizeMode = tokenizeMode;
+
+        bool loadRes = false;
+        if constexpr (sizeof(typename StringType::value_type)>sizeof(char))
+            loadRes = optArgs.load(toUtf8(optionsFileName));
+        else
+            loadRes = optArgs.load(optionsFileName);
+
+        if (!loadRes)
+        {
+            errorMessage = optArgs.errorMessage;
+            /* ctx. */ mustExit = true;
+            return false;
+        }
+
+        std::size_t curFileIdx = (std::size_t)-1;
+
+        for( const auto &a : optArgs.args )
+        {
+            if (a.fileIdx!=curFileIdx)
+            {
+                if (curFileIdx!=(std::size_t)-1)
+                    popOptionsFileName();
+                curFileIdx = a.fileIdx;
+                if constexpr (sizeof(typename StringType::value_type)>sizeof(char))
+                    pushOptionsFileName(fromUtf8(optArgs.fileNames[curFileIdx]));
+                else
+                    pushOptionsFileName(optArgs.fileNames[curFileIdx]);
+            }
+
+            int paRes = 0;
+            if constexpr (sizeof(typename StringType::value_type)>sizeof(char))
+                paRes = callArgParser(fromUtf8(std::string(a.text)), true, true);
+            else
+                paRes = callArgParser(StringType(a.text), true, true);
+
+            if (paRes)
+            {
+                popOptionsFileName();
+                /* ctx. */ mustExit = true;
+                return paRes<0 ? false : true;
+            }
+        }
+
+        if (curFileIdx!=(std::size_t)-1)
+            popOptionsFileName();
+
+        return true;
+    }
+
     //! Parses predefined files
     /*!
         $(AppRoot)/conf/$(AppExeName).options     - file from distribution, can be skipped
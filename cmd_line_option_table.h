@@ -0,0 +1,385 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Декларативная таблица опций командной строки с диспетчеризацией через совершенный хэш
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Обычная обработка опций в ArgParser - это длинная цепочка
+    if (opt.isOption("x") || opt.setDescription(...)) else if ..., и каждый аргумент
+    проходит через линейную серию сравнений строк, а setDescription и прочие setParam
+    вызываются при каждом проходе.
+
+    Таблица опций описывается один раз при старте, по ней строится совершенная хэш-функция
+    по схеме hash and displace (CHD): имена раскладываются по корзинам, для каждой корзины подбирается
+    своё смещение, при котором её имена попадают в свободные слоты. Слотов столько же, сколько имён,
+    построение - почти линейное по количеству имён. Каждый аргумент диспетчеризуется к своему
+    обработчику за O(1). Справка собирается только если она запрошена.
+
+    \code
+    umba::command_line::CommandLineOptionTable optTable;
+
+    optTable.add( {"quet", "q"}, "Operate quetly"
+                , [&](umba::command_line::CommandLineOption &opt) { appConfig.setOptQuet(true); return 0; }
+                );
+
+    optTable.add( {"color"}
+                , [](umba::command_line::CommandLineOption &opt) { opt.setParam("CLR", 0, "no/none/file|ansi/term"); opt.setInitial(-1); }
+                , "Force set console output coloring"
+                , [&](umba::command_line::CommandLineOption &opt)
+                  {
+                      ...
+                      if (!opt.getParamValue( res, errMsg, mapper ) )
+                          return -1;
+                      return 0;
+                  }
+                );
+
+    // В ArgParser::operator()
+    if (opt.isOption())
+    {
+        int res = 0;
+        if (optTable.dispatch(opt, res))
+            return res;
+        ...
+    }
+    \endcode
+ */
+
+#pragma once
+
+#include "cmd_line.h"
+//
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// umba::command_line::
+namespace umba{
+namespace command_line{
+
+
+
+//----------------------------------------------------------------------------
+//! Декларативная таблица опций командной строки
+/*!
+    Имена опций задаются так же, как и для CommandLineOption::isOption: односимвольное имя - короткая опция,
+    остальные - длинные; имя, начинающееся с '!' - внутренняя (недокументированная) опция.
+
+    Обработчик имеет вид int handler( CommandLineOption &opt ) и возвращает, как и ArgParser,
+    0 - ok, 1 - нормальная остановка, -1 - ошибка.
+
+    Декларатор (необязательный) имеет вид void declarator( CommandLineOption &opt ), и вызывает
+    setParam/setInitial - то, что в цепочке if'ов пишется перед isOption. Декларатор вызывается
+    только для найденной опции (нужно для getParamValue) и при построении справки.
+ */
+class CommandLineOptionTable
+{
+
+public:
+
+    typedef std::function<int (CommandLineOption&)>   HandlerType;     //!< Обработчик опции
+    typedef std::function<void(CommandLineOption&)>   DeclaratorType;  //!< Задание параметров опции - setParam/setInitial
+
+    //! Добавление опции
+    CommandLineOptionTable& add( const std::vector<std::string> &names, const std::string &description, const HandlerType &handler )
+    {
+        return add(names, DeclaratorType(), description, handler);
+    }
+
+    //! Добавление опции с параметром
+    CommandLineOptionTable& add( const std::vector<std::string> &names, const DeclaratorType &declarator, const std::string &description, const HandlerType &handler )
+    {
+        Entry e;
+        e.names       = names;
+        e.declarator  = declarator;
+        e.description = description;
+        e.handler     = handler;
+        m_entries.emplace_back(e);
+        m_built = false;
+        return *this;
+    }
+
+    //! Количество опций в таблице
+    std::size_t size() const { return m_entries.size(); }
+
+    //! Построение совершенного хэша. Вызывается автоматически при первой диспетчеризации. Бросает исключение при дублировании имён опций
+    void build()
+    {
+        m_keys.clear();
+
+        std::set< std::pair<bool, std::string> > usedNames;
+
+        for(std::size_t entryIdx=0; entryIdx!=m_entries.size(); ++entryIdx)
+        {
+            for(const auto &n : m_entries[entryIdx].names)
+            {
+                Key k;
+                k.name     = normalizeName(n);
+                k.fShort   = k.name.size()==1;
+                k.entryIdx = entryIdx;
+
+                if (k.name.empty())
+                {
+                    #ifdef UMBA_DEBUGBREAK
+                        UMBA_DEBUGBREAK();
+                    #endif
+                    throw std::runtime_error("Invalid (empty) option name");
+                }
+
+                if (!usedNames.insert(std::make_pair(k.fShort, k.name)).second)
+                {
+                    #ifdef UMBA_DEBUGBREAK
+                        UMBA_DEBUGBREAK();
+                    #endif
+                    throw std::runtime_error(std::string("Duplicated option key - '") + k.name + std::string("'"));
+                }
+
+                m_keys.emplace_back(k);
+            }
+        }
+
+        // Смещения не подбираются только при совпадении 64-битных хэшей разных имён - тогда меняем seed
+        std::uint64_t seed = 0;
+        for(unsigned attempt=0; ; ++attempt)
+        {
+            if (attempt==16)
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error("Failed to build option table perfect hash");
+            }
+
+            seed = seed*6364136223846793005ull + 1442695040888963407ull;
+            if (tryBuildSlots(seed))
+                break;
+        }
+
+        m_seed  = seed;
+        m_built = true;
+    }
+
+    //! Поиск обработчика опции. Возвращает false, если это не опция или опция не найдена в таблице
+    /*! Если аргумент - опция запроса справки, и у opt задан коллектор, то предварительно собирается справка по всем опциям таблицы
+     */
+    bool dispatch( CommandLineOption &opt, int &res )
+    {
+        if (!opt.isOption())
+            return false;
+
+        if (!m_built)
+            build();
+
+        // Справка в один коллектор собирается один раз - иначе он сочтёт имена опций дублирующимися
+        if (opt.pCollector && opt.isHelpOption() && m_pHelpCollector!=opt.pCollector)
+        {
+            collectHelp(opt.pCollector);
+            m_pHelpCollector = opt.pCollector;
+        }
+
+        const Key *pKey = findKey(opt.name, opt.fShort);
+        if (!pKey)
+            return false;
+
+        const Entry &e = m_entries[pKey->entryIdx];
+
+        // Наполняем текущую информацию об опции в коллекторе - от неё зависит getParamValue.
+        // Для опции справки всё уже собрано в collectHelp, повторное добавление имён коллектор сочтёт дублированием
+        if (!(opt.pCollector && opt.isHelpOption()))
+            declareEntry(e, opt);
+
+        res = e.handler ? e.handler(opt) : 0;
+        return true;
+    }
+
+    //! Собирает справку по всем опциям в коллектор
+    void collectHelp( ICommandLineOptionCollector *pCol ) const
+    {
+        if (!pCol)
+            return;
+
+        pCol->setCollectMode(true);
+
+        for(const auto &e : m_entries)
+        {
+            CommandLineOption opt(std::string(), pCol);
+            declareEntry(e, opt);
+            opt.setDescription(e.description);
+        }
+    }
+
+
+protected:
+
+    struct Entry
+    {
+        std::vector<std::string>  names;
+        DeclaratorType            declarator;
+        std::string               description;
+        HandlerType               handler;
+    };
+
+    struct Key
+    {
+        std::string   name;
+        bool          fShort   = false;
+        std::size_t   entryIdx = 0;
+    };
+
+    //! Повторяет для коллектора то, что делает цепочка setParam(...) || isOption(...)
+    static void declareEntry( const Entry &e, CommandLineOption &opt )
+    {
+        if (e.declarator)
+            e.declarator(opt);
+
+        for(const auto &n : e.names)
+        {
+            std::string nn = normalizeName(n);
+            if (nn.size()==1)
+                opt.isOption(nn[0]);
+            else
+                opt.isOption(n);
+        }
+    }
+
+    //! Приводит имя к виду, в котором его сравнивает CommandLineOption::isOption
+    static std::string normalizeName( std::string n )
+    {
+        umba::string_plus::ltrim( n, umba::string_plus::is_one_of<char>(",+-?!") );
+        umba::string_plus::rtrim( n, umba::string_plus::is_one_of<char>(",+-") );
+        return n;
+    }
+
+    //! FNV-1a (64) с seed'ом
+    static std::uint64_t hashName( const std::string &name, bool fShort, std::uint64_t seed )
+    {
+        std::uint64_t h = 14695981039346656037ull ^ seed;
+        for(char ch : name)
+        {
+            h ^= (std::uint64_t)(unsigned char)ch;
+            h *= 1099511628211ull;
+        }
+        return h ^ (fShort ? 0x5bd1e9955bd1e995ull : 0u);
+    }
+
+    //! Слот по хэшу имени и смещению его корзины (перемешивание из splitmix64)
+    static std::size_t slotIndex( std::uint64_t h, std::uint32_t displacement, std::size_t numSlots )
+    {
+        std::uint64_t x = h + (std::uint64_t)displacement*0x9E3779B97F4A7C15ull;
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return (std::size_t)(x % numSlots);
+    }
+
+    //! Корзина по хэшу имени - около четырёх имён на корзину
+    static std::size_t bucketIndex( std::uint64_t h, std::size_t numBuckets )
+    {
+        return (std::size_t)((h >> 32) % numBuckets);
+    }
+
+    //! Раскладывает имена по корзинам и подбирает смещения - начиная с самых больших корзин, пока таблица пустая
+    bool tryBuildSlots( std::uint64_t seed )
+    {
+        const std::size_t npos       = (std::size_t)-1;
+        const std::size_t numKeys    = m_keys.size();
+        const std::size_t numBuckets = numKeys/4 + 1;
+
+        std::vector<std::uint64_t>               hashes(numKeys);
+        std::vector< std::vector<std::size_t> >  buckets(numBuckets);
+        for(std::size_t i=0; i!=numKeys; ++i)
+        {
+            hashes[i] = hashName(m_keys[i].name, m_keys[i].fShort, seed);
+            buckets[bucketIndex(hashes[i], numBuckets)].push_back(i);
+        }
+
+        std::vector<std::size_t> order(numBuckets);
+        for(std::size_t b=0; b!=numBuckets; ++b)
+            order[b] = b;
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t b1, std::size_t b2) { return buckets[b1].size()>buckets[b2].size(); } );
+
+        m_slots.assign(numKeys, npos);
+        m_displacements.assign(numBuckets, 0);
+
+        // Последней одиночной корзине в почти заполненной таблице нужно в среднем numKeys попыток
+        const std::size_t maxDisplacement = std::max<std::size_t>(1u<<16, numKeys*32);
+
+        std::vector<std::size_t> bucketSlots;
+        for(std::size_t b : order)
+        {
+            const std::vector<std::size_t> &bucket = buckets[b];
+            if (bucket.empty())
+                break;
+
+            for(std::uint32_t d=0; ; ++d)
+            {
+                if (d==maxDisplacement)
+                    return false;
+
+                bucketSlots.clear();
+                for(std::size_t k : bucket)
+                {
+                    std::size_t slot = slotIndex(hashes[k], d, numKeys);
+                    if (m_slots[slot]!=npos || std::find(bucketSlots.begin(), bucketSlots.end(), slot)!=bucketSlots.end())
+                        break;
+                    bucketSlots.push_back(slot);
+                }
+
+                if (bucketSlots.size()!=bucket.size())
+                    continue;
+
+                for(std::size_t i=0; i!=bucket.size(); ++i)
+                    m_slots[bucketSlots[i]] = bucket[i];
+                m_displacements[b] = d;
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    const Key* findKey( const std::string &name, bool fShort ) const
+    {
+        if (m_slots.empty())
+            return 0;
+
+        const std::uint64_t h      = hashName(name, fShort, m_seed);
+        const std::size_t   keyIdx = m_slots[slotIndex(h, m_displacements[bucketIndex(h, m_displacements.size())], m_slots.size())];
+        if (keyIdx==(std::size_t)-1)
+            return 0;
+
+        const Key &k = m_keys[keyIdx];
+        if (k.fShort!=fShort || k.name!=name)
+            return 0;
+
+        return &k;
+    }
+
+
+    std::vector<Entry>        m_entries;
+    std::vector<Key>          m_keys;
+    std::vector<std::size_t>  m_slots;          //!< Индекс имени в m_keys на каждый слот
+    std::vector<std::uint32_t> m_displacements; //!< Смещение на каждую корзину
+    std::uint64_t             m_seed  = 0;
+    bool                      m_built = false;
+    const ICommandLineOptionCollector *m_pHelpCollector = 0;
+
+}; // class CommandLineOptionTable
+
+//----------------------------------------------------------------------------
+
+
+
+} // namespace command_line
+} // namespace umba
+
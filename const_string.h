@@ -9,6 +9,7 @@
 #pragma once
 
 #include "umba.h"
+#include "ascii_case.h"
 
 #if defined(UMBA_KEIL_ARMCC_COMPILER_USED) || defined(UMBA_KEIL_CLANG_COMPILER_USED) || defined(UMBA_MSVC_COMPILER_USED) || defined(UMBA_GCC_COMPILER_USED)
 
@@ -191,7 +192,7 @@ public:
     int compare( const char *str ) const
     {
         if (CaseIgnore)
-            return platform_support::str_icase_compare( m_str, str );
+            return string_plus::ascii_icase_compare( m_str, m_strSize, str, std::strlen(str) );
         else
             return platform_support::str_compare( m_str, str );
     }
@@ -200,7 +201,7 @@ public:
     int compare( const ConstString &other ) const
     {
         if (CaseIgnore)
-            return platform_support::str_icase_compare( m_str, other.c_str() );
+            return string_plus::ascii_icase_compare( m_str, m_strSize, other.c_str(), other.size() );
         else
             return platform_support::str_compare( m_str, other.c_str() );
     }
@@ -209,7 +210,7 @@ public:
     int compare( const char *str, size_t n ) const
     {
         if (CaseIgnore)
-            return platform_support::strn_icase_compare( m_str, str, n );
+            return string_plus::ascii_icase_compare( m_str, limitSize(m_strSize, n), str, limitedStrLen(str, n) );
         else
             return platform_support::strn_compare( m_str, str, n );
     }
@@ -218,13 +219,28 @@ public:
     int compare( const ConstString &other, size_t n ) const
     {
         if (CaseIgnore)
-            return platform_support::strn_icase_compare( m_str, other.c_str(), n );
+            return string_plus::ascii_icase_compare( m_str, limitSize(m_strSize, n), other.c_str(), limitSize(other.size(), n) );
         else
             return platform_support::strn_compare( m_str, other.c_str(), n );
     }
 
 protected:
 
+    //! Ограничивает размер
+    static size_t limitSize( size_t sz, size_t n )
+    {
+        return sz<n ? sz : n;
+    }
+
+    //! Длина сырой строки, но не более n
+    static size_t limitedStrLen( const char *str, size_t n )
+    {
+        size_t len = 0;
+        while(len!=n && str[len]!=0)
+            ++len;
+        return len;
+    }
+
     const char* m_str;     //!< Указатель на сырую строку
     size_t      m_strSize; //!< Размер строки
 
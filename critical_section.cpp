@@ -8,6 +8,12 @@
 
 #include "critical_section.h"
 
+#if !defined(UMBA_WIN32_USED) && defined(UMBA_LINUX_USED)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
 namespace umba{
 
 
@@ -41,6 +47,259 @@ void CriticalSection::unlock()
     LeaveCriticalSection(&m_criticalSection);
 }
 
+#elif defined(UMBA_LINUX_USED)
+
+//---------------------------------------------------------
+// Реализация критической секции для Linux
+//---------------------------------------------------------
+namespace {
+
+//---------------------------------------------------------
+inline std::uint32_t currentThreadId()
+{
+    static thread_local std::uint32_t tid = (std::uint32_t)::syscall(SYS_gettid);
+    return tid;
+}
+
+//---------------------------------------------------------
+inline int* futexWord( std::atomic<std::uint32_t> &a )
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>)==sizeof(int), "std::atomic<std::uint32_t> can't be used as futex word");
+    return reinterpret_cast<int*>(&a);
+}
+
+//---------------------------------------------------------
+inline long futexCall( std::atomic<std::uint32_t> &a, int op, std::uint32_t val )
+{
+    return ::syscall(SYS_futex, futexWord(a), op, val, (void*)0, (void*)0, 0);
+}
+
+//---------------------------------------------------------
+inline void cpuRelax()
+{
+    #if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+    #else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    #endif
+}
+
+//---------------------------------------------------------
+inline bool isMultiprocessor()
+{
+    // На одном ядре владелец не может отпустить секцию, пока мы крутимся
+    static const bool res = ::sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    return res;
+}
+
+//---------------------------------------------------------
+inline void incCounter( std::atomic<std::uint64_t> &c, std::uint64_t v = 1 )
+{
+    // Вызывается только владельцем секции - атомарный RMW не нужен
+    c.store(c.load(std::memory_order_relaxed)+v, std::memory_order_relaxed);
+}
+
+} // namespace
+
+//---------------------------------------------------------
+CriticalSection::CriticalSection( bool priorityInheritance )
+: m_state(0)
+, m_owner(0)
+, m_recursionCount(0)
+, m_spinEstimate(0)
+, m_priorityInheritance(priorityInheritance)
+, m_lockCount(0)
+, m_recursiveLockCount(0)
+, m_contendedCount(0)
+, m_spinAcquiredCount(0)
+, m_parkCount(0)
+{
+}
+
+//---------------------------------------------------------
+CriticalSection::~CriticalSection()
+{
+}
+
+//---------------------------------------------------------
+CriticalSectionStats CriticalSection::getStats() const
+{
+    CriticalSectionStats st;
+    st.lockCount          = m_lockCount         .load(std::memory_order_relaxed);
+    st.recursiveLockCount = m_recursiveLockCount.load(std::memory_order_relaxed);
+    st.contendedCount     = m_contendedCount    .load(std::memory_order_relaxed);
+    st.spinAcquiredCount  = m_spinAcquiredCount .load(std::memory_order_relaxed);
+    st.parkCount          = m_parkCount         .load(std::memory_order_relaxed);
+    return st;
+}
+
+//---------------------------------------------------------
+void CriticalSection::resetStats()
+{
+    lock();
+    // Счётчики обнуляются под блокировкой. Собственный захват в resetStats lock() уже учёл,
+    // поэтому обнуление выбрасывает и его; после unlock() ничего не трогаем - секцию
+    // к этому моменту может захватить другой поток, и его захват потерялся бы
+    m_lockCount         .store(0, std::memory_order_relaxed);
+    m_recursiveLockCount.store(0, std::memory_order_relaxed);
+    m_contendedCount    .store(0, std::memory_order_relaxed);
+    m_spinAcquiredCount .store(0, std::memory_order_relaxed);
+    m_parkCount         .store(0, std::memory_order_relaxed);
+    unlock();
+}
+
+//---------------------------------------------------------
+bool CriticalSection::spinWait( std::uint32_t self )
+{
+    if (!isMultiprocessor())
+        return false;
+
+    // Адаптивное ожидание как в glibc PTHREAD_MUTEX_ADAPTIVE_NP: крутимся до удвоенной средней длины прошлых ожиданий
+    const int estimate = m_spinEstimate.load(std::memory_order_relaxed);
+    int maxSpin = 2*estimate + 10;
+    if (maxSpin>maxSpinCount)
+        maxSpin = maxSpinCount;
+
+    const std::uint32_t newState = m_priorityInheritance ? self : 1u;
+
+    int cnt = 0;
+    bool res = false;
+    for(; cnt<maxSpin; ++cnt)
+    {
+        cpuRelax();
+        std::uint32_t expected = 0;
+        if (m_state.load(std::memory_order_relaxed)==0 && m_state.compare_exchange_weak(expected, newState, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            res = true;
+            break;
+        }
+    }
+
+    m_spinEstimate.store(estimate + (cnt-estimate)/8, std::memory_order_relaxed);
+
+    return res;
+}
+
+//---------------------------------------------------------
+void CriticalSection::lockNormal( std::uint32_t &spinAcquired, std::uint32_t &parks )
+{
+    if (spinWait(0))
+    {
+        spinAcquired = 1;
+        return;
+    }
+
+    // 0 - свободно, 1 - захвачено, 2 - захвачено, есть ожидающие (Drepper, "Futexes Are Tricky", mutex3)
+    std::uint32_t c = m_state.exchange(2, std::memory_order_acquire);
+    while(c!=0)
+    {
+        ++parks;
+        futexCall(m_state, FUTEX_WAIT_PRIVATE, 2);
+        c = m_state.exchange(2, std::memory_order_acquire);
+    }
+}
+
+//---------------------------------------------------------
+void CriticalSection::unlockNormal()
+{
+    if (m_state.fetch_sub(1, std::memory_order_release)!=1)
+    {
+        m_state.store(0, std::memory_order_release);
+        futexCall(m_state, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+//---------------------------------------------------------
+void CriticalSection::lockPi( std::uint32_t self, std::uint32_t &spinAcquired, std::uint32_t &parks )
+{
+    if (spinWait(self))
+    {
+        spinAcquired = 1;
+        return;
+    }
+
+    for(;;)
+    {
+        std::uint32_t expected = 0;
+        if (m_state.compare_exchange_strong(expected, self, std::memory_order_acquire, std::memory_order_relaxed))
+            return;
+
+        ++parks;
+        // Ядро само выставляет FUTEX_WAITERS и передаёт владение, при успехе в слове futex уже наш TID
+        if (futexCall(m_state, FUTEX_LOCK_PI_PRIVATE, 0)==0)
+            return;
+
+        // EINTR/EAGAIN - владелец в процессе выхода, пробуем снова
+    }
+}
+
+//---------------------------------------------------------
+void CriticalSection::unlockPi( std::uint32_t self )
+{
+    std::uint32_t expected = self;
+    if (m_state.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+        return;
+
+    // Выставлен FUTEX_WAITERS - владение передаёт ядро
+    futexCall(m_state, FUTEX_UNLOCK_PI_PRIVATE, 0);
+}
+
+//---------------------------------------------------------
+void CriticalSection::lock()
+{
+    const std::uint32_t self = currentThreadId();
+
+    // Только сам владелец мог записать сюда свой TID
+    if (m_owner.load(std::memory_order_relaxed)==self)
+    {
+        ++m_recursionCount;
+        incCounter(m_recursiveLockCount);
+        return;
+    }
+
+    std::uint32_t expected     = 0;
+    bool          contended    = false;
+    std::uint32_t spinAcquired = 0;
+    std::uint32_t parks        = 0;
+
+    if (!m_state.compare_exchange_strong(expected, m_priorityInheritance ? self : 1u, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        contended = true;
+        if (m_priorityInheritance)
+            lockPi(self, spinAcquired, parks);
+        else
+            lockNormal(spinAcquired, parks);
+    }
+
+    m_owner.store(self, std::memory_order_relaxed);
+    m_recursionCount = 1;
+
+    incCounter(m_lockCount);
+    if (contended)
+    {
+        incCounter(m_contendedCount);
+        incCounter(m_spinAcquiredCount, spinAcquired);
+        incCounter(m_parkCount, parks);
+    }
+}
+
+//---------------------------------------------------------
+void CriticalSection::unlock()
+{
+    if (--m_recursionCount)
+        return;
+
+    const std::uint32_t self = m_owner.load(std::memory_order_relaxed);
+    m_owner.store(0, std::memory_order_relaxed);
+
+    if (m_priorityInheritance)
+        unlockPi(self);
+    else
+        unlockNormal();
+}
+
 #endif
 
 
@@ -60,6 +60,12 @@
     #include "zz_mcu_low_level.h"
 #endif
 
+#if defined(UMBA_LINUX_USED) && !defined(UMBA_WIN32_USED)
+    #include <atomic>
+    #include <cstddef>
+    #include <cstdint>
+#endif
+
 
 /*!
     \ingroup UMBA_LIBS_STATE_MACROS
@@ -188,6 +194,7 @@ class FakeCriticalSection
     class CriticalSection
     {
             template<typename LockObject> friend class AutoLock;
+            template<typename LockObject, std::size_t NumShards> friend class ShardedLock;
 
         public:
 
@@ -207,9 +214,75 @@ class FakeCriticalSection
 
 #elif defined(UMBA_LINUX_USED)
 
+    //! Статистика захватов критической секции
+    struct CriticalSectionStats
+    {
+        std::uint64_t lockCount          = 0;  //!< Всего захватов (без учёта рекурсивных)
+        std::uint64_t recursiveLockCount = 0;  //!< Рекурсивных захватов тем же потоком
+        std::uint64_t contendedCount     = 0;  //!< Захватов, при которых секция была занята
+        std::uint64_t spinAcquiredCount  = 0;  //!< Из них захвачено во время активного ожидания, без засыпания
+        std::uint64_t parkCount          = 0;  //!< Количество засыпаний на futex
+    };
+
+    //! Реализация критической секции для Linux
+    /*! Мьютекс на futex с ограниченным адаптивным активным ожиданием перед засыпанием.
+        Как и критическая секция Win32, допускает рекурсивный захват тем же потоком.
+
+        Длина активного ожидания подстраивается под то, сколько в среднем ждать приходилось раньше,
+        но не более maxSpinCount итераций.
+
+        В режиме наследования приоритетов используются FUTEX_LOCK_PI/FUTEX_UNLOCK_PI: поток,
+        держащий секцию, временно получает приоритет самого приоритетного ожидающего потока.
+        Это имеет смысл при использовании realtime-приоритетов.
+     */
+    class CriticalSection
+    {
+            template<typename LockObject> friend class AutoLock;
+            template<typename LockObject, std::size_t NumShards> friend class ShardedLock;
+
+        public:
+
+            static const int maxSpinCount = 100; //!< Максимальное количество итераций активного ожидания
+
+            explicit CriticalSection( bool priorityInheritance = false );
+            ~CriticalSection();
+            UMBA_NON_COPYABLE_CLASS(CriticalSection)
+
+        public:
+
+            //! Используется ли режим наследования приоритетов
+            bool isPriorityInheritance() const { return m_priorityInheritance; }
+
+            //! Возвращает статистику захватов. Счётчики обновляются под блокировкой, чтение не блокирует
+            CriticalSectionStats getStats() const;
+
+            //! Сбрасывает статистику захватов
+            void resetStats();
 
-    //UNDONE: need to make normal implementation
-    typedef FakeCriticalSection  CriticalSection;
+        private:
+
+            void lock();
+            void unlock();
+
+            void lockNormal( std::uint32_t &spinAcquired, std::uint32_t &parks );
+            void unlockNormal();
+            void lockPi( std::uint32_t self, std::uint32_t &spinAcquired, std::uint32_t &parks );
+            void unlockPi( std::uint32_t self );
+            bool spinWait( std::uint32_t self );
+
+            std::atomic<std::uint32_t>   m_state;          //!< Слово futex: 0 - свободно, 1 - захвачено, 2 - захвачено и есть ожидающие; в режиме PI - TID владельца
+            std::atomic<std::uint32_t>   m_owner;          //!< TID владельца - для рекурсивного захвата
+            std::uint32_t                m_recursionCount; //!< Глубина рекурсивного захвата, меняется только владельцем
+            std::atomic<int>             m_spinEstimate;   //!< Оценка длины активного ожидания
+            bool                         m_priorityInheritance;
+
+            std::atomic<std::uint64_t>   m_lockCount;
+            std::atomic<std::uint64_t>   m_recursiveLockCount;
+            std::atomic<std::uint64_t>   m_contendedCount;
+            std::atomic<std::uint64_t>   m_spinAcquiredCount;
+            std::atomic<std::uint64_t>   m_parkCount;
+
+    }; // class CriticalSection
 
 
 #elif defined(UMBA_FREERTOS_USED)
@@ -17,6 +17,24 @@
 #endif
 
 #include "format_utils.h"
+#include "i_char_writer.h"
+
+//----------------------------------------------------------------------------
+/*
+    Массовые версии (dumpBytesHex, dumpBytesHexSpaced и др.) при наличии SSE2 форматируют по 16 байт за раз,
+    при наличии SSSE3 (pshufb) - цифры берутся из таблицы тетрад, и раскладка с пробелами тоже делается перестановками.
+
+    UMBA_DUMP_NO_SIMD - отключает SSE2/SSSE3.
+ */
+
+#include "internal/simd_detect.h"
+
+#if defined(UMBA_SSE2_USED) && !defined(UMBA_DUMP_NO_SIMD)
+    #define UMBA_DUMP_SSE2
+    #if defined(UMBA_SSSE3_USED)
+        #define UMBA_DUMP_SSSE3
+    #endif
+#endif
 
 
 
@@ -107,6 +125,237 @@ size_t calcEscapedStringDumpSize( const char *pData, size_t dataSize )
     return requiredSize+1;
 }
 
+//------------------------------
+//! Возвращает количество памяти, требуемое для канонического дампа (см. dumpCanonical), включая завершающий ноль
+inline
+size_t calcCanonicalDumpSize( size_t dataSize, uint64_t startOffset = 0 )
+{
+    size_t numLines   = (dataSize+15)/16;
+    size_t offsetSize = ((startOffset+dataSize)>>32)!=0 ? 16 : 8; // Оценка сверху
+    return numLines*(offsetSize+2+48+1+16+1) + 1;
+}
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace dump_details
+{
+
+inline
+const char* getHexDigits( umba::format_utils::CaseParam caseParam )
+{
+    return caseParam==umba::format_utils::CaseParam::lower ? "0123456789abcdef" : "0123456789ABCDEF";
+}
+
+#if defined(UMBA_DUMP_SSE2)
+
+// 16 байт -> 32 шестнадцатиричные цифры: lo - байты 0-7, hi - байты 8-15
+inline
+void sse2HexDigits( __m128i v, __m128i &lo, __m128i &hi, umba::format_utils::CaseParam caseParam )
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi16(v, 4), nibbleMask);
+    __m128i loNibbles = _mm_and_si128(v, nibbleMask);
+
+    #if defined(UMBA_DUMP_SSSE3)
+        const __m128i lut = _mm_loadu_si128((const __m128i*)getHexDigits(caseParam));
+        hiNibbles = _mm_shuffle_epi8(lut, hiNibbles);
+        loNibbles = _mm_shuffle_epi8(lut, loNibbles);
+    #else
+        // '0'+n, для n>9 дополнительно добавляем смещение до 'A'/'a'
+        const __m128i nine     = _mm_set1_epi8(9);
+        const __m128i zeroChar = _mm_set1_epi8('0');
+        const __m128i alphaAdd = _mm_set1_epi8((char)((caseParam==umba::format_utils::CaseParam::lower ? 'a' : 'A') - '0' - 10));
+        hiNibbles = _mm_add_epi8(_mm_add_epi8(hiNibbles, zeroChar), _mm_and_si128(_mm_cmpgt_epi8(hiNibbles, nine), alphaAdd));
+        loNibbles = _mm_add_epi8(_mm_add_epi8(loNibbles, zeroChar), _mm_and_si128(_mm_cmpgt_epi8(loNibbles, nine), alphaAdd));
+    #endif
+
+    lo = _mm_unpacklo_epi8(hiNibbles, loNibbles);
+    hi = _mm_unpackhi_epi8(hiNibbles, loNibbles);
+}
+
+// Печатные символы (0x20-0x7E) - как есть, остальные - '.'
+inline
+__m128i sse2PrintableOrDot( __m128i v )
+{
+    // Знаковое сравнение: байты >=0x80 отрицательные и в диапазон не попадают
+    __m128i printable = _mm_and_si128( _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F))
+                                     , _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F))
+                                     );
+    return _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+}
+
+#endif
+
+#if defined(UMBA_DUMP_SSSE3)
+
+// Раскладка 32 цифр по 48 позициям "XX XX ... XX " - индексы в lo/hi, -1 - место под пробел
+inline
+void ssse3SpacedHex( char *pOut, __m128i lo, __m128i hi )
+{
+    const __m128i shuf0   = _mm_setr_epi8( 0, 1,-1, 2, 3,-1, 4, 5,-1, 6, 7,-1, 8, 9,-1,10);
+    const __m128i shuf1lo = _mm_setr_epi8(11,-1,12,13,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i shuf1hi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1, 2, 3,-1, 4, 5);
+    const __m128i shuf2   = _mm_setr_epi8(-1, 6, 7,-1, 8, 9,-1,10,11,-1,12,13,-1,14,15,-1);
+
+    const __m128i space0  = _mm_setr_epi8( 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0);
+    const __m128i space1  = _mm_setr_epi8( 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0);
+    const __m128i space2  = _mm_setr_epi8(' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ', 0, 0,' ');
+
+    __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(lo, shuf0), space0);
+    __m128i out1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(lo, shuf1lo), _mm_shuffle_epi8(hi, shuf1hi)), space1);
+    __m128i out2 = _mm_or_si128(_mm_shuffle_epi8(hi, shuf2), space2);
+
+    _mm_storeu_si128((__m128i*)(pOut   ), out0);
+    _mm_storeu_si128((__m128i*)(pOut+16), out1);
+    _mm_storeu_si128((__m128i*)(pOut+32), out2);
+}
+
+#endif
+
+} // namespace dump_details
+//! @endcond
+
+//------------------------------
+//! Пишет HEX-дамп без разделителей - по 2 символа на байт. Возвращает указатель за последним записанным символом, ноль не дописывается
+inline
+char* dumpBytesHex( char *pOut, const uint8_t *data, size_t dataSize, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::upper )
+{
+    size_t i = 0;
+
+    #if defined(UMBA_DUMP_SSE2)
+    for(; i+16<=dataSize; i+=16, pOut+=32)
+    {
+        __m128i lo, hi;
+        dump_details::sse2HexDigits(_mm_loadu_si128((const __m128i*)(data+i)), lo, hi, caseParam);
+        _mm_storeu_si128((__m128i*)(pOut   ), lo);
+        _mm_storeu_si128((__m128i*)(pOut+16), hi);
+    }
+    #endif
+
+    const char *digits = dump_details::getHexDigits(caseParam);
+    for(; i!=dataSize; ++i)
+    {
+        *pOut++ = digits[data[i]>>4  ];
+        *pOut++ = digits[data[i]&0x0F];
+    }
+
+    return pOut;
+}
+
+//------------------------------
+//! Пишет HEX-дамп - по 3 символа на байт ("XX "), пробел ставится и после последнего байта. Возвращает указатель за последним записанным символом
+inline
+char* dumpBytesHexSpaced( char *pOut, const uint8_t *data, size_t dataSize, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::upper )
+{
+    size_t i = 0;
+
+    #if defined(UMBA_DUMP_SSSE3)
+    for(; i+16<=dataSize; i+=16, pOut+=48)
+    {
+        __m128i lo, hi;
+        dump_details::sse2HexDigits(_mm_loadu_si128((const __m128i*)(data+i)), lo, hi, caseParam);
+        dump_details::ssse3SpacedHex(pOut, lo, hi);
+    }
+    #elif defined(UMBA_DUMP_SSE2)
+    for(; i+16<=dataSize; i+=16)
+    {
+        alignas(16) char digits[32];
+        __m128i lo, hi;
+        dump_details::sse2HexDigits(_mm_loadu_si128((const __m128i*)(data+i)), lo, hi, caseParam);
+        _mm_store_si128((__m128i*)(digits   ), lo);
+        _mm_store_si128((__m128i*)(digits+16), hi);
+        for(size_t k=0; k!=16; ++k, pOut+=3)
+        {
+            pOut[0] = digits[2*k  ];
+            pOut[1] = digits[2*k+1];
+            pOut[2] = ' ';
+        }
+    }
+    #endif
+
+    const char *digits = dump_details::getHexDigits(caseParam);
+    for(; i!=dataSize; ++i)
+    {
+        *pOut++ = digits[data[i]>>4  ];
+        *pOut++ = digits[data[i]&0x0F];
+        *pOut++ = ' ';
+    }
+
+    return pOut;
+}
+
+//------------------------------
+//! Пишет BIN-дамп - по 9 символов на байт ("01010101 "), пробел ставится и после последнего байта. Возвращает указатель за последним записанным символом
+inline
+char* dumpBytesBinSpaced( char *pOut, const uint8_t *data, size_t dataSize )
+{
+    for(size_t i=0; i!=dataSize; ++i, pOut+=9)
+    {
+    #if defined(UMBA_ARCH_LITTLE_ENDIAN)
+        // Размножаем байт на все 8 байт слова, в k-м байте оставляем (7-k)-й бит и переводим его в '0'/'1'
+        uint64_t v = ((uint64_t)data[i] * 0x0101010101010101ull) & 0x0102040810204080ull;
+        v = ((v + 0x7F7F7F7F7F7F7F7Full) >> 7) & 0x0101010101010101ull;
+        v += 0x3030303030303030ull;
+        std::memcpy(pOut, &v, 8);
+    #else
+        uint8_t bt = data[i];
+        for(size_t k=0; k!=8u; ++k, bt<<=1)
+            pOut[k] = bt&0x80 ? '1' : '0';
+    #endif
+        pOut[8] = ' ';
+    }
+
+    return pOut;
+}
+
+//------------------------------
+//! Пишет ASCII-колонку дампа: печатные символы (0x20-0x7E) как есть, остальные - '.'. Возвращает указатель за последним записанным символом
+inline
+char* dumpBytesPrintable( char *pOut, const uint8_t *data, size_t dataSize )
+{
+    size_t i = 0;
+
+    #if defined(UMBA_DUMP_SSE2)
+    for(; i+16<=dataSize; i+=16, pOut+=16)
+        _mm_storeu_si128((__m128i*)pOut, dump_details::sse2PrintableOrDot(_mm_loadu_si128((const __m128i*)(data+i))));
+    #endif
+
+    for(; i!=dataSize; ++i)
+        *pOut++ = (data[i]>=0x20 && data[i]<0x7F) ? (char)data[i] : '.';
+
+    return pOut;
+}
+
+//------------------------------
+//! Формирует одну строку канонического дампа (как у 'xxd -g1'), не более 16 байт. Возвращает указатель за '\n', ноль не дописывается
+/*! Формат строки: "OOOOOOOO: XX XX ... XX  ASCII\n". Смещение выводится 8 цифрами, или 16 - если не влезает в 32 бита.
+    Короткая строка дополняется пробелами так, чтобы ASCII-колонка оставалась на месте.
+ */
+inline
+char* dumpCanonicalLine( char *pOut, uint64_t offset, const uint8_t *data, size_t dataSize, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::lower )
+{
+    uint8_t offsetBytes[8];
+    for(size_t k=0; k!=8u; ++k)
+        offsetBytes[k] = (uint8_t)(offset>>(8*(7-k)));
+
+    pOut = (offset>>32)!=0 ? dumpBytesHex(pOut, &offsetBytes[0], 8, caseParam) : dumpBytesHex(pOut, &offsetBytes[4], 4, caseParam);
+    *pOut++ = ':';
+    *pOut++ = ' ';
+
+    pOut = dumpBytesHexSpaced(pOut, data, dataSize, caseParam);
+    for(size_t k=dataSize; k<16u; ++k, pOut+=3)
+    {
+        pOut[0] = ' ';
+        pOut[1] = ' ';
+        pOut[2] = ' ';
+    }
+    *pOut++ = ' ';
+
+    pOut = dumpBytesPrintable(pOut, data, dataSize);
+    *pOut++ = '\n';
+
+    return pOut;
+}
+
 
 
 } // namespace utils
@@ -160,17 +409,8 @@ const char* dump( char *pBuf, const uint8_t *data, size_t dataSize )
         return pBuf;
     }
 
-    // need to dump at least one byte
-    utils::dumpSingleByte(pBuf, *data);
-
-    size_t i = 1;
-    for(; i != dataSize; ++i)
-    {
-        pBuf[i*3-1] = ' ';
-        utils::dumpSingleByte( &pBuf[i*3], data[i] );
-    }
-
-    pBuf[i*3-1] = 0;
+    char *pEnd = utils::dumpBytesHexSpaced(pBuf, data, dataSize);
+    pEnd[-1] = 0; // Затираем пробел после последнего байта
 
     return pBuf;
 }
@@ -186,17 +426,8 @@ const char* dumpBin( char *pBuf, const uint8_t *data, size_t dataSize )
         return pBuf;
     }
 
-    // need to dump at least one byte
-    utils::dumpSingleByteBin(pBuf, *data);
-
-    size_t i = 1;
-    for(; i != dataSize; ++i)
-    {
-        pBuf[i*9-1] = ' ';
-        utils::dumpSingleByteBin( &pBuf[i*9], data[i] );
-    }
-
-    pBuf[i*9-1] = 0;
+    char *pEnd = utils::dumpBytesBinSpaced(pBuf, data, dataSize);
+    pEnd[-1] = 0; // Затираем пробел после последнего байта
 
     return pBuf;
 }
@@ -212,14 +443,7 @@ const char* dumpSolid( char *pBuf, const uint8_t *data, size_t dataSize )
         return pBuf;
     }
 
-    size_t i = 0;
-    for(; i != dataSize; ++i)
-    {
-        pBuf[i*2-0] = umba::format_utils::digitToChar( ((data[i])>>4)&0x0F );
-        pBuf[i*2+1] = umba::format_utils::digitToChar( ((data[i])   )&0x0F );
-    }
-
-    pBuf[i*2] = 0;
+    *utils::dumpBytesHex(pBuf, data, dataSize) = 0;
 
     return pBuf;
 }
@@ -236,23 +460,16 @@ const char* dump( char *pBuf, const uint8_t *data, size_t dataSizeArg, LimitType
         return pBuf;
     }
 
-    // need to dump at least one byte
-    //pBuf[0] = umba::format_utils::digitToChar( ((*data)>>4)&0x0F );
-    //pBuf[1] = umba::format_utils::digitToChar( ((*data)   )&0x0F );
-    utils::dumpSingleByte(pBuf, *data);
-
     size_t dataSize = dataSizeArg;
     if (dataSize>(size_t)elipsisLimit)
         dataSize = (size_t)elipsisLimit;
 
-    size_t i = 1;
-    for(; i != dataSize; ++i)
-    {
-        pBuf[i*3-1] = ' ';
-        utils::dumpSingleByte( &pBuf[i*3], data[i] );
-        //pBuf[i*3-0] = umba::format_utils::digitToChar( ((data[i])>>4)&0x0F );
-        //pBuf[i*3+1] = umba::format_utils::digitToChar( ((data[i])   )&0x0F );
-    }
+    // need to dump at least one byte
+    if (!dataSize)
+        dataSize = 1;
+
+    utils::dumpBytesHexSpaced( pBuf, data, dataSize );
+    size_t i = dataSize;
 
     if (dataSize == dataSizeArg)
     {
@@ -314,6 +531,138 @@ const char* escapedStringDump( char *pBuf, const char *pData, size_t dataSize )
     return pBuf;
 }
 
+//------------------------------
+//! Формирует канонический дамп (как у 'xxd -g1'): по 16 байт в строке, смещение, HEX и ASCII-колонка. Места в буфере должно быть достаточно (см. utils::calcCanonicalDumpSize)
+inline
+const char* dumpCanonical( char *pBuf, const uint8_t *data, size_t dataSize, uint64_t startOffset = 0, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::lower )
+{
+    char *pOut = pBuf;
+
+    for(size_t i=0; i<dataSize; i+=16)
+    {
+        size_t lineSize = dataSize-i<16u ? dataSize-i : 16u;
+        pOut = utils::dumpCanonicalLine(pOut, startOffset+i, data+i, lineSize, caseParam);
+    }
+
+    *pOut = 0;
+
+    return pBuf;
+}
+
+//----------------------------------------------------------------------------
+#if !defined(UMBA_DUMP_WRITER_BUF_LINES)
+    #if defined(UMBA_MCU_USED)
+        #define UMBA_DUMP_WRITER_BUF_LINES  2
+    #else
+        #define UMBA_DUMP_WRITER_BUF_LINES  128
+    #endif
+#endif
+
+//! Потоковый канонический дамп в ICharWriter
+/*! Данные можно подавать кусками произвольного размера - смещения продолжаются, неполная строка
+    копится до следующего вызова write() или до finish(). Строки форматируются в собственный буфер
+    и уходят в писатель через writeBuf пачками по UMBA_DUMP_WRITER_BUF_LINES строк.
+ */
+class CanonicalDumpWriter
+{
+
+public:
+
+    static const size_t maxLineSize = 16+2+48+1+16+1; //!< Максимальная длина строки дампа
+
+    CanonicalDumpWriter( ICharWriter *pWriter, uint64_t startOffset = 0, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::lower )
+    : m_pWriter(pWriter)
+    , m_offset(startOffset)
+    , m_caseParam(caseParam)
+    {}
+
+    CanonicalDumpWriter(const CanonicalDumpWriter&) = delete;
+    CanonicalDumpWriter& operator=(const CanonicalDumpWriter&) = delete;
+
+    ~CanonicalDumpWriter()
+    {
+        finish();
+    }
+
+    //! Дампит очередную порцию данных
+    void write( const uint8_t *data, size_t dataSize )
+    {
+        if (m_numPending)
+        {
+            size_t n = 16u-m_numPending;
+            if (n>dataSize)
+                n = dataSize;
+
+            std::memcpy(&m_pending[m_numPending], data, n);
+            m_numPending += n;
+            data         += n;
+            dataSize     -= n;
+
+            if (m_numPending!=16u)
+                return;
+
+            putLine(&m_pending[0], 16u);
+            m_numPending = 0;
+        }
+
+        for(; dataSize>=16u; data+=16, dataSize-=16)
+            putLine(data, 16u);
+
+        if (dataSize)
+        {
+            std::memcpy(&m_pending[0], data, dataSize);
+            m_numPending = dataSize;
+        }
+    }
+
+    //! Выводит неполную строку (если есть) и сбрасывает буфер в писатель
+    void finish()
+    {
+        if (m_numPending)
+        {
+            putLine(&m_pending[0], m_numPending);
+            m_numPending = 0;
+        }
+
+        flushBuf();
+    }
+
+    //! Смещение, с которого начнётся следующая строка
+    uint64_t getOffset() const
+    {
+        return m_offset;
+    }
+
+
+protected:
+
+    void putLine( const uint8_t *data, size_t dataSize )
+    {
+        if (m_bufUsed+maxLineSize>sizeof(m_buf))
+            flushBuf();
+
+        char *pEnd = utils::dumpCanonicalLine(&m_buf[m_bufUsed], m_offset, data, dataSize, m_caseParam);
+        m_bufUsed = (size_t)(pEnd-&m_buf[0]);
+        m_offset += dataSize;
+    }
+
+    void flushBuf()
+    {
+        if (m_bufUsed && m_pWriter)
+            m_pWriter->writeBuf((const uint8_t*)&m_buf[0], m_bufUsed);
+        m_bufUsed = 0;
+    }
+
+    ICharWriter                    *m_pWriter    = 0;
+    uint64_t                        m_offset     = 0;
+    umba::format_utils::CaseParam   m_caseParam  = umba::format_utils::CaseParam::lower;
+    uint8_t                         m_pending[16];
+    size_t                          m_numPending = 0;
+    char                            m_buf[maxLineSize*UMBA_DUMP_WRITER_BUF_LINES];
+    size_t                          m_bufUsed    = 0;
+
+}; // class CanonicalDumpWriter
+
 
 
 
@@ -430,6 +779,18 @@ std::string escapedStringDump( const char *pData, size_t dataSize )
     return escapedStringDump( &buf[0], pData, dataSize );
 }
 
+//----------------------------------------------------------------------------
+//! Формирует канонический дамп (как у 'xxd -g1')
+inline
+std::string dumpCanonical( const uint8_t *data, size_t dataSize, uint64_t startOffset = 0, umba::format_utils::CaseParam caseParam = umba::format_utils::CaseParam::lower )
+{
+    std::string res;
+    res.resize( utils::calcCanonicalDumpSize(dataSize, startOffset) );
+    const char *pEnd = dumpCanonical( &res[0], data, dataSize, startOffset, caseParam );
+    res.resize( std::strlen(pEnd) );
+    return res;
+}
+
 
 
 #endif
@@ -8,9 +8,22 @@
 
 #pragma once
 
+#include "internal/bit_utils.h"
+#include "internal/simd_detect.h"
+//
 #include <utility>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(UMBA_SSE2_USED) && !defined(UMBA_ESCAPE_STRING_NO_SIMD)
+    #define UMBA_ESCAPE_STRING_SSE2
+#endif
 
 
 //----------------------------------------------------------------------------
@@ -101,15 +114,6 @@ OutputIterator escapeStringC(OutputIterator outIt, InputIterator b, InputIterato
 }
 
 //----------------------------------------------------------------------------
-template<typename StringType> inline
-StringType escapeStringC(const StringType &str)
-{
-    StringType res; res.reserve(str.size());
-    escapeStringC(std::back_inserter(res), str.begin(), str.end());
-    return res;
-}
-
-//----------------------------------------------------------------------------
 
 
 
@@ -153,15 +157,6 @@ OutputIterator escapeStringGraphViz(OutputIterator outIt, InputIterator b, Input
 }
 
 //----------------------------------------------------------------------------
-template<typename StringType> inline
-StringType escapeStringGraphViz(const StringType &str)
-{
-    StringType res; res.reserve(str.size());
-    escapeStringGraphViz(std::back_inserter(res), str.begin(), str.end());
-    return res;
-}
-
-//----------------------------------------------------------------------------
 
 
 
@@ -192,17 +187,295 @@ OutputIterator escapeStringXmlHtml(OutputIterator outIt, InputIterator b, InputI
 }
 
 //----------------------------------------------------------------------------
-template<typename StringType> inline
-StringType escapeStringXmlHtml(const StringType &str)
+
+
+
+//----------------------------------------------------------------------------
+// Быстрые версии для std::string (char)
+/*
+    Для каждого экранировщика один раз строится таблица замен на все 256 значений байта
+    (таблица строится прогоном самого экранировщика, поэтому результат совпадает байт в байт).
+
+    Дальше строка сканируется блоками по 16 байт (SSE2), ищутся байты, требующие экранирования,
+    "чистые" участки копируются через memcpy. Размер результата подсчитывается заранее тем же
+    сканированием, поэтому выходная строка аллоцируется один раз. Если экранировать нечего,
+    вход просто копируется.
+
+    UMBA_ESCAPE_STRING_NO_SIMD - отключает SSE2 (остаётся табличная проверка по байтам).
+ */
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace escape_string_details {
+
+//------------------------------
+struct EscapeTable
 {
-    StringType res; res.reserve(str.size());
-    escapeStringXmlHtml(std::back_inserter(res), str.begin(), str.end());
-    return res;
+    std::uint8_t  len    [256];
+    char          data   [256][8];
+    bool          special[256];    // Байт заменяется чем-то, кроме самого себя
+};
+
+//------------------------------
+template<typename EscapeFn> inline
+EscapeTable makeEscapeTable( EscapeFn escapeFn )
+{
+    EscapeTable t;
+    for(unsigned i=0; i!=256u; ++i)
+    {
+        std::string in(1, (char)i), out;
+        escapeFn(std::back_inserter(out), in.begin(), in.end());
+
+        t.len[i] = (std::uint8_t)out.size();
+        std::memset(t.data[i], 0, sizeof(t.data[i]));
+        std::memcpy(t.data[i], out.data(), out.size()<sizeof(t.data[i]) ? out.size() : sizeof(t.data[i]));
+        t.special[i] = out!=in;
+    }
+    return t;
 }
 
+//------------------------------
+using umba::internal::lowestBitIndex;
+
+//------------------------------
+// Описание экранировщиков для SIMD-сканирования: управляющие символы и байты >=0x80 (для char они отрицательные
+// и попадают под ch<' ') плюс список отдельных спецсимволов. Маска может быть шире, чем реальный набор
+// экранируемых символов - лишние срабатывания обрабатываются таблицей.
+
+struct EscapeTraitsC
+{
+    static constexpr bool        controlAndHigh = true;
+    static constexpr std::size_t numSpecials    = 3;
+    static const char* specials() { return "\'\"\\"; }
+
+    static const EscapeTable& table()
+    {
+        static const EscapeTable t = makeEscapeTable( []( auto outIt, auto b, auto e ) { return escapeStringC(outIt, b, e); } );
+        return t;
+    }
+};
+
+struct EscapeTraitsGraphViz
+{
+    static constexpr bool        controlAndHigh = true;
+    static constexpr std::size_t numSpecials    = 8;
+    static const char* specials() { return "<>|{}\'\"\\"; }
+
+    static const EscapeTable& table()
+    {
+        static const EscapeTable t = makeEscapeTable( []( auto outIt, auto b, auto e ) { return escapeStringGraphViz(outIt, b, e); } );
+        return t;
+    }
+};
+
+struct EscapeTraitsXmlHtml
+{
+    static constexpr bool        controlAndHigh = false;
+    static constexpr std::size_t numSpecials    = 5;
+    static const char* specials() { return "&<>\'\""; }
+
+    static const EscapeTable& table()
+    {
+        static const EscapeTable t = makeEscapeTable( []( auto outIt, auto b, auto e ) { return escapeStringXmlHtml(outIt, b, e); } );
+        return t;
+    }
+};
+
+#if defined(UMBA_ESCAPE_STRING_SSE2)
+
+//------------------------------
+template<typename Traits> inline
+unsigned specialMask( const char *p )
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_setzero_si128();
+    if (Traits::controlAndHigh)
+        m = _mm_cmplt_epi8(v, _mm_set1_epi8(' ')); // знаковое сравнение - захватывает и байты >=0x80
+    const char *specials = Traits::specials();
+    for(std::size_t i=0; i!=Traits::numSpecials; ++i)
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(specials[i])));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+
+#endif
+
+//------------------------------
+template<typename Traits> inline
+std::size_t calcEscapedSize( const char *p, std::size_t n )
+{
+    const EscapeTable &t = Traits::table();
+
+    std::size_t total = 0;
+    std::size_t i     = 0;
+
+    #if defined(UMBA_ESCAPE_STRING_SSE2)
+    for(; i+16<=n; i+=16)
+    {
+        total += 16;
+        for(unsigned m=specialMask<Traits>(p+i); m; m&=m-1)
+            total += t.len[(unsigned char)p[i+lowestBitIndex(m)]] - 1u;
+    }
+    #endif
+
+    for(; i!=n; ++i)
+        total += t.len[(unsigned char)p[i]];
+
+    return total;
+}
+
+//------------------------------
+template<typename Traits> inline
+void appendEscaped( std::string &out, const char *p, std::size_t n )
+{
+    std::size_t escapedSize = calcEscapedSize<Traits>(p, n);
+    if (escapedSize==n)
+    {
+        out.append(p, n); // Экранировать нечего
+        return;
+    }
+
+    const EscapeTable &t = Traits::table();
+
+    std::size_t outPos = out.size();
+    out.resize(outPos+escapedSize);
+    char *pOut = &out[outPos];
+
+    std::size_t runStart = 0;
+    auto emitSpecial = [&]( std::size_t pos )
+    {
+        std::memcpy(pOut, p+runStart, pos-runStart);
+        pOut += pos-runStart;
+
+        unsigned char uch = (unsigned char)p[pos];
+        std::memcpy(pOut, t.data[uch], t.len[uch]);
+        pOut += t.len[uch];
+
+        runStart = pos+1;
+    };
+
+    std::size_t i = 0;
+
+    #if defined(UMBA_ESCAPE_STRING_SSE2)
+    for(; i+16<=n; i+=16)
+    {
+        for(unsigned m=specialMask<Traits>(p+i); m; m&=m-1)
+            emitSpecial(i+lowestBitIndex(m));
+    }
+    #endif
+
+    for(; i!=n; ++i)
+    {
+        if (t.special[(unsigned char)p[i]])
+            emitSpecial(i);
+    }
+
+    std::memcpy(pOut, p+runStart, n-runStart);
+}
+
+} // namespace escape_string_details
+//! @endcond
+
+//----------------------------------------------------------------------------
+//! Возвращает размер строки после экранирования в стиле C
+inline
+std::size_t calcEscapedStringCSize( std::string_view str )
+{
+    return escape_string_details::calcEscapedSize<escape_string_details::EscapeTraitsC>(str.data(), str.size());
+}
+
+//! Дописывает в out строку, экранированную в стиле C
+inline
+void appendEscapedStringC( std::string &out, std::string_view str )
+{
+    escape_string_details::appendEscaped<escape_string_details::EscapeTraitsC>(out, str.data(), str.size());
+}
+
+//----------------------------------------------------------------------------
+//! Возвращает размер строки после экранирования для GraphViz
+inline
+std::size_t calcEscapedStringGraphVizSize( std::string_view str )
+{
+    return escape_string_details::calcEscapedSize<escape_string_details::EscapeTraitsGraphViz>(str.data(), str.size());
+}
+
+//! Дописывает в out строку, экранированную для GraphViz
+inline
+void appendEscapedStringGraphViz( std::string &out, std::string_view str )
+{
+    escape_string_details::appendEscaped<escape_string_details::EscapeTraitsGraphViz>(out, str.data(), str.size());
+}
+
+//----------------------------------------------------------------------------
+//! Возвращает размер строки после экранирования для XML/HTML
+inline
+std::size_t calcEscapedStringXmlHtmlSize( std::string_view str )
+{
+    return escape_string_details::calcEscapedSize<escape_string_details::EscapeTraitsXmlHtml>(str.data(), str.size());
+}
+
+//! Дописывает в out строку, экранированную для XML/HTML
+inline
+void appendEscapedStringXmlHtml( std::string &out, std::string_view str )
+{
+    escape_string_details::appendEscaped<escape_string_details::EscapeTraitsXmlHtml>(out, str.data(), str.size());
+}
+
+//----------------------------------------------------------------------------
+
+
+
 //----------------------------------------------------------------------------
+template<typename StringType> inline
+StringType escapeStringC(const StringType &str)
+{
+    if constexpr (std::is_same<StringType, std::string>::value)
+    {
+        StringType res;
+        appendEscapedStringC(res, str);
+        return res;
+    }
+    else
+    {
+        StringType res; res.reserve(str.size());
+        escapeStringC(std::back_inserter(res), str.begin(), str.end());
+        return res;
+    }
+}
 
+//----------------------------------------------------------------------------
+template<typename StringType> inline
+StringType escapeStringGraphViz(const StringType &str)
+{
+    if constexpr (std::is_same<StringType, std::string>::value)
+    {
+        StringType res;
+        appendEscapedStringGraphViz(res, str);
+        return res;
+    }
+    else
+    {
+        StringType res; res.reserve(str.size());
+        escapeStringGraphViz(std::back_inserter(res), str.begin(), str.end());
+        return res;
+    }
+}
 
+//----------------------------------------------------------------------------
+template<typename StringType> inline
+StringType escapeStringXmlHtml(const StringType &str)
+{
+    if constexpr (std::is_same<StringType, std::string>::value)
+    {
+        StringType res;
+        appendEscapedStringXmlHtml(res, str);
+        return res;
+    }
+    else
+    {
+        StringType res; res.reserve(str.size());
+        escapeStringXmlHtml(std::back_inserter(res), str.begin(), str.end());
+        return res;
+    }
+}
 
 //----------------------------------------------------------------------------
 
@@ -696,7 +696,9 @@ StringType makeCanonicalForCompare( StringType                      fileName
     //
     // return addNativePrefixes(canoname, npfi, pathSep);
 
-    return umba::string_plus::tolower_copy(makeCanonical(fileName, pathSep, currentDirAlias, parentDirAlias, keepLeadingParents));
+    StringType canoname = makeCanonical(fileName, pathSep, currentDirAlias, parentDirAlias, keepLeadingParents);
+    umba::string_plus::tolower(canoname); // на месте, без лишней копии
+    return canoname;
 
     #if 0
     if (ustrp::starts_with_and_strip(canoname, getNativeNetworkUncPrefix<StringType>()))
@@ -23,6 +23,7 @@
 
 #include "internal/filesys.h"
 #include "internal/filesys_impl_helpers.h"
+#include "perf_probes.h"
 
 
 //-----------------------------------------------------------------------------
@@ -844,32 +845,48 @@ inline bool createDirEx( const char *dirname, bool forceCreatePath )
 
 
 
+//----------------------------------------------------------------------------
+//! @cond Doxygen_Suppress_Not_Documented
+namespace impl_helpers{
+
+template<typename NativeStringType, typename ContainerType> inline
+bool readFileProbed( const NativeStringType &filename, ContainerType &filedata, FileStat *pFileStat, bool ignoreSizeErrors )
+{
+    UMBA_PERF_PROBE_SCOPE_VAR(probeScope, "umba::filesys::readFile");
+    bool res = fsysapi::readFile(filename, filedata, pFileStat, ignoreSizeErrors);
+    UMBA_PERF_PROBE_ADD_BYTES(probeScope, (uint64_t)filedata.size()*sizeof(typename ContainerType::value_type));
+    return res;
+}
+
+} // namespace impl_helpers
+//! @endcond
+
 //----------------------------------------------------------------------------
 template<typename DataType> inline
 bool readFile( const std::wstring &filename, std::vector<DataType> &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 template<typename DataType> inline
 bool readFile( const std::string &filename, std::vector<DataType> &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 template<typename DataType> inline
 bool readFile( const wchar_t *filename, std::vector<DataType> &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 template<typename DataType> inline
 bool readFile( const char *filename   , std::vector<DataType> &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //----------------------------------------------------------------------------
@@ -879,25 +896,25 @@ bool readFile( const char *filename   , std::vector<DataType> &filedata, FileSta
 //----------------------------------------------------------------------------
 inline bool readFile( const std::wstring &filename, std::string &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 inline bool readFile( const std::string &filename, std::string &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 inline bool readFile( const wchar_t *filename, std::string &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //------------------------------
 inline bool readFile( const char *filename   , std::string &filedata, FileStat *pFileStat = 0, bool ignoreSizeErrors = true)
 {
-    return fsysapi::readFile(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
+    return impl_helpers::readFileProbed(impl_helpers::encodeToNative(filename), filedata, pFileStat, ignoreSizeErrors);
 }
 
 //----------------------------------------------------------------------------
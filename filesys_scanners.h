@@ -12,6 +12,7 @@
 #include "filename.h"
 #include "filesys.h"
 #include "info_log.h"
+#include "perf_probes.h"
 #include "regex_helpers.h"
 #include "umba.h"
 #include "string_plus.h"
@@ -160,6 +161,8 @@ void scanFolders( const std::vector<StringType> &rootScanPaths
                 , bool                          compareOnlyFilenames = false // not full paths
                 )
 {
+    UMBA_PERF_PROBE_SCOPE("umba::filesys::scanFolders");
+
     using namespace umba::omanip;
 
     //using PathListOrgType = decltype(appConfig.scanPaths);
@@ -12,13 +12,19 @@
 #include "stl.h"
 #include "undef_FormatMessage.h"
 #include "debug_helpers.h"
+#include "format_utils.h"
 //
 #include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <exception>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 
 
@@ -37,174 +43,414 @@ enum class EFormatAlign : unsigned
 
 
 
+//! Точность для FormatMessage::arg/MessageFormatter::arg с плавающей точкой - кратчайшее представление, читаемое обратно в то же значение
+const int formatPrecisionShortest = std::numeric_limits<int>::min();
 
+
+
+//----------------------------------------------------------------------------
+//! Предварительно разобранный шаблон сообщения с макросами $(Name)
+/*! Разбор повторяет поведение umba::macros::substMacros с флагами smf_KeepUnknownVars|smf_DisableRecursion:
+    "$$" - символ '$', '$' без скобки остаётся как есть, значения без рекурсивной подстановки,
+    для неизвестных аргументов текст "$(Name)" сохраняется.
+
+    Макросы с аргументами и условные макросы (':' или '?' в имени, вложенные скобки) не разбираются -
+    для таких шаблонов isSimple() возвращает false, и форматирование выполняется через substMacros.
+ */
 template<typename StringType>
-class FormatMessage
+class MessageTemplate
 {
 
+public:
+
     typedef typename StringType::value_type    CharType;
-    //typedef typename StringType::value_type    char_type;
 
-public:
+    static const std::size_t npos = (std::size_t)-1;
 
-    typedef umba::macros::StringStringMap<StringType>  macros_map_type;
+    MessageTemplate() {}
 
-protected:
+    explicit MessageTemplate(const StringType &msg)
+    {
+        parse(msg);
+    }
 
-    umba::macros::StringStringMap<StringType>  formattedMacros    ;
-    StringType                                 messageText        ;
-    bool                                       onlyForArgs = false;
-    bool                                       fShowbase   = true ;
-    bool                                       fShowsign   = false;
-    unsigned                                   uBase       = 10   ;
+    void parse(const StringType &msg)
+    {
+        m_text = msg;
+        m_segments.clear();
+        m_argNames.clear();
+        m_simple = true;
 
-    //TODO: !!! Надо подумать на тему замены десятичного разделителя и разделителя разрядов
+        const std::size_t size = m_text.size();
 
+        std::size_t litStart = 0;
+        std::size_t pos      = 0;
 
-protected: // utils
+        while(pos<size)
+        {
+            if (m_text[pos]!=(CharType)'$')
+            {
+                ++pos;
+                continue;
+            }
 
-    StringType getComplementString( const StringType &str, std::size_t sz, CharType fillChar=(CharType)' ')
-    {
-        if (str.size()>=sz)
-            return StringType();
+            addLiteral(litStart, pos);
 
-        return StringType( sz-str.size(), fillChar );
-    }
+            if (pos+1>=size) // '$' в конце отбрасывается
+            {
+                litStart = pos = size;
+                break;
+            }
 
-    template<typename UnsignedType>
-    static StringType formatUnsigned(UnsignedType u, UnsignedType base, std::size_t width)
-    {
-        StringType resStr;
+            if (m_text[pos+1]==(CharType)'$')
+            {
+                litStart = pos+1;
+                pos     += 2;
+                continue;
+            }
 
-        for(std::size_t i=0; i<width || u; ++i)
-        {
-            UnsignedType d = u % base;
-            CharType ch = (CharType)(d<=10 ? d+'0' : d+'A'-10);
-            resStr.append(1,ch);
-            u /= base;
-        }
+            if (m_text[pos+1]!=(CharType)'(')
+            {
+                litStart = pos;
+                pos     += 2;
+                continue;
+            }
+
+            std::size_t nameStart = pos+2;
+            std::size_t nameEnd   = nameStart;
+            int         brCnt     = 1;
+            for(; nameEnd<size; ++nameEnd)
+            {
+                CharType ch = m_text[nameEnd];
+                if (ch==(CharType)'(')
+                {
+                    ++brCnt;
+                    m_simple = false;
+                }
+                else if (ch==(CharType)')')
+                {
+                    if (!--brCnt)
+                        break;
+                }
+                else if (ch==(CharType)':' || ch==(CharType)'?')
+                {
+                    m_simple = false;
+                }
+            }
+
+            if (nameEnd>=size) // Незакрытая скобка - остаток выводится без "$("
+            {
+                litStart = nameStart<size ? nameStart : size;
+                pos      = size;
+                break;
+            }
+
+            Segment seg;
+            seg.textPos = pos;
+            seg.textLen = nameEnd+1-pos;
+            seg.argIdx  = addArgName(StringType(m_text, nameStart, nameEnd-nameStart));
+            m_segments.emplace_back(seg);
 
-        std::reverse(resStr.begin(), resStr.end());
+            litStart = pos = nameEnd+1;
+        }
 
-        return resStr;
+        addLiteral(litStart, pos);
     }
 
-    template< typename UnsignedType >
-    static
-    typename std::enable_if<std::is_unsigned<UnsignedType>::value,  /* typename  */ StringType >::type
-    formatIntDecimal(UnsignedType u, bool showSign = false)
-    {
-        StringType resStr;
+    //! Шаблон можно форматировать без substMacros
+    bool isSimple() const { return m_simple; }
 
-        while(u)
+    //! Исходный текст шаблона
+    const StringType& getText() const { return m_text; }
+
+    //! Количество различных аргументов
+    std::size_t getNumArgs() const { return m_argNames.size(); }
+
+    //! Имя аргумента по индексу
+    const StringType& getArgName(std::size_t idx) const { return m_argNames[idx]; }
+
+    //! Индекс аргумента по имени, или npos
+    std::size_t findArg(const StringType &name) const
+    {
+        for(std::size_t i=0; i!=m_argNames.size(); ++i)
         {
-            UnsignedType d = u % 10;
-            CharType ch = (CharType)(d+'0');
-            resStr.append(1,ch);
-            u /= 10;
+            if (m_argNames[i]==name)
+                return i;
         }
+        return npos;
+    }
+
+    //! Дописывает в out текст с подстановкой значений (только для isSimple())
+    /*! getValue(argIdx, pValue, valueLen) возвращает false, если значения нет (тогда "$(Name)" выводится как есть)
+     */
+    template<typename ValueGetter>
+    void format(StringType &out, ValueGetter getValue) const
+    {
+        UMBA_ASSERT(m_simple);
 
-        if (showSign)
+        for(const auto &seg : m_segments)
         {
-            resStr.append(1,(CharType)'+');
+            const CharType *pValue = 0;
+            std::size_t     len    = 0;
+
+            if (seg.argIdx==npos || !getValue(seg.argIdx, pValue, len))
+                out.append(m_text, seg.textPos, seg.textLen);
+            else
+                out.append(pValue, len);
         }
+    }
 
-        std::reverse(resStr.begin(), resStr.end());
 
-        return resStr;
+protected:
 
+    struct Segment
+    {
+        std::size_t textPos; // Литерал или исходный текст "$(Name)"
+        std::size_t textLen;
+        std::size_t argIdx ; // npos - литерал
+    };
+
+    void addLiteral(std::size_t b, std::size_t e)
+    {
+        if (b>=e)
+            return;
+
+        Segment seg;
+        seg.textPos = b;
+        seg.textLen = e-b;
+        seg.argIdx  = npos;
+        m_segments.emplace_back(seg);
     }
 
-    template< typename IntType >
-    static
-    typename std::enable_if<std::is_signed<IntType>::value,  /* typename */  StringType>::type
-    formatIntDecimal(IntType intVal, bool showSign = false)
+    std::size_t addArgName(const StringType &name)
     {
-        typedef typename std::make_unsigned<IntType>::type UnsignedType;
+        std::size_t idx = findArg(name);
+        if (idx!=npos)
+            return idx;
 
-        StringType resStr;
+        m_argNames.emplace_back(name);
+        return m_argNames.size()-1;
+    }
 
-        bool neg = false;
+    StringType                 m_text    ;
+    std::vector<Segment>       m_segments;
+    std::vector<StringType>    m_argNames;
+    bool                       m_simple = true;
 
-        UnsignedType u = (UnsignedType)intVal;
+}; // class MessageTemplate
 
-        if (intVal<0)
-        {
-            u = 0-u;
-            neg = true;
-        }
 
-        while(u)
-        {
-            UnsignedType d = u % 10;
-            CharType ch = (CharType)(d+'0');
-            resStr.append(1,ch);
-            u /= 10;
-        }
 
-        if (neg || showSign)
-        {
-            resStr.append(1,(CharType)(neg ? '-': '+'));
-        }
+//! @cond Doxygen_Suppress_Not_Documented
+namespace format_message_details {
 
-        std::reverse(resStr.begin(), resStr.end());
+template<typename StringType> inline
+void appendAscii(StringType &out, const char *p, std::size_t n)
+{
+    typedef typename StringType::value_type CharType;
 
-        return resStr;
+    if constexpr (std::is_same<CharType, char>::value)
+    {
+        out.append(p, n);
+    }
+    else
+    {
+        for(std::size_t i=0; i!=n; ++i)
+            out.append(1, (CharType)p[i]);
     }
+}
 
+// Выводит [lead][numZeros нулей][body][numTrailZeros нулей], дополняя пробелами до fieldWidth согласно align
+template<typename StringType> inline
+void appendAsciiAligned( StringType &out
+                       , const char *pLead, std::size_t leadLen
+                       , std::size_t numZeros
+                       , const char *pBody, std::size_t bodyLen
+                       , std::size_t numTrailZeros
+                       , std::size_t fieldWidth, EFormatAlign align
+                       )
+{
+    typedef typename StringType::value_type CharType;
+
+    std::size_t len  = leadLen+numZeros+bodyLen+numTrailZeros;
+    std::size_t pad  = fieldWidth>len ? fieldWidth-len : 0;
+    std::size_t padL = align==EFormatAlign::right ? pad : (align==EFormatAlign::center ? pad/2 : 0);
+
+    out.append(padL, (CharType)' ');
+    appendAscii(out, pLead, leadLen);
+    out.append(numZeros, (CharType)'0');
+    appendAscii(out, pBody, bodyLen);
+    out.append(numTrailZeros, (CharType)'0');
+    out.append(pad-padL, (CharType)' ');
+}
 
-    static StringType getUnsignedPrefix(unsigned base)
+template<typename StringType> inline
+void appendAligned(StringType &out, const typename StringType::value_type *p, std::size_t n, std::size_t fieldWidth, EFormatAlign align)
+{
+    typedef typename StringType::value_type CharType;
+
+    std::size_t pad  = fieldWidth>n ? fieldWidth-n : 0;
+    std::size_t padL = align==EFormatAlign::right ? pad : (align==EFormatAlign::center ? pad/2 : 0);
+
+    out.append(padL, (CharType)' ');
+    out.append(p, n);
+    out.append(pad-padL, (CharType)' ');
+}
+
+inline
+std::size_t getUnsignedPrefixLen(unsigned base)
+{
+    switch(base)
     {
-        StringType resStr;
+        case 2 : return 2;
+        case 8 : return 1;
+        case 16: return 2;
+        default: return 0;
+    }
+}
+
+inline
+const char* getUnsignedPrefix(unsigned base)
+{
+    switch(base)
+    {
+        case 2 : return "0b";
+        case 8 : return "0";
+        case 16: return "0x";
+        default: return "";
+    }
+}
 
-        switch(base)
+// Основание 10 - десятичное число со знаком, иначе - беззнаковое с префиксом (если showBase) и ведущими нулями до ширины поля
+template<typename StringType, typename IntType> inline
+void appendIntegral(StringType &out, IntType val, unsigned base, bool showBase, bool showSign, std::size_t fieldWidth, EFormatAlign align)
+{
+    typedef typename std::make_unsigned<IntType>::type UnsignedType;
+
+    char buf[umba::format_utils::maxFormattedIntegerSize];
+
+    if (base==10)
+    {
+        std::size_t len = 0;
+        if constexpr (std::is_signed<IntType>::value)
         {
-            case 2 :
-            case 8 :
-            case 16:
-                 resStr.append(1,(CharType)'0'); break;
+            len = umba::format_utils::formatSignedDecimal(buf, (std::int64_t)val, showSign);
         }
-
-        switch(base)
+        else
         {
-            case 2 :
-                 resStr.append(1,(CharType)'b'); break;
-            case 16:
-                 resStr.append(1,(CharType)'x'); break;
+            if (showSign)
+                buf[len++] = '+';
+            len += umba::format_utils::formatUnsignedDecimal(buf+len, (std::uint64_t)val);
         }
 
-        return resStr;
+        appendAsciiAligned(out, buf, len, 0, 0, 0, 0, fieldWidth, align);
+        return;
     }
 
-    static std::size_t getUnsignedPrefixLen(unsigned base)
+    std::size_t prefixWidth = getUnsignedPrefixLen(base);
+    std::size_t numberWidth = prefixWidth<fieldWidth ? fieldWidth-prefixWidth : 0;
+
+    std::size_t len      = umba::format_utils::formatUnsignedBase(buf, (std::uint64_t)(UnsignedType)val, base<2 ? 2 : base);
+    std::size_t numZeros = len<numberWidth ? numberWidth-len : 0;
+
+    const char *prefix = showBase ? getUnsignedPrefix(base) : "";
+    appendAsciiAligned(out, prefix, std::strlen(prefix), numZeros, buf, len, 0, fieldWidth, align);
+}
+
+// precision: formatPrecisionShortest - кратчайшее представление, <0 - не более -precision значащих цифр (%g),
+// >=0 - %g с precision значащих цифр, дополненное нулями до precision цифр после точки
+template<typename StringType, typename FloatType> inline
+void appendFloat(StringType &out, FloatType val, int precision, std::size_t fieldWidth, EFormatAlign align)
+{
+    char buf[128];
+    std::size_t len = 0;
+
+    if (precision==formatPrecisionShortest)
     {
-        switch(base)
-        {
-            case 2 : return 2;
-            case 8 : return 1;
-            case 16: return 2;
-            default: return 0;
-        }
+        if constexpr (std::is_same<FloatType, float>::value)
+            len = umba::format_utils::formatFloatShortest(buf, sizeof(buf), val);
+        else
+            len = umba::format_utils::formatFloatShortest(buf, sizeof(buf), (double)val);
+
+        appendAsciiAligned(out, buf, len, 0, 0, 0, 0, fieldWidth, align);
+        return;
     }
 
-    #include "umba/warnings/push_disable_spectre_mitigation.h"
-    static unsigned getCorrectBase(unsigned base)
+    int prec = precision<0 ? -precision : precision;
+
+    std::vector<char> bigBuf;
+    char *p = buf;
+    int   n = 0;
+
+    for(;;)
     {
-        if (base<2)
-            return 2;
+        std::size_t bufSize = p==buf ? sizeof(buf) : bigBuf.size();
+        if constexpr (std::is_same<FloatType, long double>::value)
+            n = std::snprintf(p, bufSize, "%.*Lg", prec, val);
+        else
+            n = std::snprintf(p, bufSize, "%.*g", prec, (double)val);
 
-        return base;
+        if (n<0)
+            n = 0;
+        if ((std::size_t)n<bufSize)
+            break;
 
-        // Or?
-        // switch(base)
-        // {
-        //     case 2 : return 2;
-        //     case 8 : return 8;
-        //     case 16: return 16;
-        //     default: return 10;
-        // }
+        bigBuf.resize((std::size_t)n+1);
+        p = bigBuf.data();
     }
-    #include "umba/warnings/pop.h"
+
+    len = (std::size_t)n;
+
+    const char  *dotStr   = ".";
+    std::size_t  dotLen   = 0;
+    std::size_t  numZeros = 0;
+
+    if (precision>=0)
+    {
+        const char *pDot = (const char*)std::memchr(p, '.', len);
+        if (!pDot)
+        {
+            dotLen   = 1;
+            numZeros = (std::size_t)precision;
+        }
+        else
+        {
+            std::size_t curNumDigits = len-(std::size_t)(pDot+1-p);
+            if (curNumDigits<(std::size_t)precision)
+                numZeros = (std::size_t)precision-curNumDigits;
+        }
+    }
+
+    appendAsciiAligned(out, p, len, 0, dotStr, dotLen, numZeros, fieldWidth, align);
+}
+
+} // namespace format_message_details
+//! @endcond
+
+
+
+
+template<typename StringType>
+class FormatMessage
+{
+
+    typedef typename StringType::value_type    CharType;
+    //typedef typename StringType::value_type    char_type;
+
+public:
+
+    typedef umba::macros::StringStringMap<StringType>  macros_map_type;
+
+protected:
+
+    umba::macros::StringStringMap<StringType>  formattedMacros    ;
+    MessageTemplate<StringType>                messageTemplate    ; // Разбирается один раз в конструкторе
+    bool                                       onlyForArgs = false;
+    bool                                       fShowbase   = true ;
+    bool                                       fShowsign   = false;
+    unsigned                                   uBase       = 10   ;
+
+    //TODO: !!! Надо подумать на тему замены десятичного разделителя и разделителя разрядов
 
 
 public:
@@ -217,7 +463,7 @@ public:
 
     FormatMessage( const StringType &msg, const std::string &ltag=std::string() )
     : formattedMacros()
-    , messageText(msg)
+    , messageTemplate(msg)
     {
         UMBA_USED(ltag);
     }
@@ -231,15 +477,32 @@ public:
     StringType toString() const
     {
         UMBA_ASSERT(!onlyForArgs); // нам нужны аргументы для отложенного использования, а мы вызвали форматирование
-        return umba::macros::substMacros( messageText, umba::macros::MacroTextFromMapRef<StringType>(formattedMacros)
-                                        , umba::macros::smf_KeepUnknownVars | umba::macros::smf_DisableRecursion
-                                        );
+
+        if (!messageTemplate.isSimple())
+        {
+            return umba::macros::substMacros( messageTemplate.getText(), umba::macros::MacroTextFromMapRef<StringType>(formattedMacros)
+                                            , umba::macros::smf_KeepUnknownVars | umba::macros::smf_DisableRecursion
+                                            );
+        }
+
+        StringType res; res.reserve(messageTemplate.getText().size());
+        messageTemplate.format(res, [&](std::size_t idx, const CharType *&pValue, std::size_t &len)
+                                    {
+                                        typename macros_map_type::const_iterator it = formattedMacros.find(messageTemplate.getArgName(idx));
+                                        if (it==formattedMacros.end())
+                                            return false;
+                                        pValue = it->second.data();
+                                        len    = it->second.size();
+                                        return true;
+                                    }
+                              );
+        return res;
     }
 
     // Отдаёт шаблон сообщения и позволяет далее задавать аргументы
     FormatMessage& toString(StringType &msg)
     {
-        msg = messageText;
+        msg = messageTemplate.getText();
         return *this;
     }
 
@@ -339,107 +602,211 @@ public:
 
     FormatMessage& arg(const StringType &argName, const StringType &val, std::size_t fieldWidth=0, EFormatAlign align=EFormatAlign::left)
     {
-        StringType completemntString = getComplementString( val, fieldWidth, (CharType)' ' /* fillChar */ );
-        if (align==EFormatAlign::left)
-        {
-            formattedMacros[argName] = val + completemntString;
-        }
-        else if (align==EFormatAlign::right)
-        {
-            formattedMacros[argName] = completemntString + val;
-        }
-        else // center
-        {
-            std::size_t lenLeft  = completemntString.size()/2;
-            // std::size_t lenRight = completemntString.size()-lenLeft; // not used
-            formattedMacros[argName] = StringType(completemntString, 0, lenLeft)
-                                     + val
-                                     + StringType(completemntString, lenLeft)
-                                     ;
-        }
-
+        StringType &dst = formattedMacros[argName];
+        dst.clear();
+        format_message_details::appendAligned(dst, val.data(), val.size(), fieldWidth, align);
         return *this;
-
     }
 
     template< class T
             , typename = std::enable_if_t<std::is_integral<T>::value> >
     FormatMessage& arg(const StringType &argName, T val, std::size_t fieldWidth=0, EFormatAlign align=EFormatAlign::left)
     {
-        //typedef typename std::make_signed<T>::type   IntType;
-        typedef typename std::make_unsigned<T>::type UnsignedType;
+        StringType &dst = formattedMacros[argName];
+        dst.clear();
+        format_message_details::appendIntegral(dst, val, uBase, fShowbase, fShowsign, fieldWidth, align);
+        return *this;
+    }
 
-        StringType  valFormatted;
+    template< class T
+            , typename = std::enable_if_t<std::is_floating_point<T>::value> >
+    FormatMessage& arg( const StringType &argName
+                      , T val
+                      , int precision=-2 //!< <0 - auto, the max number of digits after the decimal point, >0 - force number of digits, formatPrecisionShortest - shortest round-trip
+                      , std::size_t fieldWidth=0
+                      , EFormatAlign align=EFormatAlign::left
+                      )
+    {
+        StringType &dst = formattedMacros[argName];
+        dst.clear();
+        format_message_details::appendFloat(dst, val, precision, fieldWidth, align);
+        return *this;
+    }
 
-        if (uBase==10)
-        {
-            valFormatted = formatIntDecimal(val, fShowsign);
 
-        }
-        else
-        {
-            std::size_t prefixWidth = getUnsignedPrefixLen((UnsignedType)uBase);
-            std::size_t numberWidth = prefixWidth<fieldWidth ? fieldWidth-prefixWidth : 0;
+}; // class FormatMessage
+
+
+
+//----------------------------------------------------------------------------
+//! Форматирование сообщений по предварительно разобранному шаблону
+/*! В отличие от FormatMessage значения не хранятся в map, а пишутся прямо в общий буфер,
+    который переиспользуется между сообщениями (см. reset()). Шаблон разбирается один раз
+    и должен жить дольше форматтера.
+
+    \code
+    static const umba::MessageTemplate<std::string> tpl("$(File):$(Line): $(Msg)");
+    umba::MessageFormatter<std::string> fmt(tpl);
+    for(...)
+    {
+        fmt.reset().arg("File", fileName).arg("Line", lineNo).arg("Msg", msg);
+        fmt.formatTo(logLine);
+    }
+    \endcode
+ */
+template<typename StringType>
+class MessageFormatter
+{
 
-            valFormatted = fShowbase
-                         ? getUnsignedPrefix((UnsignedType)uBase) + formatUnsigned<UnsignedType>(val, getCorrectBase(uBase), numberWidth)
-                         :                                          formatUnsigned<UnsignedType>(val, getCorrectBase(uBase), numberWidth)
-                         ;
+public:
+
+    typedef typename StringType::value_type    CharType;
+    typedef MessageTemplate<StringType>        template_type;
+
+    explicit MessageFormatter(const template_type &tpl)
+    : m_pTemplate(&tpl)
+    , m_slots(tpl.getNumArgs(), Slot{template_type::npos, 0})
+    {}
+
+    //! Сбрасывает значения аргументов, буфер при этом сохраняется
+    MessageFormatter& reset()
+    {
+        m_values.clear();
+        std::fill(m_slots.begin(), m_slots.end(), Slot{template_type::npos, 0});
+        return *this;
+    }
+
+    MessageFormatter& showbase(bool bShow=true) { fShowbase = bShow; return *this; }
+    MessageFormatter& noshowbase()              { return showbase(false); }
+    MessageFormatter& showsign(bool bShow=true) { fShowsign = bShow; return *this; }
+    MessageFormatter& noshowsign()              { return showsign(false); }
+
+    MessageFormatter& base(unsigned b)
+    {
+        if (b>36)
+        {
+            #ifdef UMBA_DEBUGBREAK
+                UMBA_DEBUGBREAK();
+            #endif
+            throw std::runtime_error("MessageFormatter::base: number base is out of limit (36)");
         }
+        uBase = b;
+        return *this;
+    }
 
-        return arg(argName, valFormatted, fieldWidth, align);
+    MessageFormatter& hex() { return base(16); }
+    MessageFormatter& dec() { return base(10); }
+    MessageFormatter& oct() { return base(8 ); }
+    MessageFormatter& bin() { return base(2 ); }
+
+    MessageFormatter& arg(const StringType &argName, const StringType &val, std::size_t fieldWidth=0, EFormatAlign align=EFormatAlign::left)
+    {
+        std::size_t idx = m_pTemplate->findArg(argName);
+        if (idx==template_type::npos)
+            return *this; // В шаблоне нет такого аргумента
+
+        std::size_t start = m_values.size();
+        format_message_details::appendAligned(m_values, val.data(), val.size(), fieldWidth, align);
+        setSlot(idx, start);
+        return *this;
+    }
+
+    template< class T
+            , typename = std::enable_if_t<std::is_integral<T>::value> >
+    MessageFormatter& arg(const StringType &argName, T val, std::size_t fieldWidth=0, EFormatAlign align=EFormatAlign::left)
+    {
+        std::size_t idx = m_pTemplate->findArg(argName);
+        if (idx==template_type::npos)
+            return *this;
+
+        std::size_t start = m_values.size();
+        format_message_details::appendIntegral(m_values, val, uBase, fShowbase, fShowsign, fieldWidth, align);
+        setSlot(idx, start);
+        return *this;
     }
 
     template< class T
             , typename = std::enable_if_t<std::is_floating_point<T>::value> >
-    FormatMessage& arg( const StringType &argName
-                      , T val
-                      , int precision=-2 //!< <0 - auto, the max number of digits after the decimal point, >0 - force number of digits
-                      , std::size_t fieldWidth=0
-                      , EFormatAlign align=EFormatAlign::left
-                      )
+    MessageFormatter& arg( const StringType &argName
+                         , T val
+                         , int precision=-2 //!< см. FormatMessage::arg; formatPrecisionShortest - кратчайшее представление
+                         , std::size_t fieldWidth=0
+                         , EFormatAlign align=EFormatAlign::left
+                         )
     {
-        std::basic_ostringstream<CharType> oss;
+        std::size_t idx = m_pTemplate->findArg(argName);
+        if (idx==template_type::npos)
+            return *this;
+
+        std::size_t start = m_values.size();
+        format_message_details::appendFloat(m_values, val, precision, fieldWidth, align);
+        setSlot(idx, start);
+        return *this;
+    }
 
-        if (precision<0)
+    //! Дописывает отформатированное сообщение в out
+    void formatTo(StringType &out) const
+    {
+        if (m_pTemplate->isSimple())
         {
-            oss.precision(-precision);
+            m_pTemplate->format(out, [this](std::size_t idx, const CharType *&pValue, std::size_t &len)
+                                     {
+                                         const Slot &slot = m_slots[idx];
+                                         if (slot.pos==template_type::npos)
+                                             return false;
+                                         pValue = m_values.data()+slot.pos;
+                                         len    = slot.len;
+                                         return true;
+                                     }
+                                );
+            return;
         }
-        else
+
+        umba::macros::StringStringMap<StringType> macros;
+        for(std::size_t i=0; i!=m_slots.size(); ++i)
         {
-            oss.precision(precision);
+            if (m_slots[i].pos!=template_type::npos)
+                macros[m_pTemplate->getArgName(i)] = StringType(m_values, m_slots[i].pos, m_slots[i].len);
         }
 
-        oss << val;
+        out.append( umba::macros::substMacros( m_pTemplate->getText(), umba::macros::MacroTextFromMapRef<StringType>(macros)
+                                             , umba::macros::smf_KeepUnknownVars | umba::macros::smf_DisableRecursion
+                                             )
+                  );
+    }
 
-        StringType str = oss.str();
+    StringType toString() const
+    {
+        StringType res;
+        formatTo(res);
+        return res;
+    }
 
-        typename StringType::size_type numAddZeros = 0;
-        if (precision>=0)
-        {
-            typename StringType::size_type dotPos = str.rfind((CharType)'.');
-            if (dotPos==str.npos)
-            {
-                str.append(1,(CharType)'.');
-                numAddZeros = (typename StringType::size_type)precision;
-            }
-            else
-            {
-                typename StringType::size_type curNumDigits = str.size()-(dotPos+1);
-                if (curNumDigits<(typename StringType::size_type)precision)
-                {
-                    numAddZeros = (typename StringType::size_type)precision - curNumDigits;
-                }
-            }
-        }
 
-        str.append(numAddZeros, (CharType)'0');
+protected:
+
+    struct Slot
+    {
+        std::size_t pos;
+        std::size_t len;
+    };
 
-        return arg(argName, str, fieldWidth, align);
+    void setSlot(std::size_t idx, std::size_t start)
+    {
+        m_slots[idx].pos = start;
+        m_slots[idx].len = m_values.size()-start;
     }
 
+    const template_type     *m_pTemplate = 0;
+    StringType               m_values      ;
+    std::vector<Slot>        m_slots       ;
+    bool                     fShowbase = true ;
+    bool                     fShowsign = false;
+    unsigned                 uBase     = 10   ;
+
+}; // class MessageFormatter
+
 
-}; // class FormatMessage
 
 
 template<typename StreamType, typename StringType>
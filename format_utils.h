@@ -14,6 +14,16 @@
 #include "umba.h"
 
 #include <algorithm>
+#include <cstring>
+
+#if !defined(UMBA_MCU_USED)
+    #include <cstdio>
+    #include <cstdlib>
+    #if (defined(_MSVC_LANG) && _MSVC_LANG>=201703L) || __cplusplus>=201703L
+        #include <charconv>
+        #include <system_error>
+    #endif
+#endif
 
 //----------------------------------------------------------------------------
 
@@ -209,6 +219,263 @@ size_t formatDecimalFixedPoint( uint8_t * pBuf, size_t bufSize, int64_t val, siz
 }
 
 //----------------------------------------------------------------------------
+//! Максимальная длина целого числа, форматируемого formatUnsignedDecimal/formatSignedDecimal/formatUnsignedBase (64 двоичные цифры + знак)
+const size_t maxFormattedIntegerSize = 66;
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace details
+{
+
+inline
+const char* getDecimalDigitPairs()
+{
+    static const char pairs[201] = "00010203040506070809"
+                                   "10111213141516171819"
+                                   "20212223242526272829"
+                                   "30313233343536373839"
+                                   "40414243444546474849"
+                                   "50515253545556575859"
+                                   "60616263646566676869"
+                                   "70717273747576777879"
+                                   "80818283848586878889"
+                                   "90919293949596979899";
+    return pairs;
+}
+
+inline
+size_t countDecimalDigits( uint64_t val )
+{
+    size_t n = 1;
+    for(;;)
+    {
+        if (val<10u   ) return n;
+        if (val<100u  ) return n+1;
+        if (val<1000u ) return n+2;
+        if (val<10000u) return n+3;
+        val /= 10000u;
+        n   += 4;
+    }
+}
+
+} // namespace details
+//! @endcond
+
+//----------------------------------------------------------------------------
+//! Форматирует беззнаковое число в десятичном виде, по две цифры за шаг
+/*! Возвращает число символов, помещенных в буфер (не более 20).
+    Не учитывает и не помещает в конец буфера завершающий 0.
+ */
+inline
+size_t formatUnsignedDecimal( char* pBuf, uint64_t val )
+{
+    const char *pairs = details::getDecimalDigitPairs();
+
+    size_t len = details::countDecimalDigits(val);
+    char  *p   = pBuf+len;
+
+    while(val>=100u)
+    {
+        unsigned r = (unsigned)(val%100u);
+        val /= 100u;
+        p -= 2;
+        p[0] = pairs[2*r  ];
+        p[1] = pairs[2*r+1];
+    }
+
+    if (val>=10u)
+    {
+        p[-2] = pairs[2*val  ];
+        p[-1] = pairs[2*val+1];
+    }
+    else
+    {
+        p[-1] = (char)('0'+val);
+    }
+
+    return len;
+}
+
+//----------------------------------------------------------------------------
+//! Форматирует знаковое число в десятичном виде. Знак '+' выводится, если задан showSign
+/*! Возвращает число символов, помещенных в буфер (не более 21).
+    Не учитывает и не помещает в конец буфера завершающий 0.
+ */
+inline
+size_t formatSignedDecimal( char* pBuf, int64_t val, bool showSign = false )
+{
+    uint64_t u = (uint64_t)val;
+    if (val<0)
+    {
+        *pBuf = '-';
+        return 1 + formatUnsignedDecimal(pBuf+1, 0-u);
+    }
+
+    if (showSign)
+    {
+        *pBuf = '+';
+        return 1 + formatUnsignedDecimal(pBuf+1, u);
+    }
+
+    return formatUnsignedDecimal(pBuf, u);
+}
+
+//----------------------------------------------------------------------------
+//! Форматирует беззнаковое число в системе счисления base (2-36)
+/*! Возвращает число символов, помещенных в буфер (не более 64). Для нуля выводится "0".
+    Не учитывает и не помещает в конец буфера завершающий 0.
+ */
+inline
+size_t formatUnsignedBase( char* pBuf, uint64_t val, unsigned base, CaseParam caseParam = CaseParam::upper )
+{
+    if (base==10)
+        return formatUnsignedDecimal(pBuf, val);
+
+    const char *digits = caseParam==CaseParam::lower ? "0123456789abcdefghijklmnopqrstuvwxyz" : "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    char  tmp[64];
+    char *p = tmp+64;
+
+    if ((base&(base-1))==0) // Степень двойки - сдвигами
+    {
+        unsigned shift = 0;
+        while((1u<<shift)<base)
+            ++shift;
+
+        do
+        {
+            *--p = digits[val&(base-1)];
+            val >>= shift;
+        } while(val);
+    }
+    else
+    {
+        do
+        {
+            *--p = digits[val%base];
+            val /= base;
+        } while(val);
+    }
+
+    size_t len = (size_t)(tmp+64-p);
+    std::memcpy(pBuf, p, len);
+    return len;
+}
+
+//----------------------------------------------------------------------------
+#if !defined(UMBA_MCU_USED)
+
+//! Максимальная длина числа с плавающей точкой, форматируемого formatFloatShortest
+const size_t maxFormattedFloatSize = 32;
+
+//----------------------------------------------------------------------------
+//! Форматирует число с плавающей точкой в кратчайшем виде, который читается обратно в то же самое значение
+/*! Возвращает число символов, помещенных в буфер, или 0, если буфер мал.
+    Не учитывает и не помещает в конец буфера завершающий 0.
+
+    Если стандартная библиотека поддерживает std::to_chars для плавающей точки, используется он
+    (в нормальных реализациях - Ryu), иначе подбирается минимальная точность %g, дающая то же значение.
+ */
+inline
+size_t formatFloatShortest( char* pBuf, size_t bufSize, double val )
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars>=201611L
+    std::to_chars_result res = std::to_chars(pBuf, pBuf+bufSize, val);
+    return res.ec==std::errc() ? (size_t)(res.ptr-pBuf) : 0;
+#else
+    int n = 0;
+    for(int prec=15; prec<=17; ++prec)
+    {
+        n = std::snprintf(pBuf, bufSize, "%.*g", prec, val);
+        if (n<0 || (size_t)n>=bufSize)
+            return 0;
+        if (std::strtod(pBuf, 0)==val)
+            break;
+    }
+    return (size_t)n;
+#endif
+}
+
+//! Форматирует число с плавающей точкой в кратчайшем виде, который читается обратно в то же самое значение. Версия для float
+inline
+size_t formatFloatShortest( char* pBuf, size_t bufSize, float val )
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars>=201611L
+    std::to_chars_result res = std::to_chars(pBuf, pBuf+bufSize, val);
+    return res.ec==std::errc() ? (size_t)(res.ptr-pBuf) : 0;
+#else
+    int n = 0;
+    for(int prec=6; prec<=9; ++prec)
+    {
+        n = std::snprintf(pBuf, bufSize, "%.*g", prec, (double)val);
+        if (n<0 || (size_t)n>=bufSize)
+            return 0;
+        if (std::strtof(pBuf, 0)==val)
+            break;
+    }
+    return (size_t)n;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! Форматирует число с плавающей точкой с заданной точностью, как printf("%.*f"), "%.*e", "%.*g" (и версии в верхнем регистре)
+/*! conv - один из 'f', 'F', 'e', 'E', 'g', 'G', precision<0 - точность по умолчанию (6). Флаги printf не поддерживаются.
+    Возвращает число символов, помещенных в буфер, или 0, если буфер мал или conv не поддерживается.
+    Не учитывает и не помещает в конец буфера завершающий 0.
+
+    Если стандартная библиотека поддерживает std::to_chars с точностью, используется он, иначе - snprintf.
+ */
+inline
+size_t formatFloatPrecision( char* pBuf, size_t bufSize, double val, char conv, int precision )
+{
+    if (precision<0)
+        precision = 6;
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars>=201611L
+    std::chars_format fmt = std::chars_format::general;
+    switch(conv)
+    {
+        case 'f': case 'F': fmt = std::chars_format::fixed     ; break;
+        case 'e': case 'E': fmt = std::chars_format::scientific; break;
+        case 'g': case 'G': fmt = std::chars_format::general   ; break;
+        default: return 0;
+    }
+
+    std::to_chars_result res = std::to_chars(pBuf, pBuf+bufSize, val, fmt, precision);
+    if (res.ec!=std::errc())
+        return 0;
+
+    size_t n = (size_t)(res.ptr-pBuf);
+    if (conv=='F' || conv=='E' || conv=='G')
+    {
+        for(size_t i=0; i!=n; ++i)
+        {
+            if (pBuf[i]>='a' && pBuf[i]<='z')
+                pBuf[i] = (char)(pBuf[i]-'a'+'A');
+        }
+    }
+
+    return n;
+#else
+    const char *fmt = 0;
+    switch(conv)
+    {
+        case 'f': fmt = "%.*f"; break;
+        case 'F': fmt = "%.*F"; break;
+        case 'e': fmt = "%.*e"; break;
+        case 'E': fmt = "%.*E"; break;
+        case 'g': fmt = "%.*g"; break;
+        case 'G': fmt = "%.*G"; break;
+        default: return 0;
+    }
+
+    int n = std::snprintf(pBuf, bufSize, fmt, precision, val);
+    return (n<0 || (size_t)n>=bufSize) ? 0 : (size_t)n;
+#endif
+}
+
+#endif
+
+//----------------------------------------------------------------------------
 
 
 
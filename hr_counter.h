@@ -17,6 +17,12 @@
 
     Минимальная задержка, которую можно получить на STM32F1 72MHz
     функцией delayNanosec - 1740 нс
+
+    Под Linux на x86 используется инвариантный TSC, частота которого калибруется по CLOCK_MONOTONIC_RAW
+    при первом обращении. Если TSC не инвариантный, или ядро пометило его как нестабильный,
+    используется clock_gettime(CLOCK_MONOTONIC_RAW) - тики в этом случае являются наносекундами.
+    На AArch64 используется виртуальный счётчик CNTVCT_EL0 с частотой из CNTFRQ_EL0.
+    Макрос UMBA_HR_COUNTER_NO_TSC принудительно включает использование clock_gettime.
 */
 
 #pragma once
@@ -31,7 +37,17 @@
 
 
 #if defined(UMBA_WIN32_USED)
-    // Ничего дополнительно подключать не требуется
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#elif defined(UMBA_LINUX_USED)
+    #include <stdio.h>
+    #include <string.h>
+    #include <time.h>
+    #if (defined(__i386__) || defined(__x86_64__)) && !defined(UMBA_HR_COUNTER_NO_TSC)
+        #include <cpuid.h>
+        #include <x86intrin.h>
+    #endif
 #elif defined(UMBA_QT_USED)
     // Ничего дополнительно подключать не требуется
 #elif defined(UMBA_FREERTOS_USED)
@@ -47,6 +63,16 @@ namespace umba{
 namespace hr_counter{
 
 
+//! Вычисляет value*mul/div без переполнения промежуточного произведения
+/*! Результат точный, если (div-1)*mul и (value/div)*mul помещаются в 64 бита
+ */
+inline
+uint64_t mulDivU64( uint64_t value, uint64_t mul, uint64_t div )
+{
+    return (value/div)*mul + (value%div)*mul/div;
+}
+
+
 
 #if defined(UMBA_WIN32_USED)
 
@@ -101,7 +127,7 @@ namespace hr_counter{
     inline
     NanosecInterval convertTickToNanosec( HiResTick tick )
     {
-        return (tick*1000*1000) / getTickFreqKHz();
+        return mulDivU64(tick, 1000*1000, getTickFreqKHz());
     }
 
     // Not required - types are the same
@@ -111,7 +137,7 @@ namespace hr_counter{
     inline
     HiResTick convertNanosecToTick( NanosecInterval ns )
     {
-        return ns*getTickFreqKHz() / (1000*1000);
+        return mulDivU64(ns, getTickFreqKHz(), 1000*1000);
     }
 
     //! Наносекундная блокирующая задержка
@@ -136,6 +162,306 @@ namespace hr_counter{
 
 
 
+#elif defined(UMBA_LINUX_USED)
+
+
+    typedef uint64_t  HiResTick;        //!< Тики высокого разрешения
+    typedef HiResTick NanosecInterval;  //!< Наносекундные тики
+    typedef uint64_t  HiResTickLong;    //!< Тики высокого разрешения большого размера
+
+    #if !defined(UMBA_HR_COUNTER_TSC_CALIBRATION_MS)
+        //! Длительность калибровки частоты TSC, миллисекунды
+        #define UMBA_HR_COUNTER_TSC_CALIBRATION_MS  20
+    #endif
+
+    #if !defined(UMBA_HR_COUNTER_NO_TSC) && (defined(__i386__) || defined(__x86_64__))
+        //! @cond Doxygen_Suppress_Not_Documented
+        #define UMBA_HR_COUNTER_X86_TSC
+        //! @endcond
+    #elif !defined(UMBA_HR_COUNTER_NO_TSC) && defined(__aarch64__)
+        //! @cond Doxygen_Suppress_Not_Documented
+        #define UMBA_HR_COUNTER_ARM_CNTVCT
+        //! @endcond
+    #endif
+
+    //! Параметры пересчёта тиков
+    struct TickCalibration
+    {
+        bool      hwCounter;  //!< true - используется аппаратный счётчик (TSC/CNTVCT), false - clock_gettime
+        uint64_t  freqHz;     //!< Частота тиков, Гц
+        uint64_t  toNsMul;    //!< Множитель пересчёта тиков в наносекунды, с фиксированной точкой 32.32
+        uint64_t  fromNsMul;  //!< Множитель пересчёта наносекунд в тики, с фиксированной точкой 32.32
+    };
+
+    //! @cond Doxygen_Suppress_Not_Documented
+    namespace details{
+
+    inline
+    uint64_t monotonicRawNanosec()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+
+    inline
+    uint64_t readHwCounter()
+    {
+        #if defined(UMBA_HR_COUNTER_X86_TSC)
+            return __rdtsc();
+        #elif defined(UMBA_HR_COUNTER_ARM_CNTVCT)
+            uint64_t v;
+            __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(v) :: "memory");
+            return v;
+        #else
+            return 0;
+        #endif
+    }
+
+    //! Проверяет, что ядро не забраковало TSC (при этом оно удаляет tsc из списка доступных clocksource)
+    inline
+    bool isTscAcceptedByKernel()
+    {
+        FILE *f = fopen("/sys/devices/system/clocksource/clocksource0/available_clocksource", "r");
+        if (!f)
+            return true; // sysfs недоступен - доверяем CPUID
+
+        char buf[256] = { 0 };
+        size_t n = fread(buf, 1, sizeof(buf)-1, f);
+        fclose(f);
+        buf[n] = 0;
+
+        return strstr(buf, "tsc")!=0;
+    }
+
+    inline
+    bool isHwCounterUsable()
+    {
+        #if defined(UMBA_HR_COUNTER_X86_TSC)
+            unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (!__get_cpuid(0x80000000u, &eax, &ebx, &ecx, &edx) || eax<0x80000007u)
+                return false;
+            if (!__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx))
+                return false;
+            if ((edx & (1u<<8))==0) // Invariant TSC
+                return false;
+            return isTscAcceptedByKernel();
+        #elif defined(UMBA_HR_COUNTER_ARM_CNTVCT)
+            return true;
+        #else
+            return false;
+        #endif
+    }
+
+    //! Измеряет частоту аппаратного счётчика, Гц
+    inline
+    uint64_t measureHwCounterFreq()
+    {
+        #if defined(UMBA_HR_COUNTER_ARM_CNTVCT)
+
+            uint64_t freq;
+            __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+            return freq;
+
+        #else
+
+            // Берём самую узкую "вилку" чтений времени вокруг чтения счётчика - на границах интервала
+            auto sample = []( uint64_t &tick, uint64_t &ns )
+            {
+                uint64_t bestWindow = (uint64_t)-1;
+                for(int i=0; i!=16; ++i)
+                {
+                    uint64_t ns1 = monotonicRawNanosec();
+                    uint64_t t   = readHwCounter();
+                    uint64_t ns2 = monotonicRawNanosec();
+                    if (ns2-ns1 < bestWindow)
+                    {
+                        bestWindow = ns2-ns1;
+                        tick = t;
+                        ns   = ns1 + (ns2-ns1)/2;
+                    }
+                }
+            };
+
+            uint64_t tick1 = 0, ns1 = 0, tick2 = 0, ns2 = 0;
+            sample(tick1, ns1);
+
+            struct timespec req;
+            req.tv_sec  = UMBA_HR_COUNTER_TSC_CALIBRATION_MS / 1000;
+            req.tv_nsec = (UMBA_HR_COUNTER_TSC_CALIBRATION_MS % 1000) * 1000000l;
+            while(nanosleep(&req, &req)!=0) {}
+
+            sample(tick2, ns2);
+
+            if (ns2<=ns1 || tick2<=tick1)
+                return 0;
+
+            return mulDivU64(tick2-tick1, 1000000000ull, ns2-ns1);
+
+        #endif
+    }
+
+    inline
+    TickCalibration calibrate()
+    {
+        TickCalibration c;
+        c.hwCounter = false;
+        c.freqHz    = 1000000000ull;
+
+        if (isHwCounterUsable())
+        {
+            uint64_t freq = measureHwCounterFreq();
+            if (freq>=1000000ull) // Меньше 1 МГц - что-то пошло не так
+            {
+                c.hwCounter = true;
+                c.freqHz    = freq;
+            }
+        }
+
+        c.toNsMul   = mulDivU64(1ull<<32, 1000000000ull, c.freqHz);
+        c.fromNsMul = mulDivU64(1ull<<32, c.freqHz, 1000000000ull);
+
+        return c;
+    }
+
+    //! Умножение на множитель с фиксированной точкой 32.32 без переполнения
+    inline
+    uint64_t mulFixed32( uint64_t value, uint64_t mul )
+    {
+        #if defined(__SIZEOF_INT128__)
+            return (uint64_t)(((unsigned __int128)value * mul) >> 32);
+        #elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+            uint64_t hi = 0;
+            uint64_t lo = _umul128(value, mul, &hi);
+            return (hi<<32) | (lo>>32);
+        #else
+            // Полное произведение 64x64->128 по 32-битным половинам (mul может быть больше 2^32)
+            uint64_t aLo = value & 0xFFFFFFFFull, aHi = value>>32;
+            uint64_t bLo = mul   & 0xFFFFFFFFull, bHi = mul  >>32;
+
+            uint64_t ll  = aLo*bLo;
+            uint64_t lh  = aLo*bHi;
+            uint64_t hl  = aHi*bLo;
+            uint64_t hh  = aHi*bHi;
+
+            uint64_t mid = (ll>>32) + (lh & 0xFFFFFFFFull) + (hl & 0xFFFFFFFFull); // Биты 32..95, не переполняется
+            uint64_t hi  = hh + (lh>>32) + (hl>>32) + (mid>>32);
+
+            return (hi<<32) | (mid & 0xFFFFFFFFull);
+        #endif
+    }
+
+    } // namespace details
+    //! @endcond
+
+    //! Возвращает параметры пересчёта тиков. Калибровка производится при первом вызове
+    inline
+    const TickCalibration& getTickCalibration()
+    {
+        static const TickCalibration c = details::calibrate();
+        return c;
+    }
+
+    //! Возвращает true, если подсистема тиков высокого разрешения доступна
+    inline
+    bool isCounterAvailable()
+    {
+        return true;
+    }
+
+    //! Возвращает true, если используется аппаратный счётчик (TSC), а не clock_gettime
+    inline
+    bool isHwCounterUsed()
+    {
+        return getTickCalibration().hwCounter;
+    }
+
+    //! Возвращает частоту hi-res тиков в килоргерцах
+    inline
+    HiResTick getTickFreqKHz()
+    {
+        return getTickCalibration().freqHz / 1000;
+    }
+
+    //! Возвращает текущее значение hi-res тика. Чтение не сериализуется - процессор может переставить его относительно соседнего кода
+    inline
+    HiResTick getTick()
+    {
+        if (getTickCalibration().hwCounter)
+            return details::readHwCounter();
+        return details::monotonicRawNanosec();
+    }
+
+    //! Возвращает значение hi-res тика для начала замера - предыдущие инструкции завершены, последующие не начаты (LFENCE; RDTSC; LFENCE)
+    inline
+    HiResTick getTickStart()
+    {
+        #if defined(UMBA_HR_COUNTER_X86_TSC)
+            if (getTickCalibration().hwCounter)
+            {
+                _mm_lfence();
+                HiResTick t = __rdtsc();
+                _mm_lfence();
+                return t;
+            }
+        #endif
+        return getTick();
+    }
+
+    //! Возвращает значение hi-res тика для конца замера - замеряемый код завершён (RDTSCP; LFENCE)
+    inline
+    HiResTick getTickStop()
+    {
+        #if defined(UMBA_HR_COUNTER_X86_TSC)
+            if (getTickCalibration().hwCounter)
+            {
+                unsigned aux;
+                HiResTick t = __rdtscp(&aux);
+                _mm_lfence();
+                return t;
+            }
+        #endif
+        return getTick();
+    }
+
+    //! Конвертирует hi-res тик в наносекунды
+    inline
+    NanosecInterval convertTickToNanosec( HiResTick tick )
+    {
+        return details::mulFixed32(tick, getTickCalibration().toNsMul);
+    }
+
+    //! Конвертирует наносеки в hi-res тики
+    inline
+    HiResTick convertNanosecToTick( NanosecInterval ns )
+    {
+        return details::mulFixed32(ns, getTickCalibration().fromNsMul);
+    }
+
+    //! Наносекундная блокирующая задержка
+    inline
+    void delayNanosec( NanosecInterval deltaNanosec )
+    {
+        HiResTick tickStart = getTick();
+        HiResTick deltaTick = convertNanosecToTick( deltaNanosec );
+
+        while( (getTick() - tickStart) <= deltaTick)
+        {
+            #if defined(UMBA_HR_COUNTER_X86_TSC)
+                _mm_pause();
+            #endif
+        }
+    }
+
+    //! Наносекундное ожидание (полный жесткач)
+    inline
+    void delayNanosecHard( NanosecInterval deltaNanosec )
+    {
+        delayNanosec( deltaNanosec );
+    }
+
+
+
 #elif defined(UMBA_MCU_USED)
 
     typedef uint32_t  HiResTick;        //!< Тики высокого разрешения
@@ -225,14 +551,14 @@ namespace hr_counter{
     inline
     HiResTickLong convertTickToNanosec( HiResTickLong tick )
     {
-        return (tick*1000*1000) / (HiResTickLong)getTickFreqKHz();
+        return mulDivU64(tick, 1000*1000, (HiResTickLong)getTickFreqKHz());
     }
 
     //! Конвертирует наносеки в hi-res тики
     inline
     HiResTickLong convertNanosecToTick( HiResTickLong ns )
     {
-        return ns*(HiResTickLong)getTickFreqKHz() / (1000*1000);
+        return mulDivU64(ns, (HiResTickLong)getTickFreqKHz(), 1000*1000);
     }
 
     //! Наносекундная блокирующая задержка
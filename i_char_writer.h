@@ -59,11 +59,13 @@ struct ICharWriter
     }
 
     //! Запись ASCII-Z строки
+    /*! Реализация по умолчанию передаёт строку целиком в writeBuf, чтобы реализации,
+        переопределившие writeBuf, получали её одним куском, а не по символу
+     */
     virtual
     void writeString( const char* str )
     {
-        for(; *str; ++str)
-           writeChar(*str);
+        writeBuf( (const uint8_t*)str, std::strlen(str) );
     }
 
     //! Сброс всех выходных буферов
@@ -10,6 +10,16 @@
 
 #include "transliteration.h"
 
+//
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
 namespace umba {
 
 
@@ -19,14 +29,20 @@ namespace umba {
 
 
 //----------------------------------------------------------------------------
+//! Генерирует идентификатор из текста, дописывая его в resText. tmp - буфер для транслитерации (переиспользуется)
 inline
-std::string generateIdFromText_generic(const std::string &t, char replaceChar)
+void appendIdFromText_generic(std::string &resText, std::string_view t, char replaceChar, std::string &tmp)
 {
-    std::string transliterated = transliterate(t);
+    static const Transliterator &translit = getCompiledTransliterator( { &getTransliterationMapUtf8_ru()
+                                                                       , &getTransliterationMapUtf8_ascii()
+                                                                       }
+                                                                     );
+    tmp.clear();
+    translit.transliterate(tmp, t);
 
-    std::string resText; resText.reserve(transliterated.size());
+    resText.reserve(resText.size()+tmp.size());
 
-    for(char ch: transliterated)
+    for(char ch: tmp)
     {
         if (ch>='a' && ch<='z')
         {
@@ -52,7 +68,14 @@ std::string generateIdFromText_generic(const std::string &t, char replaceChar)
             }
         }
     }
+}
 
+//----------------------------------------------------------------------------
+inline
+std::string generateIdFromText_generic(const std::string &t, char replaceChar)
+{
+    std::string resText, tmp;
+    appendIdFromText_generic(resText, t, replaceChar, tmp);
     return resText;
 }
 
@@ -109,6 +132,22 @@ std::unordered_map<std::string, std::string> makeGitHubIdTranslationMapUtf8_asci
 }
 
 UMBA_TRANSLITERTION_IMPLEMENT_GET_TRANSLIT_MAP(GitHubIdTranslationMapUtf8_ascii)
+
+//----------------------------------------------------------------------------
+//! Скомпилированный транслитератор для генерации идентификаторов в стиле GitHub
+inline
+const Transliterator& getGitHubIdTransliterator()
+{
+    static const Transliterator &translit = getCompiledTransliterator( { &getGitHubIdTranslationMapUtf8_ascii()
+                                                                       , &getLowercaseMapUtf8_ru()
+                                                                       , &getLowercaseMapUtf8_en()
+                                                                       , &getDigitsTranslationMapUtf8()
+                                                                       //, get
+                                                                       }
+                                                                     );
+    return translit;
+}
+
 //----------------------------------------------------------------------------
 
 
@@ -120,19 +159,272 @@ std::string generateIdFromText_forGitHub(const std::string &t, const std::string
 
     // Никакого алгоритма не используем, тупо заменяем, что знаем, остальное - просто игнорим
 
-    std::string transliterated = transliterateEx( t
-                                                , std::vector< std::unordered_map<std::string, std::string> >{ getGitHubIdTranslationMapUtf8_ascii()
-                                                                                                             , getLowercaseMapUtf8_ru()
-                                                                                                             , getLowercaseMapUtf8_en()
-                                                                                                             , getDigitsTranslationMapUtf8()
-                                                                                                             //, get
-                                                                                                             }
-                                                , 0 // replaceChar - игнорим
-                                                );
-    return prefix+transliterated;
+    std::string res = prefix;
+    getGitHubIdTransliterator().transliterate(res, t, 0 /* replaceChar - игнорим */ );
+    return res;
 }
 
 
+//----------------------------------------------------------------------------
+//! Стиль генерации идентификаторов
+enum class IdGenerationStyle
+{
+    gitHub   = 0,  //!< generateIdFromText_forGitHub
+    doxygen     ,  //!< generateIdFromText_forDoxygen
+    generic        //!< generateIdFromText_generic с заданным символом замены
+};
+
+//----------------------------------------------------------------------------
+//! Набор идентификаторов одного документа. Все идентификаторы лежат в одном буфере
+class IdBatch
+{
+
+public:
+
+    //! Количество идентификаторов
+    std::size_t size() const { return m_ranges.size(); }
+
+    //! Идентификатор по индексу исходного текста
+    std::string_view operator[]( std::size_t idx ) const
+    {
+        return std::string_view(m_arena.data()+m_ranges[idx].first, m_ranges[idx].second);
+    }
+
+    //! Копирует идентификаторы в вектор строк
+    std::vector<std::string> toStrings() const
+    {
+        std::vector<std::string> res; res.reserve(size());
+        for(std::size_t i=0; i!=size(); ++i)
+            res.emplace_back(operator[](i));
+        return res;
+    }
+
+
+protected:
+
+    friend class BatchIdGenerator;
+
+    std::string                                             m_arena;
+    std::vector< std::pair<std::uint32_t, std::uint32_t> >  m_ranges; //!< Смещение и длина идентификатора в m_arena
+
+}; // class IdBatch
+
+//----------------------------------------------------------------------------
+//! Пакетная генерация уникальных идентификаторов (якорей) для заголовков документа
+/*!
+    Повторы уникализируются как это делает GitHub (github-slugger): второй "foo" становится "foo-1",
+    третий - "foo-2", и т.д., при этом пропускаются суффиксы, которые уже заняты другими заголовками.
+
+    Уникальность обеспечивается в пределах одного вызова generate (одного документа).
+    Объект не изменяется при генерации, поэтому один генератор можно использовать из нескольких потоков.
+ */
+class BatchIdGenerator
+{
+
+public:
+
+    BatchIdGenerator( IdGenerationStyle style = IdGenerationStyle::gitHub, const std::string &prefix = std::string(), char replaceChar = '-' )
+    : m_style(style), m_prefix(prefix), m_replaceChar(replaceChar)
+    {}
+
+    //! Генерирует уникальные идентификаторы для заголовков одного документа
+    void generate( const std::vector<std::string> &texts, IdBatch &res ) const
+    {
+        res.m_arena.clear();
+        res.m_ranges.clear();
+        res.m_ranges.reserve(texts.size());
+        res.m_arena.reserve(texts.size()*(m_prefix.size()+24));
+
+        OccurrenceTable occurrences;
+        occurrences.reserve(texts.size());
+
+        std::string tmp;
+
+        for(const auto &t : texts)
+        {
+            std::size_t idStart = res.m_arena.size();
+            res.m_arena.append(m_prefix);
+            appendId(res.m_arena, t, tmp);
+            std::size_t idSize = res.m_arena.size()-idStart;
+
+            Slot *pSlot = occurrences.find(res.m_arena, idStart, idSize);
+            if (pSlot)
+            {
+                // Повтор - подбираем свободный суффикс, счётчик ведётся в слоте исходного идентификатора.
+                // До вставки таблица не меняется, так что указатель на слот остаётся валидным
+                std::size_t baseSize = idSize;
+                for(;;)
+                {
+                    std::uint32_t n = ++pSlot->counter;
+                    res.m_arena.resize(idStart+baseSize);
+                    res.m_arena.append(1u, '-');
+                    appendNumber(res.m_arena, n);
+                    idSize = res.m_arena.size()-idStart;
+                    if (!occurrences.find(res.m_arena, idStart, idSize))
+                        break;
+                }
+            }
+
+            occurrences.insert(res.m_arena, idStart, idSize);
+            res.m_ranges.push_back(std::make_pair((std::uint32_t)idStart, (std::uint32_t)idSize));
+        }
+    }
+
+    //! Генерирует уникальные идентификаторы для заголовков одного документа
+    IdBatch generate( const std::vector<std::string> &texts ) const
+    {
+        IdBatch res;
+        generate(texts, res);
+        return res;
+    }
+
+    //! Генерирует идентификаторы для нескольких документов параллельно (numThreads==0 - по числу ядер)
+    std::vector<IdBatch> generateForDocuments( const std::vector< std::vector<std::string> > &docs, unsigned numThreads = 0 ) const
+    {
+        std::vector<IdBatch> res(docs.size());
+
+        if (numThreads==0)
+            numThreads = std::thread::hardware_concurrency();
+        if (numThreads>docs.size())
+            numThreads = (unsigned)docs.size();
+
+        if (numThreads<2)
+        {
+            for(std::size_t i=0; i!=docs.size(); ++i)
+                generate(docs[i], res[i]);
+            return res;
+        }
+
+        std::atomic<std::size_t> nextDoc(0);
+        auto worker = [&]()
+        {
+            for(std::size_t i=nextDoc++; i<docs.size(); i=nextDoc++)
+                generate(docs[i], res[i]);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads-1);
+        for(unsigned i=1; i<numThreads; ++i)
+            threads.emplace_back(worker);
+
+        worker();
+
+        for(auto &t : threads)
+            t.join();
+
+        return res;
+    }
+
+
+protected:
+
+    struct Slot
+    {
+        std::uint32_t  offset  = 0;
+        std::uint32_t  size    = 0;
+        std::uint32_t  counter = 0;
+        bool           used    = false;
+    };
+
+    //! Хэш-таблица с открытой адресацией (линейное пробирование), строки лежат в буфере IdBatch
+    class OccurrenceTable
+    {
+    public:
+
+        void reserve( std::size_t n )
+        {
+            std::size_t cap = 16;
+            while(cap<n*2)
+                cap *= 2;
+            m_slots.assign(cap, Slot());
+            m_count = 0;
+        }
+
+        Slot* find( const std::string &arena, std::size_t offset, std::size_t size )
+        {
+            std::string_view key(arena.data()+offset, size);
+            std::size_t mask = m_slots.size()-1;
+            for(std::size_t idx=hash(key)&mask; m_slots[idx].used; idx=(idx+1)&mask)
+            {
+                const Slot &s = m_slots[idx];
+                if (s.size==size && std::string_view(arena.data()+s.offset, s.size)==key)
+                    return &m_slots[idx];
+            }
+            return 0;
+        }
+
+        void insert( const std::string &arena, std::size_t offset, std::size_t size )
+        {
+            if ((m_count+1)*2>m_slots.size())
+                grow(arena);
+
+            std::size_t mask = m_slots.size()-1;
+            std::size_t idx  = hash(std::string_view(arena.data()+offset, size))&mask;
+            while(m_slots[idx].used)
+                idx = (idx+1)&mask;
+
+            Slot &s = m_slots[idx];
+            s.offset  = (std::uint32_t)offset;
+            s.size    = (std::uint32_t)size;
+            s.counter = 0;
+            s.used    = true;
+            ++m_count;
+        }
+
+    protected:
+
+        static std::size_t hash( std::string_view key )
+        {
+            return std::hash<std::string_view>()(key);
+        }
+
+        void grow( const std::string &arena )
+        {
+            std::vector<Slot> old;
+            old.swap(m_slots);
+            m_slots.assign(old.empty() ? 16 : old.size()*2, Slot());
+
+            std::size_t mask = m_slots.size()-1;
+            for(const Slot &s : old)
+            {
+                if (!s.used)
+                    continue;
+                std::size_t idx = hash(std::string_view(arena.data()+s.offset, s.size))&mask;
+                while(m_slots[idx].used)
+                    idx = (idx+1)&mask;
+                m_slots[idx] = s;
+            }
+        }
+
+        std::vector<Slot>  m_slots;
+        std::size_t        m_count = 0;
+    };
+
+    void appendId( std::string &out, const std::string &t, std::string &tmp ) const
+    {
+        switch(m_style)
+        {
+            case IdGenerationStyle::gitHub : getGitHubIdTransliterator().transliterate(out, t, 0); break;
+            case IdGenerationStyle::doxygen: appendIdFromText_generic(out, t, '-', tmp); break;
+            default                        : appendIdFromText_generic(out, t, m_replaceChar, tmp);
+        }
+    }
+
+    static void appendNumber( std::string &out, std::uint32_t n )
+    {
+        char buf[16];
+        char *p = buf+sizeof(buf);
+        do { *--p = (char)('0' + n%10u); n /= 10u; } while(n);
+        out.append(p, (std::size_t)(buf+sizeof(buf)-p));
+    }
+
+    IdGenerationStyle  m_style;
+    std::string        m_prefix;
+    char               m_replaceChar;
+
+}; // class BatchIdGenerator
+
+
 
 // inline
 // std::string transliterateEx( const std::string &str, const std::unordered_map<std::string, std::string> &m )
@@ -13,6 +13,7 @@
 #include "env.h"
 #include "filename.h"
 #include "filesys.h"
+#include "perf_probes.h"
 #include "stl.h"
 #include "umba.h"
 
@@ -206,6 +207,8 @@ public:
                        , bool                      checkModified = false
                        )
     {
+        UMBA_PERF_PROBE_SCOPE("umba::IncludeFinder::findFile");
+
         FilenameStringType basePath = umba::filename::hasLastPathSep(baseName)
                                     ? baseName
                                     : baseName.empty() ? baseName : umba::filename::appendPathSepCopy<FilenameStringType>(umba::filename::getPath<FilenameStringType>(baseName))
@@ -18,17 +18,26 @@
 #include "debug_helpers.h"
 //
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
 #include <cstring>
 #include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <locale>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 //----------------------------------------------------------------------------
@@ -342,6 +351,9 @@ public:
     , m_parseIncludes(ini.m_parseIncludes)
     , m_separators(ini.m_separators)
     , m_pFileReader(&m_defaultReader)
+    , m_readedFiles(ini.m_readedFiles)
+    , m_pIncludeCache(ini.m_pIncludeCache)
+    , m_includedFiles(ini.m_includedFiles)
     {
         if (ini.m_pFileReader != &ini.m_defaultReader)
             m_pFileReader = ini.m_pFileReader;
@@ -379,6 +391,21 @@ public:
         m_pFileReader = pFileReader;
     }
 
+    //! Кеш подключаемых файлов
+    class IncludeCache;
+
+    //! Устанавливает кеш подключаемых файлов. Кеш не принадлежит объекту Ini и должен жить дольше него. 0 - отключить кеширование
+    void setIncludeCache( IncludeCache *pIncludeCache )
+    {
+        m_pIncludeCache = pIncludeCache;
+    }
+
+    //! Возвращает установленный кеш подключаемых файлов
+    IncludeCache* getIncludeCache() const
+    {
+        return m_pIncludeCache;
+    }
+
     //! Читает и препарсит файл из вектора строк
     void readFrom( const std::vector<std::string> &lines, const std::string &fileName = "-" )
     {
@@ -624,8 +651,8 @@ protected:
 
     }
 
-    //! Парсит инклюжу
-    std::vector< LineInfo > processInclude( std::string includeFileName, size_t fileId, size_t lineNumber )
+    //! Парсит инклюжу и дописывает её строки в конец lines
+    void processInclude( std::string includeFileName, size_t fileId, size_t lineNumber, std::vector< LineInfo > &lines )
     {
         umba::string_plus::trim(includeFileName);
 
@@ -652,11 +679,25 @@ protected:
             throw umba::FileParsingException( std::string("Recursive include derective detected - file '") + filenameToOpen + ("' already included"), getFileName(fileId), lineNumber );
         }
 
+        std::string cacheKey;
+        if (m_pIncludeCache)
+        {
+            cacheKey = makeIncludeCacheKey(filenameToLookup);
+            auto pCached = m_pIncludeCache->find(cacheKey);
+            // Если в закешированном поддереве есть файл из текущей цепочки включений, то идём по медленному пути - он сообщит о рекурсии
+            if (pCached && !pCached->hasAnyOf(m_readedFiles))
+            {
+                spliceIncludedLines(lines, pCached->lines.begin(), pCached->lines.end(), pCached->fileNames, pCached->includedFiles, filenameToLookup);
+                return;
+            }
+        }
+
         auto readedFiles = m_readedFiles;
         readedFiles.insert(filenameToLookup);
 
         Ini ini( m_mergeMultilines, m_parseIncludes, m_separators);
         ini.setFileReader(m_pFileReader);
+        ini.setIncludeCache(m_pIncludeCache);
         ini.setReadedFiles(readedFiles);
 
         if (m_useConditionals)
@@ -677,17 +718,74 @@ protected:
             throw;
         }
 
-        for( auto & iniLine : ini.m_lines )
+        if (m_pIncludeCache)
         {
-            if (iniLine.fileId!=(size_t)-1)
-                iniLine.fileId += m_fileNames.size();
+            // Результат разбора переезжает в кеш, строки вклеиваются уже оттуда
+            auto pEntry = m_pIncludeCache->insert(cacheKey, std::move(ini.m_fileNames), std::move(ini.m_lines), std::move(ini.m_includedFiles));
+            spliceIncludedLines(lines, pEntry->lines.begin(), pEntry->lines.end(), pEntry->fileNames, pEntry->includedFiles, filenameToLookup);
+            return;
         }
 
-        m_fileNames.insert( m_fileNames.end(), ini.m_fileNames.begin(), ini.m_fileNames.end() );
-        //m_lines.insert( m_lines.end(), ini.m_lines.begin(), ini.m_lines.end() );
+        spliceIncludedLines(lines, std::make_move_iterator(ini.m_lines.begin()), std::make_move_iterator(ini.m_lines.end()), ini.m_fileNames, ini.m_includedFiles, filenameToLookup);
+
+    }
+
+    //! Формирует ключ кеша инклюдов - результат разбора файла зависит от его имени, файл-ридера, настроек разбора и набора условий на момент включения
+    std::string makeIncludeCacheKey( const std::string &filenameToLookup ) const
+    {
+        std::string key = filenameToLookup;
+        key.append(1, '\n');
+
+        // Ридеры по умолчанию у всех объектов Ini одинаковые, пользовательские различаем по адресу
+        if (m_pFileReader==&m_defaultReader)
+            key.append(1, '-');
+        else
+            key.append(std::to_string((std::uintptr_t)m_pFileReader));
+        key.append(1, '\n');
+
+        key.append(1, m_mergeMultilines ? '1' : '0');
+        key.append(1, m_parseIncludes   ? '1' : '0');
+        key.append(1, m_useConditionals ? '1' : '0');
+        key.append(1, m_allowDefines    ? '1' : '0');
+        key.append(m_separators);
+
+        if (m_useConditionals)
+        {
+            for(const auto &tag : m_conditionalTags)
+            {
+                key.append(1, '\n');
+                key.append(tag);
+            }
+        }
+
+        return key;
+    }
+
+    //! Вклеивает строки подключенного файла прямо в конец lines - перенумеровывает идентификаторы файлов и регистрирует имена файлов
+    template<typename LineIterator>
+    void spliceIncludedLines( std::vector< LineInfo >         &lines
+                            , LineIterator                    includedLinesBegin
+                            , LineIterator                    includedLinesEnd
+                            , const std::vector<std::string>  &includedFileNames
+                            , const std::set<std::string>     &includedFiles
+                            , const std::string               &filenameToLookup
+                            )
+    {
+        const std::size_t firstLine  = lines.size();
+        const std::size_t fileIdBase = m_fileNames.size();
+
+        lines.insert( lines.end(), includedLinesBegin, includedLinesEnd );
 
-        return ini.m_lines;
+        for( std::size_t i=firstLine; i!=lines.size(); ++i )
+        {
+            if (lines[i].fileId!=(size_t)-1)
+                lines[i].fileId += fileIdBase;
+        }
 
+        m_fileNames.insert( m_fileNames.end(), includedFileNames.begin(), includedFileNames.end() );
+
+        m_includedFiles.insert(filenameToLookup);
+        m_includedFiles.insert(includedFiles.begin(), includedFiles.end());
     }
 
     //! Подсчитывает трушность текущего состояния, получая на входе стек условий
@@ -724,6 +822,7 @@ public:
     void fromLines( std::vector<std::string> lines )
     {
         m_lines.clear();
+        m_includedFiles.clear();
 
         //----------------------------
         // Convert to LineInfo's
@@ -871,8 +970,7 @@ public:
                     if (curCondition && m_parseIncludes)
                     {
                         testStr.erase(0, directives[lineCond].size());
-                        std::vector< LineInfo > includedLines = processInclude( testStr, it->fileId, it->lineNumber );
-                        tmpLineInfos.insert( tmpLineInfos.end(), includedLines.begin(), includedLines.end() );
+                        processInclude( testStr, it->fileId, it->lineNumber, tmpLineInfos );
                     }
                 }
                 else
@@ -913,8 +1011,7 @@ public:
                     }
 
                     testStr.erase(0, directives[lineCond].size());
-                    std::vector< LineInfo > includedLines = processInclude( testStr, it->fileId, it->lineNumber );
-                    tmpLineInfos.insert( tmpLineInfos.end(), includedLines.begin(), includedLines.end() );
+                    processInclude( testStr, it->fileId, it->lineNumber, tmpLineInfos );
 
                     if (!tmpLineInfos.empty())
                     {
@@ -1825,6 +1922,104 @@ public:
 
     //--------------------------------------
 
+    //! Кеш подключаемых файлов
+    /*! Разделяемые инклюды, используемые множеством конфигов, разбираются один раз.
+        Ключом является нормализованное имя файла (см. IniFileReaderInterface::makeLookupKeyFromFileName),
+        настройки разбора и набор условных тэгов на момент включения (дефайны из подключаемого файла
+        в родителя не пробрасываются, поэтому результат разбора определяется только ими).
+
+        Записи кеша неизменяемы и разделяются между всеми пользователями по shared_ptr.
+        Кеш можно использовать из нескольких потоков одновременно (см. readIniFilesParallel).
+        Если два потока одновременно разбирают один и тот же файл, в кеше остаётся результат первого из них.
+     */
+    class IncludeCache
+    {
+
+    public:
+
+        //! Закешированный результат разбора подключаемого файла
+        struct Entry
+        {
+            std::vector<std::string>  fileNames;      //!< Имена файлов поддерева, fileId строк индексирует этот вектор
+            std::vector< LineInfo >   lines;          //!< Строки
+            std::set<std::string>     includedFiles;  //!< Lookup-ключи всех файлов, вложенно подключенных этим файлом
+
+            //! Проверяет, подключается ли в поддереве хоть один из заданных файлов
+            bool hasAnyOf( const std::set<std::string> &files ) const
+            {
+                for(const auto &f : files)
+                {
+                    if (includedFiles.find(f)!=includedFiles.end())
+                        return true;
+                }
+                return false;
+            }
+
+        }; // struct Entry
+
+        typedef std::shared_ptr<const Entry>  EntryPtr;  //!< Указатель на запись кеша
+
+        //! Поиск записи. Возвращает пустой указатель, если запись не найдена
+        EntryPtr find( const std::string &key ) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(key);
+            if (it==m_entries.end())
+            {
+                ++m_misses;
+                return EntryPtr();
+            }
+            ++m_hits;
+            return it->second;
+        }
+
+        //! Добавление записи. Если запись с таким ключом уже есть, она не заменяется. Возвращает запись, лежащую в кеше
+        EntryPtr insert( const std::string         &key
+                       , std::vector<std::string>  fileNames
+                       , std::vector< LineInfo >   lines
+                       , std::set<std::string>     includedFiles
+                       )
+        {
+            auto pEntry = std::make_shared<Entry>();
+            pEntry->fileNames     = std::move(fileNames);
+            pEntry->lines         = std::move(lines);
+            pEntry->includedFiles = std::move(includedFiles);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_entries.emplace(key, EntryPtr(pEntry)).first->second;
+        }
+
+        //! Очистка кеша
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_entries.clear();
+            m_hits   = 0;
+            m_misses = 0;
+        }
+
+        //! Количество записей в кеше
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_entries.size();
+        }
+
+        std::size_t getHits()   const { std::lock_guard<std::mutex> lock(m_mutex); return m_hits;   } //!< Количество попаданий в кеш
+        std::size_t getMisses() const { std::lock_guard<std::mutex> lock(m_mutex); return m_misses; } //!< Количество промахов
+
+
+    protected:
+
+        mutable std::mutex                           m_mutex;
+        std::unordered_map<std::string, EntryPtr>    m_entries;
+        mutable std::size_t                          m_hits   = 0;
+        mutable std::size_t                          m_misses = 0;
+
+    }; // class IncludeCache
+
+    //--------------------------------------
+
 
     //------------------
     // Validators
@@ -1990,11 +2185,90 @@ protected:
     bool                      m_useConditionals = false;     //!< Опция - парсить условия
     bool                      m_allowDefines    = false;     //!< Опция - разрешить дефайны
 
+    IncludeCache              *m_pIncludeCache  = 0;         //!< Кеш подключаемых файлов (не владеем)
+    std::set<std::string>     m_includedFiles;               //!< Lookup-ключи всех вложенно подключенных файлов
+
     //std::stack<bool>
 
 };
 
 
+//----------------------------------------------------------------------------
+//! Параллельное чтение набора корневых INI-файлов
+/*! Каждый корневой файл читается в своём объекте Ini, корни раскидываются по рабочим потокам.
+    Общие инклюды разбираются один раз и затем берутся из кеша pIncludeCache (может быть 0).
+
+    Раскрытие инклюдов внутри одного файла остаётся последовательным - на результат очередного
+    включения влияют дефайны, заданные в файле выше него.
+
+    Конфигуратор вызывается для каждого создаваемого объекта Ini перед чтением, имеет вид
+    void configurator( umba::Ini &ini ) и обычно задаёт условия (setConditionals) и файл-ридер.
+    Файл-ридер, если задан, должен допускать одновременный вызов из нескольких потоков.
+
+    Если при чтении какого-либо файла было выброшено исключение, то после завершения всех потоков
+    перевыбрасывается исключение для первого по порядку файла.
+
+    \param numThreads Количество рабочих потоков, 0 - по количеству ядер
+ */
+template<typename IniConfigurator>
+inline
+std::vector<Ini> readIniFilesParallel( const std::vector<std::string> &fileNames
+                                     , const IniConfigurator          &configurator
+                                     , Ini::IncludeCache              *pIncludeCache
+                                     , unsigned                       numThreads = 0
+                                     , bool                           mergeMultilines = true
+                                     , bool                           parseIncludes   = true
+                                     , std::string                    separators      = ":="
+                                     )
+{
+    std::vector<Ini>                 res(fileNames.size(), Ini(mergeMultilines, parseIncludes, separators));
+    std::vector<std::exception_ptr>  errors(fileNames.size());
+    std::atomic<std::size_t>         nextIdx(0);
+
+    auto worker = [&]()
+    {
+        for(std::size_t idx = nextIdx++; idx<fileNames.size(); idx = nextIdx++)
+        {
+            try
+            {
+                Ini &ini = res[idx];
+                ini.setIncludeCache(pIncludeCache);
+                configurator(ini);
+                ini.readFrom(fileNames[idx]);
+            }
+            catch(...)
+            {
+                errors[idx] = std::current_exception();
+            }
+        }
+    };
+
+    if (!numThreads)
+        numThreads = std::thread::hardware_concurrency();
+    if (!numThreads)
+        numThreads = 1;
+    if (numThreads>fileNames.size())
+        numThreads = (unsigned)fileNames.size();
+
+    std::vector<std::thread> threads;
+    for(unsigned i=1; i<numThreads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for(auto &t : threads)
+        t.join();
+
+    for(const auto &e : errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    return res;
+}
+
+//----------------------------------------------------------------------------
 //! Печатаем типа аналитику по плоскостопию INI-шки
 template< typename Stream >
 inline
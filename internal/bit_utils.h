@@ -0,0 +1,98 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Поиск младшего/старшего установленного бита и невыровненные загрузки - для быстрых путей в заголовках библиотеки
+
+    Repository: https://github.com/al-martyn1/umba
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+
+// umba::internal::
+namespace umba{
+namespace internal{
+
+
+
+//----------------------------------------------------------------------------
+//! Индекс младшего установленного бита. v не должно быть нулём
+inline
+unsigned lowestBitIndex( std::uint32_t v )
+{
+    #if defined(__GNUC__) || defined(__clang__)
+        return (unsigned)__builtin_ctz(v);
+    #elif defined(_MSC_VER)
+        unsigned long idx = 0;
+        _BitScanForward(&idx, v);
+        return (unsigned)idx;
+    #else
+        unsigned idx = 0;
+        while(!(v&1u)) { v >>= 1; ++idx; }
+        return idx;
+    #endif
+}
+
+//! Индекс младшего установленного бита 64-битного значения. v не должно быть нулём
+inline
+unsigned lowestBitIndex64( std::uint64_t v )
+{
+    #if defined(__GNUC__) || defined(__clang__)
+        return (unsigned)__builtin_ctzll(v);
+    #elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long idx = 0;
+        _BitScanForward64(&idx, v);
+        return (unsigned)idx;
+    #else
+        unsigned idx = 0;
+        while(!(v&1u)) { v >>= 1; ++idx; }
+        return idx;
+    #endif
+}
+
+//! Индекс старшего установленного бита. v не должно быть нулём
+inline
+unsigned highestBitIndex( std::uint32_t v )
+{
+    #if defined(__GNUC__) || defined(__clang__)
+        return 31u-(unsigned)__builtin_clz(v);
+    #elif defined(_MSC_VER)
+        unsigned long idx = 0;
+        _BitScanReverse(&idx, v);
+        return (unsigned)idx;
+    #else
+        unsigned idx = 0;
+        while(v>>=1) ++idx;
+        return idx;
+    #endif
+}
+
+//----------------------------------------------------------------------------
+//! Невыровненная загрузка 8 байт
+inline
+std::uint64_t load64( const char *p )
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//! Невыровненная запись 8 байт
+inline
+void store64( char *p, std::uint64_t v )
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+
+
+} // namespace internal
+} // namespace umba
+
@@ -0,0 +1,29 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Определение доступных SIMD-расширений для быстрых путей в заголовках библиотеки
+
+    Repository: https://github.com/al-martyn1/umba
+
+    UMBA_SSE2_USED  - доступен SSE2, подключен emmintrin.h
+    UMBA_SSSE3_USED - доступен SSSE3, подключен tmmintrin.h
+
+    UMBA_NO_SIMD - отключает SIMD во всех заголовках. В отдельных заголовках SIMD отключается
+    своими макросами (UMBA_ASCII_CASE_NO_SIMD, UMBA_DUMP_NO_SIMD, UMBA_ESCAPE_STRING_NO_SIMD,
+    UMBA_TEXT_NORMALIZE_NO_SIMD).
+*/
+
+#pragma once
+
+#include "../zz_detect_environment.h"
+
+
+#if !defined(UMBA_NO_SIMD) && !defined(UMBA_MCU_USED) && (defined(__SSE2__) || defined(_M_AMD64) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2))
+    #define UMBA_SSE2_USED
+    #include <emmintrin.h>
+    #if defined(__SSSE3__) || defined(__AVX__)
+        #define UMBA_SSSE3_USED
+        #include <tmmintrin.h>
+    #endif
+#endif
+
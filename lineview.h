@@ -11,6 +11,7 @@
 #include "exception.h"
 #include "linefeedtype.h"
 #include "lineposinfo.h"
+#include "perf_probes.h"
 
 #include <iterator>
 #include <memory>
@@ -178,6 +179,8 @@ splitToLineViews( const CharType *pData         //!< Указатель на д
                 , OutputIterator outputIterator //!< Итератор размещения результатов
                 )
 {
+    UMBA_PERF_PROBE_SCOPE_BYTES("umba::splitToLineViews", (uint64_t)sz*sizeof(CharType));
+
     static const CharType cr = (CharType)'\r';
     static const CharType lf = (CharType)'\n';
 
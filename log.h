@@ -13,9 +13,14 @@
     #error "umba/log.h requires umba/simple_formatter.h to be included first"
 #endif
 
-#include <string>
-#include <unordered_map>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
 
 
 // requires global vars
@@ -78,9 +83,176 @@ std::string makeAllWarnInfoLogOptionsString(const std::set<std::string> &s)
     return umba::string_plus::merge<std::string, std::set<std::string>::const_iterator, decltype(stringifier)>( s.begin(), s.end(), ", ", stringifier);
 }
 
+//----------------------------------------------------------------------------
+#if !defined(UMBA_LOG_MAX_TYPE_IDS)
+    //! Максимальное количество различных типов предупреждений (и отдельно - информационных сообщений)
+    #define UMBA_LOG_MAX_TYPE_IDS   1024
+#endif
+
+typedef uint32_t LogTypeId; //!< Идентификатор типа предупреждения/информационного сообщения
+
+const LogTypeId invalidLogTypeId = (LogTypeId)-1; //!< Неверный идентификатор - тип не зарегистрирован или превышен UMBA_LOG_MAX_TYPE_IDS
+
+//----------------------------------------------------------------------------
+//! Фильтр типов предупреждений/информационных сообщений
+/*! Имена типов интернируются в небольшие целые идентификаторы (обычно - при настройке, до начала работы),
+    признак "запрещено" хранится в атомарном битсете.
+
+    Проверка по идентификатору - одна проверка бита. Проверка по имени - поиск в хэш-таблице
+    с открытой адресацией, в которую элементы только добавляются; она не выделяет память и не блокирует.
+    Все методы чтения wait-free и могут вызываться из любого потока параллельно с настройкой.
+ */
+class LogTypeFilter
+{
+
+public:
+
+    static const std::size_t maxIds = UMBA_LOG_MAX_TYPE_IDS;
+
+    LogTypeFilter()
+    : m_numIds(0)
+    {
+        for(auto &w : m_disabledBits)
+            w.store(0, std::memory_order_relaxed);
+        for(auto &s : m_slots)
+            s.store(0, std::memory_order_relaxed);
+    }
+
+    ~LogTypeFilter()
+    {
+        for(auto &s : m_slots)
+            delete s.load(std::memory_order_relaxed);
+    }
+
+    LogTypeFilter(const LogTypeFilter&) = delete;
+    LogTypeFilter& operator=(const LogTypeFilter&) = delete;
+
+    //! Возвращает идентификатор типа, регистрируя его при необходимости
+    LogTypeId intern(std::string_view name)
+    {
+        LogTypeId id = findId(name);
+        if (id!=invalidLogTypeId)
+            return id;
+
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        // Повторный поиск - тип мог зарегистрировать другой поток
+        std::size_t slotIdx = 0;
+        id = findIdImpl(name, &slotIdx);
+        if (id!=invalidLogTypeId)
+            return id;
+
+        std::size_t numIds = m_numIds.load(std::memory_order_relaxed);
+        if (numIds>=maxIds)
+            return invalidLogTypeId;
+
+        Entry *pEntry = new Entry();
+        pEntry->name = std::string(name);
+        pEntry->id   = (LogTypeId)numIds;
+
+        m_numIds.store(numIds+1, std::memory_order_relaxed);
+        m_slots[slotIdx].store(pEntry, std::memory_order_release);
+
+        return pEntry->id;
+    }
+
+    //! Возвращает идентификатор типа, или invalidLogTypeId, если тип не зарегистрирован
+    LogTypeId findId(std::string_view name) const
+    {
+        return findIdImpl(name, 0);
+    }
+
+    //! Количество зарегистрированных типов
+    std::size_t size() const
+    {
+        return m_numIds.load(std::memory_order_relaxed);
+    }
+
+    //! Проверка, запрещён ли тип
+    bool isDisabled(LogTypeId id) const
+    {
+        if (id>=maxIds)
+            return false; // not explicitly disabled
+        return (m_disabledBits[id/64].load(std::memory_order_relaxed) & (((uint64_t)1)<<(id%64)))!=0;
+    }
+
+    //! Проверка, запрещён ли тип. Незарегистрированный тип не запрещён
+    bool isDisabled(std::string_view name) const
+    {
+        return isDisabled(findId(name));
+    }
+
+    void setDisabled(LogTypeId id, bool bDisabled=true)
+    {
+        if (id>=maxIds)
+            return;
+
+        const uint64_t mask = ((uint64_t)1)<<(id%64);
+        if (bDisabled)
+            m_disabledBits[id/64].fetch_or(mask, std::memory_order_relaxed);
+        else
+            m_disabledBits[id/64].fetch_and(~mask, std::memory_order_relaxed);
+    }
+
+    void setDisabled(std::string_view name, bool bDisabled=true)
+    {
+        setDisabled(intern(name), bDisabled);
+    }
+
+
+protected:
+
+    struct Entry
+    {
+        std::string  name;
+        LogTypeId    id;
+    };
+
+    static const std::size_t numSlots = maxIds*2; // Заполнение не более 50%
+
+    static std::size_t hashName(std::string_view name)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for(char ch : name)
+        {
+            h ^= (uint64_t)(unsigned char)ch;
+            h *= 1099511628211ull;
+        }
+        return (std::size_t)(h ^ (h>>32));
+    }
+
+    //! Поиск с линейным пробированием. pFreeSlotIdx - куда вставлять, если не найдено
+    LogTypeId findIdImpl(std::string_view name, std::size_t *pFreeSlotIdx) const
+    {
+        std::size_t idx = hashName(name) % numSlots;
+        for(std::size_t i=0; i!=numSlots; ++i, idx = (idx+1)%numSlots)
+        {
+            const Entry *pEntry = m_slots[idx].load(std::memory_order_acquire);
+            if (!pEntry)
+            {
+                if (pFreeSlotIdx)
+                    *pFreeSlotIdx = idx;
+                return invalidLogTypeId;
+            }
+
+            if (pEntry->name==name)
+                return pEntry->id;
+        }
+
+        return invalidLogTypeId;
+    }
+
+
+    std::atomic<uint64_t>        m_disabledBits[(maxIds+63)/64];
+    std::atomic<const Entry*>    m_slots[numSlots];
+    std::atomic<std::size_t>     m_numIds;
+    std::mutex                   m_mtx;   //!< Только для регистрации
+
+}; // class LogTypeFilter
+
 //----------------------------------------------------------------------------
 inline
-bool addRemoveLogOptionsImpl( std::unordered_map<std::string, bool>& optDisabledMap
+bool addRemoveLogOptionsImpl( LogTypeFilter &optFilter
                             , const std::set<std::string> &allOpts
                             , const std::string &optString
                             , std::string &unknownOpt
@@ -111,7 +283,7 @@ bool addRemoveLogOptionsImpl( std::unordered_map<std::string, bool>& optDisabled
         {
             for(const auto &optFromAll: allOpts)
             {
-                optDisabledMap[optFromAll] = bRemove;
+                optFilter.setDisabled(optFromAll, bRemove);
             }
         }
         else
@@ -122,7 +294,7 @@ bool addRemoveLogOptionsImpl( std::unordered_map<std::string, bool>& optDisabled
                 return false;
             }
 
-            optDisabledMap[opt] = bRemove;
+            optFilter.setDisabled(opt, bRemove);
         }
     }
 
@@ -134,41 +306,57 @@ bool addRemoveLogOptionsImpl( std::unordered_map<std::string, bool>& optDisabled
 
 
 //----------------------------------------------------------------------------
+//! Фильтр предупреждений
 inline
-std::unordered_map<std::string, bool>& getWarningDisabledMap()
+LogTypeFilter& getWarningFilter()
 {
-    static std::unordered_map<std::string, bool> m;
-    return m;
+    static LogTypeFilter f;
+    return f;
+}
 
-    // В многопотоке могут быть проблемы.
-    // С другой стороны, все настройки варнингов делаются обычно до какой-то работы
-    // и в многопотоке будет только поиск
+//! Регистрирует тип предупреждения, возвращает его идентификатор для быстрой проверки
+inline
+LogTypeId internWarningType(std::string_view warnType)
+{
+    return getWarningFilter().intern(warnType);
 }
 
 inline
-bool isWarningDisabled(const std::string &warnType)
+bool isWarningDisabled(LogTypeId warnTypeId)
 {
-    const std::unordered_map<std::string, bool> &m = getWarningDisabledMap();
-    std::unordered_map<std::string, bool>::const_iterator it = m.find(warnType);
-    if (it==m.end())
-        return false; // not explicitly disabled
-    return it->second;
+    return getWarningFilter().isDisabled(warnTypeId);
 }
 
 inline
-void setWarningDisabled(const std::string &warnType, bool bDisabled=true)
+bool isWarningDisabled(std::string_view warnType)
 {
-    std::unordered_map<std::string, bool> &m = getWarningDisabledMap();
-    m[warnType] = bDisabled;
+    return getWarningFilter().isDisabled(warnType);
+}
+
+inline
+void setWarningDisabled(std::string_view warnType, bool bDisabled=true)
+{
+    getWarningFilter().setDisabled(warnType, bDisabled);
+}
+
+inline
+void setWarningDisabled(LogTypeId warnTypeId, bool bDisabled=true)
+{
+    getWarningFilter().setDisabled(warnTypeId, bDisabled);
 }
 
 //----------------------------------------------------------------------------
+//! Настройка предупреждений строкой вида "+warn1,-warn2,-all". Все типы из allOpts регистрируются
+inline
 bool addRemoveWarningOptions( const std::set<std::string> &allOpts
                             , const std::string &optString
                             , std::string &unknownOpt
                             )
 {
-    return addRemoveLogOptionsImpl( getWarningDisabledMap(), allOpts, optString, unknownOpt );
+    for(const auto &opt : allOpts)
+        getWarningFilter().intern(opt);
+
+    return addRemoveLogOptionsImpl( getWarningFilter(), allOpts, optString, unknownOpt );
 }
 
 //----------------------------------------------------------------------------
@@ -176,41 +364,57 @@ bool addRemoveWarningOptions( const std::set<std::string> &allOpts
 
 
 //----------------------------------------------------------------------------
+//! Фильтр информационных сообщений
+inline
+LogTypeFilter& getInfoFilter()
+{
+    static LogTypeFilter f;
+    return f;
+}
+
+//! Регистрирует тип информационного сообщения, возвращает его идентификатор для быстрой проверки
+inline
+LogTypeId internInfoType(std::string_view infoType)
+{
+    return getInfoFilter().intern(infoType);
+}
+
 inline
-std::unordered_map<std::string, bool>& getInfoDisabledMap()
+bool isInfoDisabled(LogTypeId infoTypeId)
 {
-    static std::unordered_map<std::string, bool> m;
-    return m;
+    return getInfoFilter().isDisabled(infoTypeId);
+}
 
-    // В многопотоке могут быть проблемы.
-    // С другой стороны, все настройки варнингов делаются обычно до какой-то работы
-    // и в многопотоке будет только поиск
+inline
+bool isInfoDisabled(std::string_view infoType)
+{
+    return getInfoFilter().isDisabled(infoType);
 }
 
 inline
-bool isInfoDisabled(const std::string &warnType)
+void setInfoDisabled(std::string_view infoType, bool bDisabled=true)
 {
-    const std::unordered_map<std::string, bool> &m = getInfoDisabledMap();
-    std::unordered_map<std::string, bool>::const_iterator it = m.find(warnType);
-    if (it==m.end())
-        return false; // not explicitly disabled
-    return it->second;
+    getInfoFilter().setDisabled(infoType, bDisabled);
 }
 
 inline
-void setInfoDisabled(const std::string &warnType, bool bDisabled=true)
+void setInfoDisabled(LogTypeId infoTypeId, bool bDisabled=true)
 {
-    std::unordered_map<std::string, bool> &m = getInfoDisabledMap();
-    m[warnType] = bDisabled;
+    getInfoFilter().setDisabled(infoTypeId, bDisabled);
 }
 
 //----------------------------------------------------------------------------
+//! Настройка информационных сообщений строкой вида "+info1,-info2,-all". Все типы из allOpts регистрируются
+inline
 bool addRemoveInfoOptions( const std::set<std::string> &allOpts
                          , const std::string &optString
                          , std::string &unknownOpt
                          )
 {
-    return addRemoveLogOptionsImpl( getInfoDisabledMap(), allOpts, optString, unknownOpt );
+    for(const auto &opt : allOpts)
+        getInfoFilter().intern(opt);
+
+    return addRemoveLogOptionsImpl( getInfoFilter(), allOpts, optString, unknownOpt );
 }
 
 //----------------------------------------------------------------------------
@@ -220,8 +424,6 @@ bool addRemoveInfoOptions( const std::set<std::string> &allOpts
 
 
 
-
-
 //----------------------------------------------------------------------------
 inline
 umba::SimpleFormatter& startLogError( umba::SimpleFormatter     &s
@@ -0,0 +1,802 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Асинхронный вывод в лог
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Потоки-производители не форматируют сообщение, а кодируют запись (тип, warnType, файл, строку и аргументы)
+    в собственный кольцевой буфер (один писатель - один читатель, без блокировок). Фоновый поток
+    забирает записи из буферов всех потоков, форматирует их через umba::log::startLogError
+    в целевой SimpleFormatter пачками и сбрасывает вывод один раз на пачку.
+
+    Порядок записей одного потока сохраняется; записи разных потоков в пределах пачки упорядочиваются
+    по глобальному порядковому номеру.
+
+    Аргументы - только значения: целые, числа с плавающей точкой, bool, char и строки. Манипуляторы
+    umba::omanip в аргументах не поддерживаются.
+
+    \code
+    umba::log::AsyncLogSink asyncLog(umbaLogStreamErr, &errCharWriter);
+
+    UMBA_ASYNC_LOG_WARN(asyncLog, "some-warn", "Value is too big: ", value, "\n");
+    UMBA_ASYNC_LOG_ERR_INPUT(asyncLog, "Unexpected token '", tokenText, "'\n");
+    \endcode
+
+    Все записи, помещённые в буфер до вызова flush() или до уничтожения объекта AsyncLogSink, гарантированно
+    будут выведены.
+ */
+
+#pragma once
+
+#if !defined(UMBA_SIMPLE_FORMATTER_H)
+    #error "umba/log_async.h requires umba/simple_formatter.h to be included first"
+#endif
+
+#include "log.h"
+#include "preprocessor.h"
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// umba::log::
+namespace umba {
+namespace log {
+
+
+
+//----------------------------------------------------------------------------
+//! Поведение при переполнении кольцевого буфера потока
+enum class AsyncLogOverflowPolicy
+{
+    block       , //!< Ждать, пока фоновый поток не освободит место
+    drop        , //!< Отбросить запись
+    countDrops    //!< Отбросить запись, фоновый поток выведет предупреждение с количеством отброшенных записей
+};
+
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace async_details{
+
+enum class ArgTag : uint8_t
+{
+    int64   = 0,
+    uint64  = 1,
+    dbl     = 2,
+    boolean = 3,
+    chr     = 4,
+    str     = 5
+};
+
+//----------------------------------------------------------------------------
+//! Кольцевой буфер байт: пишет один поток, читает фоновый поток
+class SpscByteRing
+{
+    public:
+
+        explicit SpscByteRing( std::size_t capacity )
+        : m_buf(capacity)
+        , m_mask(capacity-1)
+        , m_head(0)
+        , m_tail(0)
+        , m_producerAlive(true)
+        , m_consumerAlive(true)
+        {}
+
+        std::size_t getCapacity() const { return m_buf.size(); }
+
+        //! Пытается записать блок с префиксом длины. Вызывается только производителем
+        bool tryPush( const uint8_t *pData, uint32_t size )
+        {
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+
+            if ((uint64_t)m_buf.size() - (tail-head) < (uint64_t)size + sizeof(uint32_t))
+                return false;
+
+            copyIn(tail, (const uint8_t*)&size, sizeof(uint32_t));
+            copyIn(tail+sizeof(uint32_t), pData, size);
+
+            m_tail.store(tail + sizeof(uint32_t) + size, std::memory_order_release);
+            return true;
+        }
+
+        //! Извлекает очередной блок. Вызывается только потребителем
+        bool pop( std::vector<uint8_t> &data )
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            const uint64_t tail = m_tail.load(std::memory_order_acquire);
+
+            if (head==tail)
+                return false;
+
+            uint32_t size = 0;
+            copyOut(head, (uint8_t*)&size, sizeof(uint32_t));
+            data.resize(size);
+            if (size)
+                copyOut(head+sizeof(uint32_t), &data[0], size);
+
+            m_head.store(head + sizeof(uint32_t) + size, std::memory_order_release);
+            return true;
+        }
+
+        bool isEmpty() const
+        {
+            return m_head.load(std::memory_order_acquire)==m_tail.load(std::memory_order_acquire);
+        }
+
+        void setProducerAlive( bool bAlive ) { m_producerAlive.store(bAlive, std::memory_order_release); }
+        bool isProducerAlive() const         { return m_producerAlive.load(std::memory_order_acquire); }
+
+        void setConsumerAlive( bool bAlive ) { m_consumerAlive.store(bAlive, std::memory_order_release); }
+        bool isConsumerAlive() const         { return m_consumerAlive.load(std::memory_order_acquire); }
+
+    protected:
+
+        void copyIn( uint64_t pos, const uint8_t *pData, std::size_t size )
+        {
+            std::size_t off   = (std::size_t)(pos & m_mask);
+            std::size_t first = std::min(size, m_buf.size()-off);
+            std::memcpy(&m_buf[off], pData, first);
+            if (first!=size)
+                std::memcpy(&m_buf[0], pData+first, size-first);
+        }
+
+        void copyOut( uint64_t pos, uint8_t *pData, std::size_t size ) const
+        {
+            std::size_t off   = (std::size_t)(pos & m_mask);
+            std::size_t first = std::min(size, m_buf.size()-off);
+            std::memcpy(pData, &m_buf[off], first);
+            if (first!=size)
+                std::memcpy(pData+first, &m_buf[0], size-first);
+        }
+
+        std::vector<uint8_t>               m_buf;
+        std::size_t                        m_mask;
+        alignas(64) std::atomic<uint64_t>  m_head;  //!< Позиция чтения, меняет потребитель
+        alignas(64) std::atomic<uint64_t>  m_tail;  //!< Позиция записи, меняет производитель
+        std::atomic<bool>                  m_producerAlive;
+        std::atomic<bool>                  m_consumerAlive; //!< Сбрасывается при уничтожении приёмника
+
+}; // class SpscByteRing
+
+//----------------------------------------------------------------------------
+//! Кодировщик записи в буфер потока
+class RecordEncoder
+{
+    public:
+
+        //! Буфер используется как хранилище, его размер не уменьшается между записями
+        explicit RecordEncoder( std::vector<uint8_t> &buf ) : m_buf(buf), m_size(0)
+        {
+            if (m_buf.size()<256)
+                m_buf.resize(256);
+        }
+
+        const uint8_t* data() const { return m_buf.data(); }
+        std::size_t    size() const { return m_size; }
+
+        void putBytes( const void *pData, std::size_t len )
+        {
+            if (m_buf.size()-m_size < len)
+                m_buf.resize(std::max(m_buf.size()*2, m_size+len));
+            std::memcpy(&m_buf[m_size], pData, len);
+            m_size += len;
+        }
+
+        template<typename T>
+        void putPod( const T &t )
+        {
+            putBytes(&t, sizeof(T));
+        }
+
+        void putStr( const char *pStr, std::size_t len )
+        {
+            putPod((uint32_t)len);
+            putBytes(pStr, len);
+        }
+
+        void putStr( std::string_view sv )  { putStr(sv.data(), sv.size()); }
+
+        void putTag( ArgTag tag )            { putPod((uint8_t)tag); }
+
+        // Аргументы сообщения
+        void putArg( bool b )                { putTag(ArgTag::boolean); putPod((uint8_t)(b?1:0)); }
+        void putArg( char ch )               { putTag(ArgTag::chr);     putPod(ch); }
+        void putArg( float f )               { putTag(ArgTag::dbl);     putPod((double)f); }
+        void putArg( double d )              { putTag(ArgTag::dbl);     putPod(d); }
+        void putArg( long double d )         { putTag(ArgTag::dbl);     putPod((double)d); }
+        void putArg( const char *pStr )      { putTag(ArgTag::str);     if (pStr) putStr(pStr, std::strlen(pStr)); else putStr("(null)", 6); }
+        void putArg( char *pStr )            { putArg((const char*)pStr); }
+        void putArg( const std::string &s )  { putTag(ArgTag::str);     putStr(s.data(), s.size()); }
+        void putArg( std::string_view sv )   { putTag(ArgTag::str);     putStr(sv); }
+
+        template<typename IntType>
+        typename std::enable_if< std::is_integral<IntType>::value || std::is_enum<IntType>::value >::type
+        putArg( IntType i )
+        {
+            typedef typename std::conditional< std::is_enum<IntType>::value, std::underlying_type<IntType>, std::enable_if<true, IntType> >::type::type  BaseType;
+
+            if (std::is_signed<BaseType>::value)
+            {
+                putTag(ArgTag::int64);
+                putPod((int64_t)(BaseType)i);
+            }
+            else
+            {
+                putTag(ArgTag::uint64);
+                putPod((uint64_t)(BaseType)i);
+            }
+        }
+
+        void putArgs() {}
+
+        template<typename First, typename... Rest>
+        void putArgs( const First &first, const Rest&... rest )
+        {
+            putArg(first);
+            putArgs(rest...);
+        }
+
+    protected:
+
+        std::vector<uint8_t> &m_buf;
+        std::size_t           m_size;
+
+}; // class RecordEncoder
+
+//----------------------------------------------------------------------------
+//! Декодированный аргумент записи
+struct RecordArg
+{
+    ArgTag        tag;
+    union
+    {
+        int64_t   i;
+        uint64_t  u;
+        double    d;
+        char      ch;
+        bool      b;
+    };
+    std::string   str;
+};
+
+//----------------------------------------------------------------------------
+//! Декодированная запись
+struct Record
+{
+    uint64_t                seq = 0;
+    LogEntryType            entryType = LogEntryType::msg;
+    std::string             warnType;
+    bool                    hasInputFile = false;
+    std::string             inputFile;
+    uint64_t                inputLineNo = 0;
+    bool                    hasSrcFile = false;
+    std::string             srcFile;
+    int32_t                 srcLineNo = 0;
+    std::vector<RecordArg>  args;
+};
+
+//----------------------------------------------------------------------------
+class RecordDecoder
+{
+    public:
+
+        RecordDecoder( const std::vector<uint8_t> &buf ) : m_p(buf.data()), m_pEnd(buf.data()+buf.size()) {}
+
+        template<typename T>
+        T getPod()
+        {
+            T t = T();
+            if ((std::size_t)(m_pEnd-m_p)>=sizeof(T))
+            {
+                std::memcpy(&t, m_p, sizeof(T));
+                m_p += sizeof(T);
+            }
+            return t;
+        }
+
+        void getStr( std::string &str )
+        {
+            uint32_t len = getPod<uint32_t>();
+            if ((std::size_t)(m_pEnd-m_p)<len)
+                len = (uint32_t)(m_pEnd-m_p);
+            str.assign((const char*)m_p, len);
+            m_p += len;
+        }
+
+        bool decode( Record &r )
+        {
+            r.seq          = getPod<uint64_t>();
+            r.entryType    = (LogEntryType)getPod<uint8_t>();
+            getStr(r.warnType);
+            r.hasInputFile = getPod<uint8_t>()!=0;
+            getStr(r.inputFile);
+            r.inputLineNo  = getPod<uint64_t>();
+            r.hasSrcFile   = getPod<uint8_t>()!=0;
+            getStr(r.srcFile);
+            r.srcLineNo    = getPod<int32_t>();
+
+            std::size_t nArgs = 0;
+            while(m_p<m_pEnd)
+            {
+                if (nArgs==r.args.size())
+                    r.args.emplace_back();
+
+                RecordArg &a = r.args[nArgs++];
+                a.tag = (ArgTag)getPod<uint8_t>();
+                switch(a.tag)
+                {
+                    case ArgTag::int64  : a.i  = getPod<int64_t>();  break;
+                    case ArgTag::uint64 : a.u  = getPod<uint64_t>(); break;
+                    case ArgTag::dbl    : a.d  = getPod<double>();   break;
+                    case ArgTag::boolean: a.b  = getPod<uint8_t>()!=0; break;
+                    case ArgTag::chr    : a.ch = getPod<char>();     break;
+                    case ArgTag::str    : getStr(a.str);             break;
+                    default: return false;
+                }
+            }
+
+            r.args.resize(nArgs);
+
+            return true;
+        }
+
+    protected:
+
+        const uint8_t *m_p;
+        const uint8_t *m_pEnd;
+
+}; // class RecordDecoder
+
+} // namespace async_details
+//! @endcond
+
+
+
+//----------------------------------------------------------------------------
+//! Асинхронный приёмник записей лога
+/*! Владеет фоновым потоком, который выводит записи в целевой SimpleFormatter. Пока приёмник существует,
+    в этот SimpleFormatter не следует писать из других потоков напрямую.
+ */
+class AsyncLogSink
+{
+    public:
+
+        static const std::size_t defaultRingCapacity = 64*1024; //!< Размер кольцевого буфера потока по умолчанию
+
+        //! Конструктор
+        /*! \param target         Куда выводятся записи
+            \param pTargetWriter  Писатель, в который пишет target - сбрасывается после каждой пачки. Может быть 0
+            \param policy         Поведение при переполнении буфера потока
+            \param ringCapacity   Размер кольцевого буфера каждого потока, округляется вверх до степени двойки
+         */
+        explicit AsyncLogSink( umba::SimpleFormatter  &target
+                             , ICharWriter            *pTargetWriter = 0
+                             , AsyncLogOverflowPolicy  policy        = AsyncLogOverflowPolicy::block
+                             , std::size_t             ringCapacity  = defaultRingCapacity
+                             )
+        : m_target(target)
+        , m_pTargetWriter(pTargetWriter)
+        , m_policy(policy)
+        , m_ringCapacity(roundUpPow2(ringCapacity))
+        , m_sinkId(nextSinkId())
+        , m_seq(0)
+        , m_dropped(0)
+        , m_droppedReported(0)
+        , m_consumerSleeping(false)
+        , m_stop(false)
+        , m_flushRequested(0)
+        , m_flushDone(0)
+        {
+            m_thread = std::thread( [this]() { consumerProc(); } );
+        }
+
+        //! Выводит все помещённые в буферы записи и останавливает фоновый поток
+        ~AsyncLogSink()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_stop = true;
+            }
+            m_cond.notify_all();
+            if (m_thread.joinable())
+                m_thread.join();
+
+            // Буферы остаются в thread_local списках потоков, потоки удалят их при следующем обращении
+            for(auto &pRing : m_rings)
+                pRing->setConsumerAlive(false);
+        }
+
+        UMBA_NON_COPYABLE_CLASS(AsyncLogSink)
+
+    public:
+
+        AsyncLogOverflowPolicy getOverflowPolicy() const { return m_policy; }
+
+        //! Количество отброшенных из-за переполнения записей
+        uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+        //! Помещает запись в буфер текущего потока
+        template<typename... Args>
+        void log( LogEntryType     logEntryType
+                , std::string_view warnType
+                , const char      *inputFile, std::size_t inputLineNo
+                , const char      *srcFile  , int srcLineNo
+                , const Args&...   args
+                )
+        {
+            if ( (logEntryType==LogEntryType::warn && isWarningDisabled(warnType))
+              || (logEntryType==LogEntryType::msg  && !warnType.empty() && isInfoDisabled(warnType))
+               )
+                return;
+
+            ThreadRing &tr = getThreadRing();
+
+            async_details::RecordEncoder enc(tr.scratch);
+            enc.putPod(m_seq.fetch_add(1, std::memory_order_relaxed));
+            enc.putPod((uint8_t)logEntryType);
+            enc.putStr(warnType);
+            enc.putPod((uint8_t)(inputFile ? 1 : 0));
+            enc.putStr(inputFile ? std::string_view(inputFile) : std::string_view());
+            enc.putPod((uint64_t)inputLineNo);
+            enc.putPod((uint8_t)(srcFile ? 1 : 0));
+            enc.putStr(srcFile ? std::string_view(srcFile) : std::string_view());
+            enc.putPod((int32_t)srcLineNo);
+            enc.putArgs(args...);
+
+            push(*tr.pRing, enc.data(), enc.size());
+        }
+
+        //! Ожидает вывода всех записей, помещённых в буферы до вызова
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            uint64_t req = ++m_flushRequested;
+            m_cond.notify_all();
+            m_flushDoneCond.wait(lock, [&]() { return m_flushDone>=req; });
+        }
+
+
+    protected:
+
+        typedef async_details::SpscByteRing SpscByteRing;
+
+        //! Буфер текущего потока для данного приёмника
+        struct ThreadRing
+        {
+            uint64_t                       sinkId;
+            std::shared_ptr<SpscByteRing>  pRing;
+            std::vector<uint8_t>           scratch;
+        };
+
+        //! Буферы потока для всех приёмников
+        /*! При завершении потока буферы помечаются, фоновый поток дочитывает и удаляет их.
+            Буферы уничтоженных приёмников поток удаляет из списка сам, в getThreadRing.
+         */
+        struct ThreadRings
+        {
+            std::vector<ThreadRing> rings;
+
+            ~ThreadRings()
+            {
+                for(auto &r : rings)
+                    r.pRing->setProducerAlive(false);
+            }
+        };
+
+        static uint64_t nextSinkId()
+        {
+            static std::atomic<uint64_t> id(0);
+            return ++id;
+        }
+
+        static std::size_t roundUpPow2( std::size_t sz )
+        {
+            std::size_t res = 1024;
+            while(res<sz)
+                res *= 2;
+            return res;
+        }
+
+        ThreadRing& getThreadRing()
+        {
+            static thread_local ThreadRings threadRings;
+
+            threadRings.rings.erase( std::remove_if( threadRings.rings.begin(), threadRings.rings.end()
+                                                   , [](const ThreadRing &r) { return !r.pRing->isConsumerAlive(); }
+                                                   )
+                                   , threadRings.rings.end()
+                                   );
+
+            // Идентификатор, а не адрес - адрес уничтоженного приёмника может достаться новому
+            for(auto &r : threadRings.rings)
+            {
+                if (r.sinkId==m_sinkId)
+                    return r;
+            }
+
+            ThreadRing tr;
+            tr.sinkId = m_sinkId;
+            tr.pRing  = std::make_shared<SpscByteRing>(m_ringCapacity);
+            tr.scratch.reserve(256);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_rings.push_back(tr.pRing);
+            }
+
+            threadRings.rings.emplace_back(std::move(tr));
+            return threadRings.rings.back();
+        }
+
+        void push( SpscByteRing &ring, const uint8_t *pData, std::size_t size )
+        {
+            if (size+sizeof(uint32_t) > ring.getCapacity())
+            {
+                // Запись никогда не поместится
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            for(unsigned attempt=0; !ring.tryPush(pData, (uint32_t)size); ++attempt)
+            {
+                if (m_policy!=AsyncLogOverflowPolicy::block)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                wakeConsumer();
+
+                // Сначала уступаем процессор фоновому потоку, потом засыпаем.
+                // Ожидание с таймаутом - фоновый поток оповещает о свободном месте без захвата мьютекса
+                if (attempt<64)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    std::unique_lock<std::mutex> lock(m_mtx);
+                    m_spaceCond.wait_for(lock, std::chrono::milliseconds(1));
+                }
+            }
+
+            wakeConsumer();
+        }
+
+        void wakeConsumer()
+        {
+            // Пара с seq_cst записью m_consumerSleeping и последующей проверкой буферов в consumerProc
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!m_consumerSleeping.load(std::memory_order_relaxed))
+                return;
+
+            // Будит только один производитель - остальные увидят false и не пойдут в мьютекс
+            if (!m_consumerSleeping.exchange(false, std::memory_order_relaxed))
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_cond.notify_all();
+        }
+
+        void writeRecord( const async_details::Record &r )
+        {
+            umba::SimpleFormatter &s = startLogError( m_target, r.entryType, r.warnType
+                                                    , r.hasInputFile ? r.inputFile.c_str() : (const char*)0, (std::size_t)r.inputLineNo
+                                                    , r.hasSrcFile   ? r.srcFile.c_str()   : (const char*)0, (int)r.srcLineNo
+                                                    );
+
+            for(const auto &a : r.args)
+            {
+                switch(a.tag)
+                {
+                    case async_details::ArgTag::int64  : s << a.i; break;
+                    case async_details::ArgTag::uint64 : s << a.u; break;
+                    case async_details::ArgTag::dbl    : s << a.d; break;
+                    case async_details::ArgTag::boolean: s << (a.b ? "true" : "false"); break;
+                    case async_details::ArgTag::chr    : s << a.ch; break;
+                    case async_details::ArgTag::str    : s << a.str.c_str(); break;
+                }
+            }
+        }
+
+        //! Забирает записи из всех буферов, возвращает количество выведенных
+        /*! Записи декодируются в переиспользуемые объекты batch - строки и вектора аргументов
+            сохраняют выделенную память между пачками
+         */
+        std::size_t drainBatch( std::vector< std::shared_ptr<SpscByteRing> > &rings, std::vector<async_details::Record> &batch, std::vector<const async_details::Record*> &order, std::vector<uint8_t> &tmp )
+        {
+            std::size_t batchSize = 0;
+
+            for(auto &pRing : rings)
+            {
+                while(pRing->pop(tmp))
+                {
+                    if (batchSize==batch.size())
+                        batch.emplace_back();
+
+                    async_details::RecordDecoder dec(tmp);
+                    if (dec.decode(batch[batchSize]))
+                        ++batchSize;
+                }
+            }
+
+            if (!batchSize)
+                return 0;
+
+            m_spaceCond.notify_all();
+
+            order.clear();
+            for(std::size_t i=0; i!=batchSize; ++i)
+                order.push_back(&batch[i]);
+
+            std::sort( order.begin(), order.end()
+                     , [](const async_details::Record *r1, const async_details::Record *r2) { return r1->seq<r2->seq; }
+                     );
+
+            for(const auto *pr : order)
+                writeRecord(*pr);
+
+            return batchSize;
+        }
+
+        void reportDropped()
+        {
+            if (m_policy!=AsyncLogOverflowPolicy::countDrops)
+                return;
+
+            uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+            if (dropped==m_droppedReported)
+                return;
+
+            async_details::Record r;
+            r.entryType = LogEntryType::warn;
+            async_details::RecordArg a;
+            a.tag = async_details::ArgTag::uint64;
+            a.u   = dropped - m_droppedReported;
+            r.args.push_back(a);
+            a.tag = async_details::ArgTag::str;
+            a.str = " log record(s) dropped due to buffer overflow\n";
+            r.args.push_back(a);
+            writeRecord(r);
+
+            m_droppedReported = dropped;
+        }
+
+        bool allRingsEmpty( const std::vector< std::shared_ptr<SpscByteRing> > &rings ) const
+        {
+            for(const auto &pRing : rings)
+            {
+                if (!pRing->isEmpty())
+                    return false;
+            }
+            return true;
+        }
+
+        void consumerProc()
+        {
+            std::vector< std::shared_ptr<SpscByteRing> > rings;
+            std::vector<async_details::Record>           batch;
+            std::vector<const async_details::Record*>    order;
+            std::vector<uint8_t>                         tmp;
+
+            for(;;)
+            {
+                bool     stop;
+                uint64_t flushReq;
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    stop     = m_stop;
+                    flushReq = m_flushRequested;
+
+                    // Удаляем вычитанные буферы завершившихся потоков
+                    m_rings.erase( std::remove_if( m_rings.begin(), m_rings.end()
+                                                 , [](const std::shared_ptr<SpscByteRing> &p) { return !p->isProducerAlive() && p->isEmpty(); }
+                                                 )
+                                 , m_rings.end()
+                                 );
+                    rings = m_rings;
+                }
+
+                std::size_t written = 0;
+                for(;;)
+                {
+                    std::size_t n = drainBatch(rings, batch, order, tmp);
+                    if (!n)
+                        break;
+                    written += n;
+                }
+
+                reportDropped();
+
+                if (written && m_pTargetWriter)
+                    m_pTargetWriter->flush();
+
+                if (flushReq)
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    if (m_flushDone<flushReq)
+                    {
+                        m_flushDone = flushReq;
+                        m_flushDoneCond.notify_all();
+                    }
+                }
+
+                if (stop)
+                    break;
+
+                if (written)
+                    continue;
+
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_consumerSleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!m_stop && m_flushRequested==m_flushDone && allRingsEmpty(m_rings))
+                    m_cond.wait_for(lock, std::chrono::milliseconds(100));
+                m_consumerSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+
+        umba::SimpleFormatter                         &m_target;
+        ICharWriter                                   *m_pTargetWriter;
+        const AsyncLogOverflowPolicy                   m_policy;
+        const std::size_t                              m_ringCapacity;
+        const uint64_t                                 m_sinkId;
+
+        std::atomic<uint64_t>                          m_seq;
+        std::atomic<uint64_t>                          m_dropped;
+        uint64_t                                       m_droppedReported; //!< Только для фонового потока
+        std::atomic<bool>                              m_consumerSleeping;
+
+        std::mutex                                     m_mtx;
+        std::condition_variable                        m_cond;           //!< Пробуждение фонового потока
+        std::condition_variable                        m_spaceCond;      //!< Освободилось место в буферах
+        std::condition_variable                        m_flushDoneCond;  //!< Завершён flush
+        std::vector< std::shared_ptr<SpscByteRing> >   m_rings;
+        bool                                           m_stop;
+        uint64_t                                       m_flushRequested;
+        uint64_t                                       m_flushDone;
+
+        std::thread                                    m_thread;
+
+}; // class AsyncLogSink
+
+
+
+} // namespace log
+} // namespace umba
+
+
+
+// source parsing errors
+// requires
+//   std::string curFile
+//   unsigned lineNo
+// in log scope
+#define UMBA_ASYNC_LOG_ERR_INPUT(sink, ...)               (sink).log( umba::log::LogEntryType::err , std::string_view()  , curFile.c_str(), lineNo, __FILE__, __LINE__, __VA_ARGS__ )
+#define UMBA_ASYNC_LOG_ERR_INPUT_EX(sink, errType, ...)   (sink).log( umba::log::LogEntryType::err , errType             , curFile.c_str(), lineNo, __FILE__, __LINE__, __VA_ARGS__ )
+#define UMBA_ASYNC_LOG_WARN_INPUT(sink, warnType, ...)    (sink).log( umba::log::LogEntryType::warn, warnType            , curFile.c_str(), lineNo, __FILE__, __LINE__, __VA_ARGS__ )
+#define UMBA_ASYNC_LOG_INFO_INPUT(sink, infoType, ...)    (sink).log( umba::log::LogEntryType::msg , infoType            , curFile.c_str(), lineNo, __FILE__, __LINE__, __VA_ARGS__ )
+
+// options and other errors
+#define UMBA_ASYNC_LOG_ERR(sink, ...)                     (sink).log( umba::log::LogEntryType::err , std::string_view()  , (const char*)0 , 0     , __FILE__, __LINE__, __VA_ARGS__ )
+#define UMBA_ASYNC_LOG_WARN(sink, warnType, ...)          (sink).log( umba::log::LogEntryType::warn, warnType            , (const char*)0 , 0     , __FILE__, __LINE__, __VA_ARGS__ )
+#define UMBA_ASYNC_LOG_INFO(sink, infoType, ...)          (sink).log( umba::log::LogEntryType::msg , infoType            , (const char*)0 , 0     , __FILE__, __LINE__, __VA_ARGS__ )
+
+#define UMBA_ASYNC_LOG_MSG(sink, ...)                     (sink).log( umba::log::LogEntryType::msg , std::string_view()  , (const char*)0 , 0     , (const char*)0, 0, __VA_ARGS__ )
@@ -0,0 +1,695 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Макросики-матросики. Предкомпилированные шаблоны для многократной подстановки макросов
+
+    Repository: https://github.com/al-martyn1/umba
+
+    substMacros каждый раз заново разбирает шаблон, копирует набор использованных макросов на каждом
+    уровне вложенности и создаёт временные прокси для макросов с аргументами.
+
+    Тут шаблон разбирается один раз в программу из токенов (литералы, ссылки на макросы, условия, макросы
+    с аргументами), которая затем многократно выполняется с разными наборами значений макросов,
+    дописывая результат в переиспользуемый выходной буфер. Результат выполнения совпадает с результатом substMacros
+    с теми же флагами.
+
+    \code
+    #include "umba/macro_template.h"
+    #include "umba/macro_helpers.h" // MacroTextFromMapRef
+
+    umba::macros::CompiledMacroTemplate<std::string> tpl("$(OutDir)/$(Name).$(Ext?+$(Ext):txt)", umba::macros::conditionAllowed|umba::macros::keepUnknownVars);
+    std::string out;
+    for(const auto &vars : varsList)
+        tpl.renderTo(out, umba::macros::MacroTextFromMapRef<std::string>(vars));
+    \endcode
+ */
+
+#pragma once
+
+#include "macros.h"
+//
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// umba::macros::
+namespace umba{
+namespace macros{
+
+
+//----------------------------------------------------------------------------
+//! Тип токена предкомпилированного шаблона
+enum class MacroTokenKind
+{
+    literal,    //!< Литеральный текст
+    var,        //!< $(NAME)
+    args,       //!< $(NAME:ARG1:ARG2...)
+    condition,  //!< $(NAME?*TRUE:FALSE) / $(NAME?+TRUE:FALSE)
+    error       //!< Ошибочная конструкция, при выполнении бросается исключение (как и в substMacros - только если до неё дошли)
+};
+
+template<typename StringType> struct MacroProgram;
+
+//----------------------------------------------------------------------------
+//! Токен предкомпилированного шаблона
+template<typename StringType>
+struct MacroToken
+{
+    MacroTokenKind                          kind      = MacroTokenKind::literal;
+    std::size_t                             pos       = 0;     //!< Начало литерала/исходного текста макроса в MacroProgram::text
+    std::size_t                             len       = 0;     //!< Длина литерала/исходного текста макроса
+    StringType                              name;              //!< Подготовленное (prepareMacroName/filterDotsSlashes) имя макроса
+    bool                                    onlyExist = false; //!< Для условия: ?* - проверять только существование, ?+ - непустоту
+    std::vector< MacroProgram<StringType> > subs;              //!< Аргументы макроса или ветви условия (true, false)
+    std::string                             message;           //!< Текст ошибки для MacroTokenKind::error
+};
+
+//----------------------------------------------------------------------------
+//! Программа предкомпилированного шаблона
+template<typename StringType>
+struct MacroProgram
+{
+    StringType                             text;    //!< Пул литералов и исходных текстов макросов
+    std::vector< MacroToken<StringType> >  tokens;  //!< Токены
+};
+
+//----------------------------------------------------------------------------
+namespace util{
+
+//----------------------------------------------------------------------------
+//! Добавляет литерал в программу, склеивая с предыдущим литералом
+template<typename StringType, typename IteratorType> inline
+void macroProgramAppendLiteral(MacroProgram<StringType> &prog, IteratorType b, IteratorType e)
+{
+    if (b==e)
+        return;
+
+    std::size_t pos = prog.text.size();
+    prog.text.append(b, e);
+
+    if (!prog.tokens.empty() && prog.tokens.back().kind==MacroTokenKind::literal && prog.tokens.back().pos+prog.tokens.back().len==pos)
+    {
+        prog.tokens.back().len += prog.text.size()-pos;
+        return;
+    }
+
+    MacroToken<StringType> tk;
+    tk.kind = MacroTokenKind::literal;
+    tk.pos  = pos;
+    tk.len  = prog.text.size()-pos;
+    prog.tokens.emplace_back(std::move(tk));
+}
+
+//----------------------------------------------------------------------------
+//! Добавляет токен ошибки
+template<typename StringType> inline
+void macroProgramAppendError(MacroProgram<StringType> &prog, const std::string &msg)
+{
+    MacroToken<StringType> tk;
+    tk.kind    = MacroTokenKind::error;
+    tk.message = msg;
+    prog.tokens.emplace_back(std::move(tk));
+}
+
+} // namespace util
+
+//----------------------------------------------------------------------------
+//! Компилирует шаблон в программу. Разбор повторяет разбор substMacros
+#include "umba/warnings/push_disable_spectre_mitigation.h"
+template<typename StringType>
+MacroProgram<StringType> compileMacroProgram(const StringType &str, int flags)
+{
+    namespace util = ::umba::macros::util;
+
+    typedef typename StringType::value_type CharType;
+
+    MacroProgram<StringType> prog;
+    prog.text.reserve(str.size());
+
+    typename StringType::const_iterator it = str.begin(), mstartIt = str.end(), litStart = str.begin();
+
+    while(it!=str.end())
+    {
+        if (*it!=(CharType)'$')
+        {
+            ++it;
+            continue;
+        }
+
+        util::macroProgramAppendLiteral(prog, litStart, it);
+
+        mstartIt = it;
+        ++it;
+        litStart = it;
+        if (it==str.end())
+            break;
+
+        if (*it==(CharType)'$')
+        {
+            ++it; // litStart указывает на второй '$'
+            continue;
+        }
+
+        if (*it!=(CharType)'(')
+        {
+            litStart = mstartIt; ++it;
+            continue;
+        }
+
+        ++it;
+        if (it==str.end())
+        {
+            litStart = it;
+            break;
+        }
+
+        typename StringType::const_iterator start = it;
+        int brCnt = 1;
+        for(; it!=str.end(); ++it)
+        {
+            if (*it==(CharType)'(') { ++brCnt; continue; }
+            if (*it==(CharType)')')
+            {
+                --brCnt;
+                if (!brCnt) break;
+            }
+        }
+
+        if (it==str.end())
+        {
+            litStart = start;
+            break;
+        }
+
+        StringType macroName = StringType(start, it);
+        ++it;
+        litStart = it;
+
+        typename StringType::size_type qPos = util::findChar<'(', ')', '?'>(macroName);
+        if (qPos==StringType::npos)
+        {
+            std::vector< StringType > parts;
+            typename StringType::size_type startPos = 0, nextPos = util::findChar<'(', ')', ':'>(macroName, 0);
+            do {
+                if (nextPos!=StringType::npos)
+                {
+                    parts.push_back(StringType(macroName, startPos, nextPos-startPos));
+                    startPos = nextPos+1;
+                    nextPos = util::findChar<'(', ')', ':'>(macroName, startPos);
+                }
+                else
+                {
+                    parts.push_back(StringType(macroName, startPos));
+                    break;
+                }
+
+            } while(1);
+
+            MacroToken<StringType> tk;
+
+            if (parts.size()<=1)
+            {
+                tk.kind = MacroTokenKind::var;
+                tk.name = util::prepareMacroName(util::filterDotsSlashes(macroName, flags), flags);
+                tk.pos  = prog.text.size();
+                prog.text.append(mstartIt, it);
+                tk.len  = prog.text.size()-tk.pos;
+            }
+            else
+            {
+                if (!(flags&smf_ArgsAllowed))
+                {
+                    util::macroProgramAppendError(prog, "Parametrized macros not allowed");
+                    continue;
+                }
+
+                tk.kind = MacroTokenKind::args;
+                tk.name = util::prepareMacroName(util::filterDotsSlashes(parts[0], flags), flags);
+                for(std::size_t pi=1; pi!=parts.size(); ++pi)
+                    tk.subs.emplace_back(compileMacroProgram(parts[pi], flags));
+            }
+
+            prog.tokens.emplace_back(std::move(tk));
+            continue;
+        }
+
+        if (!(flags&smf_ConditionAllowed))
+        {
+            util::macroProgramAppendError(prog, "Conditional macros not allowed");
+            continue;
+        }
+
+        StringType macroNameCond = util::prepareMacroName(util::filterDotsSlashes(StringType(macroName, 0, qPos), flags), flags);
+        ++qPos;
+        if (qPos>=macroName.size())
+            continue; // no true or false branches
+
+        if (macroName[qPos]!='*' && macroName[qPos]!='+')
+        {
+            util::macroProgramAppendError( prog
+                                         , ::std::string("Conditional macro inclusion (body: '")
+                                         + umba::string_plus::make_string<::std::string>(macroName)
+                                         + ::std::string("') - invalid condition, ?* nor ?+ used")
+                                         );
+            continue;
+        }
+
+        MacroToken<StringType> tk;
+        tk.kind      = MacroTokenKind::condition;
+        tk.name      = macroNameCond;
+        tk.onlyExist = macroName[qPos]=='*';
+
+        typename StringType::size_type truthBranchStart = ++qPos;
+        if (truthBranchStart>=macroName.size())
+            continue; // no true or false branches
+
+        typename StringType::size_type colonPos = util::findChar<'(', ')', ':'>(macroName, truthBranchStart);
+
+        StringType truthPart, falsePart;
+        if (colonPos==StringType::npos || colonPos>=macroName.size())
+        {
+            truthPart = StringType(macroName, truthBranchStart);
+        }
+        else
+        {
+            typename StringType::size_type truthBranchLen = colonPos-truthBranchStart;
+            truthPart = StringType(macroName, truthBranchStart, truthBranchLen);
+            falsePart = StringType(macroName, truthBranchStart + truthBranchLen+1);
+        }
+
+        if (flags&smf_DisableRecursion)
+        {
+            tk.subs.resize(2);
+            util::macroProgramAppendLiteral(tk.subs[0], truthPart.begin(), truthPart.end());
+            util::macroProgramAppendLiteral(tk.subs[1], falsePart.begin(), falsePart.end());
+        }
+        else
+        {
+            tk.subs.emplace_back(compileMacroProgram(truthPart, flags));
+            tk.subs.emplace_back(compileMacroProgram(falsePart, flags));
+        }
+
+        prog.tokens.emplace_back(std::move(tk));
+    }
+
+    util::macroProgramAppendLiteral(prog, litStart, str.end());
+
+    return prog;
+}
+#include "umba/warnings/pop.h"
+
+//----------------------------------------------------------------------------
+
+
+
+
+//----------------------------------------------------------------------------
+//! Кеш для выполнения предкомпилированных шаблонов
+/*! Хранит скомпилированные тела макросов, полученные от геттера (ключ - флаги и текст тела),
+    чтобы не разбирать их при каждой подстановке.
+
+    Если геттер стабилен (возвращает одни и те же значения на протяжении серии подстановок), то
+    можно включить кеширование результатов раскрытия макросов верхнего уровня (setStableGetter).
+    При смене значений макросов следует вызвать resetExpansions.
+
+    Не потокобезопасен - используйте свой экземпляр на каждый поток.
+ */
+template<typename StringType>
+class MacroRenderCache
+{
+
+public:
+
+    typedef std::shared_ptr< const MacroProgram<StringType> >  ProgramPtr;  //!< Указатель на скомпилированное тело макроса
+
+    explicit MacroRenderCache(bool stableGetter = false) : m_stableGetter(stableGetter) {}
+
+    //! Включает/выключает кеширование результатов раскрытия макросов. При выключении сбрасывает накопленные результаты
+    void setStableGetter(bool stableGetter)
+    {
+        m_stableGetter = stableGetter;
+        if (!m_stableGetter)
+            m_expansions.clear();
+    }
+
+    bool isStableGetter() const { return m_stableGetter; }  //!< Включено ли кеширование результатов раскрытия
+
+    //! Сброс результатов раскрытия - нужно вызывать при смене значений макросов
+    void resetExpansions()
+    {
+        m_expansions.clear();
+    }
+
+    //! Полная очистка кеша
+    void clear()
+    {
+        m_programs.clear();
+        m_expansions.clear();
+    }
+
+    //! Возвращает скомпилированное тело макроса
+    ProgramPtr getProgram(const StringType &text, int flags)
+    {
+        auto key = std::make_pair(flags, text);
+        auto it = m_programs.find(key);
+        if (it!=m_programs.end())
+            return it->second;
+
+        ProgramPtr pProg = std::make_shared< MacroProgram<StringType> >(compileMacroProgram(text, flags));
+        m_programs.emplace(std::move(key), pProg);
+        return pProg;
+    }
+
+    //! Возвращает закешированный результат раскрытия макроса верхнего уровня, или 0
+    const StringType* findExpansion(const StringType &name, int flags) const
+    {
+        if (!m_stableGetter)
+            return 0;
+        auto it = m_expansions.find(std::make_pair(flags, name));
+        return it==m_expansions.end() ? 0 : &it->second;
+    }
+
+    //! Сохраняет результат раскрытия макроса верхнего уровня
+    void addExpansion(const StringType &name, int flags, const StringType &text)
+    {
+        if (m_stableGetter)
+            m_expansions[std::make_pair(flags, name)] = text;
+    }
+
+
+protected:
+
+    bool                                                  m_stableGetter = false;
+    std::map< std::pair<int, StringType>, ProgramPtr >    m_programs;
+    std::map< std::pair<int, StringType>, StringType >    m_expansions;
+
+}; // class MacroRenderCache
+
+//----------------------------------------------------------------------------
+
+
+
+
+//----------------------------------------------------------------------------
+namespace util{
+
+//----------------------------------------------------------------------------
+//! Цепочка раскрываемых в данный момент макросов - замена копированию StringSet usedMacros на каждом уровне
+template<typename StringType>
+struct MacroUsageChain
+{
+    const StringType                  *pName = 0;
+    const MacroUsageChain<StringType> *pPrev = 0;
+
+    bool contains(const StringType &name) const
+    {
+        for(const MacroUsageChain *p = this; p; p=p->pPrev)
+        {
+            if (p->pName && *p->pName==name)
+                return true;
+        }
+        return false;
+    }
+
+    bool empty() const { return pName==0 && (pPrev==0 || pPrev->empty()); }
+
+}; // struct MacroUsageChain
+
+//----------------------------------------------------------------------------
+//! Геттер аргументов %0, %1... макроса с параметрами - без создания временной map, как в MacroTextGetterProxy
+template<typename StringType>
+struct MacroArgsTextGetter : public IMacroTextGetter<StringType>
+{
+    const std::vector<StringType>        &args;
+    const IMacroTextGetter<StringType>   &orgGetter;
+
+    MacroArgsTextGetter( const std::vector<StringType> &_args, const IMacroTextGetter<StringType> &_orgGetter)
+    : args(_args), orgGetter(_orgGetter) {}
+
+    virtual bool operator()(const StringType &name, StringType &text) const override
+    {
+        typedef typename StringType::value_type CharType;
+
+        // Имена вида %N без ведущих нулей
+        if (name.size()>1 && name[0]==(CharType)'%' && (name[1]!=(CharType)'0' || name.size()==2))
+        {
+            std::size_t idx = 0;
+            std::size_t i   = 1;
+            for(; i!=name.size(); ++i)
+            {
+                if (name[i]<(CharType)'0' || name[i]>(CharType)'9')
+                    break;
+                idx = idx*10 + (std::size_t)(name[i]-(CharType)'0');
+                if (idx>args.size())
+                    break;
+            }
+
+            if (i==name.size() && idx<=args.size())
+            {
+                if (idx==0)
+                    text = toString<StringType>(int(args.size()));
+                else
+                    text = args[idx-1];
+                return true;
+            }
+        }
+
+        return orgGetter(name, text);
+    }
+
+    MacroArgsTextGetter(const MacroArgsTextGetter&) = delete;
+    MacroArgsTextGetter& operator=(const MacroArgsTextGetter&) = delete;
+
+}; // struct MacroArgsTextGetter
+
+//----------------------------------------------------------------------------
+template<typename StringType>
+void renderMacroProgram( const MacroProgram<StringType>       &prog
+                       , const IMacroTextGetter<StringType>   &getMacroText
+                       , int                                  flags
+                       , const MacroUsageChain<StringType>    &usedMacros
+                       , MacroRenderCache<StringType>         *pCache
+                       , StringType                           &res
+                       );
+
+//----------------------------------------------------------------------------
+//! Раскрывает тело макроса, полученное от геттера
+template<typename StringType> inline
+void renderMacroBody( const StringType                     &macroText
+                    , const IMacroTextGetter<StringType>   &getMacroText
+                    , int                                  flags
+                    , const MacroUsageChain<StringType>    &usedMacros
+                    , MacroRenderCache<StringType>         *pCache
+                    , StringType                           &res
+                    )
+{
+    if (pCache)
+    {
+        // Копия указателя удерживает программу, даже если кеш будет очищен в процессе
+        auto pProg = pCache->getProgram(macroText, flags);
+        renderMacroProgram(*pProg, getMacroText, flags, usedMacros, pCache, res);
+    }
+    else
+    {
+        renderMacroProgram(compileMacroProgram(macroText, flags), getMacroText, flags, usedMacros, pCache, res);
+    }
+}
+
+//----------------------------------------------------------------------------
+#include "umba/warnings/push_disable_spectre_mitigation.h"
+template<typename StringType>
+void renderMacroProgram( const MacroProgram<StringType>       &prog
+                       , const IMacroTextGetter<StringType>   &getMacroText
+                       , int                                  flags
+                       , const MacroUsageChain<StringType>    &usedMacros
+                       , MacroRenderCache<StringType>         *pCache
+                       , StringType                           &res
+                       )
+{
+    StringType macroText;
+
+    for(const auto &tk : prog.tokens)
+    {
+        switch(tk.kind)
+        {
+            case MacroTokenKind::literal:
+            {
+                res.append(prog.text, tk.pos, tk.len);
+                break;
+            }
+
+            case MacroTokenKind::var:
+            {
+                if (usedMacros.contains(tk.name))
+                    break; // allready used
+
+                const bool topLevel = usedMacros.empty();
+                if (pCache && topLevel)
+                {
+                    const StringType *pExpanded = pCache->findExpansion(tk.name, flags);
+                    if (pExpanded)
+                    {
+                        res.append(*pExpanded);
+                        break;
+                    }
+                }
+
+                if (!getMacroText(tk.name, macroText))
+                {
+                    if (flags&smf_KeepUnknownVars)
+                        res.append(prog.text, tk.pos, tk.len);
+                    break; // macro not found
+                }
+
+                if (flags&smf_DisableRecursion)
+                {
+                    res.append(macroText);
+                    break;
+                }
+
+                MacroUsageChain<StringType> nextUsed;
+                nextUsed.pName = &tk.name;
+                nextUsed.pPrev = &usedMacros;
+
+                if (pCache && topLevel && pCache->isStableGetter())
+                {
+                    StringType expanded;
+                    renderMacroBody(macroText, getMacroText, flags, nextUsed, pCache, expanded);
+                    res.append(expanded);
+                    pCache->addExpansion(tk.name, flags, expanded);
+                }
+                else
+                {
+                    renderMacroBody(macroText, getMacroText, flags, nextUsed, pCache, res);
+                }
+                break;
+            }
+
+            case MacroTokenKind::args:
+            {
+                if (usedMacros.contains(tk.name))
+                    break; // allready used
+
+                if (!getMacroText(tk.name, macroText))
+                    break; // macro not found
+
+                MacroUsageChain<StringType> nextUsed;
+                nextUsed.pName = &tk.name;
+                nextUsed.pPrev = &usedMacros;
+
+                std::vector<StringType> args(tk.subs.size());
+                for(std::size_t i=0; i!=tk.subs.size(); ++i)
+                    renderMacroProgram(tk.subs[i], getMacroText, flags, nextUsed, pCache, args[i]);
+
+                // Геттер аргументов отличается от основного, результаты раскрытия внутри не кешируются
+                renderMacroBody(macroText, MacroArgsTextGetter<StringType>(args, getMacroText), flags, nextUsed, pCache, res);
+                break;
+            }
+
+            case MacroTokenKind::condition:
+            {
+                bool cond = false;
+                if (getMacroText(tk.name, macroText))
+                {
+                    if (tk.onlyExist)
+                        cond = true;
+                    else if (!umba::string_plus::trim_copy(macroText, umba::string_plus::space_pred<typename StringType::value_type>()).empty())
+                        cond = true;
+                }
+
+                renderMacroProgram(tk.subs[cond ? 0 : 1], getMacroText, flags, usedMacros, pCache, res);
+                break;
+            }
+
+            case MacroTokenKind::error:
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error(tk.message);
+            }
+        }
+    }
+}
+#include "umba/warnings/pop.h"
+
+} // namespace util
+
+//----------------------------------------------------------------------------
+
+
+
+
+//----------------------------------------------------------------------------
+//! Предкомпилированный шаблон для подстановки макросов - "скомпилировать один раз, выполнять многократно"
+/*! Шаблон неизменяем после компиляции, и может выполняться одновременно из нескольких потоков
+    (если каждый поток использует свой MacroRenderCache или не использует его вовсе).
+ */
+template<typename StringType>
+class CompiledMacroTemplate
+{
+
+public:
+
+    CompiledMacroTemplate() {}
+
+    //! Компилирует шаблон
+    explicit CompiledMacroTemplate(const StringType &str, int flags = smf_KeepUnknownVars)
+    {
+        compile(str, flags);
+    }
+
+    //! Компилирует шаблон
+    void compile(const StringType &str, int flags = smf_KeepUnknownVars)
+    {
+        m_flags   = flags;
+        m_program = compileMacroProgram(str, flags);
+    }
+
+    int getFlags() const { return m_flags; }                                       //!< Флаги, с которыми скомпилирован шаблон
+    const MacroProgram<StringType>& getProgram() const { return m_program; }       //!< Скомпилированная программа
+
+    //! Дописывает результат подстановки в res
+    void appendTo(StringType &res, const IMacroTextGetter<StringType> &getMacroText, MacroRenderCache<StringType> *pCache = 0) const
+    {
+        util::MacroUsageChain<StringType> usedMacros;
+        util::renderMacroProgram(m_program, getMacroText, m_flags, usedMacros, pCache, res);
+    }
+
+    //! Записывает результат подстановки в res, ёмкость буфера переиспользуется
+    void renderTo(StringType &res, const IMacroTextGetter<StringType> &getMacroText, MacroRenderCache<StringType> *pCache = 0) const
+    {
+        res.clear();
+        appendTo(res, getMacroText, pCache);
+    }
+
+    //! Возвращает результат подстановки
+    StringType render(const IMacroTextGetter<StringType> &getMacroText, MacroRenderCache<StringType> *pCache = 0) const
+    {
+        StringType res;
+        appendTo(res, getMacroText, pCache);
+        return res;
+    }
+
+
+protected:
+
+    int                        m_flags = smf_KeepUnknownVars;
+    MacroProgram<StringType>   m_program;
+
+}; // class CompiledMacroTemplate
+
+//----------------------------------------------------------------------------
+
+
+
+} // namespace macros
+} // namespace umba
+
+
+// umba::macros::
@@ -10,6 +10,7 @@
 
 #include "string_plus.h"
 #include "debug_helpers.h"
+#include "perf_probes.h"
 //
 #include <map>
 #include <set>
@@ -519,6 +520,8 @@ substMacros( const ::std::basic_string<CharType, Traits, Allocator> &str
            , int                                                     flags = smf_KeepUnknownVars // smf_ArgsAllowed|smf_ConditionAllowed
            )
    {
+    UMBA_PERF_PROBE_SCOPE_BYTES("umba::macros::substMacros", (uint64_t)str.size()*sizeof(CharType));
+
     StringSet< ::std::basic_string<CharType, Traits, Allocator> > usedMacros;
     return substMacros(str, getMacroText, flags, usedMacros);
    }
@@ -0,0 +1,599 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief CharWriter для вывода из нескольких потоков в одного потребителя через lock-free кольцевой буфер
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Несколько потоков пишут записи (куски байт) в общий кольцевой буфер без блокировок,
+    один поток-потребитель (собственный фоновый поток или пользовательский, вызывающий drain)
+    переносит их в целевой ICharWriter. Каждая запись лежит в буфере непрерывно и передаётся
+    целевому писателю одним вызовом writeBuf, поэтому записи разных потоков никогда не перемешиваются.
+
+    MpscRingCharWriter сам является ICharWriter - каждый вызов writeBuf/writeString становится
+    одной записью. Для построчного вывода через SimpleFormatter, который пишет строку по частям,
+    каждый поток использует свой MpscRingCharWriter::ThreadWriter - он накапливает байты и
+    отправляет их одной записью по '\n' или по flush.
+
+    \code
+    umba::StdStreamCharWriter          coutWriter(std::cout);
+    umba::MpscRingCharWriter           ringWriter(coutWriter);
+
+    // В каждом потоке-сканере
+    umba::MpscRingCharWriter::ThreadWriter  tw(ringWriter);
+    umba::SimpleFormatter                   out(&tw);
+    out << "Found: " << fileName << "\n";
+    \endcode
+ */
+
+#pragma once
+
+#include "i_char_writer.h"
+#include "preprocessor.h"
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// umba::
+namespace umba {
+
+
+
+//----------------------------------------------------------------------------
+//! Кольцевой буфер записей: пишут несколько потоков без блокировок, читает один поток
+/*!
+    Буфер разбит на гранулы по granuleSize байт. Производитель резервирует место под запись
+    CAS'ом позиции записи, копирует данные и публикует запись, записывая её длину в слово
+    фиксации начальной гранулы (release). Если запись не помещается до конца буфера,
+    вместе с ней резервируется хвост буфера, который помечается как заполнитель.
+
+    Потребитель идёт по словам фиксации от позиции чтения, пока не встретит неопубликованную запись,
+    обнуляет слова фиксации и сдвигает позицию чтения - после этого место доступно производителям.
+
+    Запись не длиннее getMaxRecordSize() байт всегда лежит в буфере непрерывно.
+ */
+class MpscByteRing
+{
+    public:
+
+        static const std::size_t granuleSize = 16; //!< Гранулярность размещения записей
+
+        //! Конструктор. Размер округляется вверх до степени двойки, не меньше 1024 байт
+        explicit MpscByteRing( std::size_t capacity )
+        : m_numGranules(roundUpPow2(std::max(capacity, (std::size_t)1024))/granuleSize)
+        , m_mask(m_numGranules-1)
+        , m_buf(m_numGranules*granuleSize)
+        , m_commit(new std::atomic<uint32_t>[m_numGranules])
+        , m_head(0)
+        , m_tail(0)
+        {
+            for(std::size_t i=0; i!=m_numGranules; ++i)
+                m_commit[i].store(0, std::memory_order_relaxed);
+        }
+
+        UMBA_NON_COPYABLE_CLASS(MpscByteRing)
+
+    public:
+
+        std::size_t getCapacity() const { return m_buf.size(); }
+
+        //! Максимальный размер записи, которая гарантированно будет размещена непрерывно
+        std::size_t getMaxRecordSize() const { return (m_numGranules/2)*granuleSize; }
+
+        //! Пытается поместить запись. Возвращает false, если места нет. Может вызываться из любого потока
+        /*! Пустые записи и записи длиннее getMaxRecordSize() не принимаются (возвращается true и false соответственно)
+         */
+        bool tryPush( const void *pData, std::size_t size )
+        {
+            if (!size)
+                return true;
+
+            if (size>getMaxRecordSize())
+                return false;
+
+            const uint64_t need = (uint64_t)granulesFor(size);
+
+            uint64_t head = m_head.load(std::memory_order_relaxed);
+            uint64_t pad  = 0;
+            for(;;)
+            {
+                const uint64_t off = head & m_mask;
+                pad = (off+need > m_numGranules) ? m_numGranules-off : 0;
+
+                // head мог устареть и отстать от tail - тогда занятым считаем ноль, CAS всё равно не пройдёт
+                const uint64_t tail = m_tail.load(std::memory_order_acquire);
+                const uint64_t used = head>tail ? head-tail : 0;
+                if (used+pad+need > m_numGranules)
+                    return false;
+
+                if (m_head.compare_exchange_weak(head, head+pad+need, std::memory_order_relaxed))
+                    break;
+            }
+
+            if (pad)
+                m_commit[head & m_mask].store(paddingFlag | (uint32_t)pad, std::memory_order_release);
+
+            const std::size_t start = (std::size_t)((head+pad) & m_mask);
+            std::memcpy(&m_buf[start*granuleSize], pData, size);
+            m_commit[start].store((uint32_t)size, std::memory_order_release);
+
+            return true;
+        }
+
+        //! Передаёт опубликованные записи обработчику handler(const uint8_t *pData, std::size_t size). Вызывается только потребителем
+        /*! Записи передаются прямо из буфера, без копирования. Возвращает количество записей
+         */
+        template<typename Handler>
+        std::size_t drain( Handler handler )
+        {
+            std::size_t count = 0;
+            uint64_t    tail  = m_tail.load(std::memory_order_relaxed);
+
+            for(;;)
+            {
+                const std::size_t off = (std::size_t)(tail & m_mask);
+                const uint32_t    c   = m_commit[off].load(std::memory_order_acquire);
+                if (!c)
+                    break;
+
+                m_commit[off].store(0, std::memory_order_relaxed);
+
+                if (c & paddingFlag)
+                {
+                    tail += c & ~paddingFlag;
+                }
+                else
+                {
+                    handler((const uint8_t*)&m_buf[off*granuleSize], (std::size_t)c);
+                    tail += granulesFor(c);
+                    ++count;
+                }
+
+                m_tail.store(tail, std::memory_order_release);
+            }
+
+            return count;
+        }
+
+        //! Позиция записи (в гранулах) - включая зарезервированные, но ещё не опубликованные записи
+        uint64_t getHeadPos() const { return m_head.load(std::memory_order_acquire); }
+
+        //! Позиция чтения (в гранулах)
+        uint64_t getTailPos() const { return m_tail.load(std::memory_order_acquire); }
+
+        bool isEmpty() const { return getHeadPos()==getTailPos(); }
+
+        static std::size_t roundUpPow2( std::size_t sz )
+        {
+            std::size_t res = 1;
+            while(res<sz)
+                res <<= 1;
+            return res;
+        }
+
+
+    protected:
+
+        static const uint32_t paddingFlag = 0x80000000u;
+
+        static std::size_t granulesFor( std::size_t size )
+        {
+            return (size+granuleSize-1)/granuleSize;
+        }
+
+        const std::size_t                            m_numGranules;
+        const uint64_t                               m_mask;
+        std::vector<uint8_t>                         m_buf;
+        std::unique_ptr< std::atomic<uint32_t>[] >   m_commit;  //!< Слово фиксации на каждую гранулу: 0 - нет записи
+        alignas(64) std::atomic<uint64_t>            m_head;    //!< Позиция записи, резервируют производители
+        alignas(64) std::atomic<uint64_t>            m_tail;    //!< Позиция чтения, меняет потребитель
+
+}; // class MpscByteRing
+
+//----------------------------------------------------------------------------
+
+
+
+
+//----------------------------------------------------------------------------
+//! ICharWriter, передающий вывод нескольких потоков в целевой писатель через MpscByteRing
+/*!
+    Если при создании запрошен фоновый поток, то он забирает записи и пишет их в target, сбрасывая
+    target после каждой пачки. Иначе записи переносит пользователь, вызывая drain() или flush(),
+    а при переполнении буфера - сам пишущий поток.
+
+    При переполнении буфера производители ждут фоновый поток: сначала уступают процессор, затем засыпают.
+
+    Терминальные операции (цвет, позиционирование) передаются байтами ESC-последовательностей,
+    только если target - ANSI-терминал, иначе игнорируются.
+ */
+class MpscRingCharWriter : UMBA_IMPLEMENTS ICharWriter
+{
+    public:
+
+        static const std::size_t defaultRingCapacity = 64*1024; //!< Размер буфера по умолчанию
+
+        //! Конструктор
+        /*! \param target          Куда переносятся записи
+            \param ringCapacity    Размер кольцевого буфера
+            \param startConsumer   Запустить фоновый поток-потребитель
+         */
+        explicit MpscRingCharWriter( ICharWriter  &target
+                                   , std::size_t   ringCapacity  = defaultRingCapacity
+                                   , bool          startConsumer = true
+                                   )
+        : m_target(target)
+        , m_ring(ringCapacity)
+        , m_bTerminal(target.isTerminal())
+        , m_bAnsiTerminal(target.isAnsiTerminal())
+        , m_flushedPos(0)
+        , m_flushWaiters(0)
+        , m_consumerSleeping(false)
+        , m_stop(false)
+        {
+            if (startConsumer)
+                m_thread = std::thread( [this]() { consumerProc(); } );
+        }
+
+        //! Переносит все записи в target и останавливает фоновый поток
+        ~MpscRingCharWriter()
+        {
+            if (m_thread.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    m_stop = true;
+                }
+                m_cond.notify_all();
+                m_thread.join();
+            }
+            else
+            {
+                drain();
+                m_target.flush();
+            }
+        }
+
+        UMBA_NON_COPYABLE_CLASS(MpscRingCharWriter)
+
+    public:
+
+        //----------------------------------------------------------------------------
+        //! Писатель одного потока: накапливает вывод и отправляет его одной записью по '\n' и по flush
+        /*! Объект принадлежит одному потоку. Вывод длиннее getMaxRecordSize() отправляется
+            несколькими записями и может перемежаться с выводом других потоков.
+         */
+        class ThreadWriter : UMBA_IMPLEMENTS ICharWriter
+        {
+            public:
+
+                //! Конструктор. bLineMode - отправлять запись по каждому '\n'
+                explicit ThreadWriter( MpscRingCharWriter &owner, bool bLineMode = true )
+                : m_owner(owner)
+                , m_bLineMode(bLineMode)
+                {
+                    m_buf.reserve(256);
+                }
+
+                ~ThreadWriter()
+                {
+                    commit();
+                }
+
+                UMBA_NON_COPYABLE_CLASS(ThreadWriter)
+
+            public:
+
+                virtual
+                void writeChar( char ch ) override
+                {
+                    m_buf.push_back((uint8_t)ch);
+                    if (m_bLineMode && ch=='\n')
+                        commit();
+                }
+
+                virtual
+                void writeBuf( const uint8_t* pBuf, size_t len ) override
+                {
+                    if (!m_bLineMode)
+                    {
+                        m_buf.insert(m_buf.end(), pBuf, pBuf+len);
+                        return;
+                    }
+
+                    // Отправляем всё до последнего перевода строки, остаток копим
+                    const uint8_t *pEnd = pBuf+len;
+                    const uint8_t *pLf  = pEnd;
+                    while(pLf!=pBuf && pLf[-1]!='\n')
+                        --pLf;
+
+                    m_buf.insert(m_buf.end(), pBuf, pLf);
+                    if (pLf!=pBuf)
+                        commit();
+                    m_buf.insert(m_buf.end(), pLf, pEnd);
+                }
+
+                virtual
+                void writeString( const char* str ) override
+                {
+                    writeBuf( (const uint8_t*)str, std::strlen(str) );
+                }
+
+                //! Отправляет накопленное одной записью и ждёт её вывода в target
+                virtual
+                void flush() override
+                {
+                    commit();
+                    m_owner.flush();
+                }
+
+                //! Отправляет накопленное одной записью, не дожидаясь вывода
+                void commit()
+                {
+                    if (m_buf.empty())
+                        return;
+                    m_owner.pushRecord(&m_buf[0], m_buf.size());
+                    m_buf.clear();
+                }
+
+                virtual bool isTerminal()     const override { return m_owner.isTerminal();     }
+                virtual bool isAnsiTerminal() const override { return m_owner.isAnsiTerminal(); }
+
+                virtual void putCR() override { if (isTerminal()) writeChar( '\r' ); }
+                virtual void putFF() override { if (isTerminal()) writeChar( '\f' ); }
+
+                virtual void setTermColors(term::colors::SgrColor clr) override { if (isAnsiTerminal()) setAnsiTermColorsImpl(clr); }
+                virtual void setDefaultTermColors()                    override { if (isAnsiTerminal()) setAnsiTermDefaultColorsImpl(); }
+
+                virtual void terminalMoveToAbs0()                       override { if (isAnsiTerminal()) terminalMoveToAbs0Impl(); }
+                virtual void terminalMoveRelative(int direction, int n) override { if (isAnsiTerminal()) terminalMoveRelativeImpl(direction, n); }
+                virtual void terminalMoveToNextLine(int n)              override { if (isAnsiTerminal()) terminalMoveToNextLineImpl(n); }
+                virtual void terminalMoveToPrevLine(int n)              override { if (isAnsiTerminal()) terminalMoveToPrevLineImpl(n); }
+                virtual void terminalMoveToAbsCol(int n)                override { if (isAnsiTerminal()) terminalMoveToAbsColImpl(n); }
+                virtual void terminalMoveToLineStart()                  override { if (isAnsiTerminal()) terminalMoveToLineStartImpl(); }
+                virtual void terminalMoveToAbsPos( int x, int y )       override { if (isAnsiTerminal()) terminalMoveToAbsPosImpl(x, y); }
+                virtual void terminalClearScreenEnd()                   override { if (isAnsiTerminal()) terminalClearScreenEndImpl(); }
+                virtual void terminalClearScreen()                      override { if (isAnsiTerminal()) terminalClearScreenImpl(); }
+                virtual void terminalClearLine()                        override { if (isAnsiTerminal()) terminalClearLineImpl(); }
+                virtual void terminalClearLineEnd()                     override { if (isAnsiTerminal()) terminalClearLineEndImpl(); }
+
+            protected:
+
+                MpscRingCharWriter    &m_owner;
+                bool                   m_bLineMode;
+                std::vector<uint8_t>   m_buf;
+
+        }; // class ThreadWriter
+
+        //----------------------------------------------------------------------------
+
+
+        //! Запись символа - отдельной записью. Для посимвольного вывода используйте ThreadWriter
+        virtual
+        void writeChar( char ch ) override
+        {
+            pushRecord(&ch, 1);
+        }
+
+        //! Запись буфера - одной записью
+        virtual
+        void writeBuf( const uint8_t* pBuf, size_t len ) override
+        {
+            pushRecord(pBuf, len);
+        }
+
+        //! Запись ASCII-Z строки - одной записью
+        virtual
+        void writeString( const char* str ) override
+        {
+            pushRecord(str, std::strlen(str));
+        }
+
+        //! Ожидает переноса в target всех записей, помещённых до вызова. Без фонового потока переносит их сам
+        virtual
+        void flush() override
+        {
+            if (!m_thread.joinable())
+            {
+                std::lock_guard<std::mutex> lock(m_drainMtx);
+                drainImpl();
+                m_target.flush();
+                return;
+            }
+
+            const uint64_t pos = m_ring.getHeadPos();
+            if (m_flushedPos.load(std::memory_order_acquire)>=pos)
+                return;
+
+            m_flushWaiters.fetch_add(1, std::memory_order_seq_cst);
+            wakeConsumer(true);
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                while(m_flushedPos.load(std::memory_order_acquire)<pos && !m_stop)
+                    m_flushDoneCond.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            m_flushWaiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        //! Переносит записи в target. Вызывается только если фоновый поток не запущен
+        std::size_t drain()
+        {
+            std::lock_guard<std::mutex> lock(m_drainMtx);
+            return drainImpl();
+        }
+
+        //! Максимальный размер записи, которая не будет разбита
+        std::size_t getMaxRecordSize() const { return m_ring.getMaxRecordSize(); }
+
+        virtual bool isTerminal()     const override { return m_bTerminal;     }
+        virtual bool isAnsiTerminal() const override { return m_bAnsiTerminal; }
+
+        virtual void setTermColors(term::colors::SgrColor clr) override { if (isAnsiTerminal()) setAnsiTermColorsImpl(clr); }
+        virtual void setDefaultTermColors()                    override { if (isAnsiTerminal()) setAnsiTermDefaultColorsImpl(); }
+
+
+    protected:
+
+        //! Помещает запись в буфер, при необходимости разбивая её и ожидая свободного места
+        void pushRecord( const void *pData, std::size_t size )
+        {
+            const uint8_t     *p       = (const uint8_t*)pData;
+            const std::size_t  maxSize = m_ring.getMaxRecordSize();
+
+            while(size)
+            {
+                std::size_t partSize = std::min(size, maxSize);
+
+                for(unsigned attempt=0; !m_ring.tryPush(p, partSize); ++attempt)
+                {
+                    if (!m_thread.joinable())
+                    {
+                        // Фонового потока нет - освобождаем место сами, если буфер не переносит другой поток
+                        std::unique_lock<std::mutex> drainLock(m_drainMtx, std::try_to_lock);
+                        if (drainLock.owns_lock() && drainImpl())
+                            continue;
+                    }
+
+                    wakeConsumer(false);
+
+                    if (attempt<64)
+                    {
+                        std::this_thread::yield();
+                    }
+                    else
+                    {
+                        std::unique_lock<std::mutex> lock(m_mtx);
+                        m_spaceCond.wait_for(lock, std::chrono::milliseconds(1));
+                    }
+                }
+
+                p    += partSize;
+                size -= partSize;
+            }
+
+            wakeConsumer(false);
+        }
+
+        //! Переносит записи в target без фонового потока. Вызывается под m_drainMtx
+        std::size_t drainImpl()
+        {
+            ICharWriter &target = m_target;
+            std::size_t n = m_ring.drain( [&target](const uint8_t *pData, std::size_t size) { target.writeBuf(pData, size); } );
+            if (n)
+                m_spaceCond.notify_all();
+            return n;
+        }
+
+        void wakeConsumer( bool bForce )
+        {
+            // Пара с seq_cst записью m_consumerSleeping и последующей проверкой буфера в consumerProc
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!bForce && !m_consumerSleeping.load(std::memory_order_relaxed))
+                return;
+
+            // Будит только один производитель - остальные увидят false и не пойдут в мьютекс
+            if (!m_consumerSleeping.exchange(false, std::memory_order_relaxed) && !bForce)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_cond.notify_all();
+        }
+
+        void consumerProc()
+        {
+            ICharWriter &target = m_target;
+
+            for(;;)
+            {
+                bool stop;
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    stop = m_stop;
+                }
+
+                // Позиция до переноса - всё, что зарезервировано до неё, будет перенесено,
+                // если только производитель не задержался между резервированием и публикацией
+                const uint64_t headPos = m_ring.getHeadPos();
+
+                std::size_t written = 0;
+                for(;;)
+                {
+                    std::size_t n = m_ring.drain( [&target](const uint8_t *pData, std::size_t size) { target.writeBuf(pData, size); } );
+                    if (!n)
+                        break;
+                    written += n;
+                    m_spaceCond.notify_all();
+                }
+
+                if (written)
+                    target.flush();
+
+                const uint64_t tailPos = m_ring.getTailPos();
+                m_flushedPos.store(std::min(headPos, tailPos), std::memory_order_release);
+
+                if (m_flushWaiters.load(std::memory_order_seq_cst))
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    m_flushDoneCond.notify_all();
+                }
+
+                if (stop && m_ring.isEmpty())
+                    break;
+
+                if (written || stop)
+                    continue;
+
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_consumerSleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!m_stop && m_ring.isEmpty())
+                    m_cond.wait_for(lock, std::chrono::milliseconds(100));
+                else if (!m_ring.isEmpty())
+                    m_cond.wait_for(lock, std::chrono::microseconds(50)); // Запись зарезервирована, но ещё не опубликована
+                m_consumerSleeping.store(false, std::memory_order_relaxed);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_flushDoneCond.notify_all();
+            }
+        }
+
+
+        ICharWriter                 &m_target;
+        MpscByteRing                 m_ring;
+        const bool                   m_bTerminal;
+        const bool                   m_bAnsiTerminal;
+
+        std::atomic<uint64_t>        m_flushedPos;       //!< Позиция, до которой всё перенесено в target и сброшено
+        std::atomic<int>             m_flushWaiters;
+        std::atomic<bool>            m_consumerSleeping;
+
+        std::mutex                   m_mtx;
+        std::condition_variable      m_cond;             //!< Пробуждение фонового потока
+        std::condition_variable      m_spaceCond;        //!< Освободилось место в буфере
+        std::condition_variable      m_flushDoneCond;    //!< Продвинулась m_flushedPos
+        bool                         m_stop;
+
+        std::mutex                   m_drainMtx;         //!< Перенос без фонового потока - из drain/flush или из переполненного pushRecord
+
+        std::thread                  m_thread;
+
+}; // class MpscRingCharWriter
+
+//----------------------------------------------------------------------------
+
+
+
+} // namespace umba
+
@@ -58,6 +58,23 @@
     \warning Использование методов lock и unlock напрямую запрещено, следует использовать
     класс \ref umba::AutoLock или макрос #UMBA_CRITICAL_SECTION / #UMBA_CRITICAL_SECTION_EX.
 
+    \section perf_counters_usage Использование
+
+    Точка замера (PerfSite) - именованный объект со статическим временем жизни. Замеры пишутся
+    в данные текущего потока без блокировок и атомарных RMW-операций; при построении отчёта
+    (collectReport) данные всех потоков, включая завершившиеся, сливаются.
+
+    \code
+    void FileCache::addFile(...)
+    {
+        UMBA_PERF_COUNTERS_SCOPED_TIMER("FileCache::addFile");
+        ...
+    }
+
+    for(const auto &r : umba::perf_counters::collectReport())
+        std::cout << r.name << ": " << r.stats.getMean() << " ns, p99 " << r.histogram.getPercentile(99.0) << " ns\n";
+    \endcode
+
     \section perf_counters_conf Настройка
     В любой системе класс критической секции называется CriticalSection, и используется соответствующая версия.
     Это справедливо и для случая использования FreeRTOS, за исключением того, что класс InterruptCriticalSection
@@ -86,8 +103,19 @@
 
 #include "preprocessor.h"
 #include "zz_detect_environment.h"
+//
+#include "hr_counter.h"
 
 #include <stdint.h>
+//
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 
 #if defined(UMBA_WIN32_USED)
@@ -131,12 +159,644 @@ if(QueryPerformanceFrequency(&liFrequency))
 }
 */
 
+#if !defined(UMBA_PERF_COUNTERS_MAX_SITES)
+    //! Максимальное количество точек замера
+    #define UMBA_PERF_COUNTERS_MAX_SITES   256
+#endif
+
+
+// umba::perf_counters::
 namespace umba{
 
-//!
+//! Счётчики производительности
 namespace perf_counters{
 
 
+
+typedef hr_counter::HiResTick  PerfTick; //!< Тик счётчика производительности
+
+
+//! Счетчики доступны
+inline
+bool countersAvailable()
+{
+    return hr_counter::isCounterAvailable();
+}
+
+//! Значение счетчика
+inline
+PerfTick queryCounter()
+{
+    return hr_counter::getTick();
+}
+
+//! Перевод разницы значений счетчика в наносекунды
+inline
+uint64_t convertToNanosec( PerfTick ticks )
+{
+    return (uint64_t)hr_counter::convertTickToNanosec(ticks);
+}
+
+
+
+//----------------------------------------------------------------------------
+//! Суммирование по Кэхэну - компенсирует потерю младших разрядов при сложении большого количества чисел
+template<typename FloatType = double>
+class KahanSum
+{
+    public:
+
+        KahanSum() : m_sum(0), m_c(0) {}
+
+        void add( FloatType v )
+        {
+            FloatType y = v - m_c;
+            FloatType t = m_sum + y;
+            m_c   = (t - m_sum) - y;
+            m_sum = t;
+        }
+
+        FloatType getSum() const { return m_sum; }
+
+    protected:
+
+        FloatType m_sum;
+        FloatType m_c;   //!< Накопленная компенсация
+
+}; // class KahanSum
+
+
+
+//----------------------------------------------------------------------------
+//! Потоковое вычисление среднего и дисперсии методом Уэлфорда
+class WelfordAccumulator
+{
+    public:
+
+        WelfordAccumulator() : m_count(0), m_mean(0), m_m2(0), m_min(0), m_max(0) {}
+
+        //! Добавляет значение
+        void add( double v )
+        {
+            ++m_count;
+            double delta = v - m_mean;
+            m_mean += delta / (double)m_count;
+            m_m2   += delta * (v - m_mean);
+
+            if (m_count==1 || v<m_min)
+                m_min = v;
+            if (m_count==1 || v>m_max)
+                m_max = v;
+        }
+
+        //! Сливает с другим аккумулятором (Chan et al.)
+        void merge( const WelfordAccumulator &other )
+        {
+            if (!other.m_count)
+                return;
+
+            if (!m_count)
+            {
+                *this = other;
+                return;
+            }
+
+            uint64_t n     = m_count + other.m_count;
+            double   delta = other.m_mean - m_mean;
+            m_mean += delta * (double)other.m_count / (double)n;
+            m_m2   += other.m_m2 + delta*delta * (double)m_count * (double)other.m_count / (double)n;
+            m_count = n;
+
+            m_min = std::min(m_min, other.m_min);
+            m_max = std::max(m_max, other.m_max);
+        }
+
+        //! Создание из сохранённого состояния
+        static WelfordAccumulator fromState( uint64_t count, double mean, double m2, double minV, double maxV )
+        {
+            WelfordAccumulator w;
+            w.m_count = count;
+            w.m_mean  = mean;
+            w.m_m2    = m2;
+            w.m_min   = minV;
+            w.m_max   = maxV;
+            return w;
+        }
+
+        uint64_t getCount() const { return m_count; }
+        double   getMean () const { return m_mean; }
+        double   getMin  () const { return m_min; }
+        double   getMax  () const { return m_max; }
+        double   getM2   () const { return m_m2; }
+
+        //! Дисперсия генеральной совокупности
+        double getVariance() const { return m_count ? m_m2/(double)m_count : 0.0; }
+
+        //! Выборочная (несмещённая) дисперсия
+        double getSampleVariance() const { return m_count>1 ? m_m2/(double)(m_count-1) : 0.0; }
+
+        //! Стандартное отклонение (выборочное)
+        double getStddev() const { return std::sqrt(getSampleVariance()); }
+
+    protected:
+
+        uint64_t  m_count;
+        double    m_mean;
+        double    m_m2;    //!< Сумма квадратов отклонений от среднего
+        double    m_min;
+        double    m_max;
+
+}; // class WelfordAccumulator
+
+
+
+//----------------------------------------------------------------------------
+//! Простое скользящее среднее по последним WindowSize значениям
+template<typename ValueType, std::size_t WindowSize, typename SumType = ValueType>
+class SimpleMovingAverage
+{
+    static_assert(WindowSize>0, "SimpleMovingAverage: WindowSize must be greater than 0");
+
+    public:
+
+        SimpleMovingAverage() : m_sum(0), m_pos(0), m_count(0)
+        {
+            for(std::size_t i=0; i!=WindowSize; ++i)
+                m_values[i] = ValueType(0);
+        }
+
+        //! Добавляет значение, возвращает текущее среднее
+        SumType add( ValueType v )
+        {
+            m_sum -= (SumType)m_values[m_pos];
+            m_sum += (SumType)v;
+            m_values[m_pos] = v;
+
+            if (++m_pos==WindowSize)
+                m_pos = 0;
+            if (m_count<WindowSize)
+                ++m_count;
+
+            return getAverage();
+        }
+
+        //! Среднее по накопленным значениям (до заполнения окна - по тем, что есть)
+        SumType getAverage() const
+        {
+            return m_count ? m_sum / (SumType)m_count : SumType(0);
+        }
+
+        std::size_t getCount() const { return m_count; }
+        bool        isFull  () const { return m_count==WindowSize; }
+
+    protected:
+
+        ValueType    m_values[WindowSize];
+        SumType      m_sum;
+        std::size_t  m_pos;
+        std::size_t  m_count;
+
+}; // class SimpleMovingAverage
+
+
+
+//----------------------------------------------------------------------------
+//! Гистограмма задержек в стиле HDR - логарифмические интервалы, каждый поделён на subBucketCount линейных частей
+/*! Относительная погрешность значения - не более 1/subBucketCount (6.25%) во всём диапазоне uint64_t.
+    Значения меньше subBucketCount хранятся точно.
+ */
+class LatencyHistogram
+{
+    public:
+
+        static const unsigned    subBucketBits  = 4;
+        static const uint64_t    subBucketCount = 1u<<subBucketBits;
+        static const std::size_t bucketCount    = (64-subBucketBits+1)*subBucketCount; //!< Общее количество корзин
+
+        LatencyHistogram() : m_counts(bucketCount, 0), m_total(0) {}
+
+        //! Индекс корзины для значения
+        static std::size_t getBucketIndex( uint64_t v )
+        {
+            if (v<subBucketCount)
+                return (std::size_t)v;
+
+            unsigned msb   = highestBit(v);
+            unsigned shift = msb - subBucketBits;
+            return (std::size_t)(((uint64_t)(shift+1) << subBucketBits) + ((v >> shift) - subBucketCount));
+        }
+
+        //! Наименьшее значение, попадающее в корзину
+        static uint64_t getBucketLowerBound( std::size_t idx )
+        {
+            if (idx<subBucketCount)
+                return (uint64_t)idx;
+
+            unsigned shift = (unsigned)(idx >> subBucketBits) - 1;
+            uint64_t sub   = (uint64_t)(idx & (subBucketCount-1));
+            return (subBucketCount + sub) << shift;
+        }
+
+        //! Наибольшее значение, попадающее в корзину
+        static uint64_t getBucketUpperBound( std::size_t idx )
+        {
+            if (idx+1>=bucketCount)
+                return (uint64_t)-1;
+            return getBucketLowerBound(idx+1) - 1;
+        }
+
+        void add( uint64_t v, uint64_t count = 1 )
+        {
+            m_counts[getBucketIndex(v)] += count;
+            m_total += count;
+        }
+
+        void addToBucket( std::size_t idx, uint64_t count )
+        {
+            m_counts[idx] += count;
+            m_total       += count;
+        }
+
+        void merge( const LatencyHistogram &other )
+        {
+            for(std::size_t i=0; i!=bucketCount; ++i)
+                m_counts[i] += other.m_counts[i];
+            m_total += other.m_total;
+        }
+
+        uint64_t getCount() const { return m_total; }
+
+        uint64_t getBucketCount( std::size_t idx ) const { return m_counts[idx]; }
+
+        //! Значение перцентиля (0-100). Возвращается верхняя граница корзины, в которую попал перцентиль
+        uint64_t getPercentile( double percentile ) const
+        {
+            if (!m_total)
+                return 0;
+
+            if (percentile<0.0)
+                percentile = 0.0;
+            if (percentile>100.0)
+                percentile = 100.0;
+
+            uint64_t rank = (uint64_t)std::ceil(percentile/100.0 * (double)m_total);
+            if (rank==0)
+                rank = 1;
+
+            uint64_t acc = 0;
+            for(std::size_t i=0; i!=bucketCount; ++i)
+            {
+                acc += m_counts[i];
+                if (acc>=rank)
+                    return getBucketUpperBound(i);
+            }
+
+            return getBucketUpperBound(bucketCount-1);
+        }
+
+    protected:
+
+        static unsigned highestBit( uint64_t v )
+        {
+            #if defined(__GNUC__) || defined(__clang__)
+                return 63u - (unsigned)__builtin_clzll(v);
+            #else
+                unsigned r = 0;
+                while(v>>=1)
+                    ++r;
+                return r;
+            #endif
+        }
+
+        std::vector<uint64_t>  m_counts;
+        uint64_t               m_total;
+
+}; // class LatencyHistogram
+
+
+
+//----------------------------------------------------------------------------
+//! Результат по точке замера, слитый по всем потокам
+struct SiteReport
+{
+    std::string         name;
+    WelfordAccumulator  stats;      //!< Статистика длительностей, наносекунды
+    LatencyHistogram    histogram;  //!< Распределение длительностей, наносекунды
+};
+
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace details{
+
+//----------------------------------------------------------------------------
+//! Данные точки замера одного потока. Пишет только поток-владелец, читает построитель отчёта
+/*! Все поля атомарные, но владелец обновляет их парой load/store без RMW. Согласованность
+    статистики Уэлфорда при чтении обеспечивается счётчиком последовательности (как в seqlock).
+    Корзины гистограммы независимы и читаются без повторов.
+ */
+struct ThreadSiteData
+{
+    std::atomic<uint32_t>  seq;
+    std::atomic<uint64_t>  count;
+    std::atomic<double>    mean;
+    std::atomic<double>    m2;
+    std::atomic<double>    minV;
+    std::atomic<double>    maxV;
+    std::atomic<uint64_t>  buckets[LatencyHistogram::bucketCount];
+
+    ThreadSiteData() : seq(0), count(0), mean(0), m2(0), minV(0), maxV(0)
+    {
+        for(auto &b : buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+
+    void record( uint64_t ns )
+    {
+        std::size_t bucket = LatencyHistogram::getBucketIndex(ns);
+        buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        double   v  = (double)ns;
+        uint64_t n  = count.load(std::memory_order_relaxed) + 1;
+        double   mn = mean.load(std::memory_order_relaxed);
+        double   d  = v - mn;
+        mn += d / (double)n;
+
+        count.store(n, std::memory_order_relaxed);
+        mean .store(mn, std::memory_order_relaxed);
+        m2   .store(m2.load(std::memory_order_relaxed) + d*(v-mn), std::memory_order_relaxed);
+        if (n==1 || v<minV.load(std::memory_order_relaxed))
+            minV.store(v, std::memory_order_relaxed);
+        if (n==1 || v>maxV.load(std::memory_order_relaxed))
+            maxV.store(v, std::memory_order_relaxed);
+
+        seq.store(s+2, std::memory_order_release);
+    }
+
+    void mergeTo( WelfordAccumulator &stats, LatencyHistogram &hist ) const
+    {
+        for(;;)
+        {
+            uint32_t s1 = seq.load(std::memory_order_acquire);
+            if (s1&1u)
+                continue;
+
+            WelfordAccumulator w = WelfordAccumulator::fromState( count.load(std::memory_order_relaxed)
+                                                                , mean .load(std::memory_order_relaxed)
+                                                                , m2   .load(std::memory_order_relaxed)
+                                                                , minV .load(std::memory_order_relaxed)
+                                                                , maxV .load(std::memory_order_relaxed)
+                                                                );
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed)!=s1)
+                continue;
+
+            stats.merge(w);
+            break;
+        }
+
+        for(std::size_t i=0; i!=LatencyHistogram::bucketCount; ++i)
+        {
+            uint64_t c = buckets[i].load(std::memory_order_relaxed);
+            if (c)
+                hist.addToBucket(i, c);
+        }
+    }
+
+}; // struct ThreadSiteData
+
+struct ThreadData;
+
+//----------------------------------------------------------------------------
+//! Глобальный реестр точек замера и потоков
+struct Registry
+{
+    std::mutex                      mtx;
+    std::vector<std::string>        siteNames;
+    std::vector<ThreadData*>        threads;
+    std::vector<SiteReport>         retired;   //!< Данные завершившихся потоков
+
+    static Registry& get()
+    {
+        static Registry r;
+        return r;
+    }
+
+    std::size_t registerSite( const char *name )
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (siteNames.size()>=UMBA_PERF_COUNTERS_MAX_SITES)
+            return (std::size_t)-1;
+        siteNames.emplace_back(name ? name : "");
+        return siteNames.size()-1;
+    }
+
+    void registerThread( ThreadData *td )
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        threads.push_back(td);
+    }
+
+    void retireThread( ThreadData *td );
+
+}; // struct Registry
+
+//----------------------------------------------------------------------------
+//! Данные всех точек замера одного потока. Данные точки создаются при первом замере в ней
+struct ThreadData
+{
+    std::atomic<ThreadSiteData*>  sites[UMBA_PERF_COUNTERS_MAX_SITES];
+
+    ThreadData()
+    {
+        for(auto &s : sites)
+            s.store(0, std::memory_order_relaxed);
+        Registry::get().registerThread(this);
+    }
+
+    ~ThreadData()
+    {
+        Registry::get().retireThread(this);
+        for(auto &s : sites)
+            delete s.load(std::memory_order_relaxed);
+    }
+
+    ThreadSiteData* getSite( std::size_t id )
+    {
+        ThreadSiteData *p = sites[id].load(std::memory_order_relaxed);
+        if (!p)
+        {
+            p = new ThreadSiteData();
+            sites[id].store(p, std::memory_order_release);
+        }
+        return p;
+    }
+
+    static ThreadData& get()
+    {
+        static thread_local ThreadData td;
+        return td;
+    }
+
+}; // struct ThreadData
+
+//! Сливает данные потока в отчёт. Вызывается под Registry::mtx
+inline
+void mergeThreadData( const ThreadData *td, std::vector<SiteReport> &report )
+{
+    for(std::size_t i=0; i!=report.size(); ++i)
+    {
+        const ThreadSiteData *p = td->sites[i].load(std::memory_order_acquire);
+        if (p)
+            p->mergeTo(report[i].stats, report[i].histogram);
+    }
+}
+
+inline
+void Registry::retireThread( ThreadData *td )
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (retired.size()<siteNames.size())
+        retired.resize(siteNames.size());
+
+    mergeThreadData(td, retired);
+
+    threads.erase(std::remove(threads.begin(), threads.end(), td), threads.end());
+}
+
+} // namespace details
+//! @endcond
+
+
+
+//----------------------------------------------------------------------------
+//! Точка замера. Создаётся один раз (обычно - как статический объект) и регистрируется глобально
+class PerfSite
+{
+    public:
+
+        explicit PerfSite( const char *name ) : m_id(details::Registry::get().registerSite(name)) {}
+
+        //! Регистрирует длительность, заданную в тиках счётчика
+        void record( PerfTick ticks )
+        {
+            recordNanosec(convertToNanosec(ticks));
+        }
+
+        //! Регистрирует длительность в наносекундах
+        void recordNanosec( uint64_t ns )
+        {
+            if (m_id==(std::size_t)-1) // Превышено UMBA_PERF_COUNTERS_MAX_SITES
+                return;
+            details::ThreadData::get().getSite(m_id)->record(ns);
+        }
+
+        std::size_t getId() const { return m_id; }
+
+    protected:
+
+        std::size_t m_id;
+
+        UMBA_NON_COPYABLE_CLASS(PerfSite)
+
+}; // class PerfSite
+
+
+
+//----------------------------------------------------------------------------
+//! Замер времени жизни объекта
+class ScopedTimer
+{
+    public:
+
+        explicit ScopedTimer( PerfSite &site ) : m_site(site), m_start(queryCounter()) {}
+
+        ~ScopedTimer()
+        {
+            m_site.record(queryCounter() - m_start);
+        }
+
+    protected:
+
+        PerfSite  &m_site;
+        PerfTick   m_start;
+
+        UMBA_NON_COPYABLE_CLASS(ScopedTimer)
+
+}; // class ScopedTimer
+
+
+
+//----------------------------------------------------------------------------
+//! Собирает отчёт по всем точкам замера, сливая данные всех потоков, в том числе завершившихся
+inline
+std::vector<SiteReport> collectReport()
+{
+    details::Registry &r = details::Registry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+
+    std::vector<SiteReport> report(r.siteNames.size());
+    for(std::size_t i=0; i!=report.size(); ++i)
+    {
+        report[i].name = r.siteNames[i];
+        if (i<r.retired.size())
+        {
+            report[i].stats.merge(r.retired[i].stats);
+            report[i].histogram.merge(r.retired[i].histogram);
+        }
+    }
+
+    for(const auto *td : r.threads)
+        details::mergeThreadData(td, report);
+
+    return report;
+}
+
+//! Выводит отчёт в поток вывода в текстовом виде. Точки без замеров пропускаются
+template<typename StreamType>
+void printReport( StreamType &s, const std::vector<SiteReport> &report )
+{
+    for(const auto &r : report)
+    {
+        if (!r.stats.getCount())
+            continue;
+
+        // Перцентиль - верхняя граница корзины, она может превышать реальный максимум
+        const uint64_t maxV = (uint64_t)r.stats.getMax();
+
+        s << r.name << ": count " << r.stats.getCount()
+          << ", mean " << (uint64_t)r.stats.getMean() << " ns"
+          << ", stddev " << (uint64_t)r.stats.getStddev() << " ns"
+          << ", min " << (uint64_t)r.stats.getMin() << " ns"
+          << ", p50 " << std::min(r.histogram.getPercentile(50.0), maxV) << " ns"
+          << ", p99 " << std::min(r.histogram.getPercentile(99.0), maxV) << " ns"
+          << ", max " << maxV << " ns\n";
+    }
+}
+
+
+
 } // namespace perf_counters
 } // namespace umba
 
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+#define UMBA_PERF_COUNTERS_SCOPED_TIMER_IMPL2(siteName, lineNo)   static umba::perf_counters::PerfSite umba_perfSite_##lineNo(siteName); \
+                                                                  umba::perf_counters::ScopedTimer umba_perfScopedTimer_##lineNo(umba_perfSite_##lineNo)
+#define UMBA_PERF_COUNTERS_SCOPED_TIMER2(siteName, lineNo)        UMBA_PERF_COUNTERS_SCOPED_TIMER_IMPL2(siteName, lineNo)
+//! @endcond
+
+//! \def UMBA_PERF_COUNTERS_SCOPED_TIMER(siteName)
+//! Замер времени выполнения до конца текущего блока в точке замера с именем siteName
+#if defined(UMBA_PP_HAS_COUNTER)
+    #define UMBA_PERF_COUNTERS_SCOPED_TIMER(siteName)   UMBA_PERF_COUNTERS_SCOPED_TIMER2(siteName, __COUNTER__)
+#else
+    #define UMBA_PERF_COUNTERS_SCOPED_TIMER(siteName)   UMBA_PERF_COUNTERS_SCOPED_TIMER2(siteName, __LINE__)
+#endif
+
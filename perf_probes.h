@@ -0,0 +1,676 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Именованные точки инструментирования (пробы) для горячих путей библиотеки
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Проба считает количество срабатываний, обработанные байты и время выполнения (гистограмма и статистика
+    Уэлфорда из perf_counters). При включённой трассировке каждое срабатывание с замером времени
+    сохраняется как событие, которое можно выгрузить в формате Chrome trace-event и открыть
+    в chrome://tracing или https://ui.perfetto.dev.
+
+    Пробы компилируются, только если определён макрос UMBA_PERF_PROBES_ENABLE (и не определён
+    UMBA_NO_PERF_PROBES, для MCU пробы не компилируются никогда). Иначе макросы проб ничего не генерируют
+    (см. perf_probes_off.h) и сам заголовок ничего, кроме zz_detect_environment.h, не подключает.
+
+    В скомпилированном виде пробы по умолчанию выключены, и каждая проба стоит одной relaxed-загрузки
+    атомарного флага. Объекты проб инициализируются константно, регистрация происходит при первом
+    срабатывании во включённом состоянии. Пробы с одинаковым именем считаются одной пробой.
+
+    \code
+    umba::perf_probes::setEnabled(true);
+    umba::perf_probes::setTraceEnabled(true);
+
+    ... // работа утилиты
+
+    std::ofstream traceStream("trace.json");
+    umba::perf_probes::dumpChromeTrace(traceStream);
+    umba::perf_probes::dumpText(std::cerr);
+    \endcode
+
+    Инструментирование кода:
+
+    \code
+    {
+        UMBA_PERF_PROBE_SCOPE_VAR(probeScope, "umba::filesys::readFile");
+        ...
+        UMBA_PERF_PROBE_ADD_BYTES(probeScope, filedata.size());
+    }
+    \endcode
+ */
+
+#pragma once
+
+#include "zz_detect_environment.h"
+
+#if (defined(UMBA_MCU_USED) || !defined(UMBA_PERF_PROBES_ENABLE)) && !defined(UMBA_NO_PERF_PROBES)
+    #define UMBA_NO_PERF_PROBES
+#endif
+
+#if !defined(UMBA_NO_PERF_PROBES)
+
+#include "perf_counters.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+#if !defined(UMBA_PERF_PROBES_MAX_TRACE_EVENTS)
+    //! Максимальное количество событий трассировки на один поток. Дальнейшие события отбрасываются
+    #define UMBA_PERF_PROBES_MAX_TRACE_EVENTS   (1u<<20)
+#endif
+
+
+// umba::perf_probes::
+namespace umba{
+namespace perf_probes{
+
+
+
+typedef perf_counters::PerfTick  PerfTick; //!< Тик счётчика производительности
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace details{
+
+//! Флаги включения. Шаблон - чтобы определить статические члены в заголовке с константной инициализацией
+template<typename Dummy = void>
+struct Flags
+{
+    static std::atomic<bool>  enabled;
+    static std::atomic<bool>  traceEnabled;
+};
+
+template<typename Dummy> std::atomic<bool> Flags<Dummy>::enabled(false);
+template<typename Dummy> std::atomic<bool> Flags<Dummy>::traceEnabled(false);
+
+//----------------------------------------------------------------------------
+//! Зарегистрированная проба. Счётчики разнесены по кэш-линиям, поток пишет в свой шард
+struct ProbeEntry
+{
+    static const std::size_t numShards = 16;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> bytes;
+
+        Shard() : count(0), bytes(0) {}
+    };
+
+    std::string  name;
+    std::size_t  siteId;   //!< Идентификатор точки замера perf_counters
+    Shard        shards[numShards];
+
+    void add( std::size_t shardIdx, uint64_t bytes )
+    {
+        Shard &s = shards[shardIdx & (numShards-1)];
+        s.count.fetch_add(1, std::memory_order_relaxed);
+        if (bytes)
+            s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    uint64_t getCount() const
+    {
+        uint64_t res = 0;
+        for(const auto &s : shards)
+            res += s.count.load(std::memory_order_relaxed);
+        return res;
+    }
+
+    uint64_t getBytes() const
+    {
+        uint64_t res = 0;
+        for(const auto &s : shards)
+            res += s.bytes.load(std::memory_order_relaxed);
+        return res;
+    }
+
+}; // struct ProbeEntry
+
+//----------------------------------------------------------------------------
+struct TraceEvent
+{
+    const ProbeEntry  *pProbe;
+    PerfTick           startTick;
+    PerfTick           endTick;
+    uint64_t           bytes;
+};
+
+//----------------------------------------------------------------------------
+//! Буфер событий трассировки одного потока
+/*! Пишет только поток-владелец; событие публикуется release-записью размера блока,
+    поэтому выгрузка может идти параллельно с записью. Блоки не перемещаются и не освобождаются
+    до уничтожения буфера.
+ */
+struct TraceBuffer
+{
+    static const std::size_t chunkSize = 4096;
+
+    struct Chunk
+    {
+        TraceEvent                 events[chunkSize];
+        std::atomic<std::size_t>   size;
+        std::atomic<Chunk*>        next;
+
+        Chunk() : size(0), next(0) {}
+    };
+
+    uint32_t               threadNo;
+    Chunk                  first;
+    Chunk                 *pLast;
+    std::size_t            totalEvents;
+    std::atomic<uint64_t>  dropped;
+
+    explicit TraceBuffer( uint32_t tn ) : threadNo(tn), pLast(&first), totalEvents(0), dropped(0) {}
+
+    ~TraceBuffer()
+    {
+        Chunk *p = first.next.load(std::memory_order_relaxed);
+        while(p)
+        {
+            Chunk *pNext = p->next.load(std::memory_order_relaxed);
+            delete p;
+            p = pNext;
+        }
+    }
+
+    void push( const TraceEvent &e )
+    {
+        if (totalEvents>=UMBA_PERF_PROBES_MAX_TRACE_EVENTS)
+        {
+            dropped.store(dropped.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+            return;
+        }
+
+        std::size_t sz = pLast->size.load(std::memory_order_relaxed);
+        if (sz==chunkSize)
+        {
+            Chunk *pNew = new Chunk();
+            pLast->next.store(pNew, std::memory_order_release);
+            pLast = pNew;
+            sz    = 0;
+        }
+
+        pLast->events[sz] = e;
+        pLast->size.store(sz+1, std::memory_order_release);
+        ++totalEvents;
+    }
+
+    template<typename Handler>
+    void forEach( Handler handler ) const
+    {
+        for(const Chunk *p = &first; p; p = p->next.load(std::memory_order_acquire))
+        {
+            std::size_t sz = p->size.load(std::memory_order_acquire);
+            for(std::size_t i=0; i!=sz; ++i)
+                handler(p->events[i]);
+        }
+    }
+
+}; // struct TraceBuffer
+
+//----------------------------------------------------------------------------
+struct Registry
+{
+    std::mutex                                  mtx;
+    std::vector< std::unique_ptr<ProbeEntry> >  probes;
+    std::vector< std::shared_ptr<TraceBuffer> > traceBuffers; //!< Буферы живут и после завершения потока
+    uint32_t                                    threadCounter;
+
+    Registry() : threadCounter(0) {}
+
+    static Registry& get()
+    {
+        static Registry r;
+        return r;
+    }
+
+    ProbeEntry* findOrAddProbe( const char *name )
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for(const auto &p : probes)
+        {
+            if (p->name==name)
+                return p.get();
+        }
+
+        std::unique_ptr<ProbeEntry> pEntry(new ProbeEntry());
+        pEntry->name   = name;
+        pEntry->siteId = perf_counters::details::Registry::get().registerSite(name);
+        probes.emplace_back(std::move(pEntry));
+        return probes.back().get();
+    }
+
+    uint32_t newThreadNo()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return ++threadCounter;
+    }
+
+    std::shared_ptr<TraceBuffer> newTraceBuffer( uint32_t threadNo )
+    {
+        std::shared_ptr<TraceBuffer> p = std::make_shared<TraceBuffer>(threadNo);
+        std::lock_guard<std::mutex> lock(mtx);
+        traceBuffers.push_back(p);
+        return p;
+    }
+
+}; // struct Registry
+
+//----------------------------------------------------------------------------
+//! Данные текущего потока
+struct ThreadInfo
+{
+    uint32_t                      threadNo;
+    std::shared_ptr<TraceBuffer>  pTraceBuffer;
+
+    ThreadInfo() : threadNo(Registry::get().newThreadNo()) {}
+
+    static ThreadInfo& get()
+    {
+        static thread_local ThreadInfo ti;
+        return ti;
+    }
+
+    TraceBuffer& getTraceBuffer()
+    {
+        if (!pTraceBuffer)
+            pTraceBuffer = Registry::get().newTraceBuffer(threadNo);
+        return *pTraceBuffer;
+    }
+
+}; // struct ThreadInfo
+
+} // namespace details
+//! @endcond
+
+
+
+//----------------------------------------------------------------------------
+//! Включает/выключает сбор статистики проб
+inline void setEnabled( bool bEnable )       { details::Flags<>::enabled.store(bEnable, std::memory_order_relaxed); }
+
+//! Включен ли сбор статистики проб
+inline bool isEnabled()                      { return details::Flags<>::enabled.load(std::memory_order_relaxed); }
+
+//! Включает/выключает запись событий трассировки. Работает только при включенном сборе статистики
+inline void setTraceEnabled( bool bEnable )  { details::Flags<>::traceEnabled.store(bEnable, std::memory_order_relaxed); }
+
+//! Включена ли запись событий трассировки
+inline bool isTraceEnabled()                 { return details::Flags<>::traceEnabled.load(std::memory_order_relaxed); }
+
+
+
+//----------------------------------------------------------------------------
+//! Проба. Объявляется как статический объект, инициализируется константно
+class Probe
+{
+    public:
+
+        constexpr explicit Probe( const char *name ) : m_name(name), m_pEntry(nullptr) {}
+
+        const char* getName() const { return m_name; }
+
+        //! Регистрирует срабатывание без замера времени
+        void hit( uint64_t bytes = 0 )
+        {
+            if (!isEnabled())
+                return;
+            getEntry()->add(details::ThreadInfo::get().threadNo, bytes);
+        }
+
+        //! @cond Doxygen_Suppress_Not_Documented
+        details::ProbeEntry* getEntry()
+        {
+            details::ProbeEntry *p = m_pEntry.load(std::memory_order_acquire);
+            if (!p)
+            {
+                p = details::Registry::get().findOrAddProbe(m_name);
+                m_pEntry.store(p, std::memory_order_release);
+            }
+            return p;
+        }
+        //! @endcond
+
+    protected:
+
+        const char                           *m_name;
+        std::atomic<details::ProbeEntry*>     m_pEntry;
+
+}; // class Probe
+
+
+
+//----------------------------------------------------------------------------
+//! Замер срабатывания пробы от создания объекта до конца блока
+class ProbeScope
+{
+    public:
+
+        explicit ProbeScope( Probe &probe, uint64_t bytes = 0 )
+        : m_probe(probe)
+        , m_bytes(bytes)
+        , m_active(isEnabled())
+        , m_start(m_active ? perf_counters::queryCounter() : 0)
+        {}
+
+        //! Добавляет обработанные байты - если их количество становится известно только по ходу работы
+        void addBytes( uint64_t bytes )
+        {
+            m_bytes += bytes;
+        }
+
+        ~ProbeScope()
+        {
+            if (!m_active)
+                return;
+
+            PerfTick end = perf_counters::queryCounter();
+
+            details::ThreadInfo &ti     = details::ThreadInfo::get();
+            details::ProbeEntry *pEntry = m_probe.getEntry();
+
+            pEntry->add(ti.threadNo, m_bytes);
+            if (pEntry->siteId!=(std::size_t)-1) // Превышено UMBA_PERF_COUNTERS_MAX_SITES
+                perf_counters::details::ThreadData::get().getSite(pEntry->siteId)->record(perf_counters::convertToNanosec(end-m_start));
+
+            if (isTraceEnabled())
+            {
+                details::TraceEvent e;
+                e.pProbe    = pEntry;
+                e.startTick = m_start;
+                e.endTick   = end;
+                e.bytes     = m_bytes;
+                ti.getTraceBuffer().push(e);
+            }
+        }
+
+    protected:
+
+        Probe     &m_probe;
+        uint64_t   m_bytes;
+        bool       m_active;
+        PerfTick   m_start;
+
+        UMBA_NON_COPYABLE_CLASS(ProbeScope)
+
+}; // class ProbeScope
+
+
+
+//----------------------------------------------------------------------------
+//! Результат по пробе
+struct ProbeReport
+{
+    std::string                       name;
+    uint64_t                          count = 0;  //!< Количество срабатываний, включая срабатывания без замера времени
+    uint64_t                          bytes = 0;  //!< Обработано байт
+    perf_counters::WelfordAccumulator stats;      //!< Статистика длительностей, наносекунды
+    perf_counters::LatencyHistogram   histogram;  //!< Распределение длительностей, наносекунды
+};
+
+//! Собирает отчёт по всем зарегистрированным пробам
+inline
+std::vector<ProbeReport> collectReport()
+{
+    std::vector<perf_counters::SiteReport> sites = perf_counters::collectReport();
+
+    details::Registry &r = details::Registry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+
+    std::vector<ProbeReport> res;
+    res.reserve(r.probes.size());
+
+    for(const auto &p : r.probes)
+    {
+        ProbeReport pr;
+        pr.name  = p->name;
+        pr.count = p->getCount();
+        pr.bytes = p->getBytes();
+        if (p->siteId<sites.size())
+        {
+            pr.stats     = sites[p->siteId].stats;
+            pr.histogram = sites[p->siteId].histogram;
+        }
+        res.emplace_back(std::move(pr));
+    }
+
+    return res;
+}
+
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace details{
+
+template<typename StreamType>
+void writeJsonString( StreamType &s, const std::string &str )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    s << '"';
+    for(char ch : str)
+    {
+        switch(ch)
+        {
+            case '"' : s << "\\\""; break;
+            case '\\': s << "\\\\"; break;
+            case '\n': s << "\\n";  break;
+            case '\r': s << "\\r";  break;
+            case '\t': s << "\\t";  break;
+            default:
+                if ((unsigned char)ch<0x20)
+                    s << "\\u00" << hexDigits[((unsigned char)ch)>>4] << hexDigits[((unsigned char)ch)&0xF];
+                else
+                    s << ch;
+        }
+    }
+    s << '"';
+}
+
+//! Выводит наносекунды как микросекунды с тремя знаками после точки - формат времени trace-event
+template<typename StreamType>
+void writeMicrosec( StreamType &s, uint64_t ns )
+{
+    uint64_t frac = ns % 1000;
+    s << (ns/1000) << '.' << (char)('0' + frac/100) << (char)('0' + (frac/10)%10) << (char)('0' + frac%10);
+}
+
+inline
+uint64_t percentileClamped( const ProbeReport &r, double p )
+{
+    uint64_t v    = r.histogram.getPercentile(p);
+    uint64_t maxV = (uint64_t)r.stats.getMax();
+    return v<maxV ? v : maxV;
+}
+
+} // namespace details
+//! @endcond
+
+
+
+//----------------------------------------------------------------------------
+//! Выводит отчёт по пробам в текстовом виде
+template<typename StreamType>
+void dumpText( StreamType &s )
+{
+    for(const auto &r : collectReport())
+    {
+        if (!r.count)
+            continue;
+
+        const uint64_t totalNs = (uint64_t)(r.stats.getMean() * (double)r.stats.getCount());
+
+        s << r.name << ": count " << r.count;
+        if (r.bytes)
+            s << ", bytes " << r.bytes;
+
+        if (r.stats.getCount())
+        {
+            s << ", total " << totalNs/1000 << " us"
+              << ", mean " << (uint64_t)r.stats.getMean() << " ns"
+              << ", p50 "  << details::percentileClamped(r, 50.0) << " ns"
+              << ", p99 "  << details::percentileClamped(r, 99.0) << " ns"
+              << ", max "  << (uint64_t)r.stats.getMax() << " ns";
+
+            if (r.bytes && totalNs)
+                s << ", " << (r.bytes*1000/totalNs) << " MB/s";
+        }
+
+        s << "\n";
+    }
+}
+
+//! Выводит отчёт по пробам в формате JSON
+template<typename StreamType>
+void dumpJson( StreamType &s )
+{
+    s << "{\"probes\":[";
+
+    bool first = true;
+    for(const auto &r : collectReport())
+    {
+        if (!first)
+            s << ",";
+        first = false;
+
+        s << "\n{\"name\":";
+        details::writeJsonString(s, r.name);
+        s << ",\"count\":"      << r.count
+          << ",\"bytes\":"      << r.bytes
+          << ",\"timedCount\":" << r.stats.getCount()
+          << ",\"totalNs\":"    << (uint64_t)(r.stats.getMean() * (double)r.stats.getCount())
+          << ",\"meanNs\":"     << (uint64_t)r.stats.getMean()
+          << ",\"stddevNs\":"   << (uint64_t)r.stats.getStddev()
+          << ",\"minNs\":"      << (uint64_t)r.stats.getMin()
+          << ",\"maxNs\":"      << (uint64_t)r.stats.getMax()
+          << ",\"p50Ns\":"      << details::percentileClamped(r, 50.0)
+          << ",\"p90Ns\":"      << details::percentileClamped(r, 90.0)
+          << ",\"p99Ns\":"      << details::percentileClamped(r, 99.0)
+          << "}";
+    }
+
+    s << "\n]}\n";
+}
+
+//! Выводит записанные события трассировки в формате Chrome trace-event (JSON Object Format, события "X")
+template<typename StreamType>
+void dumpChromeTrace( StreamType &s )
+{
+    details::Registry &r = details::Registry::get();
+
+    std::vector< std::shared_ptr<details::TraceBuffer> > buffers;
+    {
+        std::lock_guard<std::mutex> lock(r.mtx);
+        buffers = r.traceBuffers;
+    }
+
+    // Отсчитываем время от самого раннего события
+    PerfTick baseTick = 0;
+    bool     hasBase  = false;
+    for(const auto &pBuf : buffers)
+    {
+        pBuf->forEach( [&]( const details::TraceEvent &e )
+                       {
+                           if (!hasBase || e.startTick<baseTick)
+                           {
+                               baseTick = e.startTick;
+                               hasBase  = true;
+                           }
+                       }
+                     );
+    }
+
+    s << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    for(const auto &pBuf : buffers)
+    {
+        pBuf->forEach( [&]( const details::TraceEvent &e )
+                       {
+                           if (!first)
+                               s << ",";
+                           first = false;
+
+                           s << "\n{\"name\":";
+                           details::writeJsonString(s, e.pProbe->name);
+                           s << ",\"cat\":\"umba\",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuf->threadNo << ",\"ts\":";
+                           details::writeMicrosec(s, perf_counters::convertToNanosec(e.startTick-baseTick));
+                           s << ",\"dur\":";
+                           details::writeMicrosec(s, perf_counters::convertToNanosec(e.endTick-e.startTick));
+                           if (e.bytes)
+                               s << ",\"args\":{\"bytes\":" << e.bytes << "}";
+                           s << "}";
+                       }
+                     );
+
+        uint64_t dropped = pBuf->dropped.load(std::memory_order_relaxed);
+        if (dropped)
+        {
+            if (!first)
+                s << ",";
+            first = false;
+            s << "\n{\"name\":\"dropped events\",\"ph\":\"C\",\"pid\":1,\"tid\":" << pBuf->threadNo << ",\"ts\":0,\"args\":{\"dropped\":" << dropped << "}}";
+        }
+    }
+
+    s << "\n]}\n";
+}
+
+
+
+} // namespace perf_probes
+} // namespace umba
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+#define UMBA_PERF_PROBE_SCOPE_VAR_IMPL2(varName, probeName, bytes, lineNo)  static umba::perf_probes::Probe umba_perfProbe_##lineNo(probeName); \
+                                                                            umba::perf_probes::ProbeScope varName(umba_perfProbe_##lineNo, bytes)
+#define UMBA_PERF_PROBE_SCOPE_VAR2(varName, probeName, bytes, lineNo)       UMBA_PERF_PROBE_SCOPE_VAR_IMPL2(varName, probeName, bytes, lineNo)
+#define UMBA_PERF_PROBE_SCOPE_IMPL2(probeName, bytes, lineNo)               UMBA_PERF_PROBE_SCOPE_VAR_IMPL2(umba_perfProbeScope_##lineNo, probeName, bytes, lineNo)
+#define UMBA_PERF_PROBE_SCOPE2(probeName, bytes, lineNo)                    UMBA_PERF_PROBE_SCOPE_IMPL2(probeName, bytes, lineNo)
+//! @endcond
+
+#if defined(UMBA_PP_HAS_COUNTER)
+    #define UMBA_PERF_PROBE_SCOPE_BYTES(probeName, bytes)          UMBA_PERF_PROBE_SCOPE2(probeName, bytes, __COUNTER__)
+    #define UMBA_PERF_PROBE_SCOPE_VAR(varName, probeName)          UMBA_PERF_PROBE_SCOPE_VAR2(varName, probeName, 0, __COUNTER__)
+#else
+    #define UMBA_PERF_PROBE_SCOPE_BYTES(probeName, bytes)          UMBA_PERF_PROBE_SCOPE2(probeName, bytes, __LINE__)
+    #define UMBA_PERF_PROBE_SCOPE_VAR(varName, probeName)          UMBA_PERF_PROBE_SCOPE_VAR2(varName, probeName, 0, __LINE__)
+#endif
+
+#define UMBA_PERF_PROBE_SCOPE(probeName)                           UMBA_PERF_PROBE_SCOPE_BYTES(probeName, 0)
+#define UMBA_PERF_PROBE_ADD_BYTES(varName, bytes)                  varName.addBytes(bytes)
+#define UMBA_PERF_PROBE_HIT(probeName, bytes)                      do { static umba::perf_probes::Probe umba_perfProbe(probeName); umba_perfProbe.hit(bytes); } while(0)
+
+
+#else // UMBA_NO_PERF_PROBES
+
+
+#include "perf_probes_off.h"
+
+
+#endif // UMBA_NO_PERF_PROBES
+
+
+//! \def UMBA_PERF_PROBE_SCOPE(probeName)
+//! Замер времени выполнения до конца текущего блока в пробе с именем probeName
+
+//! \def UMBA_PERF_PROBE_SCOPE_BYTES(probeName, bytes)
+//! Замер времени выполнения до конца текущего блока в пробе с именем probeName с указанием количества обработанных байт
+
+//! \def UMBA_PERF_PROBE_SCOPE_VAR(varName, probeName)
+//! Замер времени выполнения до конца текущего блока, объект замера доступен под именем varName для UMBA_PERF_PROBE_ADD_BYTES
+
+//! \def UMBA_PERF_PROBE_ADD_BYTES(varName, bytes)
+//! Добавляет количество обработанных байт в замер, объявленный UMBA_PERF_PROBE_SCOPE_VAR
+
+//! \def UMBA_PERF_PROBE_HIT(probeName, bytes)
+//! Регистрирует срабатывание пробы без замера времени
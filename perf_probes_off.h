@@ -0,0 +1,19 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Пустые макросы проб производительности - для сборок без UMBA_PERF_PROBES_ENABLE
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Заголовки библиотеки подключают perf_probes.h только при определённом UMBA_PERF_PROBES_ENABLE,
+    иначе - этот заголовок, и пробы в них ничего не генерируют.
+ */
+
+#pragma once
+
+#define UMBA_PERF_PROBE_SCOPE(probeName)
+#define UMBA_PERF_PROBE_SCOPE_BYTES(probeName, bytes)
+#define UMBA_PERF_PROBE_SCOPE_VAR(varName, probeName)
+#define UMBA_PERF_PROBE_ADD_BYTES(varName, bytes)                  do {} while(0)
+#define UMBA_PERF_PROBE_HIT(probeName, bytes)                      do {} while(0)
+
@@ -10,13 +10,19 @@
 
 #include "string_plus.h"
 
+#include <cstddef>
 #include <exception>
+#include <functional>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <regex>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 //----------------------------------------------------------------------------
@@ -183,15 +189,9 @@ bool regexMatch(const StringType &text, const std::basic_regex<typename StringTy
 
 //! Просто завернули std::regex_match в try/catch, версия для строки
 template< typename CharType > inline
-#if defined(__GNUC__)
-bool regexMatch( std::basic_string<CharType> text, const std::basic_regex<CharType> &r
-               , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
-               )
-#else
 bool regexMatch( const std::basic_string<CharType> &text, const std::basic_regex<CharType> &r
                , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
                )
-#endif
 {
     try
     {
@@ -218,15 +218,9 @@ bool regexMatch( const std::basic_string<CharType> &text, const std::basic_regex
 //----------------------------------------------------------------------------
 //! Просто завернули std::regex_match в try/catch, версия для вектора CharType'ов
 template< typename CharType > inline
-#if defined(__GNUC__)
-bool regexMatch( std::vector<CharType> text, const std::basic_regex<CharType> &r
-               , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
-               )
-#else
 bool regexMatch( const std::vector<CharType> &text, const std::basic_regex<CharType> &r
                , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
                )
-#endif
 {
     try
     {
@@ -251,43 +245,255 @@ bool regexMatch( const std::vector<CharType> &text, const std::basic_regex<CharT
 }
 
 
+//----------------------------------------------------------------------------
+//! Кеш скомпилированных регулярок
+/*! Конструирование std::basic_regex - очень дорогая операция, а regexMatch со строкой-выражением
+    делали это на каждый вызов. Кеш хранит скомпилированные регулярки по ключу (выражение, флаги синтаксиса),
+    потокобезопасен, ограничен по размеру - при переполнении выкидывается давно не использовавшаяся регулярка (LRU).
+
+    Некорректные выражения тоже кешируются, чтобы не пытаться компилировать их повторно.
+
+    Общий для процесса кеш возвращает getRegexCache.
+ */
+template< typename CharType >
+class RegexCache
+{
+
+public:
+
+    typedef std::basic_string<CharType>                   StringType;
+    typedef std::basic_regex<CharType>                    RegexType;
+    typedef std::shared_ptr<const RegexType>              RegexPtr;
+    typedef std::regex_constants::syntax_option_type      SyntaxFlags;
+
+    static const std::size_t defaultMaxSize = 256; //!< Размер кеша по умолчанию
+
+    explicit RegexCache( std::size_t maxSize = defaultMaxSize ) : m_maxSize(maxSize ? maxSize : 1) {}
+
+    //! Возвращает скомпилированную регулярку, или пустой указатель для некорректного выражения
+    /*! Если задан pErr, то в него возвращается код ошибки компиляции
+     */
+    RegexPtr find( const StringType &r, SyntaxFlags syntaxFlags = std::regex_constants::ECMAScript, std::regex_constants::error_type *pErr = 0 )
+    {
+        Key key(r, syntaxFlags);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_map.find(key);
+            if (it!=m_map.end())
+            {
+                ++m_hits;
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                if (pErr)
+                    *pErr = it->second->err;
+                return it->second->pRegex;
+            }
+            ++m_misses;
+        }
+
+        // Компилируем без блокировки - это долго
+        Entry e;
+        e.key = key;
+        try
+        {
+            e.pRegex = std::make_shared<RegexType>(r, syntaxFlags);
+        }
+        catch(const std::regex_error &err)
+        {
+            e.err = err.code();
+        }
+
+        if (pErr)
+            *pErr = e.err;
+
+        RegexPtr res = e.pRegex;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_map.find(key)==m_map.end()) // Могли добавить из другого потока, пока компилировали
+        {
+            m_lru.push_front(e);
+            m_map.emplace(key, m_lru.begin());
+
+            while(m_lru.size()>m_maxSize)
+            {
+                m_map.erase(m_lru.back().key);
+                m_lru.pop_back();
+                ++m_evictions;
+            }
+        }
+
+        return res;
+    }
+
+    //! Возвращает скомпилированную регулярку, бросает std::regex_error для некорректного выражения, как и конструктор std::basic_regex
+    RegexPtr get( const StringType &r, SyntaxFlags syntaxFlags = std::regex_constants::ECMAScript )
+    {
+        std::regex_constants::error_type err = std::regex_constants::error_type();
+        RegexPtr res = find(r, syntaxFlags, &err);
+        if (!res)
+            throw std::regex_error(err);
+        return res;
+    }
+
+    //! Очистка кеша, счётчики также сбрасываются
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.clear();
+        m_lru.clear();
+        m_hits = m_misses = m_evictions = 0;
+    }
+
+    //! Задаёт максимальный размер кеша
+    void setMaxSize( std::size_t maxSize )
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxSize = maxSize ? maxSize : 1;
+        while(m_lru.size()>m_maxSize)
+        {
+            m_map.erase(m_lru.back().key);
+            m_lru.pop_back();
+            ++m_evictions;
+        }
+    }
+
+    std::size_t size()         const { std::lock_guard<std::mutex> lock(m_mutex); return m_lru.size(); }  //!< Количество регулярок в кеше
+    std::size_t getHits()      const { std::lock_guard<std::mutex> lock(m_mutex); return m_hits;      }  //!< Количество попаданий
+    std::size_t getMisses()    const { std::lock_guard<std::mutex> lock(m_mutex); return m_misses;    }  //!< Количество промахов
+    std::size_t getEvictions() const { std::lock_guard<std::mutex> lock(m_mutex); return m_evictions; }  //!< Количество вытеснений
+
+
+protected:
+
+    typedef std::pair<StringType, SyntaxFlags> Key;
+
+    struct KeyHash
+    {
+        std::size_t operator()( const Key &k ) const
+        {
+            return std::hash<StringType>()(k.first) ^ ((std::size_t)k.second * 0x9E3779B9u);
+        }
+    };
+
+    struct Entry
+    {
+        Key                                 key;
+        RegexPtr                            pRegex;
+        std::regex_constants::error_type    err = std::regex_constants::error_type();
+    };
+
+    typedef std::list<Entry>  EntryList;
+
+    mutable std::mutex                                                      m_mutex;
+    std::size_t                                                             m_maxSize;
+    EntryList                                                               m_lru;
+    std::unordered_map<Key, typename EntryList::iterator, KeyHash>          m_map;
+    std::size_t                                                             m_hits      = 0;
+    std::size_t                                                             m_misses    = 0;
+    std::size_t                                                             m_evictions = 0;
+
+}; // class RegexCache
+
+//----------------------------------------------------------------------------
+//! Общий для процесса кеш регулярок
+template< typename CharType > inline
+RegexCache<CharType>& getRegexCache()
+{
+    static RegexCache<CharType> cache;
+    return cache;
+}
+
+//----------------------------------------------------------------------------
+//! Максимальный размер кеша регулярок потока, см. findThreadCachedRegex
+#if !defined(UMBA_REGEX_THREAD_CACHE_MAX_SIZE)
+    #define UMBA_REGEX_THREAD_CACHE_MAX_SIZE 64
+#endif
+
+//----------------------------------------------------------------------------
+//! Возвращает скомпилированную регулярку (ECMAScript) из кеша текущего потока, или пустой указатель для некорректного выражения
+/*! Кеш потока стоит перед общим кешем getRegexCache, при попадании мьютекс общего кеша не захватывается.
+    При промахе регулярка берётся из общего кеша. При переполнении кеш потока очищается целиком.
+
+    Очистка общего кеша (RegexCache::clear) на кеши потоков не влияет, попадания в кеш потока
+    в статистике общего кеша не учитываются.
+ */
+template< typename CharType > inline
+typename RegexCache<CharType>::RegexPtr findThreadCachedRegex( const std::basic_string<CharType> &r, std::regex_constants::error_type *pErr = 0 )
+{
+    struct Entry
+    {
+        typename RegexCache<CharType>::RegexPtr  pRegex;
+        std::regex_constants::error_type         err = std::regex_constants::error_type();
+    };
+
+    static thread_local std::unordered_map<std::basic_string<CharType>, Entry> cache;
+
+    auto it = cache.find(r);
+    if (it==cache.end())
+    {
+        Entry e;
+        e.pRegex = getRegexCache<CharType>().find(r, std::regex_constants::ECMAScript, &e.err);
+
+        if (cache.size()>=UMBA_REGEX_THREAD_CACHE_MAX_SIZE)
+            cache.clear();
+
+        it = cache.emplace(r, std::move(e)).first;
+    }
+
+    if (pErr)
+        *pErr = it->second.err;
+
+    return it->second.pRegex;
+}
+
+//----------------------------------------------------------------------------
+//! Возвращает скомпилированную регулярку (ECMAScript) из кеша текущего потока, бросает std::regex_error для некорректного выражения
+template< typename CharType > inline
+typename RegexCache<CharType>::RegexPtr getThreadCachedRegex( const std::basic_string<CharType> &r )
+{
+    std::regex_constants::error_type err = std::regex_constants::error_type();
+    auto pRegex = findThreadCachedRegex(r, &err);
+    if (!pRegex)
+        throw std::regex_error(err);
+    return pRegex;
+}
+
 //----------------------------------------------------------------------------
 //! На входе вместо regex строка с regex-выражением, версия для строки
+/*! Регулярка берётся из кеша потока (findThreadCachedRegex). Для некорректного выражения бросается std::regex_error
+ */
 template< typename CharType > inline
 bool regexMatch( const std::basic_string<CharType>     &text
                , const std::basic_string<CharType>     &r
                , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
                )
 {
-    // Чота если задать флаги в GCC не компилится, не стал пока разбираться
-    #if defined(__GNUC__)
-
-        return regexMatch(text, std::basic_regex<CharType>(r /* , (std::regex_constants::match_flag_type)(flags | std::regex_constants::optimize) */ ));
-
-    #else
-
-        return regexMatch(text, std::basic_regex<CharType>(r /* , flags */ ));
-
-    #endif
+    return regexMatch(text, *getThreadCachedRegex(r), flags);
 }
 
 //----------------------------------------------------------------------------
 //! На входе вместо regex строка с regex-выражением, версия для вектора CharType'ов
+/*! Регулярка берётся из кеша потока (findThreadCachedRegex). Для некорректного выражения бросается std::regex_error
+ */
 template< typename CharType > inline
 bool regexMatch( const std::vector<CharType>           &text
                , const std::basic_string<CharType>     &r
                , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
                )
 {
-    #if defined(__GNUC__)
-
-        return regexMatch(text, std::basic_regex<CharType>(r /* , (std::regex_constants::match_flag_type)(flags | std::regex_constants::optimize) */ ));
-
-    #else
-
-        return regexMatch(text, std::basic_regex<CharType>(r /* , flags */ ));
+    return regexMatch(text, *getThreadCachedRegex(r), flags);
+}
 
-    #endif
+//----------------------------------------------------------------------------
+//! Не бросающая исключений версия regexMatch со строкой-выражением - для некорректного выражения возвращает false
+template< typename CharType > inline
+bool regexMatchNoThrow( const std::basic_string<CharType>     &text
+                      , const std::basic_string<CharType>     &r
+                      , std::regex_constants::match_flag_type flags = std::regex_constants::match_default
+                      )
+{
+    auto pRegex = findThreadCachedRegex(r);
+    return pRegex ? regexMatch(text, *pRegex, flags) : false;
 }
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,396 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Блокировки для данных, которые в основном читаются: RW-блокировка, seqlock и шардированная блокировка
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Для захвата в эксклюзивном режиме используется umba::AutoLock, для захвата в разделяемом режиме (на чтение)
+    - umba::SharedAutoLock.
+
+    \code
+    umba::RwLock  cacheLock;
+
+    {
+        umba::SharedAutoLock<umba::RwLock> lock(cacheLock);
+        // читаем
+    }
+
+    {
+        umba::AutoLock<umba::RwLock> lock(cacheLock);
+        // модифицируем
+    }
+    \endcode
+ */
+
+#pragma once
+
+//
+#include "zz_detect_environment.h"
+//
+#include "autolock.h"
+#include "preprocessor.h"
+//
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    #include <immintrin.h>
+#endif
+
+
+namespace umba{
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace details{
+
+//! Подсказка процессору, что мы в цикле активного ожидания
+inline void lockCpuRelax()
+{
+    #if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _mm_pause();
+    #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_ia32_pause();
+    #elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+        __asm__ __volatile__("yield");
+    #else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    #endif
+}
+
+} // namespace details
+//! @endcond
+
+
+
+//---------------------------------------------------------
+//! RW-блокировка с приоритетом писателя
+/*! Читатели захватывают блокировку одной CAS-операцией над общим словом состояния и не сериализуются между собой.
+    Если есть ожидающий писатель, новые читатели не допускаются - писатель не может "голодать" при постоянном потоке чтений.
+
+    Перед засыпанием выполняется короткое активное ожидание. Засыпание - на условной переменной,
+    к которой освобождающий поток обращается, только если кто-то действительно спит.
+
+    Рекурсивный захват не поддерживается.
+ */
+class RwLock
+{
+        template<typename LockObject> friend class AutoLock;
+        template<typename LockObject> friend class SharedAutoLock;
+        template<typename LockObject, std::size_t NumShards> friend class ShardedLock;
+
+    public:
+
+        static const int maxSpinCount = 64; //!< Количество итераций активного ожидания перед засыпанием
+
+        RwLock() : m_state(0), m_writersWaiting(0), m_sleepers(0) {}
+
+        UMBA_NON_COPYABLE_CLASS(RwLock)
+
+    private:
+
+        static const std::uint32_t writerFlag = 0x80000000u;
+
+        bool canLockShared() const
+        {
+            return (m_state.load(std::memory_order_relaxed) & writerFlag)==0 && m_writersWaiting.load(std::memory_order_relaxed)==0;
+        }
+
+        bool tryLockSharedImpl()
+        {
+            std::uint32_t s = m_state.load(std::memory_order_relaxed);
+            while((s & writerFlag)==0 && m_writersWaiting.load(std::memory_order_relaxed)==0)
+            {
+                if (m_state.compare_exchange_weak(s, s+1, std::memory_order_acquire, std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        bool tryLockImpl()
+        {
+            std::uint32_t expected = 0;
+            return m_state.compare_exchange_strong(expected, writerFlag, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        //! Ждёт, пока pred не станет true - сначала активно, потом на условной переменной
+        template<typename Pred, typename TryLock>
+        void acquire( Pred pred, TryLock tryLock )
+        {
+            for(int i=0; i!=maxSpinCount; ++i)
+            {
+                if (pred() && tryLock())
+                    return;
+                details::lockCpuRelax();
+            }
+
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lk(m_mutex);
+                    // seq_cst инкремент m_sleepers и последующая проверка состояния в паре с seq_cst
+                    // изменением состояния и проверкой m_sleepers в wakeSleepers исключают потерю пробуждения
+                    m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    while(!pred())
+                        m_cond.wait(lk);
+                    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                if (tryLock())
+                    return;
+            }
+        }
+
+        void wakeSleepers()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleepers.load(std::memory_order_seq_cst)==0)
+                return;
+
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_cond.notify_all();
+        }
+
+        void lockShared()
+        {
+            if (tryLockSharedImpl())
+                return;
+            acquire( [this]() { return canLockShared(); }, [this]() { return tryLockSharedImpl(); } );
+        }
+
+        void unlockShared()
+        {
+            // Последний читатель будит ожидающего писателя
+            if (m_state.fetch_sub(1, std::memory_order_release)==1)
+                wakeSleepers();
+        }
+
+        void lock()
+        {
+            if (tryLockImpl())
+                return;
+
+            m_writersWaiting.fetch_add(1, std::memory_order_seq_cst);
+            acquire( [this]() { return m_state.load(std::memory_order_relaxed)==0; }, [this]() { return tryLockImpl(); } );
+            m_writersWaiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void unlock()
+        {
+            m_state.store(0, std::memory_order_release);
+            wakeSleepers();
+        }
+
+
+        std::atomic<std::uint32_t>  m_state;          //!< Старший бит - захвачено писателем, остальные - количество читателей
+        std::atomic<std::uint32_t>  m_writersWaiting; //!< Количество писателей, ожидающих захвата
+        std::atomic<std::uint32_t>  m_sleepers;       //!< Количество потоков, спящих на m_cond
+        std::mutex                  m_mutex;
+        std::condition_variable     m_cond;
+
+}; // class RwLock
+
+
+
+//---------------------------------------------------------
+//! Seqlock - защита небольших POD-данных, при которой читатель ничего не пишет в разделяемую память
+/*! Читатель копирует данные и повторяет чтение, если во время копирования была запись. Писатели сериализуются между собой.
+    Подходит для небольших, часто читаемых и редко изменяемых снапшотов (настройки, статистика, текущее время).
+
+    Тип T должен быть тривиально копируемым.
+ */
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock: T must be trivially copyable");
+
+    public:
+
+        SeqLock() : m_seq(0), m_writeLock(false), m_data() {}
+        explicit SeqLock( const T &t ) : m_seq(0), m_writeLock(false), m_data(t) {}
+
+        UMBA_NON_COPYABLE_CLASS(SeqLock)
+
+    public:
+
+        //! Возвращает согласованный снапшот данных
+        T read() const
+        {
+            T res;
+            for(;;)
+            {
+                std::uint32_t seq1 = m_seq.load(std::memory_order_acquire);
+                if (seq1&1u)
+                {
+                    details::lockCpuRelax();
+                    continue;
+                }
+
+                std::memcpy(&res, (const void*)&m_data, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (m_seq.load(std::memory_order_relaxed)==seq1)
+                    return res;
+            }
+        }
+
+        //! Записывает новое значение
+        void write( const T &t )
+        {
+            modify( [&t](T &d) { d = t; } );
+        }
+
+        //! Модифицирует данные на месте под блокировкой записи. Модификатор должен быть коротким
+        template<typename Modifier>
+        void modify( Modifier modifier )
+        {
+            lockWrite();
+
+            std::uint32_t seq = m_seq.load(std::memory_order_relaxed);
+            m_seq.store(seq+1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            modifier(m_data);
+
+            m_seq.store(seq+2, std::memory_order_release);
+
+            unlockWrite();
+        }
+
+    private:
+
+        void lockWrite()
+        {
+            while(m_writeLock.exchange(true, std::memory_order_acquire))
+            {
+                while(m_writeLock.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+            }
+        }
+
+        void unlockWrite()
+        {
+            m_writeLock.store(false, std::memory_order_release);
+        }
+
+        std::atomic<std::uint32_t>  m_seq;       //!< Нечётное значение - идёт запись
+        std::atomic<bool>           m_writeLock;
+        T                           m_data;
+
+}; // class SeqLock
+
+
+
+//---------------------------------------------------------
+//! Массив блокировок, выбираемых по хэшу ключа (lock striping)
+/*! Позволяет защищать разные части общей структуры (например, бакеты хэш-таблицы или независимые кэши)
+    разными блокировками, так что обращения к разным ключам не конкурируют.
+    Каждая блокировка размещается в своей кэш-линии.
+
+    Сам ShardedLock можно захватить через AutoLock/SharedAutoLock - при этом захватываются все шарды
+    по порядку (для операций над всей структурой, например, очистки).
+
+    \code
+    umba::ShardedLock<umba::RwLock, 16> locks;
+
+    {
+        umba::SharedAutoLock<umba::RwLock> lock(locks.getShardFor(key));
+        ...
+    }
+    \endcode
+ */
+template<typename LockObject = RwLock, std::size_t NumShards = 16>
+class ShardedLock
+{
+        static_assert(NumShards>0 && (NumShards&(NumShards-1))==0, "ShardedLock: NumShards must be a power of 2");
+
+        template<typename L> friend class AutoLock;
+        template<typename L> friend class SharedAutoLock;
+
+    public:
+
+        static const std::size_t numShards = NumShards; //!< Количество шардов
+
+        ShardedLock() {}
+
+        UMBA_NON_COPYABLE_CLASS(ShardedLock)
+
+    public:
+
+        //! Возвращает индекс шарда по хэшу
+        static std::size_t getShardIndex( std::size_t hash )
+        {
+            // Перемешиваем биты - std::hash для целых часто тождественный
+            std::uint64_t h = (std::uint64_t)hash;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return (std::size_t)(h & (NumShards-1));
+        }
+
+        //! Возвращает блокировку по хэшу
+        LockObject& getShard( std::size_t hash )
+        {
+            return m_shards[getShardIndex(hash)].lockObject;
+        }
+
+        //! Возвращает блокировку по ключу, хэш считается при помощи Hasher
+        template<typename KeyType, typename Hasher = std::hash<KeyType> >
+        LockObject& getShardFor( const KeyType &key, const Hasher &hasher = Hasher() )
+        {
+            return getShard(hasher(key));
+        }
+
+        //! Возвращает блокировку по индексу шарда
+        LockObject& getShardByIndex( std::size_t idx )
+        {
+            return m_shards[idx & (NumShards-1)].lockObject;
+        }
+
+    private:
+
+        void lock()
+        {
+            for(std::size_t i=0; i!=NumShards; ++i)
+                m_shards[i].lockObject.lock();
+        }
+
+        void unlock()
+        {
+            for(std::size_t i=NumShards; i!=0; --i)
+                m_shards[i-1].lockObject.unlock();
+        }
+
+        void lockShared()
+        {
+            for(std::size_t i=0; i!=NumShards; ++i)
+                m_shards[i].lockObject.lockShared();
+        }
+
+        void unlockShared()
+        {
+            for(std::size_t i=NumShards; i!=0; --i)
+                m_shards[i-1].lockObject.unlockShared();
+        }
+
+        struct alignas(64) Shard
+        {
+            LockObject lockObject;
+        };
+
+        Shard m_shards[NumShards];
+
+}; // class ShardedLock
+
+
+
+} // namespace umba
@@ -11,9 +11,11 @@
 //----------------------------------------------------------------------------
 
 #include "alloca.h"
+#include "ascii_case.h"
 #include "exception.h"
 #include "debug_helpers.h"
 #include "basic_enums.h"
+#include "text_normalize.h"
 
 //
 #include <algorithm>
@@ -27,6 +29,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 //----------------------------------------------------------------------------
 
@@ -646,16 +650,16 @@ template <typename StringType> inline bool ends_with_and_strip( StringType &str,
 //! Конвертирует строку StringType в нижний регистр (работает только для базового диапазона ASCII)
 template <typename StringType> inline void tolower( StringType &str )
 {
-    for(typename StringType::iterator it = str.begin(); it != str.end(); ++it)
-        *it = (typename StringType::value_type)std::tolower((char)*it);
+    if (!str.empty())
+        ascii_tolower(&str[0], str.size());
 }
 
 //-----------------------------------------------------------------------------
 //! Конвертирует строку StringType в верхний регистр (работает только для базового диапазона ASCII)
 template <typename StringType> inline void toupper( StringType &str )
 {
-    for(typename StringType::iterator it = str.begin(); it != str.end(); ++it)
-        *it = (typename StringType::value_type)std::toupper((char)*it);
+    if (!str.empty())
+        ascii_toupper(&str[0], str.size());
 }
 
 //-----------------------------------------------------------------------------
@@ -683,8 +687,10 @@ template <typename StringType> inline void case_convert( StringType &str, CaseOp
 //! Конвертирует строку StringType в нижний регистр (работает только для базового диапазона ASCII), возвращая модифицированную копию
 template <typename StringType> inline StringType tolower_copy( const StringType &str )
 {
-    StringType res = str;
-    tolower(res);
+    StringType res;
+    res.resize(str.size());
+    if (!str.empty())
+        ascii_tolower_copy(&res[0], str.data(), str.size());
     return res;
 }
 
@@ -692,8 +698,10 @@ template <typename StringType> inline StringType tolower_copy( const StringType
 //! Конвертирует строку StringType в верхний регистр (работает только для базового диапазона ASCII), возвращая модифицированную копию
 template <typename StringType> inline StringType toupper_copy( const StringType &str )
 {
-    StringType res = str;
-    toupper(res);
+    StringType res;
+    res.resize(str.size());
+    if (!str.empty())
+        ascii_toupper_copy(&res[0], str.data(), str.size());
     return res;
 }
 
@@ -714,6 +722,64 @@ template <typename StringType> inline StringType case_convert_copy( const String
 }
 
 //-----------------------------------------------------------------------------
+//! Регистронезависимое сравнение (только базовый диапазон ASCII), без аллокаций. \returns -1, 0, 1
+/*! Результат совпадает со сравнением копий, переведённых в нижний регистр.
+    Строки - std::basic_string или std::basic_string_view с одинаковым типом символа
+ */
+template <typename StringType1, typename StringType2> inline
+int icase_compare( const StringType1 &s1, const StringType2 &s2 )
+{
+    return ascii_icase_compare(s1.data(), s1.size(), s2.data(), s2.size());
+}
+
+//-----------------------------------------------------------------------------
+//! Регистронезависимая проверка на равенство (только базовый диапазон ASCII), без аллокаций
+template <typename StringType1, typename StringType2> inline
+bool icase_equal( const StringType1 &s1, const StringType2 &s2 )
+{
+    return ascii_icase_equal(s1.data(), s1.size(), s2.data(), s2.size());
+}
+
+//-----------------------------------------------------------------------------
+//! Регистронезависимый предикат "меньше" для сортировки и упорядоченных контейнеров
+struct icase_less
+{
+    typedef void is_transparent;
+
+    template <typename StringType1, typename StringType2>
+    bool operator()( const StringType1 &s1, const StringType2 &s2 ) const
+    {
+        return icase_compare(s1, s2)<0;
+    }
+};
+
+//-----------------------------------------------------------------------------
+//! Регистронезависимый предикат равенства для хэш-контейнеров
+struct icase_equal_to
+{
+    typedef void is_transparent;
+
+    template <typename StringType1, typename StringType2>
+    bool operator()( const StringType1 &s1, const StringType2 &s2 ) const
+    {
+        return icase_equal(s1, s2);
+    }
+};
+
+//-----------------------------------------------------------------------------
+//! Регистронезависимый хэш для хэш-контейнеров (в паре с icase_equal_to)
+struct icase_hash
+{
+    typedef void is_transparent;
+
+    template <typename StringType>
+    std::size_t operator()( const StringType &s ) const
+    {
+        return ascii_icase_hash(s.data(), s.size());
+    }
+};
+
+//-----------------------------------------------------------------------------
 
 
 
@@ -787,6 +853,7 @@ template<typename StringType> inline
 StringType textCompress( const StringType &text, const StringType &compressChars )
 {
     StringType res;
+    res.reserve(text.size());
 
     typename StringType::size_type i = 0, sz = text.size();
 
@@ -819,6 +886,15 @@ StringType textCompress( const StringType &text, const StringType &compressChars
     return res;
 }
 
+//! "Сжатие" строки, версия для std::string - на месте в копии, с таблицей класса символов (см. text_normalize.h)
+inline
+std::string textCompress( const std::string &text, const std::string &compressChars )
+{
+    std::string res = text;
+    text_compress_runs(res, char_class_set(compressChars));
+    return res;
+}
+
 //-----------------------------------------------------------------------------
 
 
@@ -1360,6 +1436,462 @@ StringType expand_copy( const StringType &str
 
 
 
+//-----------------------------------------------------------------------------
+// Ленивые сплиттеры, возвращающие std::basic_string_view на исходную строку
+/*
+    Сплиттер - это диапазон (range) с forward итератором, который по требованию
+    находит очередной разделитель и отдаёт кусок исходной строки как string_view,
+    ничего не копируя и не аллоцируя.
+
+    Исходная строка (и строка набора разделителей/скобок/кавычек) должна жить
+    дольше, чем сплиттер и полученные от него куски.
+
+    Поиск разделителя делегируется объекту DelimFinder, который должен предоставлять метод
+    size_type find(view_type str, size_type pos, size_type &delimLen) const, возвращающий
+    позицию очередного разделителя (и его длину в delimLen), или npos, если разделителей больше нет.
+
+    skipEmpty - пропускать пустые куски.
+    maxSplits - максимальное количество разделителей, по которым производится деление, остаток
+    строки отдаётся последним куском целиком. Пропущенные пустые куски тоже учитываются.
+ */
+
+//------------------------------
+//! Быстрый фильтр символов для сплиттеров - битовая карта для кодов 0-255
+/*! Для символов с кодом больше 255 contains всегда возвращает true - в этом случае
+    DelimFinder делает точную проверку самостоятельно.
+ */
+template<typename CharType>
+class split_char_filter
+{
+    unsigned m_bits[256/(8*sizeof(unsigned))];
+
+public:
+
+    split_char_filter() : m_bits() {}
+
+    //! Добавляет символ в фильтр
+    void add(CharType ch)
+    {
+        std::size_t code = (std::size_t)(typename std::make_unsigned<CharType>::type)ch;
+        if (code<256)
+            m_bits[code/(8*sizeof(unsigned))] |= 1u<<(code%(8*sizeof(unsigned)));
+    }
+
+    //! Добавляет символы в фильтр
+    void add(std::basic_string_view<CharType> chars)
+    {
+        for(auto ch : chars)
+            add(ch);
+    }
+
+    //! Возвращает true, если символ может быть в наборе
+    bool contains(CharType ch) const
+    {
+        std::size_t code = (std::size_t)(typename std::make_unsigned<CharType>::type)ch;
+        if (code>=256)
+            return true;
+        return (m_bits[code/(8*sizeof(unsigned))] & (1u<<(code%(8*sizeof(unsigned)))))!=0;
+    }
+
+    //! Возвращает true, если фильтр точный для данного типа символа (все коды символов укладываются в 0-255)
+    static constexpr bool is_exact()
+    {
+        return sizeof(CharType)==1;
+    }
+
+}; // class split_char_filter
+
+//------------------------------
+//! Ленивый сплиттер строки, отдающий куски исходной строки как std::basic_string_view
+template<typename CharType, typename DelimFinder>
+class basic_split_range
+{
+
+public:
+
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    //! Forward итератор по кускам строки
+    class iterator
+    {
+        friend class basic_split_range;
+
+        const basic_split_range  *m_pRange   = 0;
+        view_type                 m_cur;
+        size_type                 m_tokenPos = view_type::npos;
+        size_type                 m_nextPos  = view_type::npos;
+        size_type                 m_nSplits  = 0;
+
+        explicit iterator(const basic_split_range *pRange)
+        : m_pRange(pRange)
+        , m_nextPos(0)
+        {
+            fetch();
+        }
+
+        void fetch()
+        {
+            for(;;)
+            {
+                if (m_nextPos==view_type::npos)
+                {
+                    m_cur      = view_type();
+                    m_tokenPos = view_type::npos;
+                    return;
+                }
+
+                const view_type &str = m_pRange->m_str;
+
+                size_type delimLen = 0;
+                size_type delimPos = view_type::npos;
+                if (m_nSplits!=m_pRange->m_maxSplits)
+                    delimPos = m_pRange->m_finder.find(str, m_nextPos, delimLen);
+
+                m_tokenPos = m_nextPos;
+
+                if (delimPos==view_type::npos)
+                {
+                    m_cur     = view_type(str.data()+m_nextPos, str.size()-m_nextPos);
+                    m_nextPos = view_type::npos;
+                }
+                else
+                {
+                    m_cur     = view_type(str.data()+m_nextPos, delimPos-m_nextPos);
+                    m_nextPos = delimPos+delimLen;
+                    ++m_nSplits;
+                }
+
+                if (!m_pRange->m_skipEmpty || !m_cur.empty())
+                    return;
+            }
+        }
+
+    public:
+
+        typedef std::forward_iterator_tag  iterator_category;
+        typedef view_type                  value_type;
+        typedef std::ptrdiff_t             difference_type;
+        typedef const view_type*           pointer;
+        typedef const view_type&           reference;
+
+        iterator() {}
+
+        reference operator*() const  { return m_cur;  }
+        pointer   operator->() const { return &m_cur; }
+
+        iterator& operator++()       { fetch(); return *this; }
+        iterator  operator++(int)    { iterator tmp = *this; fetch(); return tmp; }
+
+        //! Позиция текущего куска в исходной строке
+        size_type position() const   { return m_tokenPos; }
+
+        bool operator==(const iterator &other) const { return m_tokenPos==other.m_tokenPos; }
+        bool operator!=(const iterator &other) const { return m_tokenPos!=other.m_tokenPos; }
+
+    }; // class iterator
+
+    typedef iterator const_iterator;
+
+
+    basic_split_range( view_type          str
+                     , const DelimFinder &finder
+                     , bool               skipEmpty = false
+                     , size_type          maxSplits = view_type::npos
+                     )
+    : m_str(str)
+    , m_finder(finder)
+    , m_maxSplits(maxSplits)
+    , m_skipEmpty(skipEmpty)
+    {}
+
+    iterator begin() const { return iterator(this); }
+    iterator end()   const { return iterator(); }
+
+    //! Складывает куски в выходной итератор, возвращает итератор после последнего записанного
+    template<typename OutputIterator>
+    OutputIterator copy_to(OutputIterator it) const
+    {
+        for(iterator b=begin(); b.m_tokenPos!=view_type::npos; ++b)
+            *it++ = *b;
+        return it;
+    }
+
+    //! Складывает куски в вектор строк, сконструированных из кусков
+    template<typename StringType>
+    void append_to(std::vector<StringType> &v) const
+    {
+        for(iterator b=begin(); b.m_tokenPos!=view_type::npos; ++b)
+            v.emplace_back(b->data(), b->size());
+    }
+
+
+protected:
+
+    view_type    m_str;
+    DelimFinder  m_finder;
+    size_type    m_maxSplits;
+    bool         m_skipEmpty;
+
+}; // class basic_split_range
+
+//------------------------------
+//! Поиск одиночного символа-разделителя
+template<typename CharType>
+struct split_char_finder
+{
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    CharType delim;
+
+    explicit split_char_finder(CharType d) : delim(d) {}
+
+    size_type find(view_type str, size_type pos, size_type &delimLen) const
+    {
+        delimLen = 1;
+        return str.find(delim, pos);
+    }
+
+}; // struct split_char_finder
+
+//------------------------------
+//! Поиск разделителя-строки. Пустой разделитель никогда не находится
+template<typename CharType>
+struct split_string_finder
+{
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    view_type delim;
+
+    explicit split_string_finder(view_type d) : delim(d) {}
+
+    size_type find(view_type str, size_type pos, size_type &delimLen) const
+    {
+        delimLen = delim.size();
+        if (delim.empty())
+            return view_type::npos;
+        return str.find(delim, pos);
+    }
+
+}; // struct split_string_finder
+
+//------------------------------
+//! Поиск любого символа из набора разделителей
+template<typename CharType>
+struct split_any_of_finder
+{
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    view_type                    delims;
+    split_char_filter<CharType>  filter;
+
+    explicit split_any_of_finder(view_type d) : delims(d) { filter.add(d); }
+
+    size_type find(view_type str, size_type pos, size_type &delimLen) const
+    {
+        delimLen = 1;
+        for(size_type size=str.size(); pos<size; ++pos)
+        {
+            CharType ch = str[pos];
+            if (!filter.contains(ch))
+                continue;
+            if (split_char_filter<CharType>::is_exact() || delims.find(ch)!=view_type::npos)
+                return pos;
+        }
+        return view_type::npos;
+    }
+
+}; // struct split_any_of_finder
+
+//------------------------------
+//! Поиск символа-разделителя вне кавычек
+/*! Кавычка закрывается только такой же кавычкой, внутри кавычек другие кавычки не учитываются.
+    Если escapeChar не нулевой, то следующий за ним символ не обрабатывается (ни как кавычка, ни как разделитель).
+    Кавычки остаются в кусках как есть.
+ */
+template<typename CharType>
+struct split_quoted_finder
+{
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    CharType                     delim;
+    view_type                    quotes;
+    CharType                     escapeChar;
+    split_char_filter<CharType>  filter;
+
+    split_quoted_finder(CharType d, view_type q, CharType esc = 0)
+    : delim(d), quotes(q), escapeChar(esc)
+    {
+        filter.add(d);
+        filter.add(q);
+        if (esc!=0)
+            filter.add(esc);
+    }
+
+    size_type find(view_type str, size_type pos, size_type &delimLen) const
+    {
+        delimLen = 1;
+        CharType curQuot = 0;
+        for(size_type size=str.size(); pos<size; ++pos)
+        {
+            CharType ch = str[pos];
+            if (!filter.contains(ch))
+                continue;
+
+            if (escapeChar!=0 && ch==escapeChar)
+            {
+                ++pos; // пропускаем следующий символ
+                continue;
+            }
+
+            if (curQuot!=0)
+            {
+                if (ch==curQuot)
+                    curQuot = 0;
+                continue;
+            }
+
+            if (ch==delim)
+                return pos;
+
+            if (quotes.find(ch)!=view_type::npos)
+                curQuot = ch;
+        }
+
+        return view_type::npos;
+    }
+
+}; // struct split_quoted_finder
+
+//------------------------------
+//! Создаёт std::basic_string_view для строки (std::basic_string или std::basic_string_view)
+template<typename StringType> inline
+std::basic_string_view<typename StringType::value_type> make_split_view(const StringType &str)
+{
+    return std::basic_string_view<typename StringType::value_type>(str.data(), str.size());
+}
+
+//------------------------------
+//! Ленивый сплит по символу. Исходная строка должна жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, split_char_finder<typename StringType::value_type> >
+split_view( const StringType               &str                    //!< Входная строка
+          , typename StringType::value_type delim                  //!< Разделитель
+          , bool                            skipEmpty = false      //!< Пропускать пустые элементы?
+          , std::size_t                     maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+          )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, split_char_finder<CharType> >(make_split_view(str), split_char_finder<CharType>(delim), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Ленивый сплит по строке-разделителю. Исходная строка и разделитель должны жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, split_string_finder<typename StringType::value_type> >
+split_view( const StringType                                         &str                    //!< Входная строка
+          , std::basic_string_view<typename StringType::value_type>  delim                   //!< Разделитель
+          , bool                                                     skipEmpty = false       //!< Пропускать пустые элементы?
+          , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+          )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, split_string_finder<CharType> >(make_split_view(str), split_string_finder<CharType>(delim), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Ленивый сплит по любому символу из набора. Исходная строка и набор разделителей должны жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, split_any_of_finder<typename StringType::value_type> >
+split_view_any_of( const StringType                                         &str                    //!< Входная строка
+                 , std::basic_string_view<typename StringType::value_type>  delims                  //!< Набор разделителей
+                 , bool                                                     skipEmpty = false       //!< Пропускать пустые элементы?
+                 , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                 )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, split_any_of_finder<CharType> >(make_split_view(str), split_any_of_finder<CharType>(delims), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Ленивый сплит по символу с учетом кавычек. Исходная строка и набор кавычек должны жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, split_quoted_finder<typename StringType::value_type> >
+split_view_quoted( const StringType                                         &str                    //!< Входная строка
+                 , typename StringType::value_type                          delim                   //!< Разделитель
+                 , std::basic_string_view<typename StringType::value_type>  quotes                  //!< Набор кавычек
+                 , typename StringType::value_type                          escapeChar = 0          //!< Escape-символ, 0 - не используется
+                 , bool                                                     skipEmpty  = false      //!< Пропускать пустые элементы?
+                 , std::size_t                                              maxSplits  = (std::size_t)-1 //!< Максимальное количество делений
+                 )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, split_quoted_finder<CharType> >(make_split_view(str), split_quoted_finder<CharType>(delim, quotes, escapeChar), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Сплит по символу в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_into( OutputIterator                  it                      //!< Выходной итератор
+                         , const StringType               &str                     //!< Входная строка
+                         , typename StringType::value_type delim                   //!< Разделитель
+                         , bool                            skipEmpty = false       //!< Пропускать пустые элементы?
+                         , std::size_t                     maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                         )
+{
+    return split_view(str, delim, skipEmpty, maxSplits).copy_to(it);
+}
+
+//------------------------------
+//! Сплит по строке-разделителю в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_into( OutputIterator                                            it                      //!< Выходной итератор
+                         , const StringType                                         &str                     //!< Входная строка
+                         , std::basic_string_view<typename StringType::value_type>  delim                    //!< Разделитель
+                         , bool                                                     skipEmpty = false        //!< Пропускать пустые элементы?
+                         , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                         )
+{
+    return split_view(str, delim, skipEmpty, maxSplits).copy_to(it);
+}
+
+//------------------------------
+//! Сплит по любому символу из набора в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_any_of_into( OutputIterator                                            it                      //!< Выходной итератор
+                                , const StringType                                         &str                     //!< Входная строка
+                                , std::basic_string_view<typename StringType::value_type>  delims                   //!< Набор разделителей
+                                , bool                                                     skipEmpty = false        //!< Пропускать пустые элементы?
+                                , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                                )
+{
+    return split_view_any_of(str, delims, skipEmpty, maxSplits).copy_to(it);
+}
+
+//------------------------------
+//! Сплит по символу с учетом кавычек в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_quoted_into( OutputIterator                                            it                      //!< Выходной итератор
+                                , const StringType                                         &str                     //!< Входная строка
+                                , typename StringType::value_type                          delim                    //!< Разделитель
+                                , std::basic_string_view<typename StringType::value_type>  quotes                   //!< Набор кавычек
+                                , typename StringType::value_type                          escapeChar = 0           //!< Escape-символ, 0 - не используется
+                                , bool                                                     skipEmpty  = false       //!< Пропускать пустые элементы?
+                                , std::size_t                                              maxSplits  = (std::size_t)-1 //!< Максимальное количество делений
+                                )
+{
+    return split_view_quoted(str, delim, quotes, escapeChar, skipEmpty, maxSplits).copy_to(it);
+}
+
+//-----------------------------------------------------------------------------
+
+
+
+
 //-----------------------------------------------------------------------------
 // Brace utils
 
@@ -1661,6 +2193,151 @@ simple_unbrace( const StringType &str                          //!< Строка
 }
 
 
+//------------------------------
+//! Поиск разделителя вне скобок (нестрогий режим split_against_braces)
+/*! Для каждого типа скобок ведётся свой счётчик вложенности, разделитель учитывается, только если все счётчики нулевые.
+    Лишние закрывающие скобки игнорируются, незакрытая открывающая скобка подавляет все последующие разделители.
+ */
+template<typename CharType>
+class split_brace_finder
+{
+
+public:
+
+    typedef std::basic_string_view<CharType>   view_type;
+    typedef typename view_type::size_type      size_type;
+
+    //! Сплит по символу
+    split_brace_finder(view_type braces, CharType sep)
+    : m_sep(), m_sepChar(sep), m_charSep(true)
+    {
+        init(braces);
+        m_filter.add(sep);
+    }
+
+    //! Сплит по строке. Пустой разделитель никогда не находится
+    split_brace_finder(view_type braces, view_type sep)
+    : m_sep(sep), m_sepChar(0), m_charSep(false)
+    {
+        init(braces);
+        if (!sep.empty())
+            m_filter.add(sep[0]);
+    }
+
+    size_type find(view_type str, size_type pos, size_type &delimLen) const
+    {
+        delimLen = m_charSep ? 1 : m_sep.size();
+        if (!m_charSep && (m_sep.empty() || m_sep.size()>str.size()))
+            return view_type::npos;
+
+        int counts[maxBraceTypes] = { 0 };
+        int nesting = 0;
+
+        for(size_type size=str.size(); pos<size; ++pos)
+        {
+            CharType ch = str[pos];
+            if (!m_filter.contains(ch))
+                continue;
+
+            if (nesting==0 && isSep(str, pos, ch))
+                return pos;
+
+            std::size_t lIdx = findIdx(m_lefts , ch);
+            std::size_t rIdx = findIdx(m_rights, ch);
+
+            if (lIdx!=npos && (rIdx==npos || counts[lIdx]==0))
+            {
+                ++counts[lIdx];
+                ++nesting;
+            }
+            else if (rIdx!=npos && counts[rIdx]>0)
+            {
+                --counts[rIdx];
+                --nesting;
+            }
+        }
+
+        return view_type::npos;
+    }
+
+
+protected:
+
+    static const std::size_t maxBraceTypes = 8;
+    static const std::size_t npos          = (std::size_t)-1;
+
+    void init(view_type braces)
+    {
+        m_numBraces = 0;
+        for(auto b : braces)
+        {
+            if (is_left(b)==is_right(b))
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error("umba::string_plus::ascii_brace::split_brace_finder: paired brace can't be left and right at the same time");
+            }
+
+            if (!is_paired(b))
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error("umba::string_plus::ascii_brace::split_brace_finder: can't build pair for non-paired brace");
+            }
+
+            bool isLeft = is_left(b);
+            CharType lb =  isLeft ? b : get_pair(b);
+            CharType rb = !isLeft ? b : get_pair(b);
+
+            if (findIdx(m_lefts, lb)!=npos)
+                continue;
+
+            if (m_numBraces==maxBraceTypes)
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error("umba::string_plus::ascii_brace::split_brace_finder: too many brace types");
+            }
+
+            m_lefts [m_numBraces] = lb;
+            m_rights[m_numBraces] = rb;
+            ++m_numBraces;
+
+            m_filter.add(lb);
+            m_filter.add(rb);
+        }
+    }
+
+    std::size_t findIdx(const CharType *pChars, CharType ch) const
+    {
+        for(std::size_t i=0; i!=m_numBraces; ++i)
+        {
+            if (pChars[i]==ch)
+                return i;
+        }
+        return npos;
+    }
+
+    bool isSep(view_type str, size_type pos, CharType ch) const
+    {
+        if (m_charSep)
+            return ch==m_sepChar;
+        return str.compare(pos, m_sep.size(), m_sep)==0;
+    }
+
+    view_type                    m_sep;
+    CharType                     m_sepChar;
+    bool                         m_charSep;
+    CharType                     m_lefts [maxBraceTypes] = { 0 };
+    CharType                     m_rights[maxBraceTypes] = { 0 };
+    std::size_t                  m_numBraces = 0;
+    split_char_filter<CharType>  m_filter;
+
+}; // class split_brace_finder
+
 //------------------------------
 //! Утилита для разбора строк по скобкам
 template<typename StringType> inline
@@ -1838,6 +2515,17 @@ void split_against_braces_impl( std::vector<StringType> &splits   //!< [out] К
                               , bool strictOrder = false          //!< Строгий порядок?
                               )
 {
+    typedef typename StringType::value_type CharType;
+
+    if (!strictOrder)
+    {
+        // Без контроля порядка скобок - ленивый сплиттер, без промежуточных векторов диапазонов и позиций
+        basic_split_range< CharType, split_brace_finder<CharType> >( make_split_view(str)
+                                                                   , split_brace_finder<CharType>(make_split_view(braces), sep)
+                                                                   ).append_to(splits);
+        return;
+    }
+
     typename StringType::size_type sepSize = util_get_sep_size(sep);
 
     std::vector< typename StringType::size_type > sepPositions =
@@ -1935,6 +2623,64 @@ void split_against_braces( std::vector<StringType>               &splits  //!< [
 } // ascii_brace
 
 //-----------------------------------------------------------------------------
+//! Ленивый сплит по символу с учетом скобок (нестрогий режим). Исходная строка и набор скобок должны жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, ascii_brace::split_brace_finder<typename StringType::value_type> >
+split_view_against_braces( const StringType                                         &str                    //!< Входная строка
+                         , std::basic_string_view<typename StringType::value_type>  braces                  //!< Обрабатываемые скобки
+                         , typename StringType::value_type                          sep                     //!< Разделитель
+                         , bool                                                     skipEmpty = false       //!< Пропускать пустые элементы?
+                         , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                         )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, ascii_brace::split_brace_finder<CharType> >(make_split_view(str), ascii_brace::split_brace_finder<CharType>(braces, sep), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Ленивый сплит по строке-разделителю с учетом скобок (нестрогий режим). Исходная строка, набор скобок и разделитель должны жить дольше сплиттера
+template<typename StringType> inline
+basic_split_range< typename StringType::value_type, ascii_brace::split_brace_finder<typename StringType::value_type> >
+split_view_against_braces( const StringType                                         &str                    //!< Входная строка
+                         , std::basic_string_view<typename StringType::value_type>  braces                  //!< Обрабатываемые скобки
+                         , std::basic_string_view<typename StringType::value_type>  sep                     //!< Разделитель
+                         , bool                                                     skipEmpty = false       //!< Пропускать пустые элементы?
+                         , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                         )
+{
+    typedef typename StringType::value_type CharType;
+    return basic_split_range< CharType, ascii_brace::split_brace_finder<CharType> >(make_split_view(str), ascii_brace::split_brace_finder<CharType>(braces, sep), skipEmpty, maxSplits);
+}
+
+//------------------------------
+//! Сплит по символу с учетом скобок в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_against_braces_into( OutputIterator                                            it                      //!< Выходной итератор
+                                        , const StringType                                         &str                     //!< Входная строка
+                                        , std::basic_string_view<typename StringType::value_type>  braces                   //!< Обрабатываемые скобки
+                                        , typename StringType::value_type                          sep                      //!< Разделитель
+                                        , bool                                                     skipEmpty = false        //!< Пропускать пустые элементы?
+                                        , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                                        )
+{
+    return split_view_against_braces(str, braces, sep, skipEmpty, maxSplits).copy_to(it);
+}
+
+//------------------------------
+//! Сплит по строке-разделителю с учетом скобок в выходной итератор (куски - std::basic_string_view). Возвращает итератор после последнего записанного
+template<typename OutputIterator, typename StringType> inline
+OutputIterator split_against_braces_into( OutputIterator                                            it                      //!< Выходной итератор
+                                        , const StringType                                         &str                     //!< Входная строка
+                                        , std::basic_string_view<typename StringType::value_type>  braces                   //!< Обрабатываемые скобки
+                                        , std::basic_string_view<typename StringType::value_type>  sep                      //!< Разделитель
+                                        , bool                                                     skipEmpty = false        //!< Пропускать пустые элементы?
+                                        , std::size_t                                              maxSplits = (std::size_t)-1 //!< Максимальное количество делений
+                                        )
+{
+    return split_view_against_braces(str, braces, sep, skipEmpty, maxSplits).copy_to(it);
+}
+
+//-----------------------------------------------------------------------------
 
 
 
@@ -1964,7 +2710,7 @@ void eraseEmptiesHelper( std::vector<StringType> &v /*!< Вектор элеме
 }
 
 //------------------------------
-//! Тупой сплит строки, используется версия сплита по скобкам с редуцированным набором скобок
+//! Тупой сплит строки по символу
 template<typename StringType> inline
 std::vector<StringType> split( const StringType &str                  //!< Входная строка
                              , typename StringType::value_type delim  //!< Разделитель
@@ -1972,25 +2718,12 @@ std::vector<StringType> split( const StringType &str                  //!< Вх
                              )
 {
     std::vector<StringType> splits;
-    ascii_brace::split_against_braces( splits, str
-                                     , StringType() // no braces at all
-                                     , delim
-                                     );
-
-    if (skipEmpty)
-    {
-        // Чукич, стр 62
-        // #if 0 // В 2005 студии оно не работает
-        // eraseEmptiesHelper( splits );
-        // #endif
-        eraseEmptiesHelper( splits );
-    }
-
+    split_view(str, delim, skipEmpty).append_to(splits);
     return splits;
 }
 
 //------------------------------
-//! Тупой сплит строки, используется версия сплита по скобкам с редуцированным набором скобок
+//! Тупой сплит строки по строке-разделителю
 template<typename StringType> inline
 std::vector<StringType> split( const StringType &str    //!< Входная строка
                              , const StringType &delim  //!< Разделитель
@@ -1998,28 +2731,7 @@ std::vector<StringType> split( const StringType &str    //!< Входная ст
                              )
 {
     std::vector<StringType> splits;
-    ascii_brace::split_against_braces( splits, str
-                                     , StringType() // no braces at all
-                                     , delim
-                                     );
-
-    if (skipEmpty)
-    {
-        // Чукич, стр 62
-        // #if 0 // В 2005 студии оно не работает
-        // splits.erase( std::remove_if( splits.begin()
-        //                             , splits.end()
-        //                             #ifdef UMBA_CXX_HAS_STD11
-        //                             , []( const StringType &s) { return s.empty(); }
-        //                             #else
-        //                             , lambda_is_empty<StringType>()
-        //                             #endif
-        //                             )
-        //             );
-        // #endif
-        eraseEmptiesHelper( splits );
-    }
-
+    split_view(str, make_split_view(delim), skipEmpty).append_to(splits);
     return splits;
 }
 
@@ -2099,6 +2811,7 @@ bool split_to_pair( const StringType str, StringType &first, StringType &second,
 }
 
 //-----------------------------------------------------------------------------
+//! Простой сплит по строке-разделителю. Делается не более nSplits делений, остаток добавляется всегда (в т.ч. пустой)
 template<typename StringType> inline
 std::vector<StringType> simple_string_split(const StringType &str, const StringType &delim, typename StringType::size_type nSplits = -1)
 {
@@ -2110,96 +2823,50 @@ std::vector<StringType> simple_string_split(const StringType &str, const StringT
     // x = txt.split("#", 1)
 
     std::vector<StringType> res;
-
-    typename StringType::size_type curPos  = 0;
-    typename StringType::size_type prevPos = 0;
-    //StringType token;
-    while (res.size()!=nSplits && (curPos = str.find(delim, prevPos)) != StringType::npos)
-    {
-        res.emplace_back(str, prevPos, curPos-prevPos);
-        prevPos = curPos+delim.size();
-    }
-
-    // Ранее остаток закидывали безусловно
-    // Пока так и оставим
-    res.emplace_back(str, prevPos, StringType::npos);
-
-    //TODO: !!! Надо подумать, править баг и как его править
-    #if 0
-    if (res.size()==nSplits)
-    {
-        // Набрали нужное количество частей, надо закинуть последнюю без всяких условий
-        res.emplace_back(str, prevPos);
-    }
-    else
-    {
-        // У нас сплит до упора, и мы просто не нашли следующий разделитель после последнего его вхождения
-        // Или мы вообще его не нашли
-        // Или мы его вообще не нашли
-        // Что и где может поломаться, если мы что-то тут подправим?
-
-        if ()
-    }
-    #endif
-
+    split_view(str, make_split_view(delim), false /* skipEmpty */, nSplits).append_to(res);
+    if (res.empty()) // split_view для пустой строки не даёт частей, а остаток добавляется всегда
+        res.emplace_back();
     return res;
 }
 
 //-----------------------------------------------------------------------------
+//! Простой сплит по строке-разделителю
 template<typename StringType> inline
 std::vector<StringType> simple_string_split(const StringType &str, const typename StringType::value_type *delim, typename StringType::size_type nSplits = -1)
 {
-    return simple_string_split( str, StringType(delim), nSplits);
+    std::vector<StringType> res;
+    split_view(str, std::basic_string_view<typename StringType::value_type>(delim), false /* skipEmpty */, nSplits).append_to(res);
+    if (res.empty())
+        res.emplace_back();
+    return res;
 }
 
 //-----------------------------------------------------------------------------
+//! Простой сплит по символу
 template<typename StringType> inline
 std::vector<StringType> simple_string_split(const StringType &str, const typename StringType::value_type delim, typename StringType::size_type nSplits = -1)
 {
-    typename StringType::value_type tmpDelimStr[2] = { delim, 0 };
-    return simple_string_split( str, tmpDelimStr, nSplits);
+    std::vector<StringType> res;
+    split_view(str, delim, false /* skipEmpty */, nSplits).append_to(res);
+    if (res.empty())
+        res.emplace_back();
+    return res;
 }
 
 //-----------------------------------------------------------------------------
+//! Простой сплит по строке-разделителю в выходной итератор (куски - StringType)
 template<typename StringType, typename OutputIterator> inline
 void simple_string_split(OutputIterator inserterIt, const StringType &str, const StringType &delim, typename StringType::size_type nSplits = -1)
 {
-    typename StringType::size_type curPos  = 0;
-    typename StringType::size_type prevPos = 0;
-
-    typename StringType::size_type numPartsAdded = 0;
-
-    //StringType token;
-    while (numPartsAdded!=nSplits && (curPos = str.find(delim, prevPos)) != StringType::npos)
-    {
-        *inserterIt++ = StringType(str, prevPos, curPos-prevPos);
-        prevPos = curPos+delim.size();
-        ++numPartsAdded;
-    }
-
-    // Ранее остаток закидывали безусловно
-    // Пока так и оставим
-    *inserterIt++ = StringType(str, prevPos, StringType::npos);
-
-    //TODO: !!! Надо подумать, править баг и как его править
-    #if 0
-    if (res.size()==nSplits)
-    {
-        // Набрали нужное количество частей, надо закинуть последнюю без всяких условий
-        res.emplace_back(str, prevPos);
-    }
-    else
+    if (str.empty())
     {
-        // У нас сплит до упора, и мы просто не нашли следующий разделитель после последнего его вхождения
-        // Или мы вообще его не нашли
-        // Или мы его вообще не нашли
-        // Что и где может поломаться, если мы что-то тут подправим?
-
-        if ()
+        *inserterIt++ = StringType();
+        return;
     }
-    #endif
 
-    //return res;
+    auto range = split_view(str, make_split_view(delim), false /* skipEmpty */, nSplits);
+    for(auto it=range.begin(); it!=range.end(); ++it)
+        *inserterIt++ = StringType(it->data(), it->size());
 }
 
 
@@ -2419,11 +3086,9 @@ StringType quote( const StringType &str
 
 
 //-----------------------------------------------------------------------------
-//! Хелпер для вычисления размера буфера для функции format_print
+//! Хелпер для вычисления размера начального буфера для функции format_print (результат большего размера не обрезается)
 inline std::size_t calc_buf_char_size_for_format_print( std::size_t fmtStringSize )
 {
-    UMBA_ASSERT(fmtStringSize<256);
-
     std::size_t bufSize = fmtStringSize*16;
     if (bufSize<128)
         bufSize = 128;
@@ -2439,11 +3104,12 @@ inline std::size_t calc_buf_char_size_for_format_print( std::size_t fmtStringSiz
     Используется vsnprintf.
     Теоретически, vsnprintf есть везде, но имя обычно чуть-чуть, но не такое как у других.
     Второе - не надо следить за буфером, его выделением, переполнением, и тп.
-    Выбирается некоторый разумный размер буфера, лишнее - обрезается.
-    Не следует задавать форматные строки огромной длины.
+    Сначала форматируем в буфер разумного размера, если результат не влез - переформатируем в строку точного размера.
     Функция предназначена в основном для внутреннего использования, для printf-like быстрого форматирования интегральных величин,
     но теоретически можно использовать и форматные строки, задаваемые извне.
 
+    Для нового кода лучше использовать типобезопасные umba::string_plus::format_printf/format из typed_format.h
+
     Базовый шаблон вызовет ассерт, нужна специализация для конкретного типа
 
     \param fmt Форматная строка
@@ -2464,27 +3130,27 @@ std::string format_print<std::string>( const std::string fmt, ... )
         return fmt;
     }
 
-    std::size_t bufSize = calc_buf_char_size_for_format_print (fmt.size());
-
-    char *pBuf = 0;
-    try
-    {
-        pBuf = (char*)alloca(bufSize*sizeof(*pBuf));
-        if (!pBuf) return fmt;
-    }
-    catch(...)
-    {
-        return fmt;
-    }
+    std::string res;
+    res.resize(calc_buf_char_size_for_format_print(fmt.size()));
 
     #include "warnings/push_disable_non_portable_variadic.h"
     va_list args;
     va_start (args, fmt);
-    auto numCharsPrinted = (std::size_t)vsnprintf(pBuf,bufSize-1, fmt.c_str(), args );
+    va_list argsCopy;
+    va_copy (argsCopy, args);
+    int numCharsPrinted = vsnprintf(&res[0], res.size()+1, fmt.c_str(), args );
     va_end (args);
+
+    if (numCharsPrinted>=0 && (std::size_t)numCharsPrinted>res.size())
+    {
+        res.resize((std::size_t)numCharsPrinted);
+        vsnprintf(&res[0], res.size()+1, fmt.c_str(), argsCopy );
+    }
+    va_end (argsCopy);
     #include "warnings/pop.h"
 
-    return std::string(pBuf, numCharsPrinted);
+    res.resize(numCharsPrinted>=0 ? (std::size_t)numCharsPrinted : 0u);
+    return res;
 }
 
 //-----------------------------------------------------------------------------
@@ -2499,28 +3165,25 @@ std::wstring format_print<std::wstring>( const std::wstring fmt, ... )
         return fmt;
     }
 
-    std::size_t bufSize = calc_buf_char_size_for_format_print (fmt.size());
-
-    wchar_t *pBuf = 0;
-    try
-    {
-        (wchar_t*)alloca(bufSize*sizeof(*pBuf));
-        if (!pBuf) return fmt;
-    }
-    catch(...)
-    {
-        return fmt;
-    }
-
     #include "warnings/push_disable_non_portable_variadic.h"
     #include "warnings/disable_fn_or_var_unsafe.h"
     va_list args;
     va_start (args, fmt);
-    auto numCharsPrinted = (std::size_t)_vsnwprintf(pBuf, bufSize-1, fmt.c_str(), args );
+    va_list argsCopy;
+    va_copy (argsCopy, args);
+    int numCharsRequired = _vscwprintf(fmt.c_str(), args ); // Точный размер результата
     va_end (args);
+
+    std::wstring res;
+    if (numCharsRequired>0)
+    {
+        res.resize((std::size_t)numCharsRequired);
+        _vsnwprintf(&res[0], res.size(), fmt.c_str(), argsCopy );
+    }
+    va_end (argsCopy);
     #include "warnings/pop.h"
 
-    return std::wstring(pBuf, numCharsPrinted);
+    return res;
 }
 #endif // UMBA_MSVC_COMPILER_USED
 
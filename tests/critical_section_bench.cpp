@@ -0,0 +1,149 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Замер CriticalSection (Linux, futex) под конкуренцией от 1 до 64 потоков
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Собирается отдельно от библиотеки:
+    g++ -std=c++17 -O2 -I<каталог, содержащий umba> critical_section_bench.cpp <umba>/critical_section.cpp -pthread
+
+    Каждый поток выполняет заданное количество захватов, под захватом - инкремент общего счётчика
+    и немного работы (workIters итераций), вне захвата - столько же работы. Для каждого количества потоков
+    выводится время на захват для CriticalSection в обычном режиме, в режиме наследования приоритетов
+    и для std::mutex, а также статистика CriticalSection (доля конкурентных захватов, захватов
+    во время активного ожидания и засыпаний на futex).
+
+    Замеры имеют смысл только на многоядерной машине, на одном ядре конкуренции почти нет.
+
+    Параметры командной строки: [захватов на поток] [workIters]
+*/
+
+#include "umba/umba.h"
+#include "umba/critical_section.h"
+//
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+static volatile std::uint64_t sink = 0;
+
+//----------------------------------------------------------------------------
+static inline
+void doWork( unsigned workIters )
+{
+    std::uint64_t x = sink;
+    for(unsigned i=0; i!=workIters; ++i)
+        x = x*6364136223846793005ull + 1;
+    sink = x;
+}
+
+//----------------------------------------------------------------------------
+template<typename LockType>
+double runBench( LockType &lockObj, unsigned numThreads, unsigned numLocks, unsigned workIters )
+{
+    std::uint64_t counter = 0;
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(unsigned t=0; t!=numThreads; ++t)
+    {
+        threads.emplace_back( [&]()
+                              {
+                                  for(unsigned i=0; i!=numLocks; ++i)
+                                  {
+                                      {
+                                          umba::AutoLock<LockType> lock(lockObj);
+                                          ++counter;
+                                          doWork(workIters);
+                                      }
+                                      doWork(workIters);
+                                  }
+                              }
+                            );
+    }
+
+    for(auto &thr : threads)
+        thr.join();
+
+    auto finish = std::chrono::steady_clock::now();
+
+    if (counter!=(std::uint64_t)numThreads*numLocks)
+    {
+        std::printf("Counter mismatch: %llu, expected %llu\n", (unsigned long long)counter, (unsigned long long)numThreads*numLocks);
+        std::exit(1);
+    }
+
+    return std::chrono::duration<double, std::nano>(finish-start).count() / ((double)numThreads*numLocks);
+}
+
+//----------------------------------------------------------------------------
+// std::mutex через тот же AutoLock
+class StdMutexLock
+{
+        template<typename LockObject> friend class umba::AutoLock;
+
+    public:
+
+        StdMutexLock() {}
+        UMBA_NON_COPYABLE_CLASS(StdMutexLock)
+
+    private:
+
+        void lock()   { m_mutex.lock();   }
+        void unlock() { m_mutex.unlock(); }
+
+        std::mutex m_mutex;
+
+}; // class StdMutexLock
+
+//----------------------------------------------------------------------------
+static
+void printStats( const umba::CriticalSectionStats &st )
+{
+    const double total = st.lockCount ? (double)st.lockCount : 1.0;
+    std::printf(" (contended %5.1f%%, spin %5.1f%%, parks %5.1f%%)"
+               , 100.0*(double)st.contendedCount   /total
+               , 100.0*(double)st.spinAcquiredCount/total
+               , 100.0*(double)st.parkCount        /total
+               );
+}
+
+//----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+    unsigned numLocks  = argc>1 ? (unsigned)std::atoi(argv[1]) : 200000u;
+    unsigned workIters = argc>2 ? (unsigned)std::atoi(argv[2]) : 20u;
+
+    std::printf("CPUs: %u, locks per thread: %u, work iterations: %u\n", std::thread::hardware_concurrency(), numLocks, workIters);
+
+    const unsigned threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    for(unsigned numThreads : threadCounts)
+    {
+        umba::CriticalSection  cs;
+        umba::CriticalSection  csPi(true);
+        StdMutexLock           stdMutex;
+
+        double nsCs    = runBench(cs      , numThreads, numLocks, workIters);
+        double nsCsPi  = runBench(csPi    , numThreads, numLocks, workIters);
+        double nsMutex = runBench(stdMutex, numThreads, numLocks, workIters);
+
+        std::printf("%2u threads: CriticalSection %7.1f ns", numThreads, nsCs);
+        printStats(cs.getStats());
+        std::printf(", PI %7.1f ns", nsCsPi);
+        printStats(csPi.getStats());
+        std::printf(", std::mutex %7.1f ns\n", nsMutex);
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,25 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Проверки typed_format.h на этапе компиляции
+
+    Repository: https://github.com/al-martyn1/umba
+
+    Собирается отдельно от библиотеки, достаточно скомпилировать:
+    g++ -std=c++17 -I<каталог, содержащий umba> -c typed_format_checks.cpp
+*/
+
+#include "umba/umba.h"
+#include "umba/typed_format.h"
+
+
+using umba::string_plus::typed_format_details::float_prefix_len;
+
+// printf("%010a", 3.0) - "0x0001.8p+1", нули после "0x"
+static_assert(float_prefix_len("0x1.8p+1" , 'a')==2, "float_prefix_len: %a prefix");
+static_assert(float_prefix_len("-0X1P+0"  , 'A')==3, "float_prefix_len: %A prefix");
+static_assert(float_prefix_len("+0x0p+0"  , 'a')==3, "float_prefix_len: %+a prefix");
+static_assert(float_prefix_len("-inf"     , 'a')==1, "float_prefix_len: %a inf");
+static_assert(float_prefix_len("-0.5"     , 'f')==1, "float_prefix_len: %f sign");
+static_assert(float_prefix_len("0.5"      , 'g')==0, "float_prefix_len: %g");
+
@@ -0,0 +1,423 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Быстрая нормализация текста: сжатие повторов, добавление и удаление отступов
+
+    Repository: https://github.com/al-martyn1/umba
+*/
+
+#pragma once
+
+//----------------------------------------------------------------------------
+/*
+    Ядра работают с сырыми буферами char и, где это возможно, на месте - без промежуточных строк.
+    Класс символов задаётся таблицей на 256 бит (char_class_set), проверка - один сдвиг и маска.
+
+    Для сжатия повторов (text_compress_runs):
+      - при наличии SSE2 блоки по 16 байт без одинаковых соседних символов копируются целиком,
+        таблица класса проверяется только для совпавших соседей;
+      - иначе - то же самое по 8 байт (SWAR на uint64_t).
+    Поиск и подсчёт переводов строк - memchr/SSE2.
+
+    UMBA_TEXT_NORMALIZE_NO_SIMD - отключает SSE2 (остаётся SWAR).
+ */
+
+#include "zz_detect_environment.h"
+#include "internal/bit_utils.h"
+#include "internal/simd_detect.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(UMBA_SSE2_USED) && !defined(UMBA_TEXT_NORMALIZE_NO_SIMD)
+    #define UMBA_TEXT_NORMALIZE_SSE2
+#endif
+
+
+// umba::string_plus::
+namespace umba{
+namespace string_plus{
+
+
+//----------------------------------------------------------------------------
+//! Класс символов - битовая таблица на 256 значений char
+struct char_class_set
+{
+    std::uint64_t bits[4] = { 0, 0, 0, 0 };
+
+    char_class_set() {}
+
+    //! Создаёт класс из перечисленных символов
+    explicit char_class_set( std::string_view chars )
+    {
+        for(char ch : chars)
+            add(ch);
+    }
+
+    //! Создаёт класс из символов, для которых pred(ch) возвращает true
+    template<typename PredType> static
+    char_class_set from_pred( PredType pred )
+    {
+        char_class_set res;
+        for(unsigned i=0; i!=256u; ++i)
+        {
+            if (pred((char)(unsigned char)i))
+                res.add((char)(unsigned char)i);
+        }
+        return res;
+    }
+
+    void add( char ch )
+    {
+        unsigned char uch = (unsigned char)ch;
+        bits[uch>>6] |= std::uint64_t(1)<<(uch&63u);
+    }
+
+    bool test( char ch ) const
+    {
+        unsigned char uch = (unsigned char)ch;
+        return ((bits[uch>>6]>>(uch&63u))&1u)!=0;
+    }
+
+    bool empty() const
+    {
+        return (bits[0]|bits[1]|bits[2]|bits[3])==0;
+    }
+
+}; // struct char_class_set
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace text_normalize_details{
+
+// Маска со старшим битом в каждом нулевом байте (точная, без ложных срабатываний)
+inline
+std::uint64_t swarZeroBytes( std::uint64_t x )
+{
+    const std::uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+    return ~(((x & low7) + low7) | x | low7);
+}
+
+using umba::internal::load64;
+using umba::internal::lowestBitIndex;
+using umba::internal::highestBitIndex;
+
+// Сжатие повторов в блоке из n байт, скопированном в blk. prev - символ перед блоком
+inline
+std::size_t compressBlockScalar( char *pDst, const char *blk, std::size_t n, char prev, const char_class_set &cls )
+{
+    std::size_t w = 0;
+    for(std::size_t j=0; j!=n; ++j)
+    {
+        char ch = blk[j];
+        if (ch!=prev || !cls.test(ch))
+            pDst[w++] = ch;
+        prev = ch;
+    }
+    return w;
+}
+
+} // namespace text_normalize_details
+//! @endcond
+
+
+//----------------------------------------------------------------------------
+//! Подсчитывает количество символов ch в буфере
+inline
+std::size_t count_char( const char *p, std::size_t n, char ch )
+{
+    std::size_t total = 0;
+    std::size_t i     = 0;
+
+    #if defined(UMBA_TEXT_NORMALIZE_SSE2)
+    const __m128i needle = _mm_set1_epi8(ch);
+    while(i+16<=n)
+    {
+        // Счётчики в байтах, поэтому не больше 255 блоков за раз
+        std::size_t numBlocks = (n-i)/16;
+        if (numBlocks>255)
+            numBlocks = 255;
+
+        __m128i acc = _mm_setzero_si128();
+        for(std::size_t k=0; k!=numBlocks; ++k, i+=16)
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p+i)), needle));
+
+        __m128i sad = _mm_sad_epu8(acc, _mm_setzero_si128());
+        total += (std::size_t)_mm_cvtsi128_si32(sad) + (std::size_t)_mm_extract_epi16(sad, 4);
+    }
+    #endif
+
+    for(; i!=n; ++i)
+        total += p[i]==ch ? 1u : 0u;
+
+    return total;
+}
+
+//----------------------------------------------------------------------------
+//! Ищет последний символ ch в буфере. \returns индекс или std::size_t(-1)
+inline
+std::size_t find_last_char( const char *p, std::size_t n, char ch )
+{
+    std::size_t i = n;
+
+    #if defined(UMBA_TEXT_NORMALIZE_SSE2)
+    const __m128i needle = _mm_set1_epi8(ch);
+    while(i>=16)
+    {
+        i -= 16;
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p+i)), needle));
+        if (m)
+            return i + text_normalize_details::highestBitIndex(m);
+    }
+    #endif
+
+    while(i)
+    {
+        --i;
+        if (p[i]==ch)
+            return i;
+    }
+
+    return (std::size_t)-1;
+}
+
+//----------------------------------------------------------------------------
+//! "Сжатие" на месте: последовательность одинаковых символов из класса cls заменяется одним символом. \returns новая длина
+/*! Символ удаляется, если он входит в cls и совпадает с предыдущим символом исходного текста
+ */
+inline
+std::size_t text_compress_runs( char *p, std::size_t n, const char_class_set &cls )
+{
+    using namespace text_normalize_details;
+
+    if (n<2 || cls.empty())
+        return n;
+
+    // Пока ничего не удалено, блоки не переписываем
+    std::size_t w = 1;
+    std::size_t i = 1;
+
+    #if defined(UMBA_TEXT_NORMALIZE_SSE2)
+    for(; i+16<=n; i+=16)
+    {
+        __m128i  cur  = _mm_loadu_si128((const __m128i*)(p+i  ));
+        __m128i  prev = _mm_loadu_si128((const __m128i*)(p+i-1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(cur, prev));
+
+        // Из совпавших соседей оставляем только символы класса - они и удаляются
+        for(unsigned m=mask; m; m&=m-1)
+        {
+            unsigned j = lowestBitIndex(m);
+            if (!cls.test(p[i+j]))
+                mask &= ~(1u<<j);
+        }
+
+        if (!mask)
+        {
+            if (w!=i)
+                _mm_storeu_si128((__m128i*)(p+w), cur);
+            w += 16;
+            continue;
+        }
+
+        alignas(16) char blk[16];
+        _mm_store_si128((__m128i*)blk, cur);
+        for(unsigned j=0; j!=16u; ++j)
+        {
+            if (!((mask>>j)&1u))
+                p[w++] = blk[j];
+        }
+    }
+    #endif
+
+    for(; i+8<=n; i+=8)
+    {
+        std::uint64_t cur = load64(p+i);
+        if (!swarZeroBytes(cur ^ load64(p+i-1)))
+        {
+            if (w!=i)
+                std::memmove(p+w, p+i, 8);
+            w += 8;
+            continue;
+        }
+
+        char blk[8];
+        std::memcpy(blk, p+i, 8);
+        w += compressBlockScalar(p+w, blk, 8, p[i-1], cls);
+    }
+
+    for(; i!=n; ++i)
+    {
+        char ch = p[i];
+        if (ch!=p[i-1] || !cls.test(ch))
+            p[w++] = ch;
+    }
+
+    return w;
+}
+
+//! "Сжатие" строки на месте
+inline
+void text_compress_runs( std::string &text, const char_class_set &cls )
+{
+    if (text.empty())
+        return;
+    text.resize(text_compress_runs(&text[0], text.size(), cls));
+}
+
+//----------------------------------------------------------------------------
+//! Дописывает в out текст с отступом: firstIndent - перед первой строкой, indent - после каждого '\n'
+inline
+void text_add_indent_to( std::string &out, const char *p, std::size_t n, std::string_view indent, std::string_view firstIndent )
+{
+    if (!n)
+        return;
+
+    std::size_t numLf  = indent.empty() ? 0 : count_char(p, n, '\n');
+    std::size_t outPos = out.size();
+    out.resize(outPos + n + firstIndent.size() + numLf*indent.size());
+
+    char *pOut = &out[0]+outPos;
+    std::memcpy(pOut, firstIndent.data(), firstIndent.size());
+    pOut += firstIndent.size();
+
+    if (!numLf)
+    {
+        std::memcpy(pOut, p, n);
+        return;
+    }
+
+    const char *pEnd = p+n;
+    for(;;)
+    {
+        const char *pLf = (const char*)std::memchr(p, '\n', (std::size_t)(pEnd-p));
+        if (!pLf)
+        {
+            std::memcpy(pOut, p, (std::size_t)(pEnd-p));
+            return;
+        }
+
+        std::size_t len = (std::size_t)(pLf+1-p);
+        std::memcpy(pOut, p, len);
+        pOut += len;
+        std::memcpy(pOut, indent.data(), indent.size());
+        pOut += indent.size();
+        p     = pLf+1;
+    }
+}
+
+//! Добавляет отступ на месте: firstIndent - перед первой строкой, indent - после каждого '\n'
+/*! Строка расширяется один раз, текст сдвигается от конца к началу
+ */
+inline
+void text_add_indent( std::string &text, std::string_view indent, std::string_view firstIndent )
+{
+    std::size_t n = text.size();
+    if (!n)
+        return;
+
+    std::size_t numLf = indent.empty() ? 0 : count_char(text.data(), n, '\n');
+    std::size_t dst   = n + firstIndent.size() + numLf*indent.size();
+    text.resize(dst);
+
+    char *p = &text[0];
+
+    if (numLf)
+    {
+        std::size_t end = n; // Конец переносимого куска (не включая)
+        std::size_t lf  = find_last_char(p, n, '\n');
+        while(lf!=(std::size_t)-1)
+        {
+            std::size_t len = end-(lf+1);
+            dst -= len;
+            std::memmove(p+dst, p+lf+1, len);
+            dst -= indent.size();
+            std::memcpy(p+dst, indent.data(), indent.size());
+            end = lf+1;
+            lf  = find_last_char(p, lf, '\n');
+        }
+        n = end;
+    }
+
+    std::memmove(p+firstIndent.size(), p, n);
+    std::memcpy(p, firstIndent.data(), firstIndent.size());
+}
+
+//! Добавляет отступ на месте перед каждой строкой
+inline
+void text_add_indent( std::string &text, std::string_view indent )
+{
+    text_add_indent(text, indent, indent);
+}
+
+//----------------------------------------------------------------------------
+//! Возвращает длину отступа строки - количество начальных символов из класса spaces
+inline
+std::size_t text_line_indent_size( const char *p, std::size_t n, const char_class_set &spaces )
+{
+    std::size_t i = 0;
+    while(i!=n && spaces.test(p[i]))
+        ++i;
+    return i;
+}
+
+//----------------------------------------------------------------------------
+//! Удаляет на месте общий для всех строк отступ из символов класса spaces. \returns новая длина
+/*! Строки разделяются '\n'. Пустые строки тоже учитываются (как и в text_utils::textStripCommonIndent),
+    кусок после последнего '\n' считается строкой, только если он не пуст
+ */
+inline
+std::size_t text_strip_common_indent( char *p, std::size_t n, const char_class_set &spaces )
+{
+    if (!n)
+        return n;
+
+    const char *pEnd = p+n;
+
+    std::size_t minIndent = (std::size_t)-1;
+    for(const char *pLine=p; pLine!=pEnd && minIndent; )
+    {
+        const char *pLf      = (const char*)std::memchr(pLine, '\n', (std::size_t)(pEnd-pLine));
+        const char *pLineEnd = pLf ? pLf : pEnd;
+
+        std::size_t indent = text_line_indent_size(pLine, (std::size_t)(pLineEnd-pLine), spaces);
+        if (indent<minIndent)
+            minIndent = indent;
+
+        pLine = pLf ? pLf+1 : pEnd;
+    }
+
+    if (!minIndent || minIndent==(std::size_t)-1)
+        return n;
+
+    std::size_t w = 0;
+    for(const char *pLine=p; pLine!=pEnd; )
+    {
+        const char *pLf   = (const char*)std::memchr(pLine, '\n', (std::size_t)(pEnd-pLine));
+        const char *pNext = pLf ? pLf+1 : pEnd;
+
+        std::size_t len = (std::size_t)(pNext-pLine) - minIndent;
+        std::memmove(p+w, pLine+minIndent, len);
+        w    += len;
+        pLine = pNext;
+    }
+
+    return w;
+}
+
+//! Удаляет на месте общий для всех строк отступ из символов класса spaces
+inline
+void text_strip_common_indent( std::string &text, const char_class_set &spaces )
+{
+    if (text.empty())
+        return;
+    text.resize(text_strip_common_indent(&text[0], text.size(), spaces));
+}
+
+
+} // namespace string_plus
+} // namespace umba
+
@@ -13,13 +13,21 @@
 // #include "case.h"
 
 #include "string_plus.h"
+#include "transliteration.h"
 #include "utf.h"
 #include "debug_helpers.h"
 //
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <iterator>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 // umba::text_utils::
 namespace umba{
@@ -80,6 +88,25 @@ void textStripCommonIndent(std::vector<StringType> &v, SpacePredType pred)
         s.erase(0, minIndentLen);
 }
 
+//-----------------------------------------------------------------------------
+//! Версия для std::string - предикат один раз переводится в таблицу класса символов
+template<typename SpacePredType> inline
+void textStripCommonIndent(std::vector<std::string> &v, SpacePredType pred)
+{
+    const umba::string_plus::char_class_set spaces = umba::string_plus::char_class_set::from_pred(pred);
+
+    std::size_t minIndentLen = (std::size_t)-1;
+    for(auto && s : v)
+    {
+        minIndentLen = std::min(minIndentLen, umba::string_plus::text_line_indent_size(s.data(), s.size(), spaces));
+        if (!minIndentLen)
+            return;
+    }
+
+    for(auto & s : v)
+        s.erase(0, minIndentLen);
+}
+
 //-----------------------------------------------------------------------------
 template<typename StringType, typename SpacePredType> inline
 std::vector<StringType> textStripCommonIndentCopy(const std::vector<StringType> &v, SpacePredType pred)
@@ -94,20 +121,7 @@ inline
 std::string textAddIndent(const std::string &text, const std::string &indent)
 {
     std::string res;
-
-    // (text.size()/40) - кол-во строк навскидку
-    res.reserve( text.size() + (text.size()/40) * indent.size());
-
-    if (!text.empty())
-        res = indent;
-
-    for( char ch : text)
-    {
-        res.append(1,ch);
-        if (ch=='\n')
-            res.append(indent);
-    }
-
+    umba::string_plus::text_add_indent_to(res, text.data(), text.size(), indent, indent);
     return res;
 }
 
@@ -116,20 +130,7 @@ inline
 std::string textAddIndent(const std::string &text, const std::string &indent, const std::string &firstIndent)
 {
     std::string res;
-
-    // (text.size()/40) - кол-во строк навскидку
-    res.reserve( text.size() + (text.size()/40) * indent.size());
-
-    if (!text.empty())
-        res = firstIndent;
-
-    for( char ch : text)
-    {
-        res.append(1,ch);
-        if (ch=='\n')
-            res.append(indent);
-    }
-
+    umba::string_plus::text_add_indent_to(res, text.data(), text.size(), indent, firstIndent);
     return res;
 }
 
@@ -148,8 +149,16 @@ std::string compareStringsCasePrepare( const std::string &s, bool ci )
 }
 
 //-----------------------------------------------------------------------------
-//inline
-//int compareStringsCaseNoCase( const std::string &s1, const std::string &s2, bool ci )
+//! Сравнивает строки с учетом или без учета регистра, без создания копий. \returns -1, 0, 1
+inline
+int compareStringsCase( const std::string &s1, const std::string &s2, bool ci )
+{
+    if (ci)
+        return umba::string_plus::icase_compare(s1, s2);
+
+    int res = s1.compare(s2);
+    return res<0 ? -1 : (res>0 ? 1 : 0);
+}
 
 //-----------------------------------------------------------------------------
 struct StringsLess
@@ -158,7 +167,7 @@ struct StringsLess
     StringsLess( bool bCI = true ) : bCaseIgnore(bCI) {}
     bool operator()( const std::string &s1, const std::string &s2 ) const
     {
-        return compareStringsCasePrepare(s1,bCaseIgnore) < compareStringsCasePrepare(s2,bCaseIgnore);
+        return compareStringsCase(s1,s2,bCaseIgnore) < 0;
     }
 };
 
@@ -168,7 +177,7 @@ struct StringsGreater
     StringsGreater( bool bCI = true ) : bCaseIgnore(bCI) {}
     bool operator()( const std::string &s1, const std::string &s2 ) const
     {
-        return compareStringsCasePrepare(s1,bCaseIgnore) > compareStringsCasePrepare(s2,bCaseIgnore);
+        return compareStringsCase(s1,s2,bCaseIgnore) > 0;
     }
 };
 
@@ -183,7 +192,7 @@ struct StringsLessFirstBySize
             return true;
         if (s1.size()>s2.size())
             return false;
-        return compareStringsCasePrepare(s1,bCaseIgnore) < compareStringsCasePrepare(s2,bCaseIgnore);
+        return compareStringsCase(s1,s2,bCaseIgnore) < 0;
     }
 };
 
@@ -197,32 +206,267 @@ struct StringsGreaterFirstBySize
             return true;
         if (s1.size()<s2.size())
             return false;
-        return compareStringsCasePrepare(s1,bCaseIgnore) > compareStringsCasePrepare(s2,bCaseIgnore);
+        return compareStringsCase(s1,s2,bCaseIgnore) > 0;
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Ключи сортировки (collation keys)
+/*
+    Ключ строится один раз на строку и хранится рядом со значением, дальше сравниваются
+    только ключи - побайтно (memcmp), без повторного приведения регистра на каждом сравнении.
+
+    Порядок по ключам без свёртки кириллицы совпадает с порядком StringsLess(true).
+ */
+
+//------------------------------
+//! Таблица свёртки двухбайтовых символов UTF-8 (U+0080-U+07FF), строится из карты транслитерации
+/*! Из карты берутся только пары, где и исходный символ, и замена - двухбайтовые символы UTF-8,
+    поэтому свёртка не меняет длину строки и выполняется на месте.
+ */
+class Utf8TwoByteFoldTable
+{
+
+public:
+
+    //! Строит таблицу из карты транслитерации (например, getLowercaseMapUtf8_ru())
+    explicit Utf8TwoByteFoldTable( const std::unordered_map<std::string, std::string> &m )
+    : m_table(tableSize)
+    {
+        for(std::size_t i=0; i!=tableSize; ++i)
+            m_table[i] = (std::uint16_t)i;
+
+        std::unordered_map<std::string, std::string>::const_iterator it = m.begin();
+        for(; it!=m.end(); ++it)
+        {
+            if (!isTwoByteChar(it->first) || !isTwoByteChar(it->second))
+                continue;
+            m_table[decode(it->first[0], it->first[1])] = decode(it->second[0], it->second[1]);
+        }
+    }
+
+    //! Сворачивает двухбайтовые символы в буфере (на месте)
+    void fold( char *p, std::size_t n ) const
+    {
+        for(std::size_t i=0; i+1<n; ++i)
+        {
+            unsigned char b0 = (unsigned char)p[i];
+            if (b0<0xC0u || b0>0xDFu)
+                continue;
+
+            unsigned char b1 = (unsigned char)p[i+1];
+            if ((b1&0xC0u)!=0x80u)
+                continue;
+
+            std::uint16_t cp = m_table[decode((char)b0, (char)b1)];
+            p[i]   = (char)(0xC0u | (cp>>6));
+            p[i+1] = (char)(0x80u | (cp&0x3Fu));
+            ++i;
+        }
+    }
+
+
+protected:
+
+    static const std::size_t tableSize = 0x800;
+
+    static bool isTwoByteChar( const std::string &s )
+    {
+        if (s.size()!=2)
+            return false;
+        unsigned char b0 = (unsigned char)s[0];
+        unsigned char b1 = (unsigned char)s[1];
+        return b0>=0xC2u && b0<=0xDFu && (b1&0xC0u)==0x80u;
+    }
+
+    static std::uint16_t decode( char b0, char b1 )
+    {
+        return (std::uint16_t)((((unsigned char)b0&0x1Fu)<<6) | ((unsigned char)b1&0x3Fu));
+    }
+
+    std::vector<std::uint16_t>  m_table;
+
+}; // class Utf8TwoByteFoldTable
+
+//------------------------------
+//! Таблица свёртки кириллицы в нижний регистр (по getLowercaseMapUtf8_ru())
+inline
+const Utf8TwoByteFoldTable& getCyrillicLowercaseFoldTable()
+{
+    static Utf8TwoByteFoldTable t = Utf8TwoByteFoldTable(getLowercaseMapUtf8_ru());
+    return t;
+}
+
+//------------------------------
+//! Построитель ключей сортировки: свёртка регистра ASCII и, опционально, кириллицы (UTF-8)
+struct CollationKeyBuilder
+{
+    bool bFoldCyrillic;
+
+    CollationKeyBuilder( bool bFoldCyr = false ) : bFoldCyrillic(bFoldCyr) {}
+
+    //! Строит ключ в буфер key (буфер переиспользуется)
+    void operator()( std::string &key, std::string_view str ) const
+    {
+        key.resize(str.size());
+        if (str.empty())
+            return;
+
+        umba::string_plus::ascii_tolower_copy(&key[0], str.data(), str.size());
+        if (bFoldCyrillic)
+            getCyrillicLowercaseFoldTable().fold(&key[0], key.size());
+    }
+
+    //! Возвращает ключ
+    std::string operator()( std::string_view str ) const
+    {
+        std::string key;
+        operator()(key, str);
+        return key;
     }
 };
 
+//------------------------------
+//! Строит ключ сортировки для строки
+inline
+std::string makeCollationKey( std::string_view str, bool bFoldCyrillic = false )
+{
+    return CollationKeyBuilder(bFoldCyrillic)(str);
+}
+
+//------------------------------
+//! Первые 8 байт ключа (big endian, с дополнением нулями) - сравнение таких чисел совпадает с memcmp префиксов
+inline
+std::uint64_t getCollationKeyPrefix( std::string_view key )
+{
+    std::uint64_t prefix = 0;
+    for(std::size_t j=0; j!=8; ++j)
+        prefix = (prefix<<8) | (j<key.size() ? (std::uint64_t)(unsigned char)key[j] : 0u);
+    return prefix;
+}
+
+//------------------------------
+//! Сравнение ключей: сначала префиксы, затем (при равенстве) ключи целиком
+inline
+int compareCollationKeys( std::uint64_t prefix1, std::string_view key1, std::uint64_t prefix2, std::string_view key2 )
+{
+    if (prefix1!=prefix2)
+        return prefix1<prefix2 ? -1 : 1;
+    return key1.compare(key2);
+}
+
+//------------------------------
+//! Сортировка по ключам: ключи строятся один раз на элемент, дальше сравниваются через memcmp
+/*! KeyBuilder - функтор вида void(std::string &key, const ValueType &val).
+    Элементы с равными ключами сохраняют исходный порядок.
+ */
+template<typename RandomIt, typename KeyBuilder> inline
+void keyed_sort( RandomIt b, RandomIt e, const KeyBuilder &keyBuilder )
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type ValueType;
+
+    struct SortItem
+    {
+        std::uint64_t   prefix; // первые 8 байт ключа, big endian - сравниваются как число
+        std::size_t     offset;
+        std::size_t     size;
+        std::size_t     idx;
+    };
+
+    const std::size_t n = (std::size_t)(e-b);
+    if (n<2)
+        return;
+
+    std::string            keys;
+    std::string            key;
+    std::vector<SortItem>  items;
+    items.reserve(n);
+
+    for(std::size_t i=0; i!=n; ++i)
+    {
+        keyBuilder(key, b[i]);
+        items.push_back(SortItem{getCollationKeyPrefix(key), keys.size(), key.size(), i});
+        keys.append(key);
+    }
+
+    const char *pKeys = keys.data();
+    std::sort( items.begin(), items.end()
+             , [pKeys]( const SortItem &i1, const SortItem &i2 )
+               {
+                   int res = compareCollationKeys( i1.prefix, std::string_view(pKeys+i1.offset, i1.size)
+                                                 , i2.prefix, std::string_view(pKeys+i2.offset, i2.size)
+                                                 );
+                   return res!=0 ? res<0 : i1.idx<i2.idx;
+               }
+             );
+
+    std::vector<ValueType> tmp;
+    tmp.reserve(n);
+    for(const auto &item : items)
+        tmp.emplace_back(std::move(b[item.idx]));
+
+    std::move(tmp.begin(), tmp.end(), b);
+}
+
+//------------------------------
+//! Сортировка строк по ключам сортировки (регистронезависимо, опционально со свёрткой кириллицы)
+template<typename RandomIt> inline
+void keyed_sort( RandomIt b, RandomIt e, bool bFoldCyrillic = false )
+{
+    keyed_sort(b, e, CollationKeyBuilder(bFoldCyrillic));
+}
+
 //-----------------------------------------------------------------------------
 #include "umba/warnings/push_disable_spectre_mitigation.h"
 //! Расширяет строку до заданной длины, вставляя дополнительные пробелы
 inline
 std::string expandStringWidth( std::string str, std::string::size_type width )
 {
+    if (str.size()>=width)
+        return str;
+
+    const char *pBegin = str.data();
+    const char *pEnd   = pBegin+str.size();
 
-    while(str.size() < width)
+    // Пробелы добавляются по одному в каждую серию пробелов слева направо, пока не наберётся нужная ширина -
+    // т.е. каждая серия получает extra/numRuns пробелов, а первые extra%numRuns серий - ещё по одному
+    std::size_t numRuns = 0;
+    for(const char *p=pBegin; (p=(const char*)std::memchr(p, ' ', (std::size_t)(pEnd-p)))!=0; )
     {
-        std::string::size_type i = 0;
-        for( ; i!=str.size() && str.size()<width; ++i)
+        ++numRuns;
+        while(p!=pEnd && *p==' ') ++p;
+    }
+
+    if (!numRuns)
+        return str;
+
+    std::size_t extra     = width-str.size();
+    std::size_t perRun    = extra/numRuns;
+    std::size_t numLonger = extra%numRuns;
+
+    std::string res;
+    res.reserve(width);
+
+    std::size_t runIdx = 0;
+    for(const char *p=pBegin; p!=pEnd; )
+    {
+        const char *pSpace = (const char*)std::memchr(p, ' ', (std::size_t)(pEnd-p));
+        if (!pSpace)
         {
-            if (str[i]==' ')
-            {
-                str.insert( i, 1, ' ');
-                while( i!=str.size() && str[i]==' ') ++i;
-                --i;
-            }
+            res.append(p, (std::size_t)(pEnd-p));
+            break;
         }
+
+        res.append(p, (std::size_t)(pSpace-p));
+        res.append(perRun + (runIdx<numLonger ? 1u : 0u), ' ');
+        ++runIdx;
+
+        p = pSpace;
+        while(p!=pEnd && *p==' ') ++p;
+        res.append(pSpace, (std::size_t)(p-pSpace));
     }
 
-    return str;
+    return res;
 }
 #include "umba/warnings/pop.h"
 
@@ -524,38 +768,9 @@ std::string textAppendDot( std::string text )
 inline
 std::string textCompress( const std::string &text, const std::string &compressChars )
 {
-    std::string res;
-
-    std::string::size_type i = 0, sz = text.size();
-
-    char prevWs = 0;
-
-    for(; i!=sz; ++i)
-    {
-        char ch = text[i];
-        std::string::size_type chPos = compressChars.find(ch);
-        //if (ch==' ' || ch=='\t')
-        if (chPos!=compressChars.npos)
-        {
-            if (ch==prevWs)
-            {
-                // simple skip
-            }
-            else
-            {
-                prevWs = ch;
-                res.append(1,ch);
-            }
-        }
-        else
-        {
-            prevWs = 0;
-            res.append(1,ch);
-        }
-    }
-
+    std::string res = text;
+    umba::string_plus::text_compress_runs(res, umba::string_plus::char_class_set(compressChars));
     return res;
-
 }
 
 inline
@@ -21,6 +21,7 @@
 #endif
 
 #if defined(UMBA_LINUX_USED)
+    #include <errno.h>
     #include <time.h>
     #include <unistd.h>
 #endif
@@ -127,6 +128,44 @@ namespace time_service{
 
     #elif defined(UMBA_LINUX_USED)
 
+        #if !defined(UMBA_TIME_SERVICE_COARSE_CLOCK_MAX_RESOLUTION_US)
+            //! Максимальное разрешение CLOCK_MONOTONIC_COARSE, при котором он используется для getCurTimeMs. 0 - не использовать
+            #define UMBA_TIME_SERVICE_COARSE_CLOCK_MAX_RESOLUTION_US   1000
+        #endif
+
+        //! Часы для милисекундных тиков
+        /*! CLOCK_MONOTONIC_COARSE читается из vDSO без обращения к аппаратному счётчику, но его разрешение
+            равно периоду системного тика (1-10 мс). Он используется, только если его разрешение не хуже
+            UMBA_TIME_SERVICE_COARSE_CLOCK_MAX_RESOLUTION_US
+         */
+        static
+        clockid_t getMsClockId()
+        {
+            static const clockid_t clockId = []()
+            {
+                #if defined(CLOCK_MONOTONIC_COARSE)
+                    timespec res;
+                    res.tv_sec  = 0;
+                    res.tv_nsec = 0;
+                    if ( UMBA_TIME_SERVICE_COARSE_CLOCK_MAX_RESOLUTION_US>0
+                      && clock_getres(CLOCK_MONOTONIC_COARSE, &res)==0
+                      && res.tv_sec==0
+                      && res.tv_nsec<=(long)UMBA_TIME_SERVICE_COARSE_CLOCK_MAX_RESOLUTION_US*1000l
+                       )
+                    {
+                        return (clockid_t)CLOCK_MONOTONIC_COARSE;
+                    }
+                #endif
+                return (clockid_t)CLOCK_MONOTONIC;
+            }();
+
+            return clockId;
+        }
+
+        void init() {}
+        void start() {}
+        void stop() {}
+
         TimeTick ticksToMs(TimeTick ticks)
         {
             return ticks;
@@ -143,7 +182,7 @@ namespace time_service{
             ts.tv_sec  = 0;
             ts.tv_nsec = 0;
 
-            clock_gettime( CLOCK_MONOTONIC, &ts );
+            clock_gettime( getMsClockId(), &ts );
 
             return 1000ul*(TimeTick)ts.tv_sec + (TimeTick)(ts.tv_nsec/1000000l);
         }
@@ -166,7 +205,22 @@ namespace time_service{
 
         void   delayMs(TimeTick deltaMs)
         {
-            usleep( deltaMs*1000 );
+            // usleep не принимает больше секунды, и при прерывании сигналом спит меньше.
+            // Спим до абсолютного момента, повторяя после сигналов
+            timespec deadline;
+            deadline.tv_sec  = 0;
+            deadline.tv_nsec = 0;
+            clock_gettime( CLOCK_MONOTONIC, &deadline );
+
+            deadline.tv_sec  += (time_t)(deltaMs/1000u);
+            deadline.tv_nsec += (long)(deltaMs%1000u)*1000000l;
+            if (deadline.tv_nsec>=1000000000l)
+            {
+                deadline.tv_sec  += 1;
+                deadline.tv_nsec -= 1000000000l;
+            }
+
+            while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0)==EINTR) {}
         }
 
         void delay_ms(TimeTick delta)
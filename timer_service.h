@@ -0,0 +1,612 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Иерархическое колесо таймеров и сервис таймеров на базе timerfd (Linux)
+
+    Repository: https://github.com/al-martyn1/umba
+
+    TimerWheel - платформонезависимое колесо таймеров с разрешением 1 мс: 4 уровня по 64 слота
+    (около 4.6 часов) и список для более дальних таймеров. Добавление и отмена таймера - O(1),
+    продвижение времени - O(количество сработавших таймеров) плюс не более одного шага на каждые 64 мс.
+    Сработавшие таймеры вызывают ITimerHandler::onTimer(eventId).
+
+    TimerService (только Linux) - колесо таймеров плюс timerfd, взведённый на ближайший момент срабатывания.
+    Дескриптор можно добавить в epoll/poll своего цикла событий и вызывать processEvents(), когда он готов к чтению,
+    или крутить runOnce() в отдельном потоке.
+
+    \code
+    umba::time_service::TimerService timers;
+
+    auto h = umba::makeSimpleTimerHandler( [&](umba::ITimerHandler*, unsigned id) { onTick(id); } );
+
+    auto tid = timers.addTimer( &h, 1, 100, 100 ); // Через 100 мс, затем каждые 100 мс
+    ...
+    timers.cancelTimer(tid);
+    \endcode
+
+    Все методы TimerWheel и TimerService вызываются из одного потока (как правило - из обработчиков
+    и из потока, который вызывает processEvents/runOnce).
+ */
+
+#pragma once
+
+#include "basic_interfaces.h"
+#include "preprocessor.h"
+#include "time_service.h"
+#include "zz_detect_environment.h"
+#include "internal/bit_utils.h"
+//
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(UMBA_LINUX_USED)
+    #include <errno.h>
+    #include <poll.h>
+    #include <sys/timerfd.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+
+// umba::time_service::
+namespace umba{
+namespace time_service{
+
+
+
+//----------------------------------------------------------------------------
+typedef uint64_t  TimerId; //!< Идентификатор таймера. 0 - неверный идентификатор
+
+const TimerId invalidTimerId = 0;
+
+//----------------------------------------------------------------------------
+
+
+
+
+//----------------------------------------------------------------------------
+//! Иерархическое колесо таймеров
+/*!
+    Время - монотонные милисекунды (uint64_t), задаваемые пользователем: advance(nowMs) обрабатывает все таймеры,
+    срок которых не позже nowMs. Обработчик может добавлять и отменять любые таймеры, в том числе свой.
+
+    Таймер с периодом срабатывает повторно через period мс от предыдущего срока; если обработка отстала
+    больше, чем на период, пропущенные срабатывания не повторяются.
+ */
+class TimerWheel
+{
+    public:
+
+        static const unsigned levelBits = 6;                   //!< log2 количества слотов уровня
+        static const unsigned numSlots  = 1u<<levelBits;       //!< Слотов на уровне
+        static const unsigned numLevels = 4;                   //!< Количество уровней
+
+        //! Конструктор. nowMs - начальное время колеса
+        explicit TimerWheel( uint64_t nowMs = 0 )
+        : m_curTime(nowMs)
+        , m_numTimers(0)
+        {
+            m_links.resize(firstNodeIdx);
+            for(uint32_t i=0; i!=firstNodeIdx; ++i)
+            {
+                m_links[i].prev = i;
+                m_links[i].next = i;
+            }
+            m_nodes.resize(firstNodeIdx);
+
+            for(auto &bm : m_bitmaps)
+                bm = 0;
+        }
+
+        //! Добавляет таймер со сроком expiresMs (абсолютное время колеса). period - 0 для однократного таймера
+        TimerId addTimerAt( ITimerHandler *pHandler, unsigned eventId, uint64_t expiresMs, uint64_t periodMs = 0 )
+        {
+            uint32_t idx = 0;
+            if (!m_freeNodes.empty())
+            {
+                idx = m_freeNodes.back();
+                m_freeNodes.pop_back();
+            }
+            else
+            {
+                idx = (uint32_t)m_links.size();
+                m_links.emplace_back();
+                m_nodes.emplace_back();
+            }
+
+            Node &n = m_nodes[idx];
+            n.pHandler  = pHandler;
+            n.eventId   = eventId;
+            n.expires   = expiresMs;
+            n.period    = periodMs;
+            n.generation += 1;
+            if (!n.generation)
+                n.generation = 1;
+            n.bActive   = true;
+
+            insertNode(idx);
+            ++m_numTimers;
+
+            return makeTimerId(idx, n.generation);
+        }
+
+        //! Добавляет таймер, срабатывающий через delayMs от текущего времени колеса
+        TimerId addTimer( ITimerHandler *pHandler, unsigned eventId, uint64_t delayMs, uint64_t periodMs = 0 )
+        {
+            return addTimerAt(pHandler, eventId, m_curTime+delayMs, periodMs);
+        }
+
+        //! Отменяет таймер. Возвращает false, если таймер уже сработал (однократный) или отменён
+        bool cancelTimer( TimerId id )
+        {
+            uint32_t idx = getNodeIdx(id);
+            if (!idx)
+                return false;
+
+            unlinkNode(idx);
+            freeNode(idx);
+            return true;
+        }
+
+        //! Проверяет, активен ли таймер
+        bool isTimerActive( TimerId id ) const
+        {
+            return getNodeIdx(id)!=0;
+        }
+
+        //! Количество активных таймеров
+        std::size_t size() const { return m_numTimers; }
+
+        bool empty() const { return m_numTimers==0; }
+
+        //! Текущее время колеса - время последнего advance
+        uint64_t getCurTime() const { return m_curTime; }
+
+        //! Продвигает время колеса до nowMs, вызывая обработчики сработавших таймеров. Возвращает количество срабатываний
+        std::size_t advance( uint64_t nowMs )
+        {
+            std::size_t fired = 0;
+
+            while(m_curTime<nowMs)
+            {
+                if (!m_numTimers)
+                {
+                    m_curTime = nowMs;
+                    break;
+                }
+
+                // Следующий занятый слот нулевого уровня в текущем обороте или граница оборота (каскадирование)
+                const uint64_t base = m_curTime & ~(uint64_t)(numSlots-1);
+                const unsigned idx0 = (unsigned)(m_curTime & (numSlots-1));
+                const uint64_t bits = idx0==numSlots-1 ? 0 : (m_bitmaps[0] & (~(uint64_t)0 << (idx0+1)));
+                const uint64_t next = bits ? base + umba::internal::lowestBitIndex64(bits) : base + numSlots;
+
+                if (next>nowMs)
+                {
+                    m_curTime = nowMs;
+                    break;
+                }
+
+                m_curTime = next;
+
+                if (!(m_curTime & (numSlots-1)))
+                    cascade();
+
+                fired += expireSlot(slotListIdx(0, (unsigned)(m_curTime & (numSlots-1))));
+            }
+
+            return fired;
+        }
+
+        //! Возвращает время (абсолютное), не позже которого сработает ближайший таймер, или false, если таймеров нет
+        /*! Для таймеров нулевого уровня время точное, для остальных - время их каскадирования (не позже срока)
+         */
+        bool getNextExpiry( uint64_t &t ) const
+        {
+            if (!m_numTimers)
+                return false;
+
+            bool found = false;
+
+            for(unsigned level=0; level!=numLevels; ++level)
+            {
+                if (!m_bitmaps[level])
+                    continue;
+
+                const unsigned shift    = level*levelBits;
+                const unsigned revShift = shift+levelBits;
+                const unsigned idx      = (unsigned)((m_curTime>>shift) & (numSlots-1));
+                const uint64_t rev      = m_curTime>>revShift;
+
+                const uint64_t hi = idx==numSlots-1 ? 0 : (m_bitmaps[level] & (~(uint64_t)0 << (idx+1)));
+
+                uint64_t slotTime = 0;
+                if (hi)
+                    slotTime = (rev<<revShift) + ((uint64_t)umba::internal::lowestBitIndex64(hi)<<shift);
+                else
+                    slotTime = ((rev+1)<<revShift) + ((uint64_t)umba::internal::lowestBitIndex64(m_bitmaps[level])<<shift);
+
+                if (!found || slotTime<t)
+                {
+                    t     = slotTime;
+                    found = true;
+                }
+            }
+
+            if (m_links[overflowListIdx].next!=overflowListIdx)
+            {
+                const unsigned revShift = numLevels*levelBits;
+                const uint64_t ovfTime  = ((m_curTime>>revShift)+1)<<revShift;
+                if (!found || ovfTime<t)
+                {
+                    t     = ovfTime;
+                    found = true;
+                }
+            }
+
+            // Таймеры с уже прошедшим сроком стоят в слоте следующей милисекунды
+            return found;
+        }
+
+
+    protected:
+
+        struct Link
+        {
+            uint32_t  prev = 0;
+            uint32_t  next = 0;
+        };
+
+        struct Node
+        {
+            ITimerHandler  *pHandler   = 0;
+            uint64_t        expires    = 0;
+            uint64_t        period     = 0;
+            unsigned        eventId    = 0;
+            uint32_t        generation = 0;
+            uint16_t        listIdx    = 0;   //!< Список, в котором находится узел
+            bool            bActive    = false;
+        };
+
+        // Первые элементы m_links - головы списков: слоты уровней, список дальних таймеров, список срабатывающих
+        static const uint32_t overflowListIdx = numLevels*numSlots;
+        static const uint32_t pendingListIdx  = overflowListIdx+1;
+        static const uint32_t firstNodeIdx    = pendingListIdx+1;
+
+        static uint32_t slotListIdx( unsigned level, unsigned slot )
+        {
+            return level*numSlots + slot;
+        }
+
+        static TimerId makeTimerId( uint32_t idx, uint32_t generation )
+        {
+            return ((TimerId)generation<<32) | (TimerId)idx;
+        }
+
+        uint32_t getNodeIdx( TimerId id ) const
+        {
+            const uint32_t idx = (uint32_t)(id & 0xFFFFFFFFu);
+            const uint32_t gen = (uint32_t)(id>>32);
+            if (idx<firstNodeIdx || idx>=m_nodes.size())
+                return 0;
+            const Node &n = m_nodes[idx];
+            if (!n.bActive || n.generation!=gen)
+                return 0;
+            return idx;
+        }
+
+        void linkNode( uint32_t listIdx, uint32_t idx )
+        {
+            const uint32_t tail = m_links[listIdx].prev;
+            m_links[idx].prev  = tail;
+            m_links[idx].next  = listIdx;
+            m_links[tail].next = idx;
+            m_links[listIdx].prev = idx;
+            m_nodes[idx].listIdx = (uint16_t)listIdx;
+
+            if (listIdx<overflowListIdx)
+                m_bitmaps[listIdx/numSlots] |= (uint64_t)1<<(listIdx%numSlots);
+        }
+
+        void unlinkNode( uint32_t idx )
+        {
+            const uint32_t prev = m_links[idx].prev;
+            const uint32_t next = m_links[idx].next;
+            m_links[prev].next = next;
+            m_links[next].prev = prev;
+            m_links[idx].prev = idx;
+            m_links[idx].next = idx;
+
+            const uint32_t listIdx = m_nodes[idx].listIdx;
+            if (listIdx<overflowListIdx && m_links[listIdx].next==listIdx)
+                m_bitmaps[listIdx/numSlots] &= ~((uint64_t)1<<(listIdx%numSlots));
+        }
+
+        void freeNode( uint32_t idx )
+        {
+            Node &n = m_nodes[idx];
+            n.bActive  = false;
+            n.pHandler = 0;
+            m_freeNodes.push_back(idx);
+            --m_numTimers;
+        }
+
+        //! Помещает узел в слот по сроку относительно текущего времени колеса
+        /*! bCascading - узел переносится с верхнего уровня перед обработкой слота текущей милисекунды,
+            и таймер со сроком, равным текущему времени, должен сработать в ней же
+         */
+        void insertNode( uint32_t idx, bool bCascading = false )
+        {
+            const uint64_t expires = m_nodes[idx].expires;
+
+            if (expires==m_curTime && bCascading)
+            {
+                linkNode(slotListIdx(0, (unsigned)(m_curTime & (numSlots-1))), idx);
+                return;
+            }
+
+            if (expires<=m_curTime)
+            {
+                // Срок прошёл - сработает на следующей милисекунде
+                linkNode(slotListIdx(0, (unsigned)((m_curTime+1) & (numSlots-1))), idx);
+                return;
+            }
+
+            const uint64_t delta = expires - m_curTime;
+            for(unsigned level=0; level!=numLevels; ++level)
+            {
+                const unsigned revShift = (level+1)*levelBits;
+                if (delta < ((uint64_t)1<<revShift))
+                {
+                    linkNode(slotListIdx(level, (unsigned)((expires>>(level*levelBits)) & (numSlots-1))), idx);
+                    return;
+                }
+            }
+
+            linkNode(overflowListIdx, idx);
+        }
+
+        //! Переносит все узлы списка в нижние уровни
+        void cascadeList( uint32_t listIdx )
+        {
+            // Дальние таймеры могут вернуться в тот же список - идём только по исходным узлам
+            uint32_t idx = m_links[listIdx].next;
+            const uint32_t last = m_links[listIdx].prev;
+            while(idx!=listIdx)
+            {
+                const uint32_t next = m_links[idx].next;
+                unlinkNode(idx);
+                insertNode(idx, true);
+                if (idx==last)
+                    break;
+                idx = next;
+            }
+        }
+
+        //! Каскадирование на границе оборота нулевого уровня
+        void cascade()
+        {
+            for(unsigned level=1; level!=numLevels; ++level)
+            {
+                const unsigned idx = (unsigned)((m_curTime>>(level*levelBits)) & (numSlots-1));
+                cascadeList(slotListIdx(level, idx));
+                if (idx)
+                    return;
+            }
+
+            cascadeList(overflowListIdx);
+        }
+
+        //! Вызывает обработчики таймеров слота
+        std::size_t expireSlot( uint32_t listIdx )
+        {
+            if (m_links[listIdx].next==listIdx)
+                return 0;
+
+            // Переносим слот в отдельный список - обработчики могут добавлять таймеры в этот же слот
+            // и отменять таймеры, ещё не вызванные в этом проходе
+            const uint32_t first = m_links[listIdx].next;
+            const uint32_t last  = m_links[listIdx].prev;
+            m_links[pendingListIdx].next = first;
+            m_links[pendingListIdx].prev = last;
+            m_links[first].prev = pendingListIdx;
+            m_links[last].next  = pendingListIdx;
+            m_links[listIdx].next = listIdx;
+            m_links[listIdx].prev = listIdx;
+            m_bitmaps[listIdx/numSlots] &= ~((uint64_t)1<<(listIdx%numSlots));
+
+            for(uint32_t idx=first; idx!=pendingListIdx; idx=m_links[idx].next)
+                m_nodes[idx].listIdx = (uint16_t)pendingListIdx;
+
+            std::size_t fired = 0;
+
+            while(m_links[pendingListIdx].next!=pendingListIdx)
+            {
+                const uint32_t idx = m_links[pendingListIdx].next;
+                unlinkNode(idx);
+
+                Node &n = m_nodes[idx];
+                ITimerHandler  *pHandler = n.pHandler;
+                const unsigned  eventId  = n.eventId;
+
+                if (n.period)
+                {
+                    n.expires = (n.expires+n.period>m_curTime) ? n.expires+n.period : m_curTime+n.period;
+                    insertNode(idx);
+                }
+                else
+                {
+                    freeNode(idx);
+                }
+
+                ++fired;
+                if (pHandler)
+                    pHandler->onTimer(eventId); // Может изменить m_nodes - ссылки на узлы дальше не используются
+            }
+
+            return fired;
+        }
+
+
+        uint64_t                m_curTime;
+        std::size_t             m_numTimers;
+        std::vector<Link>       m_links;      //!< Головы списков, затем узлы таймеров
+        std::vector<Node>       m_nodes;      //!< Параллельно m_links
+        std::vector<uint32_t>   m_freeNodes;
+        uint64_t                m_bitmaps[numLevels]; //!< Непустые слоты уровней
+
+}; // class TimerWheel
+
+//----------------------------------------------------------------------------
+
+
+
+
+#if defined(UMBA_LINUX_USED)
+
+//----------------------------------------------------------------------------
+//! Сервис таймеров на базе TimerWheel и timerfd
+/*!
+    Время - CLOCK_MONOTONIC в милисекундах. Текущее время читается один раз на processEvents
+    и доступно обработчикам через getCachedTimeMs() без системных вызовов.
+
+    timerfd перевзводится только при изменении ближайшего срока.
+ */
+class TimerService
+{
+    public:
+
+        //! Конструктор. Создаёт timerfd, при ошибке бросает std::runtime_error
+        TimerService()
+        : m_fd(-1)
+        , m_armedTime(0)
+        , m_bArmed(false)
+        , m_wheel(readClockMs())
+        {
+            m_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (m_fd<0)
+            {
+                #ifdef UMBA_DEBUGBREAK
+                    UMBA_DEBUGBREAK();
+                #endif
+                throw std::runtime_error("TimerService: timerfd_create failed");
+            }
+        }
+
+        ~TimerService()
+        {
+            if (m_fd>=0)
+                ::close(m_fd);
+        }
+
+        UMBA_NON_COPYABLE_CLASS(TimerService)
+
+    public:
+
+        //! Дескриптор для poll/epoll - готов к чтению, когда пора вызвать processEvents
+        int getFd() const { return m_fd; }
+
+        //! Добавляет таймер: первое срабатывание через delayMs, затем - каждые periodMs (0 - однократный)
+        TimerId addTimer( ITimerHandler *pHandler, unsigned eventId, TimeTick delayMs, TimeTick periodMs = 0 )
+        {
+            TimerId id = m_wheel.addTimerAt(pHandler, eventId, readClockMs()+(uint64_t)delayMs, (uint64_t)periodMs);
+            rearm();
+            return id;
+        }
+
+        //! Отменяет таймер
+        bool cancelTimer( TimerId id )
+        {
+            return m_wheel.cancelTimer(id);
+            // Не перевзводим - лишнее пробуждение дешевле системного вызова на каждую отмену
+        }
+
+        bool isTimerActive( TimerId id ) const { return m_wheel.isTimerActive(id); }
+
+        std::size_t size() const { return m_wheel.size(); }
+
+        //! Время последнего processEvents (мс, CLOCK_MONOTONIC)
+        uint64_t getCachedTimeMs() const { return m_wheel.getCurTime(); }
+
+        //! Обрабатывает сработавшие таймеры и перевзводит timerfd. Возвращает количество срабатываний
+        std::size_t processEvents()
+        {
+            uint64_t expirations = 0;
+            while(::read(m_fd, &expirations, sizeof(expirations))<0 && errno==EINTR) {}
+
+            m_bArmed = false;
+            std::size_t fired = m_wheel.advance(readClockMs());
+            rearm();
+            return fired;
+        }
+
+        //! Ждёт срабатывания таймеров не дольше timeoutMs (-1 - без ограничения) и обрабатывает их
+        std::size_t runOnce( int timeoutMs = -1 )
+        {
+            pollfd pfd;
+            pfd.fd      = m_fd;
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+
+            int res = ::poll(&pfd, 1, timeoutMs);
+            if (res<=0)
+                return 0;
+
+            return processEvents();
+        }
+
+        //! Прямой доступ к колесу таймеров
+        TimerWheel& getWheel() { return m_wheel; }
+
+
+    protected:
+
+        static uint64_t readClockMs()
+        {
+            timespec ts;
+            ts.tv_sec  = 0;
+            ts.tv_nsec = 0;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (uint64_t)ts.tv_sec*1000u + (uint64_t)ts.tv_nsec/1000000u;
+        }
+
+        void rearm()
+        {
+            uint64_t t = 0;
+            if (!m_wheel.getNextExpiry(t))
+                return; // Пустое колесо - лишнее срабатывание ничего не сделает
+
+            if (m_bArmed && m_armedTime<=t)
+                return;
+
+            itimerspec its;
+            its.it_interval.tv_sec  = 0;
+            its.it_interval.tv_nsec = 0;
+            its.it_value.tv_sec     = (time_t)(t/1000u);
+            its.it_value.tv_nsec    = (long)(t%1000u)*1000000l;
+            if (!its.it_value.tv_sec && !its.it_value.tv_nsec)
+                its.it_value.tv_nsec = 1; // Нулевое значение снимает таймер
+
+            ::timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &its, 0);
+            m_armedTime = t;
+            m_bArmed    = true;
+        }
+
+        int         m_fd;
+        uint64_t    m_armedTime;
+        bool        m_bArmed;
+        TimerWheel  m_wheel;
+
+}; // class TimerService
+
+//----------------------------------------------------------------------------
+
+#endif // UMBA_LINUX_USED
+
+
+
+} // namespace time_service
+} // namespace umba
+
@@ -11,7 +11,16 @@
 #include "utf8.h"
 
 //
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 
 #define UMBA_TRANSLITERTION_IMPLEMENT_GET_TRANSLIT_MAP(whichMap)                            \
@@ -195,6 +204,7 @@ std::string transliterateEx( const std::string &str
     //const std::unordered_map<std::string, std::string> &m = getTransliterationMapUtf8();
 
     std::string resStr; resStr.reserve(str.size()/2u);
+    std::string curUtfSymbol; // переиспользуется для всех символов
 
     std::size_t idx = 0;
     while(idx<str.size())
@@ -207,7 +217,7 @@ std::string transliterateEx( const std::string &str
         if (idxNext>str.size())
             break;
 
-        std::string curUtfSymbol = std::string(str, idx, idxNext-idx);
+        curUtfSymbol.assign(str, idx, idxNext-idx);
         std::unordered_map<std::string, std::string>::const_iterator it = m.find(curUtfSymbol);
         if (it==m.end())
         {
@@ -228,24 +238,302 @@ std::string transliterateEx( const std::string &str
 }
 
 //----------------------------------------------------------------------------
+//! Скомпилированный транслитератор
+/*!
+    Строится один раз из набора карт транслитерации (более поздние карты перекрывают более ранние,
+    как в mergeTransliterationMaps), дальше работает без аллокаций на каждый символ.
+
+    - ключи из одного символа UTF-8 из BMP (U+0000-U+FFFF) - в плоской двухуровневой таблице по коду символа;
+    - прочие ключи (символы вне BMP и ключи из нескольких символов) - в префиксном дереве (trie) по байтам,
+      выбирается самое длинное совпадение.
+
+    Поведение совпадает с transliterateEx: незнакомые символы пропускаются (или копируются как есть,
+    если replaceChar не нулевой), на некорректной последовательности UTF-8 обработка прекращается.
+    В отличие от transliterateEx, ключи из нескольких символов тоже учитываются.
+ */
+class Transliterator
+{
+
+public:
+
+    typedef std::unordered_map<std::string, std::string>  MapType;
+
+    Transliterator() {}
+
+    //! Строит транслитератор из набора карт (карты только читаются, ссылки не сохраняются)
+    explicit Transliterator( const std::vector<const MapType*> &maps )
+    {
+        for(const MapType *pMap : maps)
+        {
+            if (pMap)
+                addMap(*pMap);
+        }
+    }
+
+    //! Строит транслитератор из набора карт
+    explicit Transliterator( const std::vector<MapType> &maps )
+    {
+        for(const MapType &m : maps)
+            addMap(m);
+    }
+
+    //! Добавляет карту, её значения перекрывают ранее добавленные
+    void addMap( const MapType &m )
+    {
+        MapType::const_iterator it = m.begin();
+        for(; it!=m.end(); ++it)
+            addPair(it->first, it->second);
+    }
+
+    //! Добавляет пару ключ/значение, значение перекрывает ранее добавленное
+    void addPair( const std::string &key, const std::string &value )
+    {
+        if (key.empty())
+            return;
+
+        std::uint32_t valueIdx = addValue(value);
+
+        std::uint32_t cp = 0;
+        if (decodeBmpSymbol(key.data(), key.size(), cp)==key.size())
+        {
+            std::uint32_t pageIdx = cp>>8;
+            if (m_pageIndex[pageIdx]==0)
+            {
+                m_pages.resize(m_pages.size()+256, 0);
+                m_pageIndex[pageIdx] = (std::uint32_t)(m_pages.size()/256); // страницы нумеруются с 1
+            }
+            m_pages[(m_pageIndex[pageIdx]-1)*256 + (cp&0xFFu)] = valueIdx;
+            return;
+        }
+
+        if (m_trie.empty())
+            m_trie.emplace_back();
+
+        std::uint32_t nodeIdx = 0;
+        for(char ch : key)
+            nodeIdx = getOrAddChild(nodeIdx, (unsigned char)ch);
+        m_trie[nodeIdx].valueIdx = valueIdx;
+        m_trieFirstBytes[(unsigned char)key[0]] = true;
+    }
+
+    //! Транслитерирует str, дописывая результат в out
+    void transliterate( std::string &out, std::string_view str, char replaceChar = 0 ) const
+    {
+        out.reserve(out.size()+str.size());
+
+        const char *p = str.data();
+        std::size_t size = str.size();
+        std::size_t idx  = 0;
+
+        while(idx<size)
+        {
+            std::size_t nCharBytes = getNumberOfCharsUtf8((utf8_char_t)p[idx]);
+            if (nCharBytes==0 || idx+nCharBytes>size)
+                break;
+
+            if (m_trieFirstBytes[(unsigned char)p[idx]])
+            {
+                std::size_t matchLen = 0;
+                std::uint32_t valueIdx = matchTrie(p+idx, size-idx, matchLen);
+                if (valueIdx!=0)
+                {
+                    appendValue(out, valueIdx);
+                    idx += matchLen;
+                    continue;
+                }
+            }
+
+            std::uint32_t valueIdx = 0;
+            std::uint32_t cp = 0;
+            if (decodeBmpSymbol(p+idx, nCharBytes, cp)==nCharBytes)
+            {
+                std::uint32_t pageNo = m_pageIndex[cp>>8];
+                if (pageNo!=0)
+                    valueIdx = m_pages[(pageNo-1)*256 + (cp&0xFFu)];
+            }
+
+            if (valueIdx!=0)
+                appendValue(out, valueIdx);
+            else if (replaceChar!=0) // либо заменяем, либо пропускаем
+                out.append(p+idx, nCharBytes);
+
+            idx += nCharBytes;
+        }
+    }
+
+    //! Транслитерирует строку
+    std::string operator()( std::string_view str, char replaceChar = 0 ) const
+    {
+        std::string res;
+        transliterate(res, str, replaceChar);
+        return res;
+    }
+
+
+protected:
+
+    struct TrieNode
+    {
+        std::uint32_t                                        valueIdx = 0;
+        std::vector< std::pair<unsigned char, std::uint32_t> > children; // отсортированы по символу
+    };
+
+    //! Декодирует один символ UTF-8 из BMP в каноничной записи. Возвращает количество байт или 0
+    static std::size_t decodeBmpSymbol( const char *p, std::size_t size, std::uint32_t &cp )
+    {
+        unsigned char b0 = (unsigned char)p[0];
+        if (b0<0x80u)
+        {
+            cp = b0;
+            return 1;
+        }
+
+        if (b0>=0xC2u && b0<=0xDFu && size>=2)
+        {
+            unsigned char b1 = (unsigned char)p[1];
+            if ((b1&0xC0u)!=0x80u)
+                return 0;
+            cp = ((b0&0x1Fu)<<6) | (b1&0x3Fu);
+            return 2;
+        }
+
+        if ((b0&0xF0u)==0xE0u && size>=3)
+        {
+            unsigned char b1 = (unsigned char)p[1];
+            unsigned char b2 = (unsigned char)p[2];
+            if ((b1&0xC0u)!=0x80u || (b2&0xC0u)!=0x80u)
+                return 0;
+            cp = ((b0&0x0Fu)<<12) | ((b1&0x3Fu)<<6) | (b2&0x3Fu);
+            if (cp<0x800u) // overlong
+                return 0;
+            return 3;
+        }
+
+        return 0;
+    }
+
+    std::uint32_t addValue( const std::string &value )
+    {
+        m_values.push_back(std::make_pair((std::uint32_t)m_valuesBuf.size(), (std::uint32_t)value.size()));
+        m_valuesBuf.append(value);
+        return (std::uint32_t)m_values.size(); // индексы значений начинаются с 1
+    }
+
+    void appendValue( std::string &out, std::uint32_t valueIdx ) const
+    {
+        const std::pair<std::uint32_t, std::uint32_t> &v = m_values[valueIdx-1];
+        out.append(m_valuesBuf.data()+v.first, v.second);
+    }
+
+    std::uint32_t findChild( std::uint32_t nodeIdx, unsigned char ch ) const
+    {
+        const auto &children = m_trie[nodeIdx].children;
+        auto it = std::lower_bound( children.begin(), children.end(), ch
+                                  , []( const std::pair<unsigned char, std::uint32_t> &c, unsigned char v ) { return c.first<v; }
+                                  );
+        return (it!=children.end() && it->first==ch) ? it->second : 0;
+    }
+
+    std::uint32_t getOrAddChild( std::uint32_t nodeIdx, unsigned char ch )
+    {
+        std::uint32_t childIdx = findChild(nodeIdx, ch);
+        if (childIdx!=0)
+            return childIdx;
+
+        childIdx = (std::uint32_t)m_trie.size();
+        m_trie.emplace_back();
+
+        auto &children = m_trie[nodeIdx].children;
+        auto it = std::lower_bound( children.begin(), children.end(), ch
+                                  , []( const std::pair<unsigned char, std::uint32_t> &c, unsigned char v ) { return c.first<v; }
+                                  );
+        children.insert(it, std::make_pair(ch, childIdx));
+        return childIdx;
+    }
+
+    //! Ищет самое длинное совпадение в trie, возвращает индекс значения (0 - не найдено)
+    std::uint32_t matchTrie( const char *p, std::size_t size, std::size_t &matchLen ) const
+    {
+        std::uint32_t bestValueIdx = 0;
+        std::uint32_t nodeIdx      = 0;
+        for(std::size_t i=0; i!=size; ++i)
+        {
+            nodeIdx = findChild(nodeIdx, (unsigned char)p[i]);
+            if (nodeIdx==0)
+                break;
+            if (m_trie[nodeIdx].valueIdx!=0)
+            {
+                bestValueIdx = m_trie[nodeIdx].valueIdx;
+                matchLen     = i+1;
+            }
+        }
+        return bestValueIdx;
+    }
+
+
+    std::uint32_t                                          m_pageIndex[256] = { 0 };       //!< Номер страницы (с 1) для старшего байта кода символа
+    std::vector<std::uint32_t>                             m_pages;                         //!< Страницы по 256 индексов значений
+    std::vector<TrieNode>                                  m_trie;                          //!< Узел 0 - корень
+    bool                                                   m_trieFirstBytes[256] = { false };
+    std::vector< std::pair<std::uint32_t, std::uint32_t> > m_values;                        //!< Смещение и длина значения в m_valuesBuf
+    std::string                                            m_valuesBuf;
+
+}; // class Transliterator
+
+//----------------------------------------------------------------------------
+//! Возвращает скомпилированный транслитератор для набора карт, кэшируя его по адресам карт
+/*! Карты должны жить (и не изменяться) всё время работы программы - как карты, возвращаемые функциями get*Map*
+ */
+inline
+const Transliterator& getCompiledTransliterator( const std::vector<const std::unordered_map<std::string, std::string>*> &maps )
+{
+    static std::mutex mtx;
+    static std::map< std::vector<const std::unordered_map<std::string, std::string>*>, std::unique_ptr<Transliterator> > cache;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto &pTranslit = cache[maps];
+    if (!pTranslit)
+        pTranslit.reset(new Transliterator(maps));
+
+    return *pTranslit;
+}
+
+//----------------------------------------------------------------------------
+//! Транслитерация набором карт через кэшированный скомпилированный транслитератор (см. getCompiledTransliterator)
 inline
 std::string transliterateEx( const std::string &str
-                           , const std::vector< std::unordered_map<std::string, std::string> > &mv
+                           , const std::vector<const std::unordered_map<std::string, std::string>*> &maps
                            , char replaceChar = 0
                            )
 {
-    return transliterateEx(str, mergeTransliterationMaps(mv), replaceChar );
+    return getCompiledTransliterator(maps)(str, replaceChar);
+}
+
+//----------------------------------------------------------------------------
+//! Транслитерация набором карт. Транслитератор строится на каждый вызов
+/*! Карты передаются по значению, поэтому закэшировать транслитератор по ним нельзя.
+    Следует использовать версию с указателями на карты или getCompiledTransliterator.
+ */
+UMBA_DECLARE_DEPRECATED_FN_MSG( "Builds a Transliterator on every call, use the overload taking map pointers or getCompiledTransliterator"
+                              , inline std::string transliterateEx( const std::string &str
+                                                                  , const std::vector< std::unordered_map<std::string, std::string> > &mv
+                                                                  , char replaceChar = 0
+                                                                  )
+                              )
+{
+    return Transliterator(mv)(str, replaceChar);
 }
 
 //----------------------------------------------------------------------------
 inline
 std::string transliterate( const std::string &str )
 {
-    return transliterateEx( str
-                          , std::vector< std::unordered_map<std::string, std::string> >{ getTransliterationMapUtf8_ru()
-                                                                                       , getTransliterationMapUtf8_ascii()
-                                                                                       }
-                          );
+    static const Transliterator &translit = getCompiledTransliterator( { &getTransliterationMapUtf8_ru()
+                                                                       , &getTransliterationMapUtf8_ascii()
+                                                                       }
+                                                                     );
+    return translit(str);
 }
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,1076 @@
+/*! \file
+    \author Alexander Martynov (Marty AKA al-martyn1) <amart@mail.ru>
+    \copyright (c) 2018-2026 Alexander Martynov
+    \brief Типобезопасное форматирование строк в стиле printf ("%d") и в стиле std::format ("{}")
+
+    Repository: https://github.com/al-martyn1/umba
+*/
+
+#pragma once
+
+//----------------------------------------------------------------------------
+/*
+    Замена string_plus::format_print:
+      - аргументы передаются через variadic template, типы известны, va_list не используется;
+      - размер результата заранее оценивается сверху (длина литералов, строк и целых известна,
+        для чисел с плавающей точкой - по порядку числа и точности), память выделяется один раз,
+        ничего не обрезается, alloca/VLA не используются;
+      - форматная строка, завёрнутая в UMBA_FMT("..."), разбирается на этапе компиляции,
+        там же проверяются количество и типы аргументов (static_assert);
+      - обычная строка (std::string_view) разбирается при вызове, ошибки - std::runtime_error.
+
+    Стиль printf (format_printf/format_printf_to):
+        %[флаги][ширина][.точность][модификатор длины]преобразование
+        флаги "-+ #0", модификаторы длины (h, hh, l, ll, L, q, j, z, t) игнорируются - тип аргумента известен,
+        преобразования: d i u x X o c s f F e E g G a A p, "%%" - символ '%'.
+        Для u/x/X/o отрицательные значения выводятся так же, как у printf с соответствующим модификатором длины.
+
+    Стиль std::format (format/format_to):
+        {} или {N}, с необязательной спецификацией {:[[заполнитель]<>^][+- ][#][0][ширина][.точность][тип]}
+        типы: b c d o x X e E f F g G s p, "{{" и "}}" - символы '{' и '}'.
+        Число с плавающей точкой без типа и точности выводится в кратчайшем виде (как у std::format).
+        Как и в std::format, отрицательные целые в x/X/o/b выводятся со знаком ("{:x}" для -1 - "-1"),
+        а '0' при заданном выравнивании игнорируется ("{:>08d}" для 42 - "      42").
+
+        Имена format/format_to совпадают с std::format/std::format_to. В C++20 неквалифицированный
+        вызов (после using namespace umba::string_plus) с аргументами типов из std (std::string и т.п.)
+        через ADL находит и std::format и становится неоднозначным, поэтому вызывайте их
+        с явной квалификацией umba::string_plus::.
+
+    \code
+    std::string s1 = umba::string_plus::format_printf(UMBA_FMT("%s: %08X %.3f"), name, id, val);
+    std::string s2 = umba::string_plus::format(UMBA_FMT("{}: {:08X} {:.3f}"), name, id, val);
+    umba::string_plus::format_to(buf, userFormat, a, b); // разбор при вызове
+    \endcode
+ */
+
+#include "format_utils.h"
+#include "string_plus.h"
+//
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+//----------------------------------------------------------------------------
+//! Форматная строка, разбираемая на этапе компиляции
+#define UMBA_FMT(str)                                                                  \
+    ([]()                                                                              \
+     {                                                                                 \
+         struct umba_fmt_string_holder : ::umba::string_plus::compiled_format_tag      \
+         {                                                                             \
+             static constexpr std::string_view value() { return str; }                 \
+         };                                                                            \
+         return umba_fmt_string_holder{};                                              \
+     }())
+
+
+// umba::string_plus::
+namespace umba{
+namespace string_plus{
+
+
+//----------------------------------------------------------------------------
+//! Синтаксис форматной строки
+enum class format_syntax
+{
+    printf,  //!< "%d"
+    braces   //!< "{}"
+};
+
+//----------------------------------------------------------------------------
+//! Базовый класс для типов, создаваемых UMBA_FMT
+struct compiled_format_tag {};
+
+//----------------------------------------------------------------------------
+//! Элемент разобранной форматной строки - литерал или подстановка аргумента
+struct format_segment
+{
+    std::uint32_t  pos       = 0;     //!< Литерал - позиция в форматной строке
+    std::uint32_t  len       = 0;     //!< Литерал - длина
+    bool           is_arg    = false;
+    char           conv      = 0;     //!< Тип преобразования, 0 - по умолчанию (только для "{}")
+    char           align     = 0;     //!< 0 - по умолчанию, '<', '>', '^'
+    char           fill      = ' ';
+    char           sign      = 0;     //!< 0, '+', ' '
+    bool           alt       = false; //!< '#'
+    bool           zero_pad  = false; //!< '0'
+    std::int32_t   width     = 0;
+    std::int32_t   precision = -1;
+    std::uint32_t  arg_index = 0;
+};
+
+//----------------------------------------------------------------------------
+//! Категория аргумента
+enum class format_arg_kind : unsigned char
+{
+    none,
+    int_signed,
+    int_unsigned,
+    boolean,
+    character,
+    floating,
+    long_floating,
+    string,
+    pointer
+};
+
+//----------------------------------------------------------------------------
+//! Аргумент форматирования со стёртым типом
+struct format_arg
+{
+    format_arg_kind  kind      = format_arg_kind::none;
+    unsigned char    int_size  = 8;     //!< sizeof исходного целого - для u/x/X/o с отрицательными значениями
+    bool             is_single = false; //!< Исходный тип - float
+
+    union
+    {
+        std::int64_t     i;
+        std::uint64_t    u;
+        double           d;
+        long double      ld;
+        const void      *p;
+        char             c;
+        bool             b;
+        struct
+        {
+            const char  *ptr;
+            std::size_t  len;
+        } s;
+    };
+
+    format_arg() : u(0) {}
+};
+
+
+
+//! @cond Doxygen_Suppress_Not_Documented
+namespace typed_format_details{
+
+const std::size_t npos = (std::size_t)-1;
+
+constexpr bool is_digit(char ch) { return ch>='0' && ch<='9'; }
+
+constexpr bool is_one_of(char ch, const char *chars)
+{
+    for(; *chars; ++chars)
+    {
+        if (*chars==ch)
+            return true;
+    }
+    return false;
+}
+
+constexpr std::size_t parse_uint(std::string_view fmt, std::size_t &pos)
+{
+    std::size_t res = 0;
+    for(; pos<fmt.size() && is_digit(fmt[pos]); ++pos)
+        res = res*10 + (std::size_t)(fmt[pos]-'0');
+    return res;
+}
+
+// Оценка сверху количества сегментов: каждый спецсимвол даёт не более двух сегментов
+constexpr std::size_t max_format_segments(std::string_view fmt)
+{
+    std::size_t n = 1;
+    for(std::size_t i=0; i!=fmt.size(); ++i)
+    {
+        if (fmt[i]=='%' || fmt[i]=='{' || fmt[i]=='}')
+            n += 2;
+    }
+    return n;
+}
+
+constexpr void add_literal(format_segment *segs, std::size_t &numSegs, std::size_t b, std::size_t e)
+{
+    if (b>=e)
+        return;
+
+    format_segment seg;
+    seg.pos = (std::uint32_t)b;
+    seg.len = (std::uint32_t)(e-b);
+    segs[numSegs++] = seg;
+}
+
+// Разбор спецификации printf после '%'. Возвращает позицию за спецификацией или npos
+constexpr std::size_t parse_printf_spec(std::string_view fmt, std::size_t pos, format_segment &seg)
+{
+    seg.align = '>';
+
+    for(; pos<fmt.size() && is_one_of(fmt[pos], "-+ #0"); ++pos)
+    {
+        switch(fmt[pos])
+        {
+            case '-': seg.align    = '<' ; break;
+            case '+': seg.sign     = '+' ; break;
+            case ' ': if (seg.sign!='+') seg.sign = ' '; break;
+            case '#': seg.alt      = true; break;
+            case '0': seg.zero_pad = true; break;
+        }
+    }
+
+    seg.width = (std::int32_t)parse_uint(fmt, pos);
+
+    if (pos<fmt.size() && fmt[pos]=='.')
+    {
+        ++pos;
+        seg.precision = (std::int32_t)parse_uint(fmt, pos);
+    }
+
+    for(; pos<fmt.size() && is_one_of(fmt[pos], "hlLqjzt"); ++pos) {}
+
+    if (pos>=fmt.size() || !is_one_of(fmt[pos], "diuxXocsfFeEgGaAp"))
+        return npos;
+
+    seg.conv = fmt[pos]=='i' ? 'd' : fmt[pos];
+    return pos+1;
+}
+
+// Разбор "{...}" после '{'. Возвращает позицию за '}' или npos
+constexpr std::size_t parse_braces_spec(std::string_view fmt, std::size_t pos, format_segment &seg, std::size_t &autoIndex)
+{
+    if (pos<fmt.size() && is_digit(fmt[pos]))
+        seg.arg_index = (std::uint32_t)parse_uint(fmt, pos);
+    else
+        seg.arg_index = (std::uint32_t)autoIndex++;
+
+    if (pos<fmt.size() && fmt[pos]==':')
+    {
+        ++pos;
+
+        if (pos+1<fmt.size() && is_one_of(fmt[pos+1], "<>^"))
+        {
+            seg.fill  = fmt[pos];
+            seg.align = fmt[pos+1];
+            pos += 2;
+        }
+        else if (pos<fmt.size() && is_one_of(fmt[pos], "<>^"))
+        {
+            seg.align = fmt[pos++];
+        }
+
+        if (pos<fmt.size() && is_one_of(fmt[pos], "+- "))
+        {
+            seg.sign = fmt[pos]=='-' ? (char)0 : fmt[pos];
+            ++pos;
+        }
+
+        if (pos<fmt.size() && fmt[pos]=='#')
+        {
+            seg.alt = true;
+            ++pos;
+        }
+
+        if (pos<fmt.size() && fmt[pos]=='0')
+        {
+            seg.zero_pad = seg.align==0; // Как в std::format - при заданном выравнивании '0' игнорируется
+            ++pos;
+        }
+
+        seg.width = (std::int32_t)parse_uint(fmt, pos);
+
+        if (pos<fmt.size() && fmt[pos]=='.')
+        {
+            ++pos;
+            if (pos>=fmt.size() || !is_digit(fmt[pos]))
+                return npos;
+            seg.precision = (std::int32_t)parse_uint(fmt, pos);
+        }
+
+        if (pos<fmt.size() && is_one_of(fmt[pos], "bcdoxXeEfFgGsp"))
+            seg.conv = fmt[pos++];
+    }
+
+    if (pos>=fmt.size() || fmt[pos]!='}')
+        return npos;
+
+    return pos+1;
+}
+
+// Разбирает форматную строку. Возвращает количество сегментов или npos при ошибке
+template<format_syntax Syntax>
+constexpr std::size_t parse_format(std::string_view fmt, format_segment *segs, std::size_t maxSegs, std::size_t &numArgs)
+{
+    std::size_t numSegs   = 0;
+    std::size_t autoIndex = 0;
+    std::size_t litStart  = 0;
+    std::size_t pos       = 0;
+
+    numArgs = 0;
+
+    while(pos<fmt.size())
+    {
+        char ch = fmt[pos];
+
+        if (Syntax==format_syntax::printf ? ch!='%' : (ch!='{' && ch!='}'))
+        {
+            ++pos;
+            continue;
+        }
+
+        add_literal(segs, numSegs, litStart, pos);
+
+        if (pos+1<fmt.size() && fmt[pos+1]==ch) // "%%", "{{", "}}"
+        {
+            litStart = pos+1;
+            pos     += 2;
+            continue;
+        }
+
+        if (ch=='}') // Одиночная '}'
+            return npos;
+
+        format_segment seg;
+        seg.is_arg = true;
+
+        if constexpr (Syntax==format_syntax::printf)
+        {
+            seg.arg_index = (std::uint32_t)autoIndex++;
+            pos = parse_printf_spec(fmt, pos+1, seg);
+        }
+        else
+        {
+            pos = parse_braces_spec(fmt, pos+1, seg, autoIndex);
+        }
+
+        if (pos==npos || numSegs>=maxSegs)
+            return npos;
+
+        segs[numSegs++] = seg;
+        if (numArgs<(std::size_t)seg.arg_index+1)
+            numArgs = (std::size_t)seg.arg_index+1;
+
+        litStart = pos;
+    }
+
+    add_literal(segs, numSegs, litStart, pos);
+
+    return numSegs;
+}
+
+//------------------------------
+constexpr bool is_float_conv(char conv)
+{
+    switch(conv)
+    {
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            return true;
+        default:
+            return false;
+    }
+}
+
+constexpr bool is_integer_conv(char conv)
+{
+    switch(conv)
+    {
+        case 'b': case 'c': case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            return true;
+        default:
+            return false;
+    }
+}
+
+//------------------------------
+// Допустимо ли преобразование conv для аргумента вида kind
+constexpr bool conv_accepts(char conv, format_arg_kind kind)
+{
+    switch(kind)
+    {
+        case format_arg_kind::int_signed   :
+        case format_arg_kind::int_unsigned :
+            return conv==0 || is_integer_conv(conv) || is_float_conv(conv);
+
+        case format_arg_kind::boolean      :
+        case format_arg_kind::character    :
+            return conv==0 || conv=='s' || is_integer_conv(conv) || is_float_conv(conv);
+
+        case format_arg_kind::floating     :
+        case format_arg_kind::long_floating:
+            return conv==0 || is_float_conv(conv);
+
+        case format_arg_kind::string       :
+            return conv==0 || conv=='s';
+
+        case format_arg_kind::pointer      :
+            return conv==0 || conv=='p';
+
+        default:
+            return false;
+    }
+}
+
+//------------------------------
+template<typename T>
+constexpr format_arg_kind arg_kind_of()
+{
+    typedef std::decay_t<T> Type;
+
+    if constexpr (std::is_same<Type, bool>::value)
+        return format_arg_kind::boolean;
+    else if constexpr (std::is_same<Type, char>::value)
+        return format_arg_kind::character;
+    else if constexpr (std::is_integral<Type>::value)
+        return std::is_signed<Type>::value ? format_arg_kind::int_signed : format_arg_kind::int_unsigned;
+    else if constexpr (std::is_enum<Type>::value)
+        return arg_kind_of<std::underlying_type_t<Type>>();
+    else if constexpr (std::is_same<Type, long double>::value)
+        return format_arg_kind::long_floating;
+    else if constexpr (std::is_floating_point<Type>::value)
+        return format_arg_kind::floating;
+    else if constexpr (std::is_same<Type, char*>::value || std::is_same<Type, const char*>::value || std::is_convertible<const Type&, std::string_view>::value)
+        return format_arg_kind::string;
+    else if constexpr (std::is_pointer<Type>::value || std::is_same<Type, std::nullptr_t>::value)
+        return format_arg_kind::pointer;
+    else
+        return format_arg_kind::none;
+}
+
+template<typename T> inline
+format_arg make_arg(const T &val)
+{
+    typedef std::decay_t<T> Type;
+    constexpr format_arg_kind kind = arg_kind_of<T>();
+
+    static_assert(kind!=format_arg_kind::none, "umba::string_plus::format: argument type is not supported");
+
+    format_arg arg;
+    arg.kind = kind;
+
+    if constexpr (kind==format_arg_kind::boolean)
+        arg.b = val;
+    else if constexpr (kind==format_arg_kind::character)
+        arg.c = val;
+    else if constexpr (std::is_enum<Type>::value)
+        return make_arg((std::underlying_type_t<Type>)val);
+    else if constexpr (kind==format_arg_kind::int_signed)
+    {
+        arg.i        = (std::int64_t)val;
+        arg.int_size = (unsigned char)sizeof(Type);
+    }
+    else if constexpr (kind==format_arg_kind::int_unsigned)
+    {
+        arg.u        = (std::uint64_t)val;
+        arg.int_size = (unsigned char)sizeof(Type);
+    }
+    else if constexpr (kind==format_arg_kind::long_floating)
+        arg.ld = val;
+    else if constexpr (kind==format_arg_kind::floating)
+    {
+        arg.d         = (double)val;
+        arg.is_single = std::is_same<Type, float>::value;
+    }
+    else if constexpr (kind==format_arg_kind::string)
+    {
+        if constexpr (std::is_array<T>::value)
+        {
+            arg.s.ptr = val;
+            arg.s.len = std::strlen(val);
+        }
+        else if constexpr (std::is_pointer<Type>::value)
+        {
+            arg.s.ptr = val ? val : "(null)";
+            arg.s.len = std::strlen(arg.s.ptr);
+        }
+        else
+        {
+            std::string_view sv = val;
+            arg.s.ptr = sv.data();
+            arg.s.len = sv.size();
+        }
+    }
+    else // pointer
+        arg.p = (const void*)val;
+
+    return arg;
+}
+
+//------------------------------
+[[noreturn]] inline
+void throw_format_error(const char *msg)
+{
+    #ifdef UMBA_DEBUGBREAK
+        UMBA_DEBUGBREAK();
+    #endif
+    throw std::runtime_error(std::string("umba::string_plus::format: ") + msg);
+}
+
+//------------------------------
+// Длина префикса числа с плавающей точкой, после которого ставятся ведущие нули: знак и, для a/A, "0x"/"0X"
+constexpr std::size_t float_prefix_len( const char *body, std::size_t bodyLen, char conv, bool &finite )
+{
+    std::size_t prefixLen = bodyLen && (body[0]=='-' || body[0]=='+' || body[0]==' ') ? 1 : 0;
+
+    finite = bodyLen>prefixLen && (is_digit(body[prefixLen]) || body[prefixLen]=='.');
+
+    if (finite && (conv=='a' || conv=='A') && bodyLen>prefixLen+1 && body[prefixLen]=='0' && (body[prefixLen+1]=='x' || body[prefixLen+1]=='X'))
+        prefixLen += 2;
+
+    return prefixLen;
+}
+
+constexpr std::size_t float_prefix_len( const char *body, char conv )
+{
+    bool finite = false;
+    std::size_t len = 0;
+    while(body[len]) ++len;
+    return float_prefix_len(body, len, conv, finite);
+}
+
+//------------------------------
+// Выводит [prefix][zeros][body] с выравниванием по ширине поля
+inline
+void append_padded( std::string &out, const format_segment &seg, char defaultAlign
+                  , const char *prefix, std::size_t prefixLen
+                  , std::size_t numZeros
+                  , const char *body, std::size_t bodyLen
+                  )
+{
+    std::size_t len = prefixLen+numZeros+bodyLen;
+    std::size_t pad = (std::size_t)seg.width>len ? (std::size_t)seg.width-len : 0;
+
+    if (seg.zero_pad && seg.align==0 && pad) // "{:08}" - нули после знака
+    {
+        numZeros += pad;
+        pad       = 0;
+    }
+
+    char        align = seg.align ? seg.align : defaultAlign;
+    std::size_t padL  = align=='>' ? pad : (align=='^' ? pad/2 : 0);
+
+    if (padL     ) out.append(padL, seg.fill);
+    if (prefixLen) out.append(prefix, prefixLen);
+    if (numZeros ) out.append(numZeros, '0');
+    out.append(body, bodyLen);
+    if (pad-padL ) out.append(pad-padL, seg.fill);
+}
+
+//------------------------------
+inline
+void append_integer(std::string &out, const format_segment &seg, const format_arg &arg, format_syntax syntax)
+{
+    char conv = seg.conv ? seg.conv : 'd';
+
+    bool          neg = false;
+    std::uint64_t u   = arg.u;
+
+    // std::format выводит x/o/b со знаком (знак и модуль), printf - как беззнаковое
+    bool signMagnitude = conv=='d' || syntax==format_syntax::braces;
+
+    if (signMagnitude && arg.kind==format_arg_kind::int_signed)
+    {
+        if (arg.i<0)
+        {
+            neg = true;
+            u   = 0-(std::uint64_t)arg.i;
+        }
+    }
+    else if (arg.kind==format_arg_kind::int_signed && arg.int_size<8)
+    {
+        u &= (std::uint64_t(1)<<(arg.int_size*8))-1; // Как printf с модификатором длины
+    }
+
+    unsigned base = 10;
+    switch(conv)
+    {
+        case 'x': case 'X': base = 16; break;
+        case 'o':           base = 8 ; break;
+        case 'b':           base = 2 ; break;
+    }
+
+    char        digits[umba::format_utils::maxFormattedIntegerSize];
+    std::size_t numDigits = umba::format_utils::formatUnsignedBase(digits, u, base, conv=='x' ? umba::format_utils::CaseParam::lower : umba::format_utils::CaseParam::upper);
+
+    if (seg.precision==0 && u==0 && syntax==format_syntax::printf) // printf("%.0d", 0) - пусто
+        numDigits = 0;
+
+    char        prefix[3] = { 0 };
+    std::size_t prefixLen = 0;
+
+    if (neg)
+        prefix[prefixLen++] = '-';
+    else if (seg.sign && signMagnitude)
+        prefix[prefixLen++] = seg.sign;
+
+    std::size_t numZeros = seg.precision>0 && (std::size_t)seg.precision>numDigits ? (std::size_t)seg.precision-numDigits : 0;
+
+    if (seg.alt)
+    {
+        if ((conv=='x' || conv=='X' || conv=='b') && (u!=0 || syntax==format_syntax::braces))
+        {
+            prefix[prefixLen++] = '0';
+            prefix[prefixLen++] = conv;
+        }
+        else if (conv=='o' && numZeros==0 && (numDigits==0 || digits[0]!='0'))
+        {
+            numZeros = 1;
+        }
+    }
+
+    if (seg.zero_pad && seg.align!='<' && (seg.precision<0 || syntax==format_syntax::braces))
+    {
+        std::size_t len = prefixLen+numZeros+numDigits;
+        if ((std::size_t)seg.width>len)
+            numZeros += (std::size_t)seg.width-len;
+    }
+
+    append_padded(out, seg, '>', prefix, prefixLen, numZeros, digits, numDigits);
+}
+
+//------------------------------
+inline
+void append_floating(std::string &out, const format_segment &seg, const format_arg &arg)
+{
+    char        buf[128];
+    std::string bigBuf;
+    const char *body    = buf;
+    std::size_t bodyLen = 0;
+
+    bool isLong = arg.kind==format_arg_kind::long_floating;
+
+    if (seg.conv==0 && seg.precision<0 && !isLong)
+    {
+        bodyLen = arg.is_single
+                ? umba::format_utils::formatFloatShortest(buf, sizeof(buf), (float)arg.d)
+                : umba::format_utils::formatFloatShortest(buf, sizeof(buf), arg.d);
+    }
+    else if (!isLong && !seg.alt && seg.conv!='a' && seg.conv!='A'
+          && (bodyLen=umba::format_utils::formatFloatPrecision(buf+1, sizeof(buf)-1, arg.d, seg.conv ? seg.conv : 'g', seg.precision))!=0
+            )
+    {
+        // Знак '+'/' ' для неотрицательных ставим сами, для него зарезервирован buf[0]
+        body = buf+1;
+        if (seg.sign && buf[1]!='-')
+        {
+            buf[0] = seg.sign;
+            body   = buf;
+            ++bodyLen;
+        }
+    }
+    else
+    {
+        // Ширину и выравнивание делаем сами, snprintf - только знак, '#', точность и тип
+        char  fmt[16];
+        char *pFmt = fmt;
+        *pFmt++ = '%';
+        if (seg.sign) *pFmt++ = seg.sign;
+        if (seg.alt ) *pFmt++ = '#';
+        if (seg.precision>=0) { *pFmt++ = '.'; *pFmt++ = '*'; }
+        if (isLong) *pFmt++ = 'L';
+        *pFmt++ = seg.conv ? seg.conv : 'g';
+        *pFmt   = 0;
+
+        int prec = seg.precision;
+        auto print = [&](char *p, std::size_t size)
+        {
+            if (isLong)
+                return seg.precision>=0 ? std::snprintf(p, size, fmt, prec, arg.ld) : std::snprintf(p, size, fmt, arg.ld);
+            return seg.precision>=0 ? std::snprintf(p, size, fmt, prec, arg.d) : std::snprintf(p, size, fmt, arg.d);
+        };
+
+        int n = print(buf, sizeof(buf));
+        if (n<0)
+            n = 0;
+
+        if ((std::size_t)n>=sizeof(buf))
+        {
+            bigBuf.resize((std::size_t)n+1);
+            print(&bigBuf[0], bigBuf.size());
+            bigBuf.resize((std::size_t)n);
+            body = bigBuf.data();
+        }
+
+        bodyLen = (std::size_t)n;
+    }
+
+    bool finite = false;
+    std::size_t prefixLen = float_prefix_len(body, bodyLen, seg.conv, finite);
+
+    std::size_t numZeros = 0;
+    if (seg.zero_pad && seg.align!='<' && finite && (std::size_t)seg.width>bodyLen)
+        numZeros = (std::size_t)seg.width-bodyLen;
+
+    append_padded(out, seg, '>', body, prefixLen, numZeros, body+prefixLen, bodyLen-prefixLen);
+}
+
+//------------------------------
+inline
+void append_arg(std::string &out, const format_segment &seg, const format_arg &arg, format_syntax syntax)
+{
+    if (!conv_accepts(seg.conv, arg.kind))
+        throw_format_error("argument type does not match format specifier");
+
+    switch(arg.kind)
+    {
+        case format_arg_kind::int_signed  :
+        case format_arg_kind::int_unsigned:
+            if (seg.conv=='c')
+            {
+                char ch = (char)arg.u;
+                append_padded(out, seg, '<', 0, 0, 0, &ch, 1);
+            }
+            else if (is_float_conv(seg.conv))
+            {
+                format_arg tmp;
+                tmp.kind = format_arg_kind::floating;
+                tmp.d    = arg.kind==format_arg_kind::int_signed ? (double)arg.i : (double)arg.u;
+                append_floating(out, seg, tmp);
+            }
+            else
+            {
+                append_integer(out, seg, arg, syntax);
+            }
+            return;
+
+        case format_arg_kind::boolean:
+            if (seg.conv==0 || seg.conv=='s')
+            {
+                const char *str = arg.b ? "true" : "false";
+                append_padded(out, seg, '<', 0, 0, 0, str, std::strlen(str));
+            }
+            else
+            {
+                format_arg tmp;
+                tmp.kind     = format_arg_kind::int_unsigned;
+                tmp.u        = arg.b ? 1u : 0u;
+                tmp.int_size = 1;
+                append_arg(out, seg, tmp, syntax);
+            }
+            return;
+
+        case format_arg_kind::character:
+            if (seg.conv==0 || seg.conv=='c' || seg.conv=='s')
+            {
+                append_padded(out, seg, '<', 0, 0, 0, &arg.c, 1);
+            }
+            else
+            {
+                format_arg tmp;
+                tmp.kind     = std::is_signed<char>::value ? format_arg_kind::int_signed : format_arg_kind::int_unsigned;
+                tmp.i        = (std::int64_t)arg.c;
+                tmp.int_size = 1;
+                append_arg(out, seg, tmp, syntax);
+            }
+            return;
+
+        case format_arg_kind::floating     :
+        case format_arg_kind::long_floating:
+            append_floating(out, seg, arg);
+            return;
+
+        case format_arg_kind::string:
+        {
+            std::size_t len = arg.s.len;
+            if (seg.precision>=0 && (std::size_t)seg.precision<len)
+                len = (std::size_t)seg.precision;
+
+            format_segment strSeg = seg;
+            strSeg.zero_pad = false;
+            append_padded(out, strSeg, '<', 0, 0, 0, arg.s.ptr, len);
+            return;
+        }
+
+        case format_arg_kind::pointer:
+        {
+            char        digits[umba::format_utils::maxFormattedIntegerSize];
+            std::size_t numDigits = umba::format_utils::formatUnsignedBase(digits, (std::uint64_t)(std::uintptr_t)arg.p, 16, umba::format_utils::CaseParam::lower);
+            append_padded(out, seg, '>', "0x", 2, 0, digits, numDigits);
+            return;
+        }
+
+        default:
+            throw_format_error("invalid argument");
+    }
+}
+
+//------------------------------
+// Оценка сверху длины вывода целого без учёта ширины поля: цифры или точность, знак и префикс "0x"
+inline
+std::size_t integer_size_bound(const format_segment &seg)
+{
+    std::size_t numDigits = 20;
+    switch(seg.conv)
+    {
+        case 'x': case 'X': numDigits = 16; break;
+        case 'o':           numDigits = 22; break;
+        case 'b':           numDigits = 64; break;
+    }
+
+    std::size_t prec = seg.precision>0 ? (std::size_t)seg.precision : 0;
+    return (prec>numDigits ? prec : numDigits)+4;
+}
+
+//------------------------------
+// Оценка сверху длины вывода числа с плавающей точкой без учёта ширины поля
+inline
+std::size_t float_size_bound(const format_segment &seg, long double val)
+{
+    std::size_t prec = seg.precision>=0 ? (std::size_t)seg.precision : 6;
+
+    switch(seg.conv)
+    {
+        case 'f': case 'F':
+        {
+            // Целая часть - не больше exp2*log10(2)+1 цифр, плюс знак, точка и '#'
+            int exp2 = 0;
+            if (std::isfinite(val))
+                std::frexp(val, &exp2);
+            std::size_t intDigits = exp2>0 ? (std::size_t)exp2*30103u/100000u+2 : 1;
+            return intDigits+prec+8;
+        }
+
+        case 'a': case 'A':
+            return (seg.precision>=0 ? prec : 32)+16;
+
+        case 0:
+            if (seg.precision<0)
+                return 32; // Кратчайший вид
+            return prec+16;
+
+        default: // e E g G - мантисса с точностью и порядок не длиннее 5 цифр
+            return prec+16;
+    }
+}
+
+//------------------------------
+// Оценка сверху длины вывода аргумента с учётом ширины поля
+inline
+std::size_t arg_size_bound(const format_segment &seg, const format_arg &arg)
+{
+    std::size_t len = 0;
+
+    switch(arg.kind)
+    {
+        case format_arg_kind::int_signed  :
+        case format_arg_kind::int_unsigned:
+        case format_arg_kind::boolean     :
+        case format_arg_kind::character   :
+            if (is_float_conv(seg.conv))
+                len = float_size_bound(seg, 18446744073709551616.0L); // Модуль любого 64-битного целого не больше
+            else if (seg.conv=='c' || (arg.kind==format_arg_kind::character && (seg.conv==0 || seg.conv=='s')))
+                len = 1;
+            else if (arg.kind==format_arg_kind::boolean && (seg.conv==0 || seg.conv=='s'))
+                len = 5;
+            else
+                len = integer_size_bound(seg);
+            break;
+
+        case format_arg_kind::floating     : len = float_size_bound(seg, (long double)arg.d); break;
+        case format_arg_kind::long_floating: len = float_size_bound(seg, arg.ld);             break;
+
+        case format_arg_kind::string:
+            len = seg.precision>=0 && (std::size_t)seg.precision<arg.s.len ? (std::size_t)seg.precision : arg.s.len;
+            break;
+
+        case format_arg_kind::pointer:
+            len = 2+16;
+            break;
+
+        default:
+            break;
+    }
+
+    return (std::size_t)seg.width>len ? (std::size_t)seg.width : len;
+}
+
+//------------------------------
+// Литералы и аргументы дописываются прямо в out, память резервируется один раз по оценке размера сверху
+inline
+void format_segments_to( std::string &out, std::string_view fmt
+                       , const format_segment *segs, std::size_t numSegs, std::size_t numSpecArgs
+                       , const format_arg *args, std::size_t numArgs
+                       , format_syntax syntax
+                       )
+{
+    if (numSpecArgs>numArgs)
+        throw_format_error("not enough arguments");
+
+    std::size_t sizeBound = out.size();
+    for(std::size_t i=0; i!=numSegs; ++i)
+        sizeBound += segs[i].is_arg ? arg_size_bound(segs[i], args[segs[i].arg_index]) : segs[i].len;
+
+    if (sizeBound>out.capacity())
+        out.reserve(sizeBound);
+
+    for(std::size_t i=0; i!=numSegs; ++i)
+    {
+        if (segs[i].is_arg)
+            append_arg(out, segs[i], args[segs[i].arg_index], syntax);
+        else
+            out.append(fmt.data()+segs[i].pos, segs[i].len);
+    }
+}
+
+//------------------------------
+template<format_syntax Syntax, typename... Args> inline
+void format_runtime_to(std::string &out, std::string_view fmt, const Args&... args)
+{
+    const format_arg argArray[sizeof...(Args)+1] = { make_arg(args)..., format_arg() };
+
+    std::size_t maxSegs = max_format_segments(fmt);
+
+    // Без инициализации - parse_format записывает каждый используемый сегмент целиком
+    union LocalSegs { format_segment segs[32]; LocalSegs() {} } localSegs;
+
+    std::vector<format_segment>  heapSegs;
+    format_segment              *segs = localSegs.segs;
+    if (maxSegs>32)
+    {
+        heapSegs.resize(maxSegs);
+        segs = heapSegs.data();
+    }
+
+    std::size_t numArgs = 0;
+    std::size_t numSegs = parse_format<Syntax>(fmt, segs, maxSegs, numArgs);
+    if (numSegs==npos)
+        throw_format_error("invalid format string");
+
+    format_segments_to(out, fmt, segs, numSegs, numArgs, argArray, sizeof...(Args), Syntax);
+}
+
+//------------------------------
+template<typename Holder, format_syntax Syntax>
+struct compiled_format
+{
+    static constexpr std::string_view fmt      = Holder::value();
+    static constexpr std::size_t      max_segs = max_format_segments(fmt);
+
+    struct parsed
+    {
+        format_segment  segs[max_segs];
+        std::size_t     num_segs = 0;
+        std::size_t     num_args = 0;
+        bool            ok       = false;
+    };
+
+    static constexpr parsed make()
+    {
+        parsed res{};
+        std::size_t numArgs = 0;
+        std::size_t numSegs = parse_format<Syntax>(fmt, res.segs, max_segs, numArgs);
+        if (numSegs!=npos)
+        {
+            res.num_segs = numSegs;
+            res.num_args = numArgs;
+            res.ok       = true;
+        }
+        return res;
+    }
+
+    static constexpr parsed value = make();
+};
+
+template<typename Compiled, typename... Args>
+constexpr bool check_arg_types()
+{
+    constexpr format_arg_kind kinds[sizeof...(Args)+1] = { arg_kind_of<Args>()..., format_arg_kind::none };
+
+    for(std::size_t i=0; i!=Compiled::value.num_segs; ++i)
+    {
+        const format_segment &seg = Compiled::value.segs[i];
+        if (seg.is_arg && seg.arg_index<sizeof...(Args) && !conv_accepts(seg.conv, kinds[seg.arg_index]))
+            return false;
+    }
+    return true;
+}
+
+template<format_syntax Syntax, typename Holder, typename... Args> inline
+void format_compiled_to(std::string &out, const Args&... args)
+{
+    typedef compiled_format<Holder, Syntax> Compiled;
+
+    static_assert(Compiled::value.ok, "umba::string_plus::format: invalid format string");
+    static_assert(Compiled::value.num_args<=sizeof...(Args), "umba::string_plus::format: not enough arguments");
+    static_assert(check_arg_types<Compiled, Args...>(), "umba::string_plus::format: argument type does not match format specifier");
+
+    const format_arg argArray[sizeof...(Args)+1] = { make_arg(args)..., format_arg() };
+
+    format_segments_to(out, Compiled::fmt, Compiled::value.segs, Compiled::value.num_segs, Compiled::value.num_args, argArray, sizeof...(Args), Syntax);
+}
+
+template<typename T>
+using enable_if_compiled_format = std::enable_if_t<std::is_base_of<compiled_format_tag, T>::value>;
+
+} // namespace typed_format_details
+//! @endcond
+
+
+
+//----------------------------------------------------------------------------
+//! Дописывает в out строку, отформатированную в стиле printf. Форматная строка разбирается при вызове
+template<typename... Args> inline
+void format_printf_to(std::string &out, std::string_view fmt, const Args&... args)
+{
+    typed_format_details::format_runtime_to<format_syntax::printf>(out, fmt, args...);
+}
+
+//! Дописывает в out строку, отформатированную в стиле printf. Форматная строка (UMBA_FMT) разобрана при компиляции
+template<typename FmtHolder, typename... Args, typename = typed_format_details::enable_if_compiled_format<FmtHolder> > inline
+void format_printf_to(std::string &out, FmtHolder, const Args&... args)
+{
+    typed_format_details::format_compiled_to<format_syntax::printf, FmtHolder>(out, args...);
+}
+
+//! Форматирует в стиле printf. Форматная строка разбирается при вызове
+template<typename... Args> inline
+std::string format_printf(std::string_view fmt, const Args&... args)
+{
+    std::string res;
+    format_printf_to(res, fmt, args...);
+    return res;
+}
+
+//! Форматирует в стиле printf. Форматная строка (UMBA_FMT) разобрана при компиляции
+template<typename FmtHolder, typename... Args, typename = typed_format_details::enable_if_compiled_format<FmtHolder> > inline
+std::string format_printf(FmtHolder fmt, const Args&... args)
+{
+    std::string res;
+    format_printf_to(res, fmt, args...);
+    return res;
+}
+
+//----------------------------------------------------------------------------
+//! Дописывает в out строку, отформатированную в стиле std::format. Форматная строка разбирается при вызове
+template<typename... Args> inline
+void format_to(std::string &out, std::string_view fmt, const Args&... args)
+{
+    typed_format_details::format_runtime_to<format_syntax::braces>(out, fmt, args...);
+}
+
+//! Дописывает в out строку, отформатированную в стиле std::format. Форматная строка (UMBA_FMT) разобрана при компиляции
+template<typename FmtHolder, typename... Args, typename = typed_format_details::enable_if_compiled_format<FmtHolder> > inline
+void format_to(std::string &out, FmtHolder, const Args&... args)
+{
+    typed_format_details::format_compiled_to<format_syntax::braces, FmtHolder>(out, args...);
+}
+
+//! Форматирует в стиле std::format. Форматная строка разбирается при вызове
+template<typename... Args> inline
+std::string format(std::string_view fmt, const Args&... args)
+{
+    std::string res;
+    format_to(res, fmt, args...);
+    return res;
+}
+
+//! Форматирует в стиле std::format. Форматная строка (UMBA_FMT) разобрана при компиляции
+template<typename FmtHolder, typename... Args, typename = typed_format_details::enable_if_compiled_format<FmtHolder> > inline
+std::string format(FmtHolder fmt, const Args&... args)
+{
+    std::string res;
+    format_to(res, fmt, args...);
+    return res;
+}
+
+
+} // namespace string_plus
+} // namespace umba
+